@@ -245,7 +245,7 @@ ENDIF(WITH_SERVER)
 # zlib
 #----------------------------------------------------
 
-IF(WITH_CLIENT OR WITH_G2OCHECKER)
+IF(WITH_CLIENT OR WITH_G2OCHECKER OR WITH_SERVER)
 	IF(WIN32 AND NOT ANDROID AND NOT EXISTS "${SPINE_DEP_DIR}/zlib/")
 		execute_process(COMMAND ${CMAKE_SOURCE_DIR}/dependencies/build-zlib.bat ${VS_TOOLCHAIN} ${VS_ARCH} WORKING_DIRECTORY ${CMAKE_SOURCE_DIR}/dependencies)
 	ENDIF(WIN32 AND NOT ANDROID AND NOT EXISTS "${SPINE_DEP_DIR}/zlib/")
@@ -277,7 +277,7 @@ IF(WITH_CLIENT OR WITH_G2OCHECKER)
 
 		find_package(EasyFind REQUIRED COMPONENTS ${ZLIB_RELEASE_COMPONENT})
 	ENDIF(UNIX)
-ENDIF(WITH_CLIENT OR WITH_G2OCHECKER)
+ENDIF(WITH_CLIENT OR WITH_G2OCHECKER OR WITH_SERVER)
 
 #----------------------------------------------------
 # Zipper
@@ -19,8 +19,11 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
+#include <QHash>
 #include <QProgressDialog>
+#include <QVector>
 
 class QMainWindow;
 class QWinTaskbarProgress;
@@ -83,8 +86,50 @@ namespace widgets {
 		QString _gothicDirectory;
 		QString _gothic2Directory;
 
+		/**
+		 * \brief hash of a file from the last check, valid as long as size and modification time didn't change
+		 */
+		struct CachedHash {
+			QString path;
+			qint64 size;
+			qint64 modificationTime;
+			QString hash;
+
+			CachedHash() : size(-1), modificationTime(-1) {}
+
+			CachedHash(std::string s1, std::string s2, std::string s3, std::string s4) : path(QString::fromStdString(s1)), size(std::stoll(s2)), modificationTime(std::stoll(s3)), hash(QString::fromStdString(s4)) {}
+		};
+
+		struct HashJob {
+			enum Type {
+				Mod,
+				Gothic,
+				Gothic2
+			};
+
+			QString path;
+			QString referenceHash;
+			Type type;
+			int index; // in the list of mod files
+			qint64 size; // -1 if the file doesn't exist
+			qint64 modificationTime;
+			QString hash;
+			bool hashed; // not taken from the cache
+			bool processed; // false if the check was canceled before this job ran
+
+			HashJob() : type(Mod), index(-1), size(-1), modificationTime(-1), hashed(false), processed(false) {}
+
+			HashJob(QString p, QString h, Type t, int i) : path(p), referenceHash(h), type(t), index(i), size(-1), modificationTime(-1), hashed(false), processed(false) {}
+		};
+
 		void closeEvent(QCloseEvent * evt) override;
 		void process(int projectID);
+
+		QHash<QString, CachedHash> loadHashCache() const;
+		/**
+		 * \brief updates the cache with the hashed files and removes entries of files that are gone, jobs that didn't run are ignored
+		 */
+		void storeHashCache(const QVector<HashJob> & jobs) const;
 	};
 
 } /* namespace widgets */
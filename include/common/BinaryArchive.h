@@ -0,0 +1,324 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "boost/archive/archive_exception.hpp"
+#include "boost/archive/basic_archive.hpp"
+#include "boost/archive/detail/common_iarchive.hpp"
+#include "boost/archive/detail/common_oarchive.hpp"
+#include "boost/archive/detail/register_archive.hpp"
+#include "boost/serialization/collection_size_type.hpp"
+#include "boost/serialization/item_version_type.hpp"
+
+namespace spine {
+namespace common {
+
+	/**
+	 * \brief compact binary archive for the existing serialize methods of the messages
+	 * integers are written as varints (signed ones zigzag encoded), strings and byte vectors with a varint length prefix,
+	 * all types have a fixed encoding independent of platform and boost version, floating point values are written in little endian byte order
+	 */
+	class BinaryOArchive : public boost::archive::detail::common_oarchive<BinaryOArchive> {
+		friend class boost::archive::detail::interface_oarchive<BinaryOArchive>;
+		friend class boost::archive::detail::common_oarchive<BinaryOArchive>;
+		friend class boost::archive::save_access;
+
+	public:
+		explicit BinaryOArchive(std::string & buffer) : boost::archive::detail::common_oarchive<BinaryOArchive>(boost::archive::no_header), _buffer(buffer) {}
+
+		void save_binary(const void * address, std::size_t count) {
+			_buffer.append(static_cast<const char *>(address), count);
+		}
+
+	private:
+		std::string & _buffer;
+
+		template<class T>
+		void save_override(T & t) {
+			boost::archive::detail::common_oarchive<BinaryOArchive>::save_override(t);
+		}
+
+		// file contents and images, one varint per byte would be a waste
+		void save_override(const std::vector<uint8_t> & t) {
+			saveVarint(t.size());
+			save_binary(t.data(), t.size());
+		}
+
+		template<class T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type save(const T & t) {
+			saveVarint(t);
+		}
+
+		template<class T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type save(const T & t) {
+			const auto value = static_cast<int64_t>(t);
+			saveVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+		}
+
+		void save(bool t) {
+			_buffer.push_back(t ? 1 : 0);
+		}
+
+		void save(float t) {
+			uint32_t bits;
+			memcpy(&bits, &t, sizeof(bits));
+			saveFixed(bits, sizeof(bits));
+		}
+
+		void save(double t) {
+			uint64_t bits;
+			memcpy(&bits, &t, sizeof(bits));
+			saveFixed(bits, sizeof(bits));
+		}
+
+		void save(const std::string & t) {
+			saveVarint(t.size());
+			save_binary(t.data(), t.size());
+		}
+
+		void save(const std::wstring & t) {
+			saveVarint(t.size());
+
+			for (const wchar_t c : t) {
+				saveVarint(static_cast<uint32_t>(c));
+			}
+		}
+
+		void save(const boost::archive::class_name_type & t) {
+			const std::size_t size = strlen(t);
+			saveVarint(size);
+			save_binary(static_cast<const char *>(t), size);
+		}
+
+		void save(const boost::archive::version_type & t) {
+			saveVarint(static_cast<uint32_t>(t));
+		}
+
+		void save(const boost::archive::library_version_type & t) {
+			saveVarint(static_cast<uint16_t>(t));
+		}
+
+		void save(const boost::archive::class_id_type & t) {
+			save(static_cast<int16_t>(t));
+		}
+
+		void save(const boost::archive::object_id_type & t) {
+			saveVarint(static_cast<uint32_t>(t));
+		}
+
+		void save(const boost::archive::tracking_type & t) {
+			save(t.t);
+		}
+
+		void save(const boost::serialization::collection_size_type & t) {
+			saveVarint(static_cast<std::size_t>(t));
+		}
+
+		void save(const boost::serialization::item_version_type & t) {
+			saveVarint(static_cast<unsigned int>(t));
+		}
+
+		void saveVarint(uint64_t value) {
+			while (value >= 0x80) {
+				_buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+				value >>= 7;
+			}
+			_buffer.push_back(static_cast<char>(value));
+		}
+
+		void saveFixed(uint64_t value, std::size_t size) {
+			for (std::size_t i = 0; i < size; i++) {
+				_buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+			}
+		}
+	};
+
+	/**
+	 * \brief reads data written by BinaryOArchive, throws boost::archive::archive_exception on truncated or malformed input
+	 */
+	class BinaryIArchive : public boost::archive::detail::common_iarchive<BinaryIArchive> {
+		friend class boost::archive::detail::interface_iarchive<BinaryIArchive>;
+		friend class boost::archive::detail::common_iarchive<BinaryIArchive>;
+		friend class boost::archive::load_access;
+
+	public:
+		BinaryIArchive(const char * data, std::size_t size) : boost::archive::detail::common_iarchive<BinaryIArchive>(boost::archive::no_header), _data(data), _end(data + size) {}
+
+		void load_binary(void * address, std::size_t count) {
+			if (static_cast<std::size_t>(_end - _data) < count) {
+				boost::serialization::throw_exception(boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error));
+			}
+			memcpy(address, _data, count);
+			_data += count;
+		}
+
+	private:
+		const char * _data;
+		const char * _end;
+
+		template<class T>
+		void load_override(T & t) {
+			boost::archive::detail::common_iarchive<BinaryIArchive>::load_override(t);
+		}
+
+		void load_override(std::vector<uint8_t> & t) {
+			t.resize(loadSize());
+			if (!t.empty()) {
+				load_binary(t.data(), t.size());
+			}
+		}
+
+		template<class T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type load(T & t) {
+			t = static_cast<T>(loadVarint());
+		}
+
+		template<class T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type load(T & t) {
+			const uint64_t value = loadVarint();
+			t = static_cast<T>(static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1));
+		}
+
+		void load(bool & t) {
+			char c;
+			load_binary(&c, 1);
+			t = c != 0;
+		}
+
+		void load(float & t) {
+			const auto bits = static_cast<uint32_t>(loadFixed(sizeof(uint32_t)));
+			memcpy(&t, &bits, sizeof(t));
+		}
+
+		void load(double & t) {
+			const uint64_t bits = loadFixed(sizeof(uint64_t));
+			memcpy(&t, &bits, sizeof(t));
+		}
+
+		void load(std::string & t) {
+			const std::size_t size = loadSize();
+			t.assign(_data, size);
+			_data += size;
+		}
+
+		void load(std::wstring & t) {
+			const std::size_t size = loadSize();
+			t.resize(size);
+
+			for (std::size_t i = 0; i < size; i++) {
+				t[i] = static_cast<wchar_t>(loadVarint());
+			}
+		}
+
+		void load(boost::archive::class_name_type & t) {
+			std::string name;
+			load(name);
+
+			if (name.size() > BOOST_SERIALIZATION_MAX_KEY_SIZE - 1) {
+				boost::serialization::throw_exception(boost::archive::archive_exception(boost::archive::archive_exception::invalid_class_name));
+			}
+
+			memcpy(static_cast<char *>(t), name.data(), name.size());
+			static_cast<char *>(t)[name.size()] = '\0';
+		}
+
+		void load(boost::archive::version_type & t) {
+			t = boost::archive::version_type(static_cast<uint32_t>(loadVarint()));
+		}
+
+		void load(boost::archive::library_version_type & t) {
+			t = boost::archive::library_version_type(static_cast<uint16_t>(loadVarint()));
+		}
+
+		void load(boost::archive::class_id_type & t) {
+			int16_t value;
+			load(value);
+			t = boost::archive::class_id_type(value);
+		}
+
+		void load(boost::archive::object_id_type & t) {
+			t = boost::archive::object_id_type(static_cast<uint32_t>(loadVarint()));
+		}
+
+		void load(boost::archive::tracking_type & t) {
+			load(t.t);
+		}
+
+		void load(boost::serialization::collection_size_type & t) {
+			t = boost::serialization::collection_size_type(loadSize());
+		}
+
+		void load(boost::serialization::item_version_type & t) {
+			t = boost::serialization::item_version_type(static_cast<unsigned int>(loadVarint()));
+		}
+
+		uint64_t loadVarint() {
+			uint64_t value = 0;
+
+			for (unsigned int shift = 0; shift < 64; shift += 7) {
+				if (_data == _end) break;
+
+				const auto byte = static_cast<uint8_t>(*_data++);
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+				if ((byte & 0x80) == 0) return value;
+			}
+
+			boost::serialization::throw_exception(boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error));
+			return 0;
+		}
+
+		/**
+		 * \brief reads a length and checks it against the remaining input, so a corrupt packet can't trigger a huge allocation
+		 */
+		std::size_t loadSize() {
+			const uint64_t size = loadVarint();
+
+			if (size > static_cast<uint64_t>(_end - _data)) {
+				boost::serialization::throw_exception(boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error));
+			}
+
+			return static_cast<std::size_t>(size);
+		}
+
+		uint64_t loadFixed(std::size_t size) {
+			unsigned char bytes[sizeof(uint64_t)];
+			load_binary(bytes, size);
+
+			uint64_t value = 0;
+
+			for (std::size_t i = 0; i < size; i++) {
+				value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+			}
+
+			return value;
+		}
+	};
+
+} /* namespace common */
+} /* namespace spine */
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(spine::common::BinaryOArchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(spine::common::BinaryIArchive)
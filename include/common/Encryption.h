@@ -23,12 +23,22 @@
 namespace spine {
 namespace common {
 
+	/**
+	 * \brief encryption of messages between client and server
+	 * Public: encrypted for the server, only a random AES-256-GCM key is encrypted with RSA, the payload with AES
+	 * Private: signed by the server, the payload is readable with the public key anyway, so only its SHA256 is signed
+	 * decrypt methods also accept the chunked RSA format of older versions, the Legacy methods create it for peers not knowing anything else
+	 */
 	class Encryption {
 	public:
 		static bool encryptPublic(const std::string & in, std::string & out);
 
 		static bool encryptPrivate(const std::string & in, std::string & out);
 
+		static bool encryptPublicLegacy(const std::string & in, std::string & out);
+
+		static bool encryptPrivateLegacy(const std::string & in, std::string & out);
+
 		static bool decryptPublic(const std::string & in, std::string & out);
 
 		static bool decryptPrivate(const std::string & in, std::string & out);
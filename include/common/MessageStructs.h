@@ -28,7 +28,24 @@
 
 namespace spine {
 namespace common {
+
+	enum class WireFormat {
+		Text, // boost text archive, understood by every version
+		Binary // BinaryArchive, prefixed with a marker so it can't be mistaken for a text archive
+	};
 	
+	/**
+	 * \brief first client version understanding WireFormat::Binary (major << 16 | minor << 8 | patch), has to be the first release shipping it
+	 * the server answers the UpdateRequestMessage of such a client in binary, that's how the client learns the server understands it as well
+	 */
+	const uint32_t BINARY_FORMAT_CLIENT_VERSION = (1 << 16) + (36 << 8) + 0;
+
+	/**
+	 * \brief base of all messages, all Deserialize methods detect the format on their own
+	 * Serialize methods without explicit format use the format of the last message deserialized on the same thread,
+	 * so a server answers old clients still sending text archives in the format they understand
+	 * messages sent before anything was received on the thread use the default format, which stays Text until the peer is known to understand Binary
+	 */
 	struct Message {
 		MessageType type;
 		Message() : type() {}
@@ -40,8 +57,19 @@ namespace common {
 		}
 
 		std::string SerializeBlank() const;
+		std::string SerializeBlank(WireFormat format) const;
 		static Message * DeserializeBlank(const std::string & s);
 
+		/**
+		 * \brief format of the last message deserialized on this thread, the default format if there was none
+		 */
+		static WireFormat GetReplyFormat();
+
+		/**
+		 * \brief format for threads that didn't receive a message yet, only set it to Binary after receiving a binary message from the peer
+		 */
+		static void SetDefaultFormat(WireFormat format);
+
 		std::string SerializePublic() const;
 		static Message * DeserializePublic(const std::string & s);
 
@@ -670,5 +698,56 @@ namespace common {
 		}
 	};
 
+	// part of a screenshot, the server writes it to disk right away and moves the file in place with the last chunk
+	struct UploadScreenshotChunkMessage : public Message {
+		int32_t projectID;
+		std::string username;
+		std::string password;
+		std::string filename;
+		uint64_t offset;
+		bool last;
+		std::vector<uint8_t> data;
+
+		UploadScreenshotChunkMessage() : Message(), projectID(-1), offset(0), last(false) {
+			type = MessageType::UPLOADSCREENSHOTCHUNK;
+		}
+		template<class Archive>
+		void serialize(Archive & ar, const unsigned int /* file_version */) {
+			ar & boost::serialization::base_object<Message>(*this);
+			ar & projectID;
+			ar & username;
+			ar & password;
+			ar & filename;
+			ar & offset;
+			ar & last;
+			ar & data;
+		}
+	};
+
+	// sent by clients able to resume an upload, the server answers with an UploadModfilesOffsetsMessage before the files are sent
+	struct UploadModfilesResumableMessage : public UploadModfilesMessage {
+		UploadModfilesResumableMessage() : UploadModfilesMessage() {
+			type = MessageType::UPLOADMODFILESRESUMABLE;
+		}
+		template<class Archive>
+		void serialize(Archive & ar, const unsigned int /* file_version */) {
+			ar & boost::serialization::base_object<UploadModfilesMessage>(*this);
+		}
+	};
+
+	// for every file with content in the UploadModfilesResumableMessage (in the same order) the amount of bytes the server has already, only the rest has to be sent
+	struct UploadModfilesOffsetsMessage : public Message {
+		std::vector<int64_t> offsets;
+
+		UploadModfilesOffsetsMessage() : Message() {
+			type = MessageType::UPLOADMODFILESOFFSETS;
+		}
+		template<class Archive>
+		void serialize(Archive & ar, const unsigned int /* file_version */) {
+			ar & boost::serialization::base_object<Message>(*this);
+			ar & offsets;
+		}
+	};
+
 } /* namespace common */
 } /* namespace spine */
@@ -126,7 +126,10 @@ namespace common {
 		ISACHIEVEMENTUNLOCKED,
 		SENDISACHIEVEMENTUNLOCKED,
 		UPLOADACHIEVEMENTICONS,
-		UPLOADSCREENSHOTS
+		UPLOADSCREENSHOTS,
+		UPLOADSCREENSHOTCHUNK,
+		UPLOADMODFILESRESUMABLE,
+		UPLOADMODFILESOFFSETS
 	};
 
 } /* namespace common */
@@ -18,19 +18,35 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace spine {
 namespace server {
 
+	/**
+	 * \brief removes rows of users that don't have an account anymore
+	 * orphans are detected against the sorted account list and deleted in small chunks with pauses in between,
+	 * so the cleanup never holds locks for long or keeps the database busy
+	 */
 	class Cleanup {
 	public:
 		static void init();
 
 	private:
+		// configured with CLEANUP_CHUNK_SIZE, CLEANUP_CHUNK_DELAY and CLEANUP_TABLE_DELAY in the server config
+		static const size_t DELETE_CHUNK_SIZE; // users removed per DELETE statement
+		static const std::chrono::milliseconds CHUNK_DELAY; // pause between two DELETE statements
+		static const std::chrono::milliseconds TABLE_DELAY; // pause between two tables
+
 		static void cleanup();
-		static void cleanupTable(const std::string & tableName, const std::vector<int> & userList);
+
+		/**
+		 * \brief userList has to be sorted
+		 */
+		static void cleanupTable(const std::string & tableName, const std::vector<int32_t> & userList);
 	};
 
 } /* namespace server */
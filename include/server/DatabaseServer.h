@@ -40,6 +40,10 @@ namespace server {
 		void stop();
 
 	private:
+		typedef SimpleWeb::StatusCode(DatabaseServer::*RequestHandler)(MariaDBWrapper & database, int userID, const ptree & requestData, ptree & responseTree) const;
+
+		static constexpr size_t MAX_BATCH_SIZE = 100;
+
 		HttpsServer * _server;
 		std::thread * _runner;
 		mutable std::mutex _newsLock;
@@ -100,10 +104,34 @@ namespace server {
 		void requestProjectFiles(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
 		void requestPackageFiles(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
 		void gmpLogin(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
+		void requestSessionToken(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
+
+		/**
+		 * \brief executes several requests of the same user on one connection, optionally inside of a transaction
+		 * expects Username, Password, optional Transaction and Requests, an array of request bodies with an additional Resource entry
+		 * returns one entry with Status and optional Response per executed request
+		 */
+		void batch(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
+
+		/**
+		 * \brief parses the request, authenticates the user and calls the handler on a fresh connection
+		 */
+		void executeSingleRequest(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, RequestHandler handler, bool hasResponseBody = false) const;
+
+		SimpleWeb::StatusCode executeUpdatePlayTime(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
+		SimpleWeb::StatusCode executeUpdateScore(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
+		SimpleWeb::StatusCode executeUpdateAchievementProgress(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
+		SimpleWeb::StatusCode executeUpdateChapterStats(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
+		SimpleWeb::StatusCode executeIsAchievementUnlocked(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
+		SimpleWeb::StatusCode executeUpdateOfflineData(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const;
 		
 		void requestAllTri6ScoreStats(ptree & responseTree) const;
 
 		std::string getFileServer(int userID, int projectID, int majorVersion, int minorVersion, int patchVersion, int spineVersion) const;
+		/**
+		 * \brief counts the reported bytes for the load of the fileserver, at most maxBytes, nothing if maxBytes is 0
+		 */
+		void addServedBytes(const ptree & pt, uint64_t maxBytes) const;
 		void attachNewsData(MariaDBWrapper & database, const std::string & newsID, int language, ptree & newsNode) const;
 	};
 
@@ -18,23 +18,93 @@
 
 #pragma once
 
+#include <array>
+#include <condition_variable>
 #include <cstdint>
 #include <map>
 #include <mutex>
+#include <set>
+#include <string>
+#include <thread>
 
 namespace spine {
 namespace server {
 
+	class MariaDBStatement;
+
+	/**
+	 * \brief download sizes of projects and optional packages per language
+	 * the sizes of all files are indexed once in the background at startup and again for a project whenever it changed,
+	 * so requests only need a short lookup in the shard of the project
+	 */
 	class DownloadSizeChecker {
 	public:
+		DownloadSizeChecker();
+		~DownloadSizeChecker();
+
 		uint64_t getBytes(int32_t modID, const std::string & language, uint32_t version);
 		uint64_t getBytesForPackage(int32_t modID, int32_t optionalID, const std::string & language, uint32_t version);
+
+		/**
+		 * \brief returns the size of the largest language of the current version, 0 if the project or package isn't indexed
+		 * never loads anything, so it's cheap enough for requests that don't need an exact size
+		 */
+		uint64_t getMaxBytes(int32_t modID);
+		uint64_t getMaxBytesForPackage(int32_t optionalID);
+
+		/**
+		 * \brief indexes all projects in the background
+		 */
+		void warmup();
+
+		/**
+		 * \brief drops the sizes of the project and its packages and indexes them again in the background
+		 */
+		void invalidate(int32_t modID);
 		void clear();
 
 	private:
-		std::map<std::tuple<int32_t, std::string, uint32_t>, uint64_t> _cache;
-		std::map<std::tuple<int32_t, std::string, uint32_t>, uint64_t> _packageCache;
-		std::mutex _lock;
+		typedef struct {
+			uint32_t version;
+			uint64_t allLanguages; // files with Language 'All'
+			std::map<std::string, uint64_t> languages; // Language => bytes
+		} Sizes;
+
+		typedef struct {
+			std::map<int32_t, Sizes> projects; // ModID => Sizes
+			std::map<int32_t, std::pair<int32_t, Sizes>> packages; // PackageID => (ModID, Sizes)
+		} Index;
+
+		typedef struct {
+			std::mutex lock;
+			uint64_t generation; // increased on every invalidation, an index loaded before is outdated
+			Index index;
+		} Shard;
+
+		static constexpr size_t SHARD_COUNT = 16;
+
+		std::array<Shard, SHARD_COUNT> _shards;
+
+		std::mutex _workerLock;
+		std::condition_variable _workerCondition;
+		std::set<int32_t> _pendingProjects;
+		bool _pendingWarmup;
+		bool _running;
+		std::thread _worker;
+
+		Shard & getShard(int32_t modID);
+
+		void work();
+
+		/**
+		 * \brief loads the sizes of one project (modID != -1) or all projects and stores them for all shards that weren't invalidated meanwhile
+		 */
+		Index load(int32_t modID);
+		static bool loadProjects(MariaDBStatement & stmt, Index & index);
+		static bool loadPackages(MariaDBStatement & stmt, Index & index);
+
+		static uint64_t getSize(const Sizes & sizes, const std::string & language);
+		static uint64_t getMaxSize(const Sizes & sizes);
 	};
 
 } /* namespace server */
@@ -18,13 +18,29 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 
 namespace spine {
 namespace server {
 
+	class FtpSession;
+
+	/**
+	 * \brief replicates the files of all projects to the fileservers
+	 * jobs are stored in fileserverSynchronizationQueue, a dispatcher claims batches of them and hands them to a pool of workers per fileserver
+	 * every worker keeps its FTP session open, so all fileservers are updated in parallel with several transfers each
+	 * jobs for the same file are always executed in order, failed jobs are retried with exponential backoff
+	 */
 	class FileSynchronizer {
 	public:
 		enum class Operation {
@@ -72,36 +88,102 @@ namespace server {
 			std::string rootFolder;
 		} ExecuteJob;
 
+		typedef struct {
+			uint64_t succeeded;
+			uint64_t failed; // failed attempts, the job is retried later
+			uint64_t bytes;
+			uint64_t transferMicroseconds;
+			size_t queued; // claimed jobs waiting for a worker
+			size_t active;
+		} Statistics;
+
 		static void init();
 
 		static void addJob(const AddJob & job);
 
+		// ServerID => Statistics
+		static std::map<int, Statistics> getStatistics();
+		static void printStatistics();
+
 	private:
+		typedef std::tuple<int, int, std::string> FileKey; // ServerID, ProjectID, Path
+
+		typedef struct {
+			std::string username;
+			std::string password;
+			std::string ftpHost;
+			std::string rootFolder;
+			std::deque<ExecuteJob> jobs; // claimed, waiting for a worker
+			std::chrono::steady_clock::time_point throttle; // time at which all bytes sent so far are within the bandwidth limit
+			Statistics statistics;
+		} FileServer;
+
+		typedef struct {
+			int attempts;
+			std::chrono::steady_clock::time_point nextAttempt;
+		} Retry;
+
+		static constexpr size_t WORKERS_PER_SERVER = 4;
+		static constexpr size_t MAX_QUEUED_JOBS_PER_SERVER = 64;
+		static constexpr size_t CLAIM_BATCH_SIZE = 256; // rows read from the queue per query
+		static const std::chrono::seconds SESSION_IDLE_TIME; // idle workers close their session after this time
+		static constexpr uint64_t MAX_BYTES_PER_SECOND_PER_SERVER = 10 * 1024 * 1024; // shared by all workers of a server
+		static const std::chrono::seconds DISPATCH_INTERVAL; // while jobs are running or waiting for a retry
+		static const std::chrono::hours IDLE_INTERVAL; // also the interval for checking for missing files
+		static const std::chrono::seconds RETRY_DELAY; // doubled with every failed attempt
+		static const std::chrono::hours MAX_RETRY_DELAY;
+
+		// protects the queue in the database and everything about claimed jobs
 		static std::mutex lock;
+		static std::condition_variable _dispatchCondition;
+		static std::set<int> _claimedJobs;
+		static std::set<FileKey> _claimedFiles;
+		static std::map<int, Retry> _retries; // JobID => Retry
+
+		// protects the fileservers and their job queues
+		static std::mutex _workLock;
+		static std::condition_variable _workCondition;
+		static std::map<int, std::unique_ptr<FileServer>> _fileServers;
 
 		// main loop
 		static void exec();
 
+		// updates the fileservers and their credentials, starts workers for new ones
+		static void loadFileServers();
+
+		// deletes the jobs of fileservers removed from fileserverList, nobody would ever execute them
+		static void removeOrphanedJobs();
+
+		// reads the queue of every fileserver that can take more jobs and hands them to its workers, lock has to be held
+		// returns whether jobs are still pending
+		static bool dispatch();
+
+		// executes the jobs of a fileserver
+		static void work(int serverID);
+
 		// checks if for some server jobs are missing, e.g. new server got added and needs to synchronize everything now
 		static void addMissing();
 
-		// executes a single job
-		static void executeJob(const ExecuteJob & job);
+		// executes a single job, returns false if it failed
+		static bool executeJob(FtpSession & session, const ExecuteJob & job);
 
 		// called after job has been successfully finished
 		static void finishJob(const ExecuteJob & job);
 
+		// schedules the next attempt of a failed job
+		static void retryJob(const ExecuteJob & job);
+
+		// waits until sending the bytes doesn't exceed the bandwidth limit of the server
+		static void throttle(int serverID, size_t bytes);
+
 		// check if that was the last job for the projectID and if yes unlock fileserver
 		static void updateFileserver(const ExecuteJob & job);
 
 		// helper
-		// returns the first job in the queue
-		static ExecuteJob getFirstJobInQueue();
-
-		// adds a job for a specific server
+		// adds a job for a specific server, lock has to be held
 		static void addJob(const AddForServerJob & job);
 
-		// updates a job != first job to represent latest state in case a file gets updated again before previous operation finished
+		// updates a job that isn't claimed to represent latest state in case a file gets updated again before previous operation finished
 		static void updateJob(const AddForServerJob & job, int jobID);
 	};
 
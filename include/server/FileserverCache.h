@@ -0,0 +1,111 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief in-memory copy of fileserverList and projectsOnFileservers used to pick the mirror for a download
+	 * the FileSynchronizer invalidates it whenever a project got available on or removed from a fileserver, otherwise it's reloaded every few minutes
+	 * mirrors are picked randomly, weighted by their capacity and the bytes clients reported to have downloaded from them recently
+	 */
+	class FileserverCache {
+	public:
+		/**
+		 * \brief returns the url of a mirror having exactly this version of the project or an empty string if there is none
+		 * patron only mirrors are preferred for patrons and skipped for everybody else
+		 */
+		static std::string getFileserver(int userID, int projectID, int majorVersion, int minorVersion, int patchVersion, int spineVersion);
+
+		/**
+		 * \brief the next request loads the topology again
+		 */
+		static void invalidate();
+
+		/**
+		 * \brief counts a finished download for the load of the mirror, urls not in the current topology are ignored
+		 */
+		static void addServedBytes(const std::string & url, uint64_t bytes);
+
+	private:
+		typedef struct {
+			int serverID;
+			std::string url;
+			bool patronOnly;
+			int activeDays; // bitmask of the days of the week the mirror is used
+			uint32_t capacity; // relative weight, a mirror with capacity 2 gets twice as much traffic as one with 1
+		} Mirror;
+
+		typedef struct {
+			size_t mirror; // index in Topology::mirrors
+			int majorVersion;
+			int minorVersion;
+			int patchVersion;
+			int spineVersion;
+		} Placement;
+
+		typedef struct {
+			std::vector<Mirror> mirrors;
+			std::unordered_map<int, std::vector<Placement>> projects; // ProjectID => Placements
+		} Topology;
+
+		typedef struct {
+			double bytes; // decays with LOAD_HALF_LIFE
+			std::chrono::steady_clock::time_point updated;
+		} Load;
+
+		static const std::chrono::minutes REFRESH_INTERVAL;
+		static const std::chrono::minutes LOAD_HALF_LIFE;
+		static constexpr double LOAD_UNIT = 1024.0 * 1024.0 * 1024.0; // recent bytes per capacity at which a mirror gets half of its share
+
+		static std::mutex _lock;
+		static std::mutex _loadLock; // only one request loads the topology, all others keep using the old one meanwhile
+		static std::shared_ptr<const Topology> _topology;
+		static uint64_t _generation;
+		static uint64_t _loadedGeneration;
+		static std::chrono::steady_clock::time_point _expiry;
+		static std::map<std::string, int> _serverIDs; // Url => ServerID
+		static std::map<int, Load> _loads; // ServerID => Load
+
+		static std::shared_ptr<const Topology> getTopology();
+		static std::shared_ptr<const Topology> load();
+
+		/**
+		 * \brief returns the decayed load of the server, _lock has to be held
+		 */
+		static double getLoad(int serverID, std::chrono::steady_clock::time_point now);
+
+		/**
+		 * \brief picks one of the candidates randomly with weights based on capacity and load, _lock has to be held
+		 */
+		static const Mirror * pick(const Topology & topology, const std::vector<size_t> & candidates);
+	};
+
+} /* namespace server */
+} /* namespace spine */
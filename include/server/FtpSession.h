@@ -0,0 +1,109 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/tcp.hpp"
+#include "boost/asio/streambuf.hpp"
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief minimal passive mode FTP client keeping its control connection open between transfers
+	 * covers exactly what the FileSynchronizer needs: uploading files (creating missing directories) and deleting them
+	 * all calls are blocking with a timeout per network operation and not thread safe, every thread needs its own session
+	 */
+	class FtpSession {
+	public:
+		/**
+		 * \brief called with the amount of bytes sent after every block of an upload, used to throttle the transfer
+		 */
+		typedef std::function<void(size_t)> ProgressCallback;
+
+		FtpSession(const std::string & host, const std::string & username, const std::string & password);
+
+		FtpSession(const FtpSession &) = delete;
+		FtpSession & operator=(const FtpSession &) = delete;
+
+		/**
+		 * \brief uploads the local file, missing directories of remotePath are created
+		 */
+		bool upload(const std::string & localPath, const std::string & remotePath, const ProgressCallback & progress);
+		bool remove(const std::string & remotePath);
+
+		/**
+		 * \brief closes the control connection, the next transfer connects again
+		 */
+		void close();
+
+		const std::string & getLastError() const {
+			return _lastError;
+		}
+
+	private:
+		std::string _host;
+		uint16_t _port;
+		std::string _username;
+		std::string _password;
+		boost::asio::io_service _ioService;
+		boost::asio::deadline_timer _deadline;
+		boost::asio::ip::tcp::socket _control;
+		boost::asio::ip::tcp::socket _data;
+		boost::asio::streambuf _controlBuffer;
+		std::set<std::string> _knownDirectories; // directories already created or found during this session
+		std::string _lastError;
+
+		/**
+		 * \brief connects and logs in if there is no open control connection, a connection closed by the server is detected here as well
+		 */
+		bool ensureConnected();
+		bool connect();
+
+		/**
+		 * \brief sends the command and returns the reply code, 0 if the connection failed
+		 */
+		int command(const std::string & cmd, std::string * reply = nullptr);
+		int readReply(std::string * reply);
+
+		/**
+		 * \brief opens a passive data connection in _data, EPSV is tried first and PASV as fallback
+		 */
+		bool openDataConnection();
+		bool createDirectories(const std::string & remotePath);
+
+		bool connectSocket(boost::asio::ip::tcp::socket & socket, const boost::asio::ip::tcp::endpoint & endpoint);
+		bool readLine(std::string & line);
+		bool write(boost::asio::ip::tcp::socket & socket, const char * data, size_t size);
+
+		/**
+		 * \brief runs the io_service until the started operation set ec, closes all connections if it takes too long
+		 */
+		bool wait(boost::system::error_code & ec);
+		void checkDeadline();
+	};
+
+} /* namespace server */
+} /* namespace spine */
@@ -0,0 +1,106 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "boost/utility/string_ref.hpp"
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief writes JSON directly into a string instead of building a ptree first
+	 * output is compatible to write_json of boost::property_tree: all values are written as strings and escaped the same way,
+	 * so clients reading the values with toString() don't notice a difference
+	 *
+	 * JsonWriter writer;
+	 * writer.startObject();
+	 * writer.startArray("Projects");
+	 * writer.startObject();
+	 * writer.add("ProjectID", 42);
+	 * writer.endObject();
+	 * writer.endArray();
+	 * writer.endObject();
+	 * response->write(code, writer.getString());
+	 */
+	class JsonWriter {
+	public:
+		JsonWriter();
+
+		/**
+		 * \brief starts the root object or an object inside of an array
+		 */
+		void startObject();
+		void startObject(boost::string_ref key);
+		void endObject();
+
+		void startArray(boost::string_ref key);
+		void endArray();
+
+		/**
+		 * \brief adds a value to the current object
+		 */
+		void add(boost::string_ref key, boost::string_ref value);
+
+		template<typename T>
+		typename std::enable_if<std::is_arithmetic<T>::value>::type add(boost::string_ref key, T value) {
+			writeKey(key);
+			writeArithmetic(value);
+		}
+
+		/**
+		 * \brief adds a value to the current array
+		 */
+		void add(boost::string_ref value);
+
+		template<typename T>
+		typename std::enable_if<std::is_arithmetic<T>::value>::type add(T value) {
+			writeSeparator();
+			writeArithmetic(value);
+		}
+
+		const std::string & getString() const {
+			return _buffer;
+		}
+
+	private:
+		std::string _buffer;
+		std::vector<bool> _emptyScopes; // one entry per open object or array, true as long as nothing was written into it
+
+		void writeSeparator();
+		void writeKey(boost::string_ref key);
+		void writeString(boost::string_ref str);
+
+		void writeArithmetic(bool value);
+		void writeArithmetic(double value);
+
+		template<typename T>
+		typename std::enable_if<std::is_integral<T>::value>::type writeArithmetic(T value) {
+			_buffer.push_back('"');
+			_buffer.append(std::to_string(value));
+			_buffer.push_back('"');
+		}
+	};
+
+} /* namespace server */
+} /* namespace spine */
@@ -25,6 +25,9 @@
 namespace spine {
 namespace server {
 	
+	/**
+	 * \brief unknown languages are converted to an empty string and Language::None
+	 */
 	class LanguageConverter {
 	public:
 		static std::string convert(common::Language language);
@@ -34,11 +34,13 @@ namespace common {
 }
 namespace server {
 
+	class DownloadSizeChecker;
+
 	class ManagementServer {
 		friend class Server;
 		
 	public:
-		ManagementServer();
+		explicit ManagementServer(DownloadSizeChecker * downloadSizeChecker);
 		~ManagementServer();
 
 		int run();
@@ -47,6 +49,7 @@ namespace server {
 	private:
 		HttpsServer * _server;
 		std::thread * _runner;
+		DownloadSizeChecker * _downloadSizeChecker;
 
 		void getMods(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
 		void getAchievements(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const;
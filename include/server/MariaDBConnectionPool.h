@@ -0,0 +1,94 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "mariadb/mysql.h"
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief keeps MariaDB connections open between requests
+	 * there is one bounded pool per host/user/database/port, MariaDBWrapper borrows a connection in connect and returns it in close
+	 */
+	class MariaDBConnectionPool {
+	public:
+		typedef struct Connection {
+			MYSQL * handle;
+			std::string key;
+			std::chrono::steady_clock::time_point lastUsed;
+			std::map<std::string, std::string> preparedStatements; // name => statement, only touched by the thread currently holding the connection
+			std::map<std::string, MYSQL_STMT *> statements; // server side statements of MariaDBStatement, same ownership as preparedStatements
+			std::set<std::string> userVariables; // @params set by the current borrower, reset before the connection goes back to the pool
+		} Connection;
+
+		typedef struct {
+			uint64_t acquisitions;
+			uint64_t created;
+			uint64_t reused;
+			uint64_t waits;
+			uint64_t totalWaitMicroseconds;
+			uint64_t maxWaitMicroseconds;
+			uint64_t exhausted;
+			uint64_t healthCheckFailures;
+			uint64_t cachedPrepares;
+		} Statistics;
+
+		/**
+		 * \brief returns an idle connection or opens a new one if the pool isn't full yet
+		 * waits for a released connection if the pool is exhausted and returns nullptr if none got free in time
+		 */
+		static Connection * acquire(const std::string & host, const std::string & user, const std::string & password, const std::string & database, uint16_t port);
+
+		/**
+		 * \brief hands a connection back to its pool, broken connections are dropped
+		 */
+		static void release(Connection * connection, bool broken);
+
+		static void statementCached();
+
+		static Statistics getStatistics();
+		static void printStatistics();
+
+	private:
+		typedef struct {
+			std::list<Connection *> idle;
+			size_t open;
+		} Pool;
+
+		static std::mutex _lock;
+		static std::condition_variable _released;
+		static std::map<std::string, Pool> _pools;
+		static Statistics _statistics;
+
+		static MYSQL * open(const std::string & host, const std::string & user, const std::string & password, const std::string & database, uint16_t port);
+		static void closeStatements(Connection * connection);
+	};
+
+} /* namespace server */
+} /* namespace spine */
@@ -0,0 +1,131 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MariaDBConnectionPool.h"
+
+#include "mariadb/mysql.h"
+
+#include "boost/utility/string_ref.hpp"
+
+namespace spine {
+namespace server {
+
+	class MariaDBWrapper;
+
+	/**
+	 * \brief binary protocol prepared statement on a connection of a MariaDBWrapper
+	 * parameters are bound natively, so executing needs a single round trip instead of SET @param... + EXECUTE
+	 * the server side statement is cached per pooled connection, only one MariaDBStatement per query may be alive per MariaDBWrapper at a time
+	 *
+	 * MariaDBStatement stmt(database, "SELECT ID, Username FROM accounts WHERE ID = ? LIMIT 1");
+	 * stmt.bind(userID);
+	 * if (stmt.execute() && stmt.fetch()) {
+	 *     const auto username = stmt.getString(1);
+	 * }
+	 */
+	class MariaDBStatement {
+	public:
+		MariaDBStatement(MariaDBWrapper & database, const std::string & statement);
+		~MariaDBStatement();
+
+		MariaDBStatement(const MariaDBStatement &) = delete;
+		MariaDBStatement & operator=(const MariaDBStatement &) = delete;
+
+		bool isValid() const {
+			return _statement != nullptr;
+		}
+
+		/**
+		 * \brief binds the next parameter, parameters are bound in order of their placeholders
+		 * bound values are kept, so calling reset() and binding again allows executing the statement multiple times
+		 */
+		MariaDBStatement & bind(int32_t value);
+		MariaDBStatement & bind(int64_t value);
+		MariaDBStatement & bind(const std::string & value);
+
+		/**
+		 * \brief restarts binding at the first parameter
+		 */
+		void reset();
+
+		/**
+		 * \brief executes the statement and buffers the complete result on client side
+		 */
+		bool execute();
+
+		/**
+		 * \brief advances to the next row of the result, returns false if there are no more rows
+		 */
+		bool fetch();
+
+		size_t getRowCount() const;
+		uint64_t getAffectedRows() const;
+		uint64_t getInsertID() const;
+
+		bool isNull(unsigned int column) const;
+		int32_t getInt(unsigned int column) const;
+		int64_t getInt64(unsigned int column) const;
+
+		/**
+		 * \brief returns the value of the column in the current row, only valid until the next fetch
+		 */
+		boost::string_ref getString(unsigned int column) const;
+
+		std::string getLastError() const;
+
+		/**
+		 * \brief see MariaDBWrapper::isTransientError
+		 */
+		bool isTransientError() const;
+
+	private:
+		typedef struct {
+			bool integer;
+			int64_t intValue;
+			std::vector<char> buffer;
+			unsigned long length;
+			my_bool isNull;
+		} Column;
+
+		MariaDBConnectionPool::Connection * _connection;
+		std::string _query;
+		MYSQL_STMT * _statement;
+		std::string _prepareError;
+		unsigned int _errorCode; // of the last failed prepare or execute
+		std::vector<MYSQL_BIND> _parameters;
+		std::vector<int64_t> _intParameters;
+		std::vector<std::string> _stringParameters;
+		std::vector<unsigned long> _parameterLengths;
+		size_t _nextParameter;
+		std::vector<MYSQL_BIND> _results;
+		mutable std::vector<Column> _columns;
+		bool _hasResult;
+
+		MariaDBStatement & bindParameter(enum_field_types type, void * buffer, unsigned long length);
+		bool bindResults();
+		void invalidate();
+	};
+
+} /* namespace server */
+} /* namespace spine */
@@ -22,12 +22,20 @@
 #include <string>
 #include <vector>
 
+#include "MariaDBConnectionPool.h"
+
 #include "mariadb/mysql.h"
 
 namespace spine {
 namespace server {
 
+	/**
+	 * \brief borrows a connection from MariaDBConnectionPool for its lifetime
+	 * PREPARE statements are remembered per connection, so re-preparing the same statement is skipped
+	 */
 	class MariaDBWrapper {
+		friend class MariaDBStatement;
+
 	public:
 		MariaDBWrapper();
 
@@ -41,12 +49,24 @@ namespace server {
 
 		std::string getLastError() const;
 
+		/**
+		 * \brief whether the last query failed because of the connection or a lock conflict instead of the query itself, so repeating it later can succeed
+		 */
+		bool isTransientError() const;
+
+		static bool isTransientError(unsigned int error);
+
 		template<typename Result>
 		std::vector<Result> getResults() {
 			if (!_database) {
 				return{};
 			}
 			MYSQL_RES * res = mysql_store_result(_database);
+			_pendingResult = false;
+
+			if (!res) {
+				return{};
+			}
 
 			std::vector<Result> result;
 
@@ -72,7 +92,11 @@ namespace server {
 		void close();
 
 	private:
+		MariaDBConnectionPool::Connection * _connection;
 		MYSQL * _database;
+		mutable bool _pendingResult;
+
+		void discardResult() const;
 	};
 
 } /* namespace server */
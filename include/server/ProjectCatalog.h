@@ -0,0 +1,98 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief in-memory copy of all project metadata needed by requestAllProjects
+	 * loaded with a few set based queries and shared between all requests, per user visibility is applied by the caller
+	 * the catalog is reloaded after invalidate() and at least every few minutes to pick up new play times
+	 */
+	class ProjectCatalog {
+	public:
+		typedef struct {
+			int32_t projectID;
+			int32_t teamID;
+			int32_t gameType;
+			int32_t releaseDate;
+			int32_t modType;
+			int32_t majorVersion;
+			int32_t minorVersion;
+			int32_t patchVersion;
+			int32_t spineVersion;
+			bool enabled;
+			std::map<int, std::string> names; // Languages => Name
+			int supportedLanguages;
+			std::vector<std::string> keywords;
+			int32_t devDuration; // -1 if not set
+			int32_t avgDuration; // -1 if nobody played yet
+			int32_t updateDate;
+		} Project;
+
+		typedef struct {
+			int32_t packageID;
+			int32_t projectID;
+			bool enabled;
+			std::map<std::string, std::string> names; // Language => Name
+		} Package;
+
+		typedef struct {
+			std::vector<Project> projects;
+			std::map<int32_t, size_t> projectIndices; // ProjectID => index in projects
+			std::map<int32_t, std::vector<std::pair<int, std::string>>> teamNames; // TeamID => (Languages, Name)
+			std::vector<Package> packages;
+		} Catalog;
+
+		/**
+		 * \brief returns the current catalog, loading it first if necessary
+		 * returns nullptr if there is no catalog yet and loading failed
+		 */
+		static std::shared_ptr<const Catalog> get();
+
+		/**
+		 * \brief has to be called after every write to mods, names, keywords, versions or packages
+		 */
+		static void invalidate();
+
+		static std::string getTeamName(const Catalog & catalog, int32_t teamID, int language);
+
+	private:
+		static std::mutex _lock;
+		static std::mutex _loadLock;
+		static std::shared_ptr<const Catalog> _catalog;
+		static std::chrono::steady_clock::time_point _loadTime;
+		static std::atomic<uint64_t> _generation;
+		static uint64_t _loadedGeneration;
+
+		static std::shared_ptr<Catalog> load();
+	};
+
+} /* namespace server */
+} /* namespace spine */
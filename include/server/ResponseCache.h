@@ -0,0 +1,102 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "simple-web-server/server_https.hpp"
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief keeps the serialized JSON of read heavy endpoints, so they don't have to be built again for every request
+	 * entries are stored per endpoint and a key describing everything the response depends on (e.g. language and visibility)
+	 * keys are client input, so callers only cache values the server knows (e.g. supported languages) and every endpoint keeps at most MAX_ENTRIES
+	 * every response written through this class gets an ETag, clients sending a matching If-None-Match get a 304 without body
+	 */
+	class ResponseCache {
+		using HttpsServer = SimpleWeb::Server<SimpleWeb::HTTPS>;
+
+	public:
+		enum class Endpoint {
+			AllProjects,
+			AllNews,
+			CompatibilityList,
+			Count
+		};
+
+		typedef struct {
+			std::string body;
+			std::string etag;
+			std::chrono::steady_clock::time_point expiry;
+		} Entry;
+
+		/**
+		 * \brief has to be read before building a response, put ignores responses built before the last invalidation
+		 */
+		static uint64_t getGeneration(Endpoint endpoint);
+
+		/**
+		 * \brief returns the cached response or nullptr if there is none or it is expired
+		 */
+		static std::shared_ptr<const Entry> get(Endpoint endpoint, const std::string & key);
+
+		/**
+		 * \brief stores a freshly built response and returns it, the returned entry is valid even if it was not stored
+		 * expired entries are removed first, a new key isn't stored if the endpoint has MAX_ENTRIES nevertheless
+		 */
+		static std::shared_ptr<const Entry> put(Endpoint endpoint, const std::string & key, uint64_t generation, const std::string & body, std::chrono::seconds maxAge);
+
+		/**
+		 * \brief drops all responses of the endpoint, has to be called by every write path changing its content
+		 */
+		static void invalidate(Endpoint endpoint);
+
+		/**
+		 * \brief writes the entry with its ETag or 304 if the client already has this version
+		 */
+		static void write(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, const Entry & entry);
+
+		/**
+		 * \brief writes a response that can't be cached (e.g. per user data), still answers with 304 if the client has the same content
+		 */
+		static void write(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, const std::string & body);
+
+	private:
+		static constexpr size_t MAX_ENTRIES = 1024;
+
+		typedef struct {
+			uint64_t generation = 0;
+			std::map<std::string, std::shared_ptr<const Entry>> entries;
+		} EndpointCache;
+
+		static std::mutex _lock;
+		static EndpointCache _caches[static_cast<size_t>(Endpoint::Count)];
+
+		static std::string createETag(const std::string & body);
+	};
+
+} /* namespace server */
+} /* namespace spine */
@@ -33,6 +33,7 @@ namespace spine {
 namespace common {
 	struct UpdateRequestMessage;
 	struct UploadScreenshotsMessage;
+	struct UploadScreenshotChunkMessage;
 
 	struct ProjectStats;
 } /* namespace common */
@@ -57,6 +58,8 @@ namespace server {
 		int run();
 
 	private:
+		static constexpr uint64_t MAX_SCREENSHOT_SIZE = 32 * 1024 * 1024; // upper bound for a single screenshot uploaded in chunks
+
 		clockUtils::sockets::TcpSocket * _listenClient;
 		clockUtils::sockets::TcpSocket * _listenMPServer;
 		DownloadSizeChecker * _downloadSizeChecker;
@@ -75,6 +78,8 @@ namespace server {
 		
 		void handleUploadScreenshots(clockUtils::sockets::TcpSocket * sock, common::UploadScreenshotsMessage * msg) const;
 
+		void handleUploadScreenshotChunk(clockUtils::sockets::TcpSocket * sock, common::UploadScreenshotChunkMessage * msg) const;
+
 		static bool isTeamMemberOfMod(int modID, int userID);
 
 		static void getBestTri6Score(int userID, common::ProjectStats & projectStats);
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <string>
 #include <vector>
 
 #include "SpineServerConfig.h"
@@ -42,7 +44,21 @@ namespace server {
 		 * \brief returns the id in the table for the username
 		 */
 		static int getUserID(const std::string & username);
+		/**
+		 * \brief returns the id for the credentials or -1, the password can be a session token as well
+		 */
 		static int getUserID(const std::string & username, const std::string & password);
+
+		/**
+		 * \brief checks the password against the accounts database, neither cached credentials nor session tokens are accepted
+		 * \param[out] passwordHash the hash of the password as stored in the database
+		 */
+		static int checkPassword(const std::string & username, const std::string & password, std::string & passwordHash);
+
+		/**
+		 * \brief returns the fingerprint of the current password hash of the user that session tokens have to contain, empty if the database can't be reached
+		 */
+		static std::string getPasswordFingerprint(int userID);
 		static std::string getUsername(int id);
 		static std::vector<std::string> getUserList();
 		static void sendMail(const std::string & subject, const std::string & body, const std::string & replyTo);
@@ -59,6 +75,11 @@ namespace server {
 		static bool canAccessProject(int userID, int projectID);
 
 		static int getPatronLevel(int userID);
+
+		/**
+		 * \brief removes .part files of uploads that weren't continued for maxAge, searches folder recursively
+		 */
+		static void removeStalePartFiles(const std::string & folder, std::chrono::hours maxAge);
 	};
 
 } /* namespace server */
@@ -0,0 +1,102 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace spine {
+namespace server {
+
+	/**
+	 * \brief avoids checking the same credentials against the accounts database for every request
+	 * successful logins are kept for a few minutes, keyed by an HMAC of username and password so no password is kept in memory
+	 * additionally signed session tokens can be issued, they are accepted instead of the password
+	 * a token contains a fingerprint of the password hash of the account, it is checked against the accounts database at most every CREDENTIALS_TTL per user,
+	 * so changing the password invalidates all tokens of the user after that time at the latest
+	 * the HMAC key is created randomly on startup, so a restart invalidates all tokens and clients have to log in with their password again
+	 */
+	class SessionCache {
+	public:
+		static const std::chrono::minutes CREDENTIALS_TTL;
+		static const std::chrono::hours TOKEN_TTL;
+
+		/**
+		 * \brief returns the userID for the credentials or -1 if they aren't cached, tokens are handled by verifyToken
+		 */
+		static int lookup(const std::string & username, const std::string & password);
+
+		/**
+		 * \brief remembers successfully checked credentials
+		 */
+		static void store(const std::string & username, const std::string & password, int userID);
+
+		/**
+		 * \brief creates a token that can be sent instead of the password until it expires or the password changes
+		 * \param[in] passwordHash the hash of the password as stored in the accounts database
+		 */
+		static std::string createToken(const std::string & username, int userID, const std::string & passwordHash);
+
+		static bool isToken(const std::string & password);
+
+		/**
+		 * \brief checks signature and expiry of the token and returns the userID or -1
+		 * the returned fingerprint has to match the one of the current password hash, see lookupFingerprint
+		 */
+		static int verifyToken(const std::string & username, const std::string & token, std::string & fingerprint);
+
+		static std::string getFingerprint(const std::string & passwordHash);
+
+		/**
+		 * \brief returns false if the fingerprint of the user isn't cached, it has to be read from the accounts database and stored then
+		 */
+		static bool lookupFingerprint(int userID, std::string & fingerprint);
+		static void storeFingerprint(int userID, const std::string & fingerprint);
+
+	private:
+		typedef struct {
+			int userID;
+			std::chrono::steady_clock::time_point expiry;
+		} Entry;
+
+		typedef struct {
+			std::string fingerprint;
+			std::chrono::steady_clock::time_point expiry;
+		} FingerprintEntry;
+
+		typedef struct {
+			std::mutex lock;
+			std::unordered_map<std::string, Entry> entries;
+			std::unordered_map<int, FingerprintEntry> fingerprints; // userID => fingerprint of the current password hash
+		} Shard;
+
+		static constexpr size_t SHARD_COUNT = 16;
+
+		static Shard _shards[SHARD_COUNT];
+
+		static const std::string & getSecret();
+		static std::string sign(const std::string & data);
+		static Shard & getShard(const std::string & key);
+		static Shard & getShard(int userID);
+	};
+
+} /* namespace server */
+} /* namespace spine */
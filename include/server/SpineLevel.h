@@ -18,26 +18,87 @@
 
 #pragma once
 
-#include <list>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "common/MessageStructs.h"
 
-#define BOOST_SPIRIT_THREADSAFE
-#include "boost/property_tree/json_parser.hpp"
-
 namespace spine {
 namespace server {
 
+	class JsonWriter;
+	class MariaDBWrapper;
+
+	/**
+	 * \brief calculates the level of the users
+	 * the XP of a user are kept split up by their source, so an event only has to recalculate the part it changed
+	 * play time XP depend on the quartiles of the play times of each project, these are kept in memory and refreshed periodically
+	 * a background job slowly recalculates all users completely to correct anything the incremental updates missed
+	 */
 	class SpineLevel {
 	public:
+		enum XPSource {
+			Achievements = 1 << 0,
+			Scores = 1 << 1,
+			Ratings = 1 << 2,
+			Reviews = 1 << 3,
+			Compatibilities = 1 << 4,
+			PlayTime = 1 << 5,
+			UserVotes = 1 << 6,
+			Supporter = 1 << 7, // donations, Patreon and our own games, only changed outside of Spine
+
+			All = (1 << 8) - 1
+		};
+
+		typedef struct {
+			uint64_t queued; // calls of updateLevel
+			uint64_t merged; // calls for users that were already queued
+			uint64_t processed;
+			uint64_t failed;
+			size_t queueDepth;
+			size_t maxQueueDepth;
+			uint64_t totalLatencyMicroseconds; // from queueing until the level was stored
+			uint64_t maxLatencyMicroseconds;
+		} Statistics;
+
 		static void init();
 		
 		static common::SendUserLevelMessage getLevel(int userID);
-		static void updateLevel(int userID);
-		static void clear(const std::vector<int> & userList);
 
-		static void addRanking(boost::property_tree::ptree & json);
+		/**
+		 * \brief queues recalculation of the XP of the given sources, a combination of XPSource flags
+		 * a user is queued only once, sources of further calls are added to the pending update
+		 */
+		static void updateLevel(int userID, int sources);
+
+		static Statistics getStatistics();
+		static void printStatistics();
+
+		/**
+		 * \brief returns the complete ranking as JSON, serialized again only after a level changed
+		 */
+		static std::string getRanking();
+
+		/**
+		 * \brief returns the part of the ranking starting at the given position as JSON
+		 */
+		static std::string getRankingPage(size_t offset, size_t count);
+
+		/**
+		 * \brief returns the ranking around the user as JSON, count users before and after the user, and the rank of the user as OwnRank
+		 */
+		static std::string getRankingAround(int userID, size_t count);
+
+		/**
+		 * \brief returns the rank of the user, 0 if the user has no XP yet
+		 */
+		static uint32_t getRank(int userID);
 
 	private:
 		typedef struct {
@@ -46,15 +107,97 @@ namespace server {
 			uint32_t level;
 			uint32_t xp;
 		} RankingEntry;
+
+		typedef struct {
+			uint32_t xp;
+			int userID;
+		} RankingKey; // ordered by XP descending, so the position in the index is the number of users in front
+
+		typedef struct {
+			int sources;
+			std::chrono::steady_clock::time_point queued;
+		} PendingUpdate;
+
+		typedef struct {
+			int32_t firstQuartile;
+			int32_t median;
+			int32_t thirdQuartile;
+		} Quartiles;
+
+		static constexpr size_t XPSOURCE_COUNT = 8;
+
+		typedef std::array<uint32_t, XPSOURCE_COUNT> XPComponents; // index is the bit of the XPSource
+
+		static constexpr size_t WORKER_COUNT = 4;
+		static constexpr size_t UPDATE_BATCH_SIZE = 16;
+
+		static const std::chrono::minutes QUARTILE_REFRESH_INTERVAL;
+		static const std::chrono::hours VERIFICATION_INTERVAL;
+		static const std::chrono::milliseconds VERIFICATION_DELAY;
 		
 		static std::mutex _lock;
 		static std::map<int, common::SendUserLevelMessage> _levels;
-		static std::vector<RankingEntry> _rankings;
+		static std::map<int, XPComponents> _components; // only users calculated since startup, everybody else needs a full calculation first
+		static std::map<int, RankingEntry> _rankings;
+		static std::vector<RankingKey> _rankingIndex; // sorted, updated on every level change
+		static uint64_t _rankingGeneration;
+		static std::string _serializedRanking;
+		static uint64_t _serializedRankingGeneration;
 		static std::mutex _rankingLock;
-		static std::list<int> _updateQueue;
+		static std::deque<int> _updateQueue; // users of _pendingUpdates in the order they were queued
+		static std::unordered_map<int, PendingUpdate> _pendingUpdates;
+		static std::unordered_set<int> _processingUsers;
 		static std::mutex _updateQueueLock;
+		static std::condition_variable _updateCondition;
+		static Statistics _statistics;
+		static std::map<int32_t, Quartiles> _quartiles; // ProjectID => Quartiles
+		static std::mutex _quartileLock;
+
+		/**
+		 * \brief worker thread, takes several queued users at once and calculates them
+		 */
+		static void processUpdates();
+
+		/**
+		 * \brief recalculates the given sources, all sources if the user wasn't calculated yet
+		 * returns false if a query failed, the level isn't changed in that case
+		 */
+		static bool cacheLevel(int userID, int sources);
+
+		/**
+		 * \brief recalculates everything and returns whether the incrementally updated XP were different
+		 */
+		static bool verifyLevel(int userID);
+
+		static bool calculateXP(MariaDBWrapper & database, int userID, XPSource source, uint32_t & xp);
+		static bool calculatePlayTimeXP(MariaDBWrapper & database, int userID, uint32_t & xp);
+		static bool calculateSupporterXP(MariaDBWrapper & database, int userID, uint32_t & xp);
+
+		static Quartiles getQuartiles(const std::vector<int32_t> & sortedDurations);
+		static uint32_t getPlayTimeXP(int32_t duration, const Quartiles & quartiles);
+
+		/**
+		 * \brief reloads the play time quartiles of all projects and updates the play time XP of all calculated users
+		 */
+		static void refreshQuartiles();
+
+		/**
+		 * \brief takes over the XP of the given sources from components and stores the resulting level
+		 * the XP of all other sources stay as they are, so concurrent updates of different sources don't overwrite each other
+		 */
+		static void storeLevel(int userID, int sources, const XPComponents & components);
+
+		static common::SendUserLevelMessage calculateLevel(const XPComponents & components);
+
+		/**
+		 * \brief inserts or moves the user in the ranking, _rankingLock has to be locked
+		 */
+		static void updateRanking(const RankingEntry & entry);
 
-		static void cacheLevel(int userID);
+		/**
+		 * \brief writes the entries of the index in [begin, end) as ranking, _rankingLock has to be locked
+		 */
+		static void writeRanking(JsonWriter & writer, size_t begin, size_t end);
 	};
 
 } /* namespace server */
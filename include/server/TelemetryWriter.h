@@ -0,0 +1,228 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace spine {
+namespace server {
+
+	class MariaDBWrapper;
+
+	/**
+	 * \brief write-behind for statistics the client doesn't wait for (play times, login times, link clicks, downloads)
+	 * handlers only add to the pending rows and respond immediately, updates of the same key are merged in memory
+	 * (e.g. play time of the same user and project is summed up) and a background thread writes everything with a few
+	 * multi-row statements in one transaction every few seconds
+	 * the amount of pending rows is bounded: if it is reached, handlers wait a moment for the next flush and drop the update if it doesn't come
+	 * rows the database refuses (e.g. an url too long for linksClicked) are found by writing every row on its own and dropped, so they don't block everything else
+	 */
+	class TelemetryWriter {
+	public:
+		typedef struct {
+			uint64_t enqueued; // updates added by handlers
+			uint64_t coalesced; // rows merged into an already pending row
+			uint64_t blocked; // updates that had to wait because too many rows were pending
+			uint64_t dropped; // updates discarded because the pending rows didn't get flushed in time
+			uint64_t flushes;
+			uint64_t failedFlushes;
+			uint64_t writtenRows;
+			uint64_t rejectedRows; // refused by the database and dropped
+			size_t pendingRows;
+			size_t maxPendingRows; // high water mark of pendingRows
+		} Statistics;
+
+		/**
+		 * \brief holds back the updates the current thread adds while it exists, e.g. while a transaction is open
+		 * they are only handed to the TelemetryWriter by commit(), so a rolled back transaction doesn't count anything
+		 */
+		class Deferral {
+		public:
+			Deferral();
+			~Deferral();
+
+			void commit();
+
+		private:
+			std::vector<std::function<void()>> _updates;
+			std::vector<std::function<void()>> * _previous;
+			bool _active;
+
+			void deactivate();
+		};
+
+		static void start();
+
+		/**
+		 * \brief writes all pending rows and stops the background thread
+		 * has to be called after the server stopped accepting requests, updates added later are only written after the next start()
+		 */
+		static void stop();
+
+		/**
+		 * \brief userID -1 collects the play time of all unregistered players
+		 */
+		static void addPlayTime(int32_t userID, const std::vector<int32_t> & projectIDs, int32_t duration);
+		static void addLoginTime(int32_t userID);
+		static void addLinkClick(int32_t newsID, const std::string & url);
+
+		/**
+		 * \brief counts a download of the project and of its current version
+		 */
+		static void addDownload(int32_t projectID);
+
+		/**
+		 * \brief counts an update to the current version of the project
+		 */
+		static void addUpdate(int32_t projectID);
+		static void addPackageDownload(int32_t packageID);
+
+		static Statistics getStatistics();
+
+	private:
+		typedef struct {
+			std::map<std::pair<int32_t, int32_t>, int32_t> playTimes; // (ProjectID, UserID) => Duration
+			std::vector<std::pair<int32_t, int32_t>> sessionTimes; // (ProjectID, Duration), one row per session
+			std::map<std::pair<int32_t, int32_t>, int32_t> lastPlayTimes; // (ProjectID, UserID) => Timestamp
+			std::map<int32_t, int32_t> loginTimes; // UserID => Timestamp
+			std::map<std::pair<int32_t, std::string>, int32_t> linkClicks; // (NewsID, Url) => Counter
+			std::map<int32_t, int32_t> downloads; // ProjectID => Counter
+			std::map<int32_t, int32_t> versionDownloads; // ProjectID => Counter, the version is looked up when writing
+			std::map<int32_t, int32_t> packageDownloads; // PackageID => Counter
+		} Batch;
+
+		enum class WriteResult {
+			Written,
+			Transient, // the database is unavailable or a lock conflicted, writing again later can succeed
+			Rejected // a statement was refused, writing the same rows again fails as well
+		};
+
+		static const std::chrono::seconds FLUSH_INTERVAL;
+		static const std::chrono::milliseconds MAX_BLOCKING_TIME;
+		static constexpr size_t MAX_PENDING_ROWS = 20000;
+		static constexpr size_t FLUSH_THRESHOLD = MAX_PENDING_ROWS / 2; // flushes before the interval is over
+		static constexpr size_t ROWS_PER_STATEMENT = 500;
+		static constexpr int MAX_FAILED_FLUSHES = 3; // then the rows are written one by one
+
+		static thread_local std::vector<std::function<void()>> * _deferred; // updates of the innermost Deferral of this thread
+
+		static std::mutex _lock;
+		static std::condition_variable _flushCondition;
+		static std::condition_variable _capacityCondition;
+		static std::thread _writer;
+		static bool _running;
+		static Batch _pending;
+		static Statistics _statistics;
+		static int _failedFlushes; // in a row, reset by every flush that leaves no rows behind
+
+		static void run();
+
+		/**
+		 * \brief returns true if the update was held back by a Deferral, it is added by calling update later on
+		 */
+		static bool defer(const std::function<void()> & update);
+
+		/**
+		 * \brief takes all pending rows and writes them, _lock has to be locked by ul and is released while writing
+		 * returns false if rows couldn't be written for a transient reason, only those are pending again
+		 * if the batch is rejected or failed MAX_FAILED_FLUSHES times, the rows are written one by one and the rejected ones are dropped
+		 */
+		static bool flush(std::unique_lock<std::mutex> & ul);
+
+		/**
+		 * \brief writes the batch in one transaction
+		 */
+		static WriteResult write(const Batch & batch);
+
+		/**
+		 * \brief writes every row of the batch in a statement of its own without a transaction
+		 * rows failing for a transient reason are added to remaining, rejected ones are counted and dropped
+		 */
+		static void writeSingleRows(const Batch & batch, Batch & remaining, uint64_t & rejected);
+
+		/**
+		 * \brief executes the statements for all rows of the batch on the connection, the caller decides about the transaction
+		 */
+		static WriteResult writeRows(MariaDBWrapper & database, const Batch & batch);
+
+		/**
+		 * \brief inserts the rows with as few statements as possible
+		 * rows have to be complete value tuples like "(1, 2, 3)" containing only numbers
+		 */
+		static WriteResult insertRows(MariaDBWrapper & database, const std::string & insert, const std::vector<std::string> & rows, const std::string & onDuplicateKey);
+
+		static void updateLevels(const Batch & batch);
+
+		/**
+		 * \brief returns false if the update has to be dropped, _lock has to be locked by ul
+		 */
+		static bool waitForCapacity(std::unique_lock<std::mutex> & ul);
+		static void enqueued();
+
+		template<typename Key>
+		static void addCounter(std::map<Key, int32_t> & counters, const Key & key, int32_t value) {
+			const auto it = counters.find(key);
+
+			if (it == counters.end()) {
+				counters.insert(std::make_pair(key, value));
+			} else {
+				it->second += value;
+				_statistics.coalesced++;
+			}
+		}
+
+		template<typename Key>
+		static void setValue(std::map<Key, int32_t> & values, const Key & key, int32_t value) {
+			const auto result = values.insert(std::make_pair(key, value));
+
+			if (!result.second) {
+				result.first->second = value;
+				_statistics.coalesced++;
+			}
+		}
+
+		static size_t getSize(const Batch & batch);
+		static void merge(Batch & target, const Batch & source);
+
+		/**
+		 * \brief returns one batch per row
+		 */
+		static std::vector<Batch> split(const Batch & batch);
+
+		template<typename Container>
+		static void split(const Container & rows, Container Batch::*member, std::vector<Batch> & result) {
+			for (const auto & row : rows) {
+				Batch single;
+				(single.*member).insert((single.*member).end(), row);
+				result.push_back(single);
+			}
+		}
+	};
+
+} /* namespace server */
+} /* namespace spine */
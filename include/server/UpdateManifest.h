@@ -0,0 +1,68 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spine {
+namespace common {
+	enum class WireFormat;
+} /* namespace common */
+namespace server {
+
+	/**
+	 * \brief index over Spine_Version.xml answering UpdateRequestMessages without parsing the xml again
+	 * for every version in the file the list of files changed since then is serialized once, a request only has to find the first newer version
+	 * the file is loaded again as soon as its modification time changes
+	 */
+	class UpdateManifest {
+	public:
+		/**
+		 * \brief loads the manifest, otherwise this happens with the first request
+		 */
+		static void init();
+
+		/**
+		 * \brief returns the serialized UpdateFilesMessage for a client with the given version
+		 * if the manifest can't be loaded, an UpdateFileCountMessage with count 0 is returned instead
+		 */
+		static std::string getSerializedUpdate(uint8_t majorVersion, uint8_t minorVersion, uint8_t patchVersion, common::WireFormat format);
+
+	private:
+		typedef struct {
+			std::vector<uint32_t> versions; // ascending
+			std::array<std::vector<std::string>, 2> updates; // per WireFormat, updates[format][i] contains all files of versions[i] and newer, the last entry is the empty update
+		} Index;
+
+		static std::mutex _lock;
+		static std::shared_ptr<const Index> _index;
+		static std::time_t _lastWriteTime;
+
+		static std::shared_ptr<const Index> getIndex();
+		static std::shared_ptr<const Index> load();
+	};
+
+} /* namespace server */
+} /* namespace spine */
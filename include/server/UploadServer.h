@@ -18,6 +18,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace clockUtils {
 	enum class ClockError;
 namespace sockets {
@@ -26,19 +31,63 @@ namespace sockets {
 } /* namespace clockUtils */
 
 namespace spine {
+namespace common {
+	struct UploadModfilesMessage;
+} /* namespace common */
 namespace server {
 
+	class DownloadSizeChecker;
+
+	/**
+	 * \brief receives the files of a project upload
+	 * files are streamed into .part files next to their target and their hash is verified while receiving,
+	 * clients sending an UploadModfilesResumableMessage continue an interrupted upload where it stopped
+	 * only after all files arrived they are moved in place and the database is updated in a single transaction
+	 */
 	class UploadServer {
 	public:
-		UploadServer();
+		explicit UploadServer(DownloadSizeChecker * downloadSizeChecker);
 		~UploadServer();
 
 		int run();
 
 	private:
+		typedef struct {
+			size_t index; // in UploadModfilesMessage::files
+			std::string path;
+			std::string partPath;
+			int64_t offset; // bytes already received in an earlier attempt
+		} Upload;
+
+		static const std::chrono::hours STALE_PART_AGE; // parts of abandoned uploads are removed after this time
+
 		clockUtils::sockets::TcpSocket * _listenUploadServer;
+		DownloadSizeChecker * _downloadSizeChecker;
 
 		void handleUploadFiles(clockUtils::sockets::TcpSocket * sock) const;
+
+		/**
+		 * \brief creates an Upload for every file with content, offsets are only kept if the upload can be resumed
+		 * returns false if the message contains an invalid filename
+		 */
+		bool prepareUploads(const common::UploadModfilesMessage & umm, bool resumable, std::vector<Upload> & uploads) const;
+
+		/**
+		 * \brief moves the received files in place and updates the database, synchronization jobs are added in the background afterwards
+		 */
+		bool commitUpload(const common::UploadModfilesMessage & umm, const std::vector<Upload> & uploads) const;
+
+		static std::string getBackupPath(const Upload & upload);
+
+		/**
+		 * \brief replaces the file by the received part, the old file is kept at getBackupPath until the upload is committed
+		 */
+		static bool moveInPlace(const Upload & upload);
+
+		/**
+		 * \brief undoes moveInPlace for the first count uploads
+		 */
+		static void restore(const std::vector<Upload> & uploads, size_t count);
 	};
 
 } /* namespace server */
@@ -19,8 +19,11 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <QtGlobal>
@@ -44,18 +47,47 @@ public:
 	/**
 	 * \brief executes an arbitary sql operation
 	 * \param[in] dbpath filename of the database to be used
-	 * \param[in] query Query string to be executed
+	 * \param[in] query Query string to be executed, can contain several statements
 	 */
 	static void execute(const std::string & dbpath, const std::string & query, DBError & error);
 
 	/**
-	 * \brief opens given database and keeps it open
+	 * \brief executes a single statement with the parameters bound to its placeholders (?)
+	 * the prepared statement is cached, so executing it again with other values doesn't parse the query again
+	 * \param[in] dbpath filename of the database to be used
+	 * \param[in] query Query string to be executed
+	 * \param[in] params values for the placeholders, integral types, double, std::string and const char * are supported
+	 */
+	template<typename... Params>
+	static void execute(const std::string & dbpath, const std::string & query, DBError & error, const Params &... params) {
+		const auto connection = getConnection(dbpath, true, error);
+		if (!connection) return;
+
+		std::lock_guard<std::mutex> lg(connection->lock);
+		sqlite3_stmt * stmt = prepare(*connection, query, true, error);
+		if (!stmt) return;
+
+		if (bindParameters(stmt, 1, error, params...)) {
+			const int r = sqlite3_step(stmt);
+			if (r != SQLITE_DONE && r != SQLITE_ROW) {
+				error.error = true;
+				error.errMsg = std::string("step(): ") + sqlite3_errmsg(connection->db);
+			} else {
+				error.error = false;
+			}
+		}
+		finish(*connection, stmt, true);
+	}
+
+	/**
+	 * \brief opens given database and keeps it open until close is called
+	 * all databases stay open after their first use anyway, this only matters for connection specific settings like pragmas
 	 * \param[in] dbpath filename of the database to be used
 	 */
 	static void open(const std::string & dbpath, DBError & error);
 
 	/**
-	 * \brief closes given database
+	 * \brief ends what open started, the connection itself stays open for other users and gets its default pragmas back
 	 * \param[in] dbpath filename of the database to be used
 	 */
 	static void close(const std::string & dbpath, DBError & error);
@@ -71,30 +103,23 @@ public:
 	 */
 	template<typename Result, typename... Columns>
 	static Result queryNth(std::string dbpath, std::string query, DBError & error, unsigned int n = 0) {
-		sqlite3 * db;
-		sqlite3_stmt * stmt;
-		std::lock_guard<std::mutex> lg(_lock); // _lock the database vector and sqlite
-		int r = sqlite3_open_v2(dbpath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
-		if (r != SQLITE_OK) {
-			error.error = true;
-			error.errMsg = std::string("open(): ") + sqlite3_errmsg(db);
-			return Result();
-		}
-		r = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
-		if (r != SQLITE_OK) {
-			error.error = true;
-			error.errMsg = std::string("prepare(): ") + sqlite3_errmsg(db);
-			return Result();
-		}
+		const auto connection = getConnection(dbpath, false, error);
+		if (!connection) return Result();
+
+		std::lock_guard<std::mutex> lg(connection->lock);
+		sqlite3_stmt * stmt = prepare(*connection, query, false, error);
+		if (!stmt) return Result();
+
 		for (unsigned int i = 0; i <= n; i++) {
-			r = sqlite3_step(stmt);
+			const int r = sqlite3_step(stmt);
 			if (r != SQLITE_ROW) {
 				error.error = true;
 				if (r == SQLITE_DONE) {
 					error.errMsg = std::string("not enough rows available");
 				} else {
-					error.errMsg = std::string("step(): ") + sqlite3_errmsg(db);
+					error.errMsg = std::string("step(): ") + sqlite3_errmsg(connection->db);
 				}
+				finish(*connection, stmt, false);
 				return Result();
 			}
 		}
@@ -103,13 +128,13 @@ public:
 		std::tuple<Columns...> resultColumns = colRet.retrieve(stmt);
 
 		Result ret = tupleToResult<Result>(resultColumns, typename GenerateSequence<sizeof...(Columns)>::type());
-		if (sqlite3_errcode(db) != SQLITE_OK && sqlite3_errcode(db) != SQLITE_ROW && sqlite3_errcode(db) != SQLITE_DONE) {
+		if (sqlite3_errcode(connection->db) != SQLITE_OK && sqlite3_errcode(connection->db) != SQLITE_ROW && sqlite3_errcode(connection->db) != SQLITE_DONE) {
 			error.error = true;
-			error.errMsg = std::string("column_*(): ") + sqlite3_errstr(sqlite3_errcode(db)); // sqlite3_errmsg() doesn't work here, because a later call to queryColumn may have succeeded
+			error.errMsg = std::string("column_*(): ") + sqlite3_errstr(sqlite3_errcode(connection->db)); // sqlite3_errmsg() doesn't work here, because a later call to queryColumn may have succeeded
+			finish(*connection, stmt, false);
 			return Result();
 		}
-		sqlite3_finalize(stmt);
-		sqlite3_close(db);
+		finish(*connection, stmt, false);
 		error.error = false;
 		return ret;
 	}
@@ -119,58 +144,50 @@ public:
 	 * \param[in] dbpath path to the database file
 	 * \param[in] query query to execute
 	 * \param[out] error strcut containing the result code
+	 * \param[in] params values for placeholders (?) in the query, if there are any the prepared statement is cached
 	 * \returns vector containing all rows
 	 * if an error occured, the returned vector may still contain some data, but
 	 * it is not guaranteed that the data is complete or correct
 	 */
-	template<typename Result, typename... Columns>
-	static QList<Result> queryAll(std::string dbpath, std::string query, DBError & error) {
-		sqlite3 * db;
-		sqlite3_stmt * stmt;
+	template<typename Result, typename... Columns, typename... Params>
+	static QList<Result> queryAll(std::string dbpath, std::string query, DBError & error, const Params &... params) {
 		QList<Result> v;
-		bool selfOpened = false;
-		std::lock_guard<std::mutex> lg(_lock); // _lock the database vector and sqlite
-		if (_databases.find(dbpath) != _databases.end()) {
-			db = _databases[dbpath];
-		} else {
-			const int r = sqlite3_open_v2(dbpath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
-			if (r != SQLITE_OK) {
-				error.error = true;
-				error.errMsg = std::string("open(): ") + sqlite3_errmsg(db);
-				return v;
-			}
-			selfOpened = true;
-		}
-		int r = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
-		if (r != SQLITE_OK) {
-			error.error = true;
-			error.errMsg = std::string("prepare(): ") + sqlite3_errmsg(db);
+		const auto connection = getConnection(dbpath, false, error);
+		if (!connection) return v;
+
+		// queries without parameters usually have their values in the query string, so caching them would be useless
+		const bool cache = sizeof...(Params) > 0;
+
+		std::lock_guard<std::mutex> lg(connection->lock);
+		sqlite3_stmt * stmt = prepare(*connection, query, cache, error);
+		if (!stmt) return v;
+
+		if (!bindParameters(stmt, 1, error, params...)) {
+			finish(*connection, stmt, cache);
 			return v;
 		}
-		while ((r = sqlite3_step(stmt)) == SQLITE_ROW) {
-			DBError err;
 
+		int r;
+		while ((r = sqlite3_step(stmt)) == SQLITE_ROW) {
 			ColumnRetriever<sizeof...(Columns) - 1, Columns...> colRet;
 			std::tuple<Columns...> resultColumns = colRet.retrieve(stmt);
 
 			Result ret = tupleToResult<Result>(resultColumns, typename GenerateSequence<sizeof...(Columns)>::type());
-			if (sqlite3_errcode(db) != SQLITE_OK && sqlite3_errcode(db) != SQLITE_ROW && sqlite3_errcode(db) != SQLITE_DONE) {
+			if (sqlite3_errcode(connection->db) != SQLITE_OK && sqlite3_errcode(connection->db) != SQLITE_ROW && sqlite3_errcode(connection->db) != SQLITE_DONE) {
 				error.error = true;
-				error.errMsg = std::string("column_*(): ") + sqlite3_errstr(sqlite3_errcode(db)); // sqlite3_errmsg() doesn't work here, because a later call to queryColumn may have succeeded
+				error.errMsg = std::string("column_*(): ") + sqlite3_errstr(sqlite3_errcode(connection->db)); // sqlite3_errmsg() doesn't work here, because a later call to queryColumn may have succeeded
+				finish(*connection, stmt, cache);
 				return v;
 			}
 			v.push_back(ret);
 		}
 		if (r != SQLITE_DONE) {
 			error.error = true;
-			error.errMsg = std::string("step(): ") + sqlite3_errmsg(db);
+			error.errMsg = std::string("step(): ") + sqlite3_errmsg(connection->db);
+			finish(*connection, stmt, cache);
 			return v;
 		}
-		sqlite3_finalize(stmt);
-
-		if (selfOpened) {
-			sqlite3_close(db);
-		}
+		finish(*connection, stmt, cache);
 		error.error = false;
 		return v;
 	}
@@ -182,55 +199,79 @@ public:
 	 * \param[out] error strcut containing the result code
 	 * \returns number of rows the query produces, or -1 if an error occured
 	 */
-	static int queryCount(std::string dbpath, std::string query, DBError & error) {
-		sqlite3 * db;
-		sqlite3_stmt * stmt;
-		std::lock_guard<std::mutex> lg(_lock); // _lock the database vector and sqlite
-		int r = sqlite3_open_v2(dbpath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
-		if (r != SQLITE_OK) {
-			error.error = true;
-			error.errMsg = std::string("open(): ") + sqlite3_errmsg(db);
-			return -1;
-		}
-		r = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr);
-		if (r != SQLITE_OK) {
-			error.error = true;
-			error.errMsg = std::string("prepare(): ") + sqlite3_errmsg(db);
-			return -1;
-		}
-		int counter = 0;
-		while((r = sqlite3_step(stmt)) == SQLITE_ROW) {
-			counter++;
-		}
-		if (r != SQLITE_DONE) {
-			error.error = true;
-			error.errMsg = std::string("step(): ") + sqlite3_errmsg(db);
-			return -1;
-		}
-		sqlite3_finalize(stmt);
-		sqlite3_close(db);
-		error.error = false;
-		return counter;
-	}
+	static int queryCount(std::string dbpath, std::string query, DBError & error);
 
 	/**
 	 * \brief returns whether the given Database exists and can be opend
 	 */
-	static bool exists(std::string dbpath) {
+	static bool exists(std::string dbpath);
+
+private:
+	/**
+	 * \brief one long-lived connection per database file
+	 * every connection has its own lock, so different databases can be used from different threads at the same time
+	 */
+	struct Connection {
 		sqlite3 * db;
-		std::lock_guard<std::mutex> lg(_lock); // _lock the database vector and sqlite
-		int r = sqlite3_open_v2(dbpath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+		std::mutex lock; // guards db and statements
+		std::map<std::string, sqlite3_stmt *> statements; // query => prepared statement
+		bool opened; // explicitly opened with open()
+
+		Connection() : db(nullptr), opened(false) {}
+		~Connection();
+	};
+
+	static const size_t MAX_CACHED_STATEMENTS;
+
+	// only guards _connections, the databases themselves are guarded by the lock of their connection
+	static std::mutex _lock;
+	static std::map<std::string, std::shared_ptr<Connection>> _connections;
+
+	/**
+	 * \brief returns the connection to the database and opens it if necessary
+	 * \param[in] create whether a missing database file is created, queries only read existing databases
+	 */
+	static std::shared_ptr<Connection> getConnection(const std::string & dbpath, bool create, DBError & error);
+
+	/**
+	 * \brief sets the pragmas every connection starts with, pragmas changed between open() and close() are reset this way
+	 */
+	static void setDefaultPragmas(sqlite3 * db);
+
+	/**
+	 * \brief returns a prepared statement, cached ones are reused, the lock of the connection has to be held
+	 */
+	static sqlite3_stmt * prepare(Connection & connection, const std::string & query, bool cache, DBError & error);
+
+	/**
+	 * \brief resets a cached statement for its next use or finalizes an uncached one
+	 */
+	static void finish(Connection & connection, sqlite3_stmt * stmt, bool cached);
+
+	template<typename T>
+	static typename std::enable_if<std::is_integral<T>::value, int>::type bindParameter(sqlite3_stmt * stmt, int index, T value) {
+		return sqlite3_bind_int64(stmt, index, static_cast<sqlite3_int64>(value));
+	}
+
+	static int bindParameter(sqlite3_stmt * stmt, int index, double value);
+	static int bindParameter(sqlite3_stmt * stmt, int index, const std::string & value);
+	static int bindParameter(sqlite3_stmt * stmt, int index, const char * value);
+
+	static bool bindParameters(sqlite3_stmt *, int, DBError &) {
+		return true;
+	}
+
+	template<typename Param, typename... Params>
+	static bool bindParameters(sqlite3_stmt * stmt, int index, DBError & error, const Param & param, const Params &... params) {
+		const int r = bindParameter(stmt, index, param);
 		if (r != SQLITE_OK) {
+			error.error = true;
+			error.errMsg = std::string("bind(): ") + sqlite3_errstr(r);
 			return false;
 		}
-		sqlite3_close(db);
-		return true;
+		return bindParameters(stmt, index + 1, error, params...);
 	}
 
-private:
-	 // _lock the database vector and sqlite
-	static std::mutex _lock;
-
 	template<typename T>
 	static T queryColumn(int column, sqlite3_stmt * stmt) {
 		return T();
@@ -315,7 +356,6 @@ private:
 		return Result({std::get<S>(tpl)...});
 	}
 
-	static std::map<std::string, sqlite3 *> _databases;
 };
 
 template<>
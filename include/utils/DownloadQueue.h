@@ -31,7 +31,10 @@ namespace spine {
 namespace utils {
 
 	class MultiFileDownloader;
-	
+
+	/**
+	 * \brief runs the queued MultiFileDownloaders, a few of them at once so a mod of many small files doesn't block everything behind it
+	 */
 	class DownloadQueue : public QObject {
 		Q_OBJECT
 		
@@ -54,16 +57,21 @@ namespace utils {
 
 	private:
 		static DownloadQueue * instance;
+		static const int MAX_RUNNING;
 		
 		QQueue<MultiFileDownloader *> _queue;
 		QWinTaskbarButton * _taskbarButton;
 		QWinTaskbarProgress * _taskbarProgress;
-		MultiFileDownloader * _running;
+		QSet<const MultiFileDownloader *> _running;
 		QMap<const MultiFileDownloader *, qint64> _totalBytesMap;
 		QMap<const MultiFileDownloader *, qint64> _downloadedBytesMap;
 		QSet<const MultiFileDownloader *> _cancelled;
+		qint64 _runningTotalBytes; // sums over the running downloads for the taskbar
+		qint64 _runningDownloadedBytes;
 
 		void checkQueue();
+		void removeRunning(const MultiFileDownloader * downloader);
+		void updateTaskbar();
 	};
 
 } /* namespace utils */
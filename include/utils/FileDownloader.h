@@ -21,12 +21,16 @@
 #include <QNetworkReply>
 #include <QObject>
 #include <QUrl>
+#include <QVector>
 
 class QFile;
+class QNetworkAccessManager;
 
 namespace spine {
 namespace utils {
 
+	class StreamingUncompressor;
+
 	enum class DownloadError {
 		NoError,
 		UnknownError,
@@ -36,6 +40,11 @@ namespace utils {
 		CanceledError
 	};
 
+	/**
+	 * \brief downloads a single file into a .part file next to its target, interrupted downloads are resumed with Range requests
+	 * large files are split into segments downloaded in parallel if the server supports ranges
+	 * all downloaders of a thread share one QNetworkAccessManager, so connections to the same host are reused
+	 */
 	class FileDownloader : public QObject {
 		Q_OBJECT
 
@@ -47,6 +56,13 @@ namespace utils {
 		void startDownload();
 		void requestFileSize();
 		QString getFileName() const;
+		QUrl getUrl() const;
+
+		/**
+		 * \brief number of connections startDownload opens, large files use one per segment if the server supports ranges
+		 * only known after requestFileSize, one before
+		 */
+		int getConnectionCount() const;
 
 		void cancel();
 
@@ -63,24 +79,54 @@ namespace utils {
 		void retry();
 
 	private slots:
-		void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 		void fileDownloaded();
 		void determineFileSize();
 		void writeToFile();
-		void networkError(QNetworkReply::NetworkError err);
 		void sslErrors(const QList<QSslError> & errors);
 
 	private:
+		typedef struct {
+			qint64 start;
+			qint64 end; // inclusive, -1 if the size is unknown and the segment reaches until the end of the file
+			qint64 received;
+			QFile * file;
+			QNetworkReply * reply;
+			bool checkedRange; // whether the status code of the current reply was checked already
+		} Segment;
+
 		QUrl _url;
 		QUrl _fallbackUrl;
 		QString _targetDirectory;
 		QString _fileName;
 		QString _hash;
 		qint64 _filesize;
-		QFile * _outputFile;
+		bool _acceptRanges;
+		QVector<Segment> _segments;
+		StreamingUncompressor * _uncompressor; // only set while a fresh single stream is downloaded
+		int _resumeAttempts;
 		bool _finished;
-		bool _retried;
-		bool _blockErrors;
+		bool _failed;
+
+		static QNetworkAccessManager * getNetworkAccessManager();
+
+		QString getPartPath() const;
+		QString getSegmentPath(int index) const;
+		int findSegment(QNetworkReply * reply) const;
+		qint64 getReceivedBytes() const;
+
+		void startSegment(int index);
+		bool writeData(Segment & segment, const QByteArray & data);
+
+		/**
+		 * \brief closes all segments, partial files are kept so the next attempt can resume them
+		 */
+		void closeSegments();
+		void failDownload(DownloadError error);
+
+		/**
+		 * \brief uncompresses and hashes the part files in one pass unless this happened during the download already and moves the result to its final name
+		 */
+		DownloadError finishPartFile(QString & hash);
 
 		void uncompressAndHash();
 
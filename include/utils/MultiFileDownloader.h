@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <QHash>
+#include <QList>
 #include <QMap>
 #include <QQueue>
 #include <QObject>
@@ -32,11 +34,17 @@ namespace utils {
 	class FileDownloader;
 	enum class DownloadError;
 
+	/**
+	 * \brief downloads a set of files, several of them at once with a limit of connections per host
+	 * the larger files start first, so no big file is left running alone at the end
+	 * the limit is shared by all MultiFileDownloaders of a thread, as they also share the QNetworkAccessManager of the FileDownloaders
+	 */
 	class MultiFileDownloader : public QObject {
 		Q_OBJECT
 
 	public:
 		MultiFileDownloader(QObject * par);
+		~MultiFileDownloader();
 
 		void addFileDownloader(FileDownloader * fileDownloader);
 		void startDownloads(qint64 maxSize); // deprecated
@@ -61,12 +69,35 @@ namespace utils {
 		void finishedFile();
 
 	private:
-		QMap<FileDownloader *, QPair<qint64, qint64>> _downloadStats;
-		QQueue<FileDownloader *> _downloadQueue;
-		QMap<FileDownloader *, QPair<qint64, qint64>>::iterator _currentIndex;
-		int _counter;
+		static const int MAX_DOWNLOADS;
+		static const int MAX_CONNECTIONS_PER_HOST;
+		static const int MAX_SIZE_REQUESTS;
+
+		static thread_local QHash<QString, int> _connectionsPerHost; // host => connections of all running FileDownloaders of this thread
+		static thread_local QList<MultiFileDownloader *> _instances; // waiting ones start files when another one frees connections
+
+		QMap<FileDownloader *, QPair<qint64, qint64>> _downloadStats; // received, total
+		QList<FileDownloader *> _downloadQueue;
+		QHash<FileDownloader *, QPair<QString, int>> _runningDownloads; // FileDownloader => host it was started for and its connections
+		QQueue<FileDownloader *> _sizeQueue;
+		int _sizeRequests;
 		qint64 _maxSize;
+		qint64 _downloadedBytes;
 		int _downloadFilesCount;
+		bool _started;
+		bool _scheduling;
+		bool _scheduleAgain;
+
+		/**
+		 * \brief starts queued files until the limits are reached
+		 */
+		void scheduleDownloads();
+
+		/**
+		 * \brief gives the connections of a started file back and lets all MultiFileDownloaders of the thread use them
+		 */
+		void releaseConnections(const QString & host, int connections);
+		void requestNextSizes();
 	};
 
 } /* namespace utils */
@@ -0,0 +1,90 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#pragma once
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QString>
+
+#include "zlib.h"
+
+namespace spine {
+namespace utils {
+
+	/**
+	 * \brief inflates a file compressed with Compression block by block while it is written and hashes the result on the way
+	 * this way every byte is only written once and never read back, the hash is the same Hashing::hash computes for the uncompressed file
+	 * uncompressed data is only hashed and optionally copied to the target
+	 */
+	class StreamingUncompressor {
+	public:
+		/**
+		 * \brief targetFile can be empty if data isn't compressed and only the hash is needed
+		 */
+		StreamingUncompressor(bool compressed, const QString & targetFile);
+		~StreamingUncompressor();
+
+		StreamingUncompressor(const StreamingUncompressor &) = delete;
+		StreamingUncompressor & operator=(const StreamingUncompressor &) = delete;
+
+		bool open();
+
+		/**
+		 * \brief processes the next block of the stream, after an error all further calls fail
+		 */
+		bool add(const char * data, qint64 size);
+
+		/**
+		 * \brief reads the complete file and processes it
+		 */
+		bool addFile(const QString & file);
+
+		/**
+		 * \brief closes the target file, fails if the compressed stream is incomplete
+		 */
+		bool finish();
+
+		/**
+		 * \brief SHA-512 of the uncompressed data as lower case hex string, only valid after finish
+		 */
+		QString getHash() const;
+
+		/**
+		 * \brief whether the last error was caused by writing the target and not by invalid data
+		 */
+		bool isWriteError() const {
+			return _writeError;
+		}
+
+	private:
+		bool _compressed;
+		QFile _target;
+		QCryptographicHash _hash;
+		z_stream _stream;
+		bool _initialized;
+		bool _streamEnded;
+		bool _failed;
+		bool _writeError;
+		QByteArray _buffer;
+
+		bool output(const char * data, qint64 size);
+	};
+
+} /* namespace utils */
+} /* namespace spine */
@@ -635,15 +635,15 @@ void ILauncher::removeAchievementProgress(int32_t projectID, int32_t identifier)
 
 void ILauncher::cacheOverallSaveData(int32_t projectID, const std::string & key, const std::string & value) const {
 	Database::DBError err;
-	Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "INSERT INTO overallSaveDataCache (ModID, Entry, Value) VALUES (" + std::to_string(projectID) + ", '" + key + "', '" + value + "');", err);
+	Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "INSERT INTO overallSaveDataCache (ModID, Entry, Value) VALUES (?, ?, ?);", err, projectID, key, value);
 	if (err.error) {
-		Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "UPDATE overallSaveDataCache SET Value = '" + value + "' WHERE ModID = " + std::to_string(projectID) + " AND Entry = '" + key + "';", err);
+		Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "UPDATE overallSaveDataCache SET Value = ? WHERE ModID = ? AND Entry = ?;", err, value, projectID, key);
 	}
 }
 
 void ILauncher::removeOverallSaveData(int32_t projectID, const std::string & key) const {
 	Database::DBError err;
-	Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "DELETE FROM overallSaveDataCache WHERE ModID = " + std::to_string(projectID) + " AND Entry = '" + key + "';", err);
+	Database::execute(Config::BASEDIR.toStdString() + "/" + FIX_DATABASE, "DELETE FROM overallSaveDataCache WHERE ModID = ? AND Entry = ?;", err, projectID, key);
 }
 
 void ILauncher::synchronizeOfflineData() {
@@ -751,7 +751,6 @@ void ILauncher::synchronizeOfflineData() {
 
 					Database::open(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, err2);
 					Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "PRAGMA synchronous = OFF;", err2);
-					Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "PRAGMA journal_mode = MEMORY;", err2);
 					Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "PRAGMA cache_size=10000;", err2);
 					Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "BEGIN TRANSACTION;", err2);
 
@@ -114,6 +114,9 @@ void AutoUpdateDialog::checkForUpdate() {
 	}
 	common::UpdateFilesMessage * ufm = dynamic_cast<common::UpdateFilesMessage *>(m);
 
+	// the server answers in binary only if it understands binary messages as well, so all further messages can use it
+	common::Message::SetDefaultFormat(common::Message::GetReplyFormat());
+
 	if (ufm->files.empty()) {
 		if (_manuallyChecking) {
 			QMessageBox resultMsg(QMessageBox::Icon::Information, QApplication::tr("VersionUpToDate"), QApplication::tr("VersionUpToDateText"), QMessageBox::StandardButton::Ok);
@@ -18,6 +18,7 @@
 
 #include "widgets/IntegrityCheckDialog.h"
 
+#include <atomic>
 #include <thread>
 
 #include "SpineConfig.h"
@@ -30,11 +31,14 @@
 #include "clockUtils/log/Log.h"
 
 #include <QApplication>
+#include <QDateTime>
 #include <QDirIterator>
 #include <QFileInfo>
 #include <QFutureWatcher>
 #include <QMainWindow>
 #include <QProgressBar>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 
 #ifdef Q_OS_WIN
@@ -187,21 +191,28 @@ void IntegrityCheckDialog::process(int projectID) {
 	}
 	
 	auto files = Database::queryAll<ModFile, std::string, std::string, std::string>(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, statement, err);
-	int amount = static_cast<int>(files.size());
+
+	QVector<HashJob> jobs;
+	jobs.reserve(files.size() + gothicFileList.size() + gothic2FileList.size());
+
+	for (int i = 0; i < files.size(); i++) {
+		jobs.append(HashJob(Config::DOWNLOADDIR + "/mods/" + QString::number(files[i].modID) + "/" + files[i].file, files[i].hash, HashJob::Mod, i));
+	}
 	if (!_gothicDirectory.isEmpty()) {
-		amount += gothicFileList.size();
+		for (auto it2 = gothicFileList.constBegin(); it2 != gothicFileList.constEnd(); ++it2) {
+			jobs.append(HashJob(_gothicDirectory + "/" + it2.key(), it2.value(), HashJob::Gothic, -1));
+		}
 	}
 	if (!_gothic2Directory.isEmpty()) {
-		amount += gothic2FileList.size();
-	}
-	emit updateCount(amount + 1);
-	int count = 0;
-	int step = amount / 200;
-	step = 1;
-	if (step == 0) {
-		step = 1;
+		for (auto it2 = gothic2FileList.constBegin(); it2 != gothic2FileList.constEnd(); ++it2) {
+			jobs.append(HashJob(_gothic2Directory + "/" + it2.key(), it2.value(), HashJob::Gothic2, -1));
+		}
 	}
-	QSet<QString> allFiles;
+
+	emit updateCount(jobs.size() + 1);
+
+	// lower case path => path, files still in here after the check don't belong to any project and are removed
+	QHash<QString, QString> allFiles;
 
 	auto projectDir = Config::DOWNLOADDIR + "/mods/";
 
@@ -213,104 +224,160 @@ void IntegrityCheckDialog::process(int projectID) {
 	while (it.hasNext()) {
 		QString path = it.next();
 		if (!path.contains(".spsav")) {
-			allFiles.insert(path);
+			allFiles.insert(path.toLower(), path);
 		}
 	}
 
-	QSet<int> d3d11Versions;
-	
-	for (const ModFile & file : files) {
-		QFileInfo fi(file.file);
-		if (count % step == 0) {
-			emit updateText(fi.fileName());
+	for (const HashJob & job : jobs) {
+		if (job.type == HashJob::Mod) {
+			allFiles.remove(job.path.toLower());
 		}
+	}
+
+	const QHash<QString, CachedHash> cache = loadHashCache();
+
+	std::atomic<int> count(0);
+	std::atomic<int> lastJob(-1);
+
+	// this thread belongs to the global pool as well and only waits from here on, so its slot is given to the hashing
+	// otherwise a single core machine never starts hashing and on two cores only one file is hashed at a time
+	QThreadPool::globalInstance()->releaseThread();
+
+	// files are hashed in parallel, size and modification time unchanged since the last check means the cached hash is still valid
+	QFuture<void> future = QtConcurrent::map(jobs, [this, &cache, &count, &lastJob, &jobs](HashJob & job) {
+		if (!_running) return;
 
-		const bool b = utils::Hashing::checkHash(Config::DOWNLOADDIR + "/mods/" + QString::number(file.modID) + "/" + file.file, file.hash);
-		if (!b && !file.file.contains("directx_Jun2010_redist.exe", Qt::CaseInsensitive)) {
-			_corruptFiles.append(file);
-
-			if (file.file.contains("GD3D11", Qt::CaseInsensitive) && !d3d11Versions.contains(file.modID)) {
-				d3d11Versions.insert(file.modID);
-
-				{
-					ModFile mf;
-					mf.modID = file.modID;
-					mf.file = "D3D11.zip";
-					_corruptFiles.append(mf);
-				}
-				{
-					ModFile mf;
-					mf.modID = file.modID;
-					mf.file = "archive.zip";
-					_corruptFiles.append(mf);
-				}
+		lastJob = static_cast<int>(&job - jobs.constData());
+
+		const QFileInfo fi(job.path);
+
+		if (fi.exists()) {
+			job.size = fi.size();
+			job.modificationTime = fi.lastModified().toMSecsSinceEpoch();
+
+			const auto cachedIt = cache.constFind(job.path);
+
+			if (cachedIt != cache.constEnd() && cachedIt->size == job.size && cachedIt->modificationTime == job.modificationTime) {
+				job.hash = cachedIt->hash;
+			} else if (Hashing::hash(job.path, job.hash)) {
+				job.hashed = true;
 			}
 		}
 
-		for (auto it2 = allFiles.begin(); it2 != allFiles.end(); ++it2) {
-			const auto path = Config::DOWNLOADDIR + "/mods/" + QString::number(file.modID) + "/" + file.file;
-			const auto refPath = *it2;
+		job.processed = true;
 
-			if (refPath.compare(path, Qt::CaseInsensitive) != 0) continue;
-			
-			allFiles.erase(it2);
+		++count;
+	});
 
-			break;
-		}
-		count++;
-		if (count % step == 0) {
-			emit updateValue(count);
+	// one update per interval instead of one per file, every update blocks until the GUI thread handled it
+	while (!future.isFinished()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		const int index = lastJob;
+
+		if (index >= 0) {
+			emit updateText(QFileInfo(jobs.at(index).path).fileName());
 		}
+
+		emit updateValue(count);
+
 		if (!_running) {
+			future.cancel();
+			future.waitForFinished();
 			emit rejected();
 			break;
 		}
 	}
-	if (!_gothicDirectory.isEmpty()) {
-		for (auto it2 = gothicFileList.constBegin(); it2 != gothicFileList.constEnd(); ++it2) {
-			QFileInfo fi(it2.key());
-			emit updateText(fi.fileName());
 
-			const bool b = utils::Hashing::checkHash(_gothicDirectory + "/" + it2.key(), it2.value());
-			if (!b) {
-				_corruptGothicFiles.append(ModFile(it2.key(), it2.value()));
-			}
+	QThreadPool::globalInstance()->reserveThread();
 
-			count++;
-			emit updateValue(count);
-			if (!_running) {
-				emit rejected();
-				break;
-			}
+	emit updateValue(count);
+
+	storeHashCache(jobs);
+
+	if (!_running) return;
+
+	QSet<int> d3d11Versions;
+
+	for (const HashJob & job : jobs) {
+		if (job.hash == job.referenceHash) continue;
+
+		if (job.type == HashJob::Gothic) {
+			_corruptGothicFiles.append(ModFile(job.path.mid(_gothicDirectory.size() + 1), job.referenceHash));
+			continue;
 		}
-	}
-	if (!_gothic2Directory.isEmpty()) {
-		for (auto it2 = gothic2FileList.constBegin(); it2 != gothic2FileList.constEnd(); ++it2) {
-			QFileInfo fi(it2.key());
-			emit updateText(fi.fileName());
 
-			const bool b = utils::Hashing::checkHash(_gothic2Directory + "/" + it2.key(), it2.value());
-			if (!b) {
-				_corruptGothic2Files.append(ModFile(it2.key(), it2.value()));
-			}
+		if (job.type == HashJob::Gothic2) {
+			_corruptGothic2Files.append(ModFile(job.path.mid(_gothic2Directory.size() + 1), job.referenceHash));
+			continue;
+		}
+
+		const ModFile & file = files[job.index];
+
+		if (file.file.contains("directx_Jun2010_redist.exe", Qt::CaseInsensitive)) continue;
+
+		_corruptFiles.append(file);
 
-			count++;
-			emit updateValue(count);
-			if (!_running) {
-				emit rejected();
-				break;
+		if (file.file.contains("GD3D11", Qt::CaseInsensitive) && !d3d11Versions.contains(file.modID)) {
+			d3d11Versions.insert(file.modID);
+
+			{
+				ModFile mf;
+				mf.modID = file.modID;
+				mf.file = "D3D11.zip";
+				_corruptFiles.append(mf);
+			}
+			{
+				ModFile mf;
+				mf.modID = file.modID;
+				mf.file = "archive.zip";
+				_corruptFiles.append(mf);
 			}
 		}
 	}
-	if (_running) {
-		for (const QString & file : allFiles) {
-			QFile(file).remove();
+
+	for (const QString & file : allFiles) {
+		QFile(file).remove();
+	}
+
+	if (Config::extendedLogging) {
+		for (const auto & mf : _corruptFiles) {
+			LOGINFO("Integrity Check - Hash invalid: " << q2s(mf.file) << " (" << mf.modID << ")")
 		}
+	}
+}
 
-		if (Config::extendedLogging) {
-			for (const auto & mf : _corruptFiles) {
-				LOGINFO("Integrity Check - Hash invalid: " << q2s(mf.file) << " (" << mf.modID << ")")
-			}
+QHash<QString, IntegrityCheckDialog::CachedHash> IntegrityCheckDialog::loadHashCache() const {
+	Database::DBError err;
+	Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "CREATE TABLE IF NOT EXISTS hashCache(Path TEXT PRIMARY KEY, Size INT NOT NULL, ModificationTime INT NOT NULL, Hash TEXT NOT NULL);", err);
+
+	const auto entries = Database::queryAll<CachedHash, std::string, std::string, std::string, std::string>(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "SELECT Path, Size, ModificationTime, Hash FROM hashCache;", err);
+
+	QHash<QString, CachedHash> cache;
+	cache.reserve(entries.size());
+
+	for (const CachedHash & entry : entries) {
+		cache.insert(entry.path, entry);
+	}
+
+	return cache;
+}
+
+void IntegrityCheckDialog::storeHashCache(const QVector<HashJob> & jobs) const {
+	Database::DBError err;
+	Database::open(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, err);
+	Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "BEGIN TRANSACTION;", err);
+
+	for (const HashJob & job : jobs) {
+		if (!job.processed) continue;
+
+		if (job.size == -1) {
+			Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "DELETE FROM hashCache WHERE Path = ?;", err, job.path.toUtf8().toStdString());
+		} else if (job.hashed) {
+			Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "INSERT OR REPLACE INTO hashCache (Path, Size, ModificationTime, Hash) VALUES (?, ?, ?, ?);", err, job.path.toUtf8().toStdString(), job.size, job.modificationTime, job.hash.toStdString());
 		}
 	}
+
+	Database::execute(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, "END TRANSACTION;", err);
+	Database::close(Config::BASEDIR.toStdString() + "/" + INSTALLED_DATABASE, err);
 }
@@ -996,7 +996,13 @@ void ModDatabaseView::downloadModFiles(Mod mod, QSharedPointer<QList<QPair<QStri
 		buttonItem->setData(false, Installed);
 	});
 
-	connect(mfd, &MultiFileDownloader::downloadSucceeded, [this, mod, fileList]() {
+	const auto downloadedBytes = QSharedPointer<qint64>::create(0);
+
+	connect(mfd, &MultiFileDownloader::totalBytes, [downloadedBytes](qint64 bytes) {
+		*downloadedBytes = bytes;
+	});
+
+	connect(mfd, &MultiFileDownloader::downloadSucceeded, [this, mod, fileList, fileserver, downloadedBytes]() {
 		_downloadingList.removeAll(mod.id);
 		
 		int row = 0;
@@ -1037,6 +1043,8 @@ void ModDatabaseView::downloadModFiles(Mod mod, QSharedPointer<QList<QPair<QStri
 
 		QJsonObject json;
 		json["ID"] = mod.id;
+		json["Fileserver"] = fileserver;
+		json["Size"] = *downloadedBytes;
 
 		Https::postAsync(DATABASESERVER_PORT, "downloadSucceeded", QJsonDocument(json).toJson(QJsonDocument::Compact), [](const QJsonObject &, int) {});
 
@@ -1283,7 +1291,13 @@ void ModDatabaseView::downloadPackageFiles(Mod mod, Package package, QSharedPoin
 		buttonItem->setToolTip(QApplication::tr("Downloading"));
 	});
 
-	connect(mfd, &MultiFileDownloader::downloadSucceeded, [this, package, fileList, mod]() {
+	const auto downloadedBytes = QSharedPointer<qint64>::create(0);
+
+	connect(mfd, &MultiFileDownloader::totalBytes, [downloadedBytes](qint64 bytes) {
+		*downloadedBytes = bytes;
+	});
+
+	connect(mfd, &MultiFileDownloader::downloadSucceeded, [this, package, fileList, mod, fileserver, downloadedBytes]() {
 		_downloadingPackageList.removeAll(package.packageID);
 		
 		TextItem * buttonItem = _packageIDIconMapping[package.packageID];
@@ -1307,6 +1321,8 @@ void ModDatabaseView::downloadPackageFiles(Mod mod, Package package, QSharedPoin
 		// notify server download was successful
 		QJsonObject json;
 		json["ID"] = package.packageID;
+		json["Fileserver"] = fileserver;
+		json["Size"] = *downloadedBytes;
 
 		Https::postAsync(DATABASESERVER_PORT, "packageDownloadSucceeded", QJsonDocument(json).toJson(QJsonDocument::Compact), [](const QJsonObject &, int) {});
 
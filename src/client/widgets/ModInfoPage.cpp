@@ -81,6 +81,10 @@ using namespace spine::https;
 using namespace spine::utils;
 using namespace spine::widgets;
 
+namespace {
+	constexpr qint64 SCREENSHOT_CHUNK_SIZE = 256 * 1024;
+}
+
 ModInfoPage::ModInfoPage(QMainWindow * mainWindow, QWidget * par) : QWidget(par), _mainWindow(mainWindow), _projectNameLabel(nullptr), _previewImageLabel(nullptr), _ratingWidget(nullptr), _rateWidget(nullptr), _thumbnailView(nullptr), _installButton(nullptr), _descriptionView(nullptr), _spineFeaturesView(nullptr), _thumbnailModel(nullptr), _spineFeatureModel(nullptr), _projectID(-1), _editInfoPageButton(nullptr), _descriptionEdit(nullptr), _featuresEdit(nullptr), _spineFeaturesEdit(nullptr), _addImageButton(nullptr), _deleteImageButton(nullptr), _applyButton(nullptr), _waitSpinner(nullptr), _forceEdit(false) {
 	auto * l = new QVBoxLayout();
 	l->setAlignment(Qt::AlignTop);
@@ -883,10 +887,7 @@ void ModInfoPage::submitChanges() {
 		json["Features"] = featuresArray;
 		json["SpineFeatures"] = modules;
 
-		common::UploadScreenshotsMessage usm;
-		usm.projectID = projectID;
-		usm.username = q2s(Config::Username);
-		usm.password = q2s(Config::Password);
+		QStringList uploads;
 
 		if (!_screens.isEmpty()) {
 			QJsonArray screens;
@@ -904,21 +905,10 @@ void ModInfoPage::submitChanges() {
 					// 2. compress
 					Compression::compress(p.first, false);
 					p.first += ".z";
-					// 3. add image to message
-					
+					// 3. upload it after all screenshots are prepared
+					uploads << p.first;
+
 					const auto file = QFileInfo(p.first).fileName();
-					{
-						QFile f(p.first);
-						if (f.open(QIODevice::ReadOnly)) {
-							QByteArray byteArr = f.readAll();
-							std::vector<uint8_t> buffer(byteArr.length());
-							memcpy(&buffer[0], byteArr.data(), byteArr.length());
-
-							usm.screenshots.emplace_back(q2s(file), buffer);
-						}
-						f.close();
-						f.remove();
-					}
 					
 					QJsonObject jsonScreen;
 					jsonScreen["File"] = file;
@@ -936,11 +926,32 @@ void ModInfoPage::submitChanges() {
 
 			json["Screenshots"] = screens;
 
-			if (!usm.screenshots.empty()) {
-				const auto serialized = usm.SerializeBlank();
+			if (!uploads.isEmpty()) {
 				clockUtils::sockets::TcpSocket sock;
-				if (sock.connectToHostname("clockwork-origins.com", SERVER_PORT, 10000) == clockUtils::ClockError::SUCCESS) {
-					sock.writePacket(serialized);
+				const bool connected = sock.connectToHostname("clockwork-origins.com", SERVER_PORT, 10000) == clockUtils::ClockError::SUCCESS;
+
+				for (const QString & path : uploads) {
+					QFile f(path);
+					if (connected && f.open(QIODevice::ReadOnly)) {
+						// sent in chunks, so neither client nor server have to keep the whole screenshot in memory
+						common::UploadScreenshotChunkMessage uscm;
+						uscm.projectID = projectID;
+						uscm.username = q2s(Config::Username);
+						uscm.password = q2s(Config::Password);
+						uscm.filename = q2s(QFileInfo(path).fileName());
+
+						do {
+							const QByteArray chunk = f.read(SCREENSHOT_CHUNK_SIZE);
+							uscm.data.assign(chunk.begin(), chunk.end());
+							uscm.last = chunk.isEmpty() || f.atEnd();
+
+							sock.writePacket(uscm.SerializeBlank());
+
+							uscm.offset += static_cast<uint64_t>(chunk.size());
+						} while (!uscm.last);
+					}
+					f.close();
+					f.remove();
 				}
 			}
 		}
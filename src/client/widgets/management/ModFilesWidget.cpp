@@ -248,7 +248,7 @@ void ModFilesWidget::uploadCurrentMod() {
 	_taskbarProgress->show();
 #endif
 	QtConcurrent::run([this]() {
-		common::UploadModfilesMessage umm;
+		common::UploadModfilesResumableMessage umm;
 		umm.modID = _mods[_modIndex].id;
 		for (const auto & mmf : _data.files) {
 			common::ModFile mf;
@@ -335,7 +335,23 @@ void ModFilesWidget::uploadCurrentMod() {
 			auto size = static_cast<int32_t>(serialized.size());
 			sock.write(&size, 4);
 			sock.write(serialized);
-			for (const QString & file : uploadFiles) {
+
+			// the server answers with the bytes it already has of every file from an interrupted upload
+			std::vector<int64_t> offsets;
+			if (sock.receivePacket(serialized) == clockUtils::ClockError::SUCCESS) {
+				common::Message * offsetsMsg = common::Message::DeserializeBlank(serialized);
+				auto * uomm = dynamic_cast<common::UploadModfilesOffsetsMessage *>(offsetsMsg);
+				if (uomm) {
+					offsets = uomm->offsets;
+				}
+				delete offsetsMsg;
+			}
+			if (offsets.size() != static_cast<size_t>(uploadFiles.size())) {
+				emit finishedUpload(false, uploadFiles.size());
+				return;
+			}
+			for (int i = 0; i < uploadFiles.size(); i++) {
+				const QString & file = uploadFiles[i];
 #ifdef Q_OS_WIN
 				const auto path = q2ws(file);
 #else
@@ -343,6 +359,8 @@ void ModFilesWidget::uploadCurrentMod() {
 #endif
 				
 				std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+				in.seekg(offsets[i]);
+				writtenBytes += offsets[i];
 				while (in.good()) {
 					char buffer[1024];
 					in.read(buffer, 1024);
@@ -19,28 +19,218 @@
 #include "common/Encryption.h"
 
 #include <algorithm>
-#include <mutex>
-#include <sstream>
+#include <cstring>
+#include <vector>
 
 #include "common/RSAKey.h"
 
 #ifdef WIN32
 	#include "openssl/applink.c"
 #endif
+#include "openssl/evp.h"
 #include "openssl/pem.h"
+#include "openssl/rand.h"
+#include "openssl/sha.h"
 
 using namespace common;
 using namespace spine::common;
 
+namespace {
+	// chunked RSA data always has a multiple of RSA_size as length, so these markers can only collide with it by chance and decrypting falls back in that case
+	const char HYBRID_MARKER[] = { 'S', 'P', 'E', '1' };
+	const char SIGNED_MARKER[] = { 'S', 'P', 'S', '1' };
+	constexpr size_t MARKER_SIZE = 4;
+	constexpr int KEY_SIZE = 32;
+	constexpr int IV_SIZE = 12;
+	constexpr int TAG_SIZE = 16;
+
+	RSA * loadPublicKey() {
+		RSA * publicKey = nullptr;
+		BIO * bufio = BIO_new_mem_buf(reinterpret_cast<void *>(RSA_PUB_KEY), -1);
+		PEM_read_bio_RSA_PUBKEY(bufio, &publicKey, nullptr, nullptr);
+		BIO_free(bufio);
+		return publicKey;
+	}
+
+	RSA * loadPrivateKey() {
+		RSA * privateKey = nullptr;
+		FILE * f = fopen(SPINE_PRIVATE_KEY, "r");
+		if (f != nullptr) {
+			PEM_read_RSAPrivateKey(f, &privateKey, nullptr, nullptr);
+			fclose(f);
+		}
+		return privateKey;
+	}
+
+	// parsed only once and kept for the lifetime of the process, RSA objects can be used from multiple threads
+	RSA * getPublicKey() {
+		static RSA * publicKey = loadPublicKey();
+		return publicKey;
+	}
+
+	RSA * getPrivateKey() {
+		static RSA * privateKey = loadPrivateKey();
+		return privateKey;
+	}
+
+	bool hasMarker(const std::string & in, const char * marker) {
+		return in.size() >= MARKER_SIZE && memcmp(in.data(), marker, MARKER_SIZE) == 0;
+	}
+
+	bool aesGcm(bool encrypt, const unsigned char * key, const unsigned char * iv, const unsigned char * in, int length, unsigned char * out, unsigned char * tag) {
+		EVP_CIPHER_CTX * ctx = EVP_CIPHER_CTX_new();
+
+		if (!ctx) return false;
+
+		int outLength = 0;
+		bool success = EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, encrypt ? 1 : 0) == 1;
+		success = success && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_SIZE, nullptr) == 1;
+		success = success && EVP_CipherInit_ex(ctx, nullptr, nullptr, key, iv, encrypt ? 1 : 0) == 1;
+		success = success && (length == 0 || EVP_CipherUpdate(ctx, out, &outLength, in, length) == 1);
+
+		if (success && !encrypt) {
+			success = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) == 1;
+		}
+
+		// for decryption this verifies the tag
+		success = success && EVP_CipherFinal_ex(ctx, out + outLength, &outLength) == 1;
+
+		if (success && encrypt) {
+			success = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag) == 1;
+		}
+
+		EVP_CIPHER_CTX_free(ctx);
+
+		return success;
+	}
+
+	bool decryptHybrid(const std::string & in, std::string & out) {
+		RSA * privateKey = getPrivateKey();
+
+		if (!privateKey) return false;
+
+		const auto rsaSize = static_cast<size_t>(RSA_size(privateKey));
+
+		if (in.size() < MARKER_SIZE + rsaSize + IV_SIZE + TAG_SIZE) return false;
+
+		const auto * data = reinterpret_cast<const unsigned char *>(in.data()) + MARKER_SIZE;
+
+		std::vector<unsigned char> key(rsaSize);
+
+		if (RSA_private_decrypt(static_cast<int>(rsaSize), data, key.data(), privateKey, RSA_PKCS1_OAEP_PADDING) != KEY_SIZE) return false;
+
+		const unsigned char * iv = data + rsaSize;
+		unsigned char tag[TAG_SIZE];
+		memcpy(tag, iv + IV_SIZE, TAG_SIZE);
+
+		const unsigned char * cipherText = iv + IV_SIZE + TAG_SIZE;
+		const size_t length = in.size() - MARKER_SIZE - rsaSize - IV_SIZE - TAG_SIZE;
+
+		std::string result(length, '\0');
+
+		if (!aesGcm(false, key.data(), iv, cipherText, static_cast<int>(length), reinterpret_cast<unsigned char *>(&result[0]), tag)) return false;
+
+		out = std::move(result);
+
+		return !out.empty();
+	}
+
+	bool verifySigned(const std::string & in, std::string & out) {
+		RSA * publicKey = getPublicKey();
+
+		if (!publicKey) return false;
+
+		const auto rsaSize = static_cast<size_t>(RSA_size(publicKey));
+
+		if (in.size() <= MARKER_SIZE + rsaSize) return false;
+
+		const auto * signature = reinterpret_cast<const unsigned char *>(in.data()) + MARKER_SIZE;
+		const auto * payload = signature + rsaSize;
+		const size_t length = in.size() - MARKER_SIZE - rsaSize;
+
+		unsigned char digest[SHA256_DIGEST_LENGTH];
+		SHA256(payload, length, digest);
+
+		if (RSA_verify(NID_sha256, digest, SHA256_DIGEST_LENGTH, signature, static_cast<unsigned int>(rsaSize), publicKey) != 1) return false;
+
+		out.assign(reinterpret_cast<const char *>(payload), length);
+
+		return true;
+	}
+}
+
 bool Encryption::encryptPublic(const std::string & in, std::string & out) {
+	if (in.empty()) return false;
+
+	RSA * publicKey = getPublicKey();
+
+	if (!publicKey) return false;
+
+	const auto rsaSize = static_cast<size_t>(RSA_size(publicKey));
+
+	unsigned char key[KEY_SIZE];
+	unsigned char iv[IV_SIZE];
+
+	if (RAND_bytes(key, KEY_SIZE) != 1 || RAND_bytes(iv, IV_SIZE) != 1) return false;
+
+	// marker | RSA-OAEP encrypted AES key | IV | GCM tag | ciphertext
+	std::string result(MARKER_SIZE + rsaSize + IV_SIZE + TAG_SIZE + in.size(), '\0');
+	auto * data = reinterpret_cast<unsigned char *>(&result[0]);
+
+	memcpy(data, HYBRID_MARKER, MARKER_SIZE);
+	data += MARKER_SIZE;
+
+	if (RSA_public_encrypt(KEY_SIZE, key, data, publicKey, RSA_PKCS1_OAEP_PADDING) != static_cast<int>(rsaSize)) return false;
+	data += rsaSize;
+
+	memcpy(data, iv, IV_SIZE);
+
+	unsigned char * tag = data + IV_SIZE;
+
+	if (!aesGcm(true, key, iv, reinterpret_cast<const unsigned char *>(in.data()), static_cast<int>(in.size()), tag + TAG_SIZE, tag)) return false;
+
+	out = std::move(result);
+
+	return true;
+}
+
+bool Encryption::encryptPrivate(const std::string & in, std::string & out) {
+	if (in.empty()) return false;
+
+	RSA * privateKey = getPrivateKey();
+
+	if (!privateKey) return false;
+
+	const auto rsaSize = static_cast<size_t>(RSA_size(privateKey));
+
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	SHA256(reinterpret_cast<const unsigned char *>(in.data()), in.size(), digest);
+
+	// marker | signature of the SHA256 | payload
+	std::string result(MARKER_SIZE + rsaSize, '\0');
+	auto * data = reinterpret_cast<unsigned char *>(&result[0]);
+
+	memcpy(data, SIGNED_MARKER, MARKER_SIZE);
+
+	unsigned int signatureLength = 0;
+
+	if (RSA_sign(NID_sha256, digest, SHA256_DIGEST_LENGTH, data + MARKER_SIZE, &signatureLength, privateKey) != 1 || signatureLength != rsaSize) return false;
+
+	result.append(in);
+
+	out = std::move(result);
+
+	return true;
+}
+
+bool Encryption::encryptPublicLegacy(const std::string & in, std::string & out) {
 	int completeLength = static_cast<int>(in.length());
 
 	if (completeLength == 0) return false;
 
-	RSA * publicKey = nullptr;
-	BIO * bufio = BIO_new_mem_buf(reinterpret_cast<void *>(RSA_PUB_KEY), -1);
-	PEM_read_bio_RSA_PUBKEY(bufio, &publicKey, nullptr, nullptr);
-	BIO_free(bufio);
+	RSA * publicKey = getPublicKey();
+
+	if (!publicKey) return false;
 
 	int length = 0;
 	const int packetSize = RSA_size(publicKey) - 42;
@@ -51,32 +241,26 @@ bool Encryption::encryptPublic(const std::string & in, std::string & out) {
 		completeLength -= std::min(packetSize, completeLength);
 		if (length == -1) {
 			delete[] arr;
-			RSA_free(publicKey);
 			return false;
 		}
 	}
 	if (length == 0) {
 		delete[] arr;
-		RSA_free(publicKey);
 		return false;
 	}
 	out = std::string(reinterpret_cast<char *>(arr), length);
 	delete[] arr;
-	RSA_free(publicKey);
 	return true;
 }
 
-bool Encryption::encryptPrivate(const std::string & in, std::string & out) {
+bool Encryption::encryptPrivateLegacy(const std::string & in, std::string & out) {
 	int completeLength = static_cast<int>(in.length());
 
 	if (completeLength == 0) return false;
 
-	RSA * privateKey = nullptr;
-	FILE * f = fopen(SPINE_PRIVATE_KEY, "r");
-	if (f != nullptr) {
-		PEM_read_RSAPrivateKey(f, &privateKey, nullptr, nullptr);
-		fclose(f);
-	}
+	RSA * privateKey = getPrivateKey();
+
+	if (!privateKey) return false;
 
 	int length = 0;
 	const int packetSize = RSA_size(privateKey) - 12;
@@ -87,18 +271,15 @@ bool Encryption::encryptPrivate(const std::string & in, std::string & out) {
 		completeLength -= std::min(packetSize, completeLength);
 		if (length == -1) {
 			delete[] arr;
-			RSA_free(privateKey);
 			return false;
 		}
 	}
 	if (length == 0) {
 		delete[] arr;
-		RSA_free(privateKey);
 		return false;
 	}
 	out = std::string(reinterpret_cast<char *>(arr), length);
 	delete[] arr;
-	RSA_free(privateKey);
 	return true;
 }
 
@@ -107,15 +288,15 @@ bool Encryption::decryptPublic(const std::string & in, std::string & out) {
 
 	if (completeLength == 0) return false;
 
-	RSA * publicKey = nullptr;
-	BIO * bufio = BIO_new_mem_buf(reinterpret_cast<void *>(RSA_PUB_KEY), -1);
-	PEM_read_bio_RSA_PUBKEY(bufio, &publicKey, nullptr, nullptr);
-	BIO_free(bufio);
+	if (hasMarker(in, SIGNED_MARKER) && verifySigned(in, out)) return true;
+
+	RSA * publicKey = getPublicKey();
+
+	if (!publicKey) return false;
 
 	int length = 0;
 	const int packetSize = RSA_size(publicKey);
 	if (packetSize == 0 || completeLength % packetSize != 0) {
-		RSA_free(publicKey);
 		return false;
 	}
 	const int determinedSize = static_cast<int>(((in.length() - 1) / packetSize + 1) * RSA_size(publicKey));
@@ -125,18 +306,15 @@ bool Encryption::decryptPublic(const std::string & in, std::string & out) {
 		completeLength -= std::min(packetSize, completeLength);
 		if (length == -1) {
 			delete[] arr;
-			RSA_free(publicKey);
 			return false;
 		}
 	}
 	if (length == 0) {
 		delete[] arr;
-		RSA_free(publicKey);
 		return false;
 	}
 	out = std::string(reinterpret_cast<char *>(arr), length);
 	delete[] arr;
-	RSA_free(publicKey);
 	return true;
 }
 
@@ -145,16 +323,15 @@ bool Encryption::decryptPrivate(const std::string & in, std::string & out) {
 
 	if (completeLength == 0) return false;
 
-	RSA * privateKey = nullptr;
-	FILE * f = fopen(SPINE_PRIVATE_KEY, "r");
-	if (f != nullptr) {
-		PEM_read_RSAPrivateKey(f, &privateKey, nullptr, nullptr);
-		fclose(f);
-	}
+	if (hasMarker(in, HYBRID_MARKER) && decryptHybrid(in, out)) return true;
+
+	RSA * privateKey = getPrivateKey();
+
+	if (!privateKey) return false;
+
 	int length = 0;
 	const int packetSize = RSA_size(privateKey);
 	if (packetSize == 0 || completeLength % packetSize != 0) {
-		RSA_free(privateKey);
 		return false;
 	}
 	const int determinedSize = static_cast<int>(((in.length() - 1) / packetSize + 1) * RSA_size(privateKey));
@@ -164,17 +341,14 @@ bool Encryption::decryptPrivate(const std::string & in, std::string & out) {
 		completeLength -= std::min(packetSize, completeLength);
 		if (length == -1) {
 			delete[] arr;
-			RSA_free(privateKey);
 			return false;
 		}
 	}
 	if (length == 0) {
 		delete[] arr;
-		RSA_free(privateKey);
 		return false;
 	}
 	out = std::string(reinterpret_cast<char *>(arr), length);
 	delete[] arr;
-	RSA_free(privateKey);
 	return true;
 }
@@ -18,86 +18,132 @@
 
 #include "common/MessageStructs.h"
 
+#include <atomic>
 #include <sstream>
 
+#include "common/BinaryArchive.h"
 #include "common/Encryption.h"
 
 using namespace spine::common;
 
-std::string Message::SerializeBlank() const {
-	std::stringstream ss;
-	boost::archive::text_oarchive arch(ss);
-	auto * m = const_cast<Message *>(this);
-	try {
-		arch << m;
-	} catch (...) {
+namespace {
+	// a text archive always starts with the length of "serialization::archive", so a NUL byte can't be the start of one
+	const char BINARY_MARKER = '\0';
+	const char BINARY_VERSION = 1;
+
+	// a peer might be an old version only knowing text archives, so Binary is only used once it is known to be understood
+	std::atomic<WireFormat> defaultFormat(WireFormat::Text);
+
+	thread_local bool receivedMessage = false;
+	thread_local WireFormat replyFormat = WireFormat::Text;
+
+	WireFormat getReplyFormat() {
+		return receivedMessage ? replyFormat : defaultFormat.load();
+	}
+
+	std::string serializeMessage(const Message * msg, WireFormat format) {
+		auto * m = const_cast<Message *>(msg);
+
+		if (format == WireFormat::Binary) {
+			std::string buffer;
+			buffer.push_back(BINARY_MARKER);
+			buffer.push_back(BINARY_VERSION);
+			try {
+				BinaryOArchive arch(buffer);
+				arch << m;
+			} catch (...) {
+			}
+			return buffer;
+		}
+
+		std::stringstream ss;
+		boost::archive::text_oarchive arch(ss);
+		try {
+			arch << m;
+		} catch (...) {
+		}
+		return ss.str();
+	}
+
+	Message * deserializeMessage(const std::string & s) {
+		Message * m = nullptr;
+		try {
+			if (s.size() >= 2 && s[0] == BINARY_MARKER) {
+				if (s[1] != BINARY_VERSION) return nullptr;
+
+				BinaryIArchive arch(s.data() + 2, s.size() - 2);
+				arch >> m;
+				replyFormat = WireFormat::Binary;
+				receivedMessage = true;
+			} else {
+				std::stringstream ss(s);
+				boost::archive::text_iarchive arch(ss);
+				arch >> m;
+				replyFormat = WireFormat::Text;
+				receivedMessage = true;
+			}
+		} catch (...) {
+			// depending on the boost version the object is already allocated when a member fails to load
+			delete m;
+			m = nullptr;
+		}
+		return m;
 	}
-	return ss.str();
+}
+
+std::string Message::SerializeBlank() const {
+	return serializeMessage(this, getReplyFormat());
+}
+
+std::string Message::SerializeBlank(WireFormat format) const {
+	return serializeMessage(this, format);
 }
 
 Message * Message::DeserializeBlank(const std::string & s) {
-	Message * m = nullptr;
-	std::stringstream ss(s);
-	try {
-		boost::archive::text_iarchive arch(ss);
-		arch >> m;
-	} catch (...) {
-	}
-	return m;
+	return deserializeMessage(s);
+}
+
+WireFormat Message::GetReplyFormat() {
+	return getReplyFormat();
+}
+
+void Message::SetDefaultFormat(WireFormat format) {
+	defaultFormat = format;
 }
 
 std::string Message::SerializePublic() const {
-	std::stringstream ss;
-	boost::archive::text_oarchive arch(ss);
-	auto * m = const_cast<Message *>(this);
-	try {
-		arch << m;
-	} catch (...) {
-	}
+	// a peer still using text archives doesn't know the hybrid encryption either
+	const WireFormat format = getReplyFormat();
 	std::string encrypted;
-	Encryption::encryptPublic(ss.str(), encrypted);
+	if (format == WireFormat::Binary) {
+		Encryption::encryptPublic(serializeMessage(this, format), encrypted);
+	} else {
+		Encryption::encryptPublicLegacy(serializeMessage(this, format), encrypted);
+	}
 	return encrypted;
 }
 
 Message * Message::DeserializePublic(const std::string & s) {
-	Message * m = nullptr;
 	std::string decrypted;
-	if (Encryption::decryptPublic(s, decrypted)) {
-		std::stringstream ss(decrypted);
-		try {
-			boost::archive::text_iarchive arch(ss);
-			arch >> m;
-		} catch (...) {
-		}
-	}
-	return m;
+	if (!Encryption::decryptPublic(s, decrypted)) return nullptr;
+	return deserializeMessage(decrypted);
 }
 
 std::string Message::SerializePrivate() const {
-	std::stringstream ss;
-	boost::archive::text_oarchive arch(ss);
-	auto * m = const_cast<Message *>(this);
-	try {
-		arch << m;
-	} catch (...) {
-	}
+	const WireFormat format = getReplyFormat();
 	std::string encrypted;
-	Encryption::encryptPrivate(ss.str(), encrypted);
+	if (format == WireFormat::Binary) {
+		Encryption::encryptPrivate(serializeMessage(this, format), encrypted);
+	} else {
+		Encryption::encryptPrivateLegacy(serializeMessage(this, format), encrypted);
+	}
 	return encrypted;
 }
 
 Message * Message::DeserializePrivate(const std::string & s) {
-	Message * m = nullptr;
 	std::string decrypted;
-	if (Encryption::decryptPrivate(s, decrypted)) {
-		std::stringstream ss(decrypted);
-		try {
-			boost::archive::text_iarchive arch(ss);
-			arch >> m;
-		} catch (...) {
-		}
-	}
-	return m;
+	if (!Encryption::decryptPrivate(s, decrypted)) return nullptr;
+	return deserializeMessage(decrypted);
 }
 
 BOOST_CLASS_EXPORT_GUID(spine::common::Message, "0")
@@ -176,3 +222,9 @@ BOOST_CLASS_EXPORT_GUID(spine::common::UploadAchievementIconsMessage, "103")
 BOOST_CLASS_IMPLEMENTATION(spine::common::UploadAchievementIconsMessage, boost::serialization::object_serializable)
 BOOST_CLASS_EXPORT_GUID(spine::common::UploadScreenshotsMessage, "104")
 BOOST_CLASS_IMPLEMENTATION(spine::common::UploadScreenshotsMessage, boost::serialization::object_serializable)
+BOOST_CLASS_EXPORT_GUID(spine::common::UploadScreenshotChunkMessage, "105")
+BOOST_CLASS_IMPLEMENTATION(spine::common::UploadScreenshotChunkMessage, boost::serialization::object_serializable)
+BOOST_CLASS_EXPORT_GUID(spine::common::UploadModfilesResumableMessage, "106")
+BOOST_CLASS_IMPLEMENTATION(spine::common::UploadModfilesResumableMessage, boost::serialization::object_serializable)
+BOOST_CLASS_EXPORT_GUID(spine::common::UploadModfilesOffsetsMessage, "107")
+BOOST_CLASS_IMPLEMENTATION(spine::common::UploadModfilesOffsetsMessage, boost::serialization::object_serializable)
@@ -0,0 +1,93 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ServerCommon.h"
+
+using namespace spine::server;
+
+namespace {
+	// the former implementation, one regex_replace pass per escape sequence
+	std::string convertStringRegex(const std::string & str) {
+		static const std::vector<std::pair<std::string, std::string>> REPLACEMENTS = {
+			{ "%20", " " }, { "%21", "!" }, { "%22", "\"" }, { "%23", "#" }, { "%24", "$" }, { "%25", "%" }, { "%26", "&" }, { "%27", "'" },
+			{ "%28", "(" }, { "%29", ")" }, { "%2a", "*" }, { "%2b", "+" }, { "%2c", "," }, { "%2d", "-" }, { "%2e", "." }, { "%2f", "/" },
+			{ "%3a", ":" }, { "%3b", ";" }, { "%3c", "<" }, { "%3d", "=" }, { "%3e", ">" }, { "%3f", "?" }, { "%40", "@" }, { "%5b", "[" },
+			{ "%5c", "\\" }, { "%5d", "]" }, { "%5e", "^" }, { "%5f", "_" }, { "%7b", "{" }, { "%7d", "}" },
+		};
+
+		std::string result = str;
+		for (const auto & p : REPLACEMENTS) {
+			result = std::regex_replace(result, std::regex(p.first), p.second);
+		}
+		return result;
+	}
+
+	// a JSON request body as the clients send it, every special character percent encoded
+	std::string createBody(size_t size) {
+		static const std::vector<std::string> FRAGMENTS = { "%7b", "%7d", "%22", "%3a", "%2c", "%5b", "%5d", "%20", "Username", "Password", "ProjectID", "42", "Score", "1337" };
+
+		std::mt19937 gen(42);
+		std::uniform_int_distribution<size_t> dist(0, FRAGMENTS.size() - 1);
+
+		std::string body;
+		while (body.size() < size) {
+			body += FRAGMENTS[dist(gen)];
+		}
+		return body;
+	}
+
+	template<typename Converter>
+	long long measure(Converter converter, const std::string & body, int iterations, std::string & result) {
+		const auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++) {
+			result = converter(body);
+		}
+
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+	}
+}
+
+int main(const int argc, char ** argv) {
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 10;
+
+	std::cout << std::left << std::setw(12) << "Body" << std::right << std::setw(14) << "Regex" << std::setw(14) << "Single pass" << std::endl;
+
+	for (const size_t size : { static_cast<size_t>(256), static_cast<size_t>(16 * 1024), static_cast<size_t>(150 * 1024) }) {
+		const std::string body = createBody(size);
+
+		std::string regexResult;
+		std::string singlePassResult;
+
+		const auto regexTime = measure(&convertStringRegex, body, iterations, regexResult);
+		const auto singlePassTime = measure(&ServerCommon::convertString, body, iterations, singlePassResult);
+
+		std::cout << std::left << std::setw(12) << (std::to_string(body.size()) + " B") << std::right << std::setw(11) << regexTime << " us" << std::setw(11) << singlePassTime << " us" << (regexResult == singlePassResult ? "" : "  MISMATCH") << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,251 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "utils/Compression.h"
+#include "utils/Hashing.h"
+#include "utils/StreamingUncompressor.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_WIN
+	#include <Windows.h>
+#endif
+
+using namespace spine::utils;
+
+namespace {
+	constexpr qint64 NETWORK_BLOCK_SIZE = 16 * 1024; // roughly what a QNetworkReply delivers per readyRead
+
+	typedef struct {
+		std::chrono::steady_clock::time_point time;
+		qint64 read;
+		qint64 written;
+	} Measurement;
+
+	// bytes passed to read and write calls by the whole process so far, page cache hits included
+	bool getIoCounters(qint64 & read, qint64 & written) {
+#ifdef Q_OS_WIN
+		IO_COUNTERS counters;
+
+		if (!GetProcessIoCounters(GetCurrentProcess(), &counters)) return false;
+
+		read = static_cast<qint64>(counters.ReadTransferCount);
+		written = static_cast<qint64>(counters.WriteTransferCount);
+
+		return true;
+#else
+		std::ifstream in("/proc/self/io");
+
+		std::string key;
+		long long value;
+		int found = 0;
+
+		while (in >> key >> value) {
+			if (key == "rchar:") {
+				read = value;
+				found++;
+			} else if (key == "wchar:") {
+				written = value;
+				found++;
+			}
+		}
+
+		return found == 2;
+#endif
+	}
+
+	Measurement measure() {
+		Measurement m;
+
+		if (!getIoCounters(m.read, m.written)) {
+			m.read = -1;
+			m.written = -1;
+		}
+
+		m.time = std::chrono::steady_clock::now();
+
+		return m;
+	}
+
+	void print(const std::string & name, const Measurement & start, const Measurement & end, bool valid) {
+		const auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end.time - start.time).count();
+
+		std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << time << " ms";
+
+		if (start.read < 0 || end.read < 0) {
+			std::cout << std::setw(16) << "n/a" << std::setw(16) << "n/a";
+		} else {
+			std::cout << std::setw(12) << (end.read - start.read) / 1024 << " KiB" << std::setw(12) << (end.written - start.written) / 1024 << " KiB";
+		}
+
+		std::cout << (valid ? "" : "  FAILED") << std::endl;
+	}
+
+	// writes the downloaded data in network sized blocks like the FileDownloader does
+	bool writeDownload(const QString & path, const QByteArray & data) {
+		QFile f(path);
+
+		if (!f.open(QIODevice::WriteOnly)) return false;
+
+		for (qint64 offset = 0; offset < data.size(); offset += NETWORK_BLOCK_SIZE) {
+			const qint64 size = std::min(NETWORK_BLOCK_SIZE, data.size() - offset);
+
+			if (f.write(data.constData() + offset, size) != size) return false;
+		}
+
+		return true;
+	}
+
+	// some structure so the data compresses roughly like scripts and meshes of a mod
+	bool createInput(const QString & path, qint64 size) {
+		QFile f(path);
+
+		if (!f.open(QIODevice::WriteOnly)) return false;
+
+		QByteArray block(1024 * 1024, Qt::Uninitialized);
+		uint32_t state = 42;
+
+		for (qint64 written = 0; written < size; written += block.size()) {
+			for (int i = 0; i < block.size(); i++) {
+				state = state * 1103515245 + 12345;
+				block[i] = (state >> 16) % 4 == 0 ? static_cast<char>(state >> 24) : static_cast<char>('a' + i % 26);
+			}
+
+			if (f.write(block) != block.size()) return false;
+		}
+
+		return true;
+	}
+}
+
+/**
+ * compares the old way to finish a download (uncompress the .z file, read the result again for the hash) with the StreamingUncompressor
+ * every flow starts with the compressed data in memory standing in for the network and includes writing it to disk in network sized blocks,
+ * as the FileDownloader always keeps the compressed .part file for resuming
+ * Read and Written are the bytes the process passed to read and write calls during the flow (/proc/self/io or GetProcessIoCounters)
+ */
+int main(const int argc, char ** argv) {
+	const qint64 size = (argc > 1 ? std::stoll(argv[1]) : 256) * 1024 * 1024;
+	const QString directory = argc > 2 ? QString::fromLocal8Bit(argv[2]) : QDir::tempPath() + "/SpineDownloadBenchmark";
+
+	QDir().mkpath(directory);
+
+	const QString input = directory + "/input.bin";
+	const QString download = directory + "/download.bin.z";
+
+	if (!createInput(input, size)) {
+		std::cerr << "Can't create " << input.toStdString() << std::endl;
+		return 1;
+	}
+
+	Compression::compress(input, download, false);
+
+	QString referenceHash;
+	Hashing::hash(input, referenceHash);
+	QFile::remove(input);
+
+	QByteArray data;
+
+	{
+		QFile in(download);
+		in.open(QIODevice::ReadOnly);
+		data = in.readAll(); // stands in for the network, so it's loaded before the measurements
+	}
+
+	QFile::remove(download);
+
+	std::cout << "Uncompressed " << size / 1024 << " KiB, compressed " << data.size() / 1024 << " KiB" << std::endl << std::endl;
+	std::cout << std::left << std::setw(28) << "Flow" << std::right << std::setw(13) << "Time" << std::setw(16) << "Read" << std::setw(16) << "Written" << std::endl;
+
+	{
+		const QString part = directory + "/three-pass.bin.z";
+
+		const auto start = measure();
+
+		bool valid = writeDownload(part, data);
+
+		if (valid) {
+			Compression::uncompress(part, true);
+			valid = Hashing::checkHash(directory + "/three-pass.bin", referenceHash);
+		}
+
+		const auto end = measure();
+
+		print("Uncompress, then hash", start, end, valid);
+		std::cout << std::left << std::setw(28) << "  + old wait before" << std::right << std::setw(10) << 500 << " ms" << std::endl;
+
+		QFile::remove(part);
+		QFile::remove(directory + "/three-pass.bin");
+	}
+
+	{
+		const QString part = directory + "/streamed.bin.z.part";
+
+		const auto start = measure();
+
+		QFile partFile(part);
+		StreamingUncompressor uncompressor(true, directory + "/streamed.bin");
+		bool valid = partFile.open(QIODevice::WriteOnly) && uncompressor.open();
+
+		for (qint64 offset = 0; offset < data.size() && valid; offset += NETWORK_BLOCK_SIZE) {
+			const qint64 blockSize = std::min(NETWORK_BLOCK_SIZE, data.size() - offset);
+
+			valid = partFile.write(data.constData() + offset, blockSize) == blockSize && uncompressor.add(data.constData() + offset, blockSize);
+		}
+
+		partFile.close();
+
+		valid = valid && uncompressor.finish() && uncompressor.getHash() == referenceHash;
+
+		const auto end = measure();
+
+		print("Streamed", start, end, valid);
+
+		QFile::remove(part);
+		QFile::remove(directory + "/streamed.bin");
+	}
+
+	{
+		// resumed and segmented downloads are finished from the part files in one pass
+		const QString part = directory + "/one-pass.bin.z.part";
+
+		const auto start = measure();
+
+		StreamingUncompressor uncompressor(true, directory + "/one-pass.bin");
+		const bool valid = writeDownload(part, data) && uncompressor.open() && uncompressor.addFile(part) && uncompressor.finish() && uncompressor.getHash() == referenceHash;
+
+		const auto end = measure();
+
+		print("One pass from part file", start, end, valid);
+
+		QFile::remove(part);
+		QFile::remove(directory + "/one-pass.bin");
+	}
+
+	return 0;
+}
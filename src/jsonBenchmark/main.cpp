@@ -0,0 +1,121 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "JsonWriter.h"
+
+#include "boost/property_tree/json_parser.hpp"
+
+using namespace spine::server;
+
+namespace {
+	// shaped like the response of requestAllProjects, including escaped and non-ASCII names
+	std::string writePtree(int projects, bool pretty) {
+		boost::property_tree::ptree responseTree;
+		boost::property_tree::ptree projectNodes;
+
+		for (int i = 0; i < projects; i++) {
+			boost::property_tree::ptree projectNode;
+			projectNode.put("Name", "Project \"" + std::to_string(i) + "\" - Über/Test");
+			projectNode.put("ID", i);
+			projectNode.put("TeamName", "Team " + std::to_string(i % 100));
+			projectNode.put("TeamID", i % 100);
+			projectNode.put("Gothic", i % 2);
+			projectNode.put("Type", i % 5);
+			projectNode.put("MajorVersion", 1);
+			projectNode.put("MinorVersion", i % 10);
+			projectNode.put("PatchVersion", i % 3);
+			projectNode.put("DevDuration", 1234 + i);
+			projectNode.put("AvgDuration", 0.5 * i);
+			projectNode.put("Enabled", true);
+			projectNodes.push_back(std::make_pair("", projectNode));
+		}
+		responseTree.add_child("Projects", projectNodes);
+
+		std::stringstream responseStream;
+		write_json(responseStream, responseTree, pretty);
+
+		return responseStream.str();
+	}
+
+	std::string writeJsonWriter(int projects) {
+		JsonWriter writer;
+		writer.startObject();
+		writer.startArray("Projects");
+
+		for (int i = 0; i < projects; i++) {
+			writer.startObject();
+			writer.add("Name", "Project \"" + std::to_string(i) + "\" - Über/Test");
+			writer.add("ID", i);
+			writer.add("TeamName", "Team " + std::to_string(i % 100));
+			writer.add("TeamID", i % 100);
+			writer.add("Gothic", i % 2);
+			writer.add("Type", i % 5);
+			writer.add("MajorVersion", 1);
+			writer.add("MinorVersion", i % 10);
+			writer.add("PatchVersion", i % 3);
+			writer.add("DevDuration", 1234 + i);
+			writer.add("AvgDuration", 0.5 * i);
+			writer.add("Enabled", true);
+			writer.endObject();
+		}
+
+		writer.endArray();
+		writer.endObject();
+
+		return writer.getString();
+	}
+
+	template<typename Writer>
+	long long measure(Writer writer, int iterations, std::string & result) {
+		const auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++) {
+			result = writer();
+		}
+
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+	}
+}
+
+int main(const int argc, char ** argv) {
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 10;
+
+	std::cout << std::left << std::setw(12) << "Projects" << std::right << std::setw(28) << "ptree (size, time)" << std::setw(28) << "JsonWriter (size, time)" << std::endl;
+
+	for (const int projects : { 10, 1000, 20000 }) {
+		std::string ptreeResult;
+		std::string compactResult;
+		std::string writerResult;
+
+		// the server wrote the ptrees with the default, pretty printed output
+		const auto ptreeTime = measure([projects]() { return writePtree(projects, true); }, iterations, ptreeResult);
+		const auto writerTime = measure([projects]() { return writeJsonWriter(projects); }, iterations, writerResult);
+
+		compactResult = writePtree(projects, false);
+
+		std::cout << std::left << std::setw(12) << projects << std::right << std::setw(14) << ptreeResult.size() << " B" << std::setw(9) << ptreeTime << " us" << std::setw(14) << writerResult.size() << " B" << std::setw(9) << writerTime << " us" << (compactResult == writerResult ? "" : "  MISMATCH") << std::endl;
+	}
+
+	return 0;
+}
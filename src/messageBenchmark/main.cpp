@@ -0,0 +1,155 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "common/Encryption.h"
+#include "common/MessageStructs.h"
+
+using namespace spine::common;
+
+namespace {
+	// compares size and encode/decode time of the text and the binary wire format for some typical messages
+	void benchmark(const std::string & name, const Message & msg, int iterations) {
+		std::cout << std::left << std::setw(28) << name;
+
+		for (const WireFormat format : { WireFormat::Text, WireFormat::Binary }) {
+			std::string serialized;
+
+			const auto encodeStart = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++) {
+				serialized = msg.SerializeBlank(format);
+			}
+
+			const auto decodeStart = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++) {
+				delete Message::DeserializeBlank(serialized);
+			}
+
+			const auto end = std::chrono::steady_clock::now();
+
+			const auto encodeTime = std::chrono::duration_cast<std::chrono::microseconds>(decodeStart - encodeStart).count() / iterations;
+			const auto decodeTime = std::chrono::duration_cast<std::chrono::microseconds>(end - decodeStart).count() / iterations;
+
+			std::cout << std::right << std::setw(10) << serialized.size() << " B" << std::setw(8) << encodeTime << " us" << std::setw(8) << decodeTime << " us";
+		}
+
+		std::cout << std::endl;
+	}
+
+	typedef bool (*Transform)(const std::string &, std::string &);
+
+	// one direction of the encryption, encrypt and decrypt time per message
+	void benchmark(const std::string & name, Transform encrypt, Transform decrypt, const std::string & payload, int iterations) {
+		std::string encrypted;
+		std::string decrypted;
+
+		const auto encryptStart = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++) {
+			encrypt(payload, encrypted);
+		}
+
+		const auto decryptStart = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; i++) {
+			decrypt(encrypted, decrypted);
+		}
+
+		const auto end = std::chrono::steady_clock::now();
+
+		const auto encryptTime = std::chrono::duration_cast<std::chrono::microseconds>(decryptStart - encryptStart).count() / iterations;
+		const auto decryptTime = std::chrono::duration_cast<std::chrono::microseconds>(end - decryptStart).count() / iterations;
+
+		std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << payload.size() << " B" << std::setw(10) << encrypted.size() << " B" << std::setw(10) << encryptTime << " us" << std::setw(10) << decryptTime << " us" << (decrypted == payload ? "" : "  FAILED") << std::endl;
+	}
+}
+
+int main(const int argc, char ** argv) {
+	const int iterations = argc > 1 ? std::stoi(argv[1]) : 100;
+
+	std::cout << std::left << std::setw(28) << "Message" << std::right << std::setw(32) << "Text (size, encode, decode)" << std::setw(32) << "Binary (size, encode, decode)" << std::endl;
+
+	AckMessage am;
+	am.success = true;
+	benchmark("AckMessage", am, iterations);
+
+	UploadModfilesMessage umm;
+	umm.modID = 42;
+	for (int i = 0; i < 2000; i++) {
+		ModFile mf;
+		mf.filename = "System/Autorun/File" + std::to_string(i) + ".d.z";
+		mf.hash = std::string(128, 'a');
+		mf.language = "All";
+		mf.changed = true;
+		mf.size = 1024 * i;
+		umm.files.push_back(mf);
+	}
+	benchmark("UploadModfilesMessage", umm, iterations);
+
+	SendAllFriendsMessage safm;
+	for (int i = 0; i < 500; i++) {
+		safm.friends.emplace_back("Friend" + std::to_string(i), static_cast<uint32_t>(i % 50));
+	}
+	benchmark("SendAllFriendsMessage", safm, iterations);
+
+	SendAchievementsMessage sam;
+	for (int i = 0; i < 200; i++) {
+		sam.achievements.push_back(i);
+		sam.achievementProgress.emplace_back(i, std::make_pair(i * 3, 1000));
+	}
+	benchmark("SendAchievementsMessage", sam, iterations);
+
+	UploadScreenshotsMessage usm;
+	usm.projectID = 42;
+	usm.username = "Username";
+	usm.password = "Password";
+	for (int i = 0; i < 4; i++) {
+		std::vector<uint8_t> data(512 * 1024);
+		for (size_t j = 0; j < data.size(); j++) {
+			data[j] = static_cast<uint8_t>(j * 31 + i);
+		}
+		usm.screenshots.emplace_back("screenshot" + std::to_string(i) + ".png", data);
+	}
+	benchmark("UploadScreenshotsMessage", usm, iterations);
+
+	// Private needs the private key of the server, without it these lines show FAILED
+	std::cout << std::endl << std::left << std::setw(28) << "Encryption" << std::right << std::setw(12) << "Payload" << std::setw(12) << "Encrypted" << std::setw(13) << "Encrypt" << std::setw(13) << "Decrypt" << std::endl;
+
+	for (const size_t size : { static_cast<size_t>(128), static_cast<size_t>(64 * 1024), static_cast<size_t>(4 * 1024 * 1024) }) {
+		std::string payload(size, '\0');
+		for (size_t i = 0; i < size; i++) {
+			payload[i] = static_cast<char>(i * 31);
+		}
+
+		// the chunked RSA needs one RSA operation per ~200 bytes, so large payloads are measured only once
+		const int encryptionIterations = size > 1024 * 1024 ? 1 : iterations;
+
+		benchmark("Public legacy", &Encryption::encryptPublicLegacy, &Encryption::decryptPrivate, payload, encryptionIterations);
+		benchmark("Public hybrid", &Encryption::encryptPublic, &Encryption::decryptPrivate, payload, encryptionIterations);
+		benchmark("Private legacy", &Encryption::encryptPrivateLegacy, &Encryption::decryptPublic, payload, encryptionIterations);
+		benchmark("Private signed", &Encryption::encryptPrivate, &Encryption::decryptPublic, payload, encryptionIterations);
+	}
+
+	return 0;
+}
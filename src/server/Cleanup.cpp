@@ -23,10 +23,15 @@
 #include <thread>
 
 #include "ServerCommon.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
 
 using namespace spine::server;
 
+const size_t Cleanup::DELETE_CHUNK_SIZE = std::max(CLEANUP_CHUNK_SIZE, static_cast<uint32_t>(1));
+const std::chrono::milliseconds Cleanup::CHUNK_DELAY(CLEANUP_CHUNK_DELAY);
+const std::chrono::milliseconds Cleanup::TABLE_DELAY(CLEANUP_TABLE_DELAY);
+
 void Cleanup::init() {
 	std::thread(&Cleanup::cleanup).detach();
 }
@@ -36,7 +41,7 @@ void Cleanup::cleanup() {
 		std::cout << "Performing database cleanup" << std::endl;
 		
 		do {
-			std::vector<int> userList;
+			std::vector<int32_t> userList;
 			
 			{
 				MariaDBWrapper accountDatabase;
@@ -57,11 +62,15 @@ void Cleanup::cleanup() {
 
 				const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
+				userList.reserve(results.size());
+
 				for (const auto & vec : results) {
 					userList.push_back(std::stoi(vec[0]));
 				}
 			}
 
+			std::sort(userList.begin(), userList.end());
+
 			cleanupTable("ratings", userList);
 			cleanupTable("reviews", userList);
 			cleanupTable("playtimes", userList);
@@ -96,44 +105,72 @@ void Cleanup::cleanup() {
 	}
 }
 
-void Cleanup::cleanupTable(const std::string & tableName, const std::vector<int> & userList) {
+void Cleanup::cleanupTable(const std::string & tableName, const std::vector<int32_t> & userList) {
 	do {
 		CONNECTTODATABASE(__LINE__)
 
-		if (!database.query("PREPARE selectStmt FROM \"SELECT DISTINCT UserID FROM " + tableName + "\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
+		std::vector<int32_t> orphans;
+
+		{
+			MariaDBStatement selectStmt(database, "SELECT DISTINCT UserID FROM " + tableName);
+
+			if (!selectStmt.execute()) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
+				break;
+			}
+
+			while (selectStmt.fetch()) {
+				const int32_t userID = selectStmt.getInt(0);
+
+				if (userID == -1) continue; // special case
+				if (userID == 0) continue; // special case, only for newsTicker actually
+
+				if (std::binary_search(userList.begin(), userList.end(), userID)) continue;
 
-		if (!database.query("PREPARE deleteStmt FROM \"DELETE FROM " + tableName + " WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+				orphans.push_back(userID);
+			}
 		}
 
-		if (!database.query("EXECUTE selectStmt;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+		if (orphans.empty()) break;
+
+		// always the same amount of placeholders, so the statement is prepared only once, the last chunk repeats its last user
+		std::string deleteQuery = "DELETE FROM " + tableName + " WHERE UserID IN (?";
+
+		for (size_t i = 1; i < DELETE_CHUNK_SIZE; i++) {
+			deleteQuery += ", ?";
 		}
 
-		const auto results = database.getResults<std::vector<std::string>>();
+		deleteQuery += ")";
 
-		for (const auto & vec : results) {
-			const auto userID = std::stoi(vec[0]);
+		MariaDBStatement deleteStmt(database, deleteQuery);
 
-			if (userID == -1) continue; // special case
-			if (userID == 0) continue; // special case, only for newsTicker actually
+		uint64_t deletedRows = 0;
+		bool failed = false;
 
-			if (std::find_if(userList.begin(), userList.end(), [userID](const int uid) { return userID == uid; }) != userList.end()) continue;
+		for (size_t offset = 0; offset < orphans.size(); offset += DELETE_CHUNK_SIZE) {
+			if (offset > 0) {
+				std::this_thread::sleep_for(CHUNK_DELAY);
+			}
 
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
+			const size_t chunkEnd = std::min(offset + DELETE_CHUNK_SIZE, orphans.size());
+
+			deleteStmt.reset();
+
+			for (size_t i = 0; i < DELETE_CHUNK_SIZE; i++) {
+				deleteStmt.bind(orphans[std::min(offset + i, chunkEnd - 1)]);
 			}
 
-			if (!database.query("EXECUTE deleteStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			if (!deleteStmt.execute()) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << deleteStmt.getLastError() << std::endl;
+				failed = true;
 				break;
 			}
+
+			deletedRows += deleteStmt.getAffectedRows();
 		}
+
+		std::cout << "Cleanup of " << tableName << ": removed " << deletedRows << " rows of " << orphans.size() << " deleted users" << (failed ? " (aborted)" : "") << std::endl;
 	} while (false);
+
+	std::this_thread::sleep_for(TABLE_DELAY);
 }
@@ -365,7 +365,7 @@ void DatabaseCreator::createFileserverTables() {
 		return;
 	}
 
-	if (!database.query("CREATE TABLE IF NOT EXISTS fileserverList (ServerID INT AUTO_INCREMENT PRIMARY KEY, Enabled INT NOT NULL, ActiveDays INT NOT NULL, PatronOnly INT NOT NULL, Username TEXT NOT NULL, Password TEXT NOT NULL, FtpHost TEXT NOT NULL, RootFolder TEXT NOT NULL, Url TEXT NOT NULL);")) {
+	if (!database.query("CREATE TABLE IF NOT EXISTS fileserverList (ServerID INT AUTO_INCREMENT PRIMARY KEY, Enabled INT NOT NULL, ActiveDays INT NOT NULL, PatronOnly INT NOT NULL, Username TEXT NOT NULL, Password TEXT NOT NULL, FtpHost TEXT NOT NULL, RootFolder TEXT NOT NULL, Url TEXT NOT NULL, Capacity INT NOT NULL DEFAULT 1);")) {
 		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 		return;
 	}
@@ -379,4 +379,10 @@ void DatabaseCreator::createFileserverTables() {
 		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 		return;
 	}
+
+	// the FileSynchronizer reads the queue per server
+	if (!database.query("CREATE INDEX IF NOT EXISTS ServerJobs ON fileserverSynchronizationQueue (ServerID, JobID);")) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+		return;
+	}
 }
@@ -165,4 +165,15 @@ void DatabaseMigrator::migrate() {
 			break;
 		}
 	} while (false);
+	
+	do {
+		CONNECTTODATABASE(__LINE__)
+		
+		if (database.query("SELECT Capacity FROM fileserverList LIMIT 1;")) break;
+
+		if (!database.query("ALTER TABLE fileserverList ADD Capacity INT NOT NULL DEFAULT 1;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			break;
+		}
+	} while (false);
 }
@@ -18,16 +18,25 @@
 
 #include "DatabaseServer.h"
 
+#include <algorithm>
+#include <limits>
 #include <set>
 #include <sstream>
 
 #include "DownloadSizeChecker.h"
+#include "FileserverCache.h"
+#include "JsonWriter.h"
 #include "LanguageConverter.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
+#include "ProjectCatalog.h"
+#include "ResponseCache.h"
 #include "Server.h"
 #include "ServerCommon.h"
+#include "SessionCache.h"
 #include "SpineLevel.h"
 #include "SpineServerConfig.h"
+#include "TelemetryWriter.h"
 
 #include "common/ScoreOrder.h"
 
@@ -109,6 +118,10 @@ int DatabaseServer::run() {
 	_server->resource["^/requestProjectFiles"]["POST"] = std::bind(&DatabaseServer::requestProjectFiles, this, std::placeholders::_1, std::placeholders::_2);
 	_server->resource["^/requestPackageFiles"]["POST"] = std::bind(&DatabaseServer::requestPackageFiles, this, std::placeholders::_1, std::placeholders::_2);
 	_server->resource["^/gmpLogin"]["POST"] = std::bind(&DatabaseServer::gmpLogin, this, std::placeholders::_1, std::placeholders::_2);
+	_server->resource["^/requestSessionToken"]["POST"] = std::bind(&DatabaseServer::requestSessionToken, this, std::placeholders::_1, std::placeholders::_2);
+	_server->resource["^/batch"]["POST"] = std::bind(&DatabaseServer::batch, this, std::placeholders::_1, std::placeholders::_2);
+
+	TelemetryWriter::start();
 
 	_runner = new std::thread([this]() {
 		_server->start();
@@ -120,6 +133,8 @@ int DatabaseServer::run() {
 void DatabaseServer::stop() {
 	_server->stop();
 	_runner->join();
+
+	TelemetryWriter::stop();
 }
 
 void DatabaseServer::getModnameForIDs(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
@@ -211,6 +226,44 @@ void DatabaseServer::getUserID(std::shared_ptr<HttpsServer::Response> response,
 	}
 }
 
+void DatabaseServer::requestSessionToken(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
+	try {
+		const std::string content = ServerCommon::convertString(request->content.string());
+
+		std::stringstream ss(content);
+
+		ptree pt;
+		read_json(ss, pt);
+
+		const std::string username = pt.get<std::string>("Username");
+		const std::string password = pt.get<std::string>("Password");
+
+		// only the password itself, otherwise a leaked token could be renewed forever
+		std::string passwordHash;
+		const int userID = ServerCommon::checkPassword(username, password, passwordHash);
+
+		if (userID == -1) {
+			response->write(SimpleWeb::StatusCode::client_error_unauthorized);
+			return;
+		}
+
+		SessionCache::storeFingerprint(userID, SessionCache::getFingerprint(passwordHash));
+
+		std::stringstream responseStream;
+		ptree responseTree;
+
+		// the token replaces the password in all following requests, so only the first request of a session hits the accounts database
+		responseTree.put("Token", SessionCache::createToken(username, userID, passwordHash));
+		responseTree.put("ExpiresIn", std::chrono::duration_cast<std::chrono::seconds>(SessionCache::TOKEN_TTL).count());
+
+		write_json(responseStream, responseTree);
+
+		response->write(SimpleWeb::StatusCode::success_ok, responseStream.str());
+	} catch (...) {
+		response->write(SimpleWeb::StatusCode::client_error_bad_request);
+	}
+}
+
 void DatabaseServer::getOwnRating(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
 	try {
 		const std::string content = ServerCommon::convertString(request->content.string());
@@ -580,7 +633,7 @@ void DatabaseServer::unlockAchievementServer(std::shared_ptr<HttpsServer::Respon
 				break;
 			}
 
-			SpineLevel::updateLevel(userID);
+			SpineLevel::updateLevel(userID, SpineLevel::Achievements);
 		} while (false);
 
 		response->write(code);
@@ -750,14 +803,36 @@ void DatabaseServer::getDiscordIDForUserID(std::shared_ptr<HttpsServer::Response
 
 void DatabaseServer::getSpineLevelRanking(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
 	try {
-		std::stringstream responseStream;
-		ptree responseTree;
+		const std::string content = ServerCommon::convertString(request->content.string());
 
-		SpineLevel::addRanking(responseTree);
+		// without parameters the complete ranking is requested
+		if (content.empty()) {
+			response->write(SimpleWeb::StatusCode::success_ok, SpineLevel::getRanking());
+			return;
+		}
 
-		write_json(responseStream, responseTree);
+		std::stringstream ss(content);
 
-		response->write(SimpleWeb::StatusCode::success_ok, responseStream.str());
+		ptree pt;
+		read_json(ss, pt);
+
+		const auto username = pt.get<std::string>("Username", "");
+		const auto password = pt.get<std::string>("Password", "");
+		const auto count = pt.get<size_t>("Count", 50);
+
+		if (!username.empty()) {
+			const int userID = ServerCommon::getUserID(username, password);
+
+			if (userID == -1) {
+				response->write(SimpleWeb::StatusCode::client_error_bad_request);
+				return;
+			}
+
+			response->write(SimpleWeb::StatusCode::success_ok, SpineLevel::getRankingAround(userID, count));
+			return;
+		}
+
+		response->write(SimpleWeb::StatusCode::success_ok, SpineLevel::getRankingPage(pt.get<size_t>("Offset", 0), count));
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -1223,6 +1298,18 @@ void DatabaseServer::requestCompatibilityList(std::shared_ptr<HttpsServer::Respo
 
 		const auto projectID = pt.get<int64_t>("ProjectID");
 
+		// the key is client input, so only existing projects are cached
+		const auto catalog = ProjectCatalog::get();
+		const bool cacheable = catalog && projectID >= 0 && projectID <= std::numeric_limits<int32_t>::max() && catalog->projectIndices.count(static_cast<int32_t>(projectID)) > 0;
+
+		const uint64_t cacheGeneration = ResponseCache::getGeneration(ResponseCache::Endpoint::CompatibilityList);
+		const auto cachedResponse = cacheable ? ResponseCache::get(ResponseCache::Endpoint::CompatibilityList, std::to_string(projectID)) : nullptr;
+
+		if (cachedResponse) {
+			ResponseCache::write(response, request, *cachedResponse);
+			return;
+		}
+
 		do {
 			CONNECTTODATABASE(__LINE__)
 
@@ -1303,140 +1390,71 @@ void DatabaseServer::requestCompatibilityList(std::shared_ptr<HttpsServer::Respo
 
 		write_json(responseStream, responseTree);
 
-		response->write(code, responseStream.str());
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code, responseStream.str());
+		} else if (!cacheable) {
+			ResponseCache::write(response, request, responseStream.str());
+		} else {
+			// forbiddenPatches is maintained by hand, so entries expire even without a submitted vote
+			const auto newResponse = ResponseCache::put(ResponseCache::Endpoint::CompatibilityList, std::to_string(projectID), cacheGeneration, responseStream.str(), std::chrono::minutes(10));
+			ResponseCache::write(response, request, *newResponse);
+		}
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
 }
 
 void DatabaseServer::updatePlayTime(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
-
-		ptree pt;
-		read_json(ss, pt);
-
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
-		const auto username = pt.get<std::string>("Username");
-		const auto password = pt.get<std::string>("Password");
-		const auto duration = pt.get<int32_t>("Duration");
-
-		if (duration > 60 * 24 || duration < 0) {
-			response->write(code);
-			return;
-		}
-		
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+	executeSingleRequest(response, request, &DatabaseServer::executeUpdatePlayTime);
+}
 
-		do {
-			CONNECTTODATABASE(__LINE__)
+SimpleWeb::StatusCode DatabaseServer::executeUpdatePlayTime(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO playtimes (ModID, UserID, Duration) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE Duration = Duration + ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE insertSessionTimeStmt FROM \"INSERT INTO sessionTimes (ModID, Duration) VALUES (?, ?)\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE deleteSessionInfosStmt FROM \"DELETE FROM userSessionInfos WHERE UserID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE deleteSettingsStmt FROM \"DELETE FROM userSettings WHERE UserID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE selectProjectPlayersStmt FROM \"SELECT UserID FROM playtimes WHERE ModID = ? AND UserID != -1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramDuration=" + std::to_string(duration) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
+	const auto duration = pt.get<int32_t>("Duration");
 
-			std::set<int> userList;
+	if (duration > 60 * 24 || duration < 0) {
+		return code;
+	}
 
-			for (const auto & v : pt.get_child("Projects")) {
-				const auto data = v.second.data();
-				
-				if (!database.query("SET @paramModID=" + data + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("EXECUTE insertStmt USING @paramModID, @paramUserID, @paramDuration, @paramDuration;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("EXECUTE insertSessionTimeStmt USING @paramModID, @paramDuration;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("PREPARE insertLastPlaytimeStmt FROM \"INSERT INTO lastPlayTimes (ModID, UserID, Timestamp) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE Timestamp = ?\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				
-				const int timestamp = std::chrono::duration_cast<std::chrono::hours>(std::chrono::system_clock::now() - std::chrono::system_clock::time_point()).count();
-				if (!database.query("SET @paramTimestamp=" + std::to_string(timestamp) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("EXECUTE insertLastPlaytimeStmt USING @paramModID, @paramUserID, @paramTimestamp, @paramTimestamp;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
+	std::vector<int32_t> projectIDs;
 
-				if (!database.query("EXECUTE selectProjectPlayersStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				const auto lastResults = database.getResults<std::vector<std::string>>();
+	for (const auto & v : pt.get_child("Projects")) {
+		projectIDs.push_back(std::stoi(v.second.data()));
+	}
 
-				for (const auto & vec : lastResults) {
-					userList.insert(std::stoi(vec[0]));
-				}
-			}
-			if (!database.query("EXECUTE deleteSessionInfosStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("EXECUTE deleteSettingsStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
+	TelemetryWriter::addPlayTime(userID, projectIDs, duration);
 
-			SpineLevel::clear(std::vector<int>(userList.begin(), userList.end()));
-		} while (false);
+	// the session data is removed right away, a delayed delete could remove the data of the next session
+	do {
+		if (!database.query("PREPARE deleteSessionInfosStmt FROM \"DELETE FROM userSessionInfos WHERE UserID = ? LIMIT 1\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("PREPARE deleteSettingsStmt FROM \"DELETE FROM userSettings WHERE UserID = ? LIMIT 1\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("EXECUTE deleteSessionInfosStmt USING @paramUserID;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("EXECUTE deleteSettingsStmt USING @paramUserID;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+	} while (false);
 
-		response->write(code);
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
+	return code;
 }
 
 void DatabaseServer::requestScores(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
@@ -1537,6 +1555,84 @@ void DatabaseServer::requestScores(std::shared_ptr<HttpsServer::Response> respon
 }
 
 void DatabaseServer::updateScore(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
+	executeSingleRequest(response, request, &DatabaseServer::executeUpdateScore);
+}
+
+SimpleWeb::StatusCode DatabaseServer::executeUpdateScore(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+
+	const auto projectID = pt.get<int32_t>("ProjectID");
+	const auto identifier = pt.get<int32_t>("Identifier");
+	const auto score = pt.get<int32_t>("Score");
+
+	do {
+		if (userID != -1) {
+			if (!database.query("PREPARE selectStmt FROM \"SELECT * FROM modScoreList WHERE ModID = ? AND Identifier = ?\";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("PREPARE updateStmt FROM \"INSERT INTO modScores (ModID, UserID, Identifier, Score) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Score = ?\";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("PREPARE selectCheaterStmt FROM \"SELECT UserID FROM cheaters WHERE UserID = ? LIMIT 1\";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("SET @paramModID=" + std::to_string(projectID) + ";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			if (!database.query("EXECUTE selectCheaterStmt USING @paramUserID;")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			auto lastResults = database.getResults<std::vector<std::string>>();
+			if (!lastResults.empty()) {
+				break;
+			}
+			if (!database.query("EXECUTE selectStmt USING @paramModID, @paramIdentifier;")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_bad_request;
+				break;
+			}
+			lastResults = database.getResults<std::vector<std::string>>();
+			if (!lastResults.empty()) {
+				if (!database.query("SET @paramScore=" + std::to_string(score) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
+				}
+				if (!database.query("EXECUTE updateStmt USING @paramModID, @paramUserID, @paramIdentifier, @paramScore, @paramScore;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
+				}
+			}
+
+			SpineLevel::updateLevel(userID, SpineLevel::Scores);
+		}
+	} while (false);
+
+	return code;
+}
+
+void DatabaseServer::getReviews(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
 	try {
 		const std::string content = ServerCommon::convertString(request->content.string());
 
@@ -1547,101 +1643,10 @@ void DatabaseServer::updateScore(std::shared_ptr<HttpsServer::Response> response
 
 		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		const auto username = pt.get<std::string>("Username");
-		const auto password = pt.get<std::string>("Password");
-		const auto projectID = pt.get<int32_t>("ProjectID");
-		const auto identifier = pt.get<int32_t>("Identifier");
-		const auto score = pt.get<int32_t>("Score");
+		std::stringstream responseStream;
+		ptree responseTree;
 
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
-
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (userID != -1) {
-				if (!database.query("PREPARE selectStmt FROM \"SELECT * FROM modScoreList WHERE ModID = ? AND Identifier = ?\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("PREPARE updateStmt FROM \"INSERT INTO modScores (ModID, UserID, Identifier, Score) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Score = ?\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("PREPARE selectCheaterStmt FROM \"SELECT UserID FROM cheaters WHERE UserID = ? LIMIT 1\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("SET @paramModID=" + std::to_string(projectID) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				if (!database.query("EXECUTE selectCheaterStmt USING @paramUserID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				auto lastResults = database.getResults<std::vector<std::string>>();
-				if (!lastResults.empty()) {
-					break;
-				}
-				if (!database.query("EXECUTE selectStmt USING @paramModID, @paramIdentifier;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_bad_request;
-					break;
-				}
-				lastResults = database.getResults<std::vector<std::string>>();
-				if (!lastResults.empty()) {
-					if (!database.query("SET @paramScore=" + std::to_string(score) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
-					if (!database.query("EXECUTE updateStmt USING @paramModID, @paramUserID, @paramIdentifier, @paramScore, @paramScore;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
-				}
-
-				SpineLevel::updateLevel(userID);
-			}
-		} while (false);
-
-		response->write(code);
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
-}
-
-void DatabaseServer::getReviews(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
-
-		ptree pt;
-		read_json(ss, pt);
-
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
-		std::stringstream responseStream;
-		ptree responseTree;
-
-		const auto projectID = pt.get<int64_t>("ProjectID");
+		const auto projectID = pt.get<int64_t>("ProjectID");
 
 		do {
 			CONNECTTODATABASE(__LINE__)
@@ -1814,7 +1819,7 @@ void DatabaseServer::updateReview(std::shared_ptr<HttpsServer::Response> respons
 				break;
 			}
 
-			SpineLevel::updateLevel(userID);
+			SpineLevel::updateLevel(userID, SpineLevel::Reviews);
 			
 			if (!database.query("EXECUTE selectFeedbackMailStmt USING @paramProjectID;")) {
 				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
@@ -2050,7 +2055,7 @@ void DatabaseServer::unlockAchievement(std::shared_ptr<HttpsServer::Response> re
 				break;
 			}
 
-			SpineLevel::updateLevel(userID);
+			SpineLevel::updateLevel(userID, SpineLevel::Achievements);
 		} while (false);
 
 		response->write(code);
@@ -2060,68 +2065,54 @@ void DatabaseServer::unlockAchievement(std::shared_ptr<HttpsServer::Response> re
 }
 
 void DatabaseServer::updateAchievementProgress(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
+	executeSingleRequest(response, request, &DatabaseServer::executeUpdateAchievementProgress);
+}
 
-		ptree pt;
-		read_json(ss, pt);
+SimpleWeb::StatusCode DatabaseServer::executeUpdateAchievementProgress(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+	const auto projectID = pt.get<int32_t>("ProjectID");
+	const auto identifier = pt.get<int32_t>("Identifier");
+	const auto progress = pt.get<int32_t>("Progress");
 
-		const auto username = pt.get<std::string>("Username");
-		const auto password = pt.get<std::string>("Password");
-		const auto projectID = pt.get<int32_t>("ProjectID");
-		const auto identifier = pt.get<int32_t>("Identifier");
-		const auto progress = pt.get<int32_t>("Progress");
-
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+	if (userID == -1) {
+		return SimpleWeb::StatusCode::client_error_bad_request;
+	}
 
-		if (userID == -1) {
-			response->write(SimpleWeb::StatusCode::client_error_bad_request);
-			return;
+	do {
+		if (!database.query("PREPARE updateProgressStmt FROM \"INSERT INTO modAchievementProgress (ModID, UserID, Identifier, Current) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Current = ?\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
 		}
+		if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramProgress=" + std::to_string(progress) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("EXECUTE updateProgressStmt USING @paramProjectID, @paramUserID, @paramIdentifier, @paramProgress, @paramProgress;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+	} while (false);
 
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE updateProgressStmt FROM \"INSERT INTO modAchievementProgress (ModID, UserID, Identifier, Current) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Current = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramProgress=" + std::to_string(progress) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("EXECUTE updateProgressStmt USING @paramProjectID, @paramUserID, @paramIdentifier, @paramProgress, @paramProgress;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-		} while (false);
-
-		response->write(code);
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
+	return code;
 }
 
 void DatabaseServer::requestOverallSaveData(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
@@ -2359,294 +2350,251 @@ void DatabaseServer::requestAllFriends(std::shared_ptr<HttpsServer::Response> re
 }
 
 void DatabaseServer::updateChapterStats(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
-
-		ptree pt;
-		read_json(ss, pt);
-
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+	executeSingleRequest(response, request, &DatabaseServer::executeUpdateChapterStats);
+}
 
-		const auto projectID = pt.get<int32_t>("ProjectID");
-		const auto identifier = pt.get<int32_t>("Identifier");
-		const auto guild = pt.get<int32_t>("Guild");
-		const auto key = pt.get<std::string>("Key");
-		const auto value = pt.get<int32_t>("Value");
+SimpleWeb::StatusCode DatabaseServer::executeUpdateChapterStats(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		do {
-			CONNECTTODATABASE(__LINE__)
+	const auto projectID = pt.get<int32_t>("ProjectID");
+	const auto identifier = pt.get<int32_t>("Identifier");
+	const auto guild = pt.get<int32_t>("Guild");
+	const auto key = pt.get<std::string>("Key");
+	const auto value = pt.get<int32_t>("Value");
 
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO chapterStats (ModID, Identifier, Guild, StatName, StatValue) VALUES (?, ?, ?, CONVERT(? USING BINARY), ?)\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramGuild=" + std::to_string(guild) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramStatName='" + key + "';")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramStatValue=" + std::to_string(value) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("EXECUTE insertStmt USING @paramProjectID, @paramIdentifier, @paramGuild, @paramStatName, @paramStatValue;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-		} while (false);
+	do {
+		if (!database.query("PREPARE insertStmt FROM \"INSERT INTO chapterStats (ModID, Identifier, Guild, StatName, StatValue) VALUES (?, ?, ?, CONVERT(? USING BINARY), ?)\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramIdentifier=" + std::to_string(identifier) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramGuild=" + std::to_string(guild) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramStatName='" + key + "';")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramStatValue=" + std::to_string(value) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("EXECUTE insertStmt USING @paramProjectID, @paramIdentifier, @paramGuild, @paramStatName, @paramStatValue;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+	} while (false);
 
-		response->write(code);
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
+	return code;
 }
 
 void DatabaseServer::isAchievementUnlocked(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
-
-		ptree pt;
-		read_json(ss, pt);
-
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+	executeSingleRequest(response, request, &DatabaseServer::executeIsAchievementUnlocked, true);
+}
 
-		std::stringstream responseStream;
-		ptree responseTree;
+SimpleWeb::StatusCode DatabaseServer::executeIsAchievementUnlocked(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		const auto username = pt.get<std::string>("Username");
-		const auto password = pt.get<std::string>("Password");
-		const auto projectID = pt.get<int32_t>("ProjectID");
-		const auto achievementID = pt.get<int32_t>("AchievementID");
+	const auto projectID = pt.get<int32_t>("ProjectID");
+	const auto achievementID = pt.get<int32_t>("AchievementID");
 
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+	if (userID == -1) {
+		return SimpleWeb::StatusCode::client_error_bad_request;
+	}
 
-		if (userID == -1) {
-			response->write(SimpleWeb::StatusCode::client_error_bad_request);
-			return;
+	do {
+		if (!database.query("PREPARE selectStmt FROM \"SELECT UserID FROM modAchievements WHERE UserID = ? AND ModID = ? AND Identifier = ? LIMIT 1\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
 		}
+		if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramAchievementID=" + std::to_string(achievementID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("EXECUTE selectStmt USING @paramUserID, @paramProjectID, @paramAchievementID;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		const auto lastResults = database.getResults<std::vector<std::string>>();
 
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE selectStmt FROM \"SELECT UserID FROM modAchievements WHERE UserID = ? AND ModID = ? AND Identifier = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramAchievementID=" + std::to_string(achievementID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("EXECUTE selectStmt USING @paramUserID, @paramProjectID, @paramAchievementID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			const auto lastResults = database.getResults<std::vector<std::string>>();
-
-			if (!lastResults.empty()) {
-				responseTree.put("Unlocked", true);
-			}			
-		} while (false);
-
-		write_json(responseStream, responseTree);
+		if (!lastResults.empty()) {
+			responseTree.put("Unlocked", true);
+		}			
+	} while (false);
 
-		response->write(code, responseStream.str());
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
+	return code;
 }
 
 void DatabaseServer::updateOfflineData(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
-	try {
-		const std::string content = ServerCommon::convertString(request->content.string());
-
-		std::stringstream ss(content);
-
-		ptree pt;
-		read_json(ss, pt);
-
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
-		const auto username = pt.get<std::string>("Username");
-		const auto password = pt.get<std::string>("Password");
-
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+	executeSingleRequest(response, request, &DatabaseServer::executeUpdateOfflineData);
+}
 
-		if (userID == -1) {
-			response->write(SimpleWeb::StatusCode::client_error_bad_request);
-			return;
-		}
+SimpleWeb::StatusCode DatabaseServer::executeUpdateOfflineData(MariaDBWrapper & database, int userID, const ptree & pt, ptree & responseTree) const {
+	SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		do {
-			CONNECTTODATABASE(__LINE__)
+	if (userID == -1) {
+		return SimpleWeb::StatusCode::client_error_bad_request;
+	}
 
-			if (!database.query("PREPARE insertAchievementStmt FROM \"INSERT IGNORE INTO modAchievements (ModID, Identifier, UserID) VALUES (?, ?, ?)\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE updateAchievementProgress FROM \"INSERT INTO modAchievementProgress (ModID, Identifier, UserID, Current) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Current = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE updateScoresStmt FROM \"INSERT INTO modScores (ModID, Identifier, UserID, Score) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Score = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE updateOverallSaveStmt FROM \"INSERT INTO overallSaveData (ModID, UserID, Entry, Value) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Value = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("PREPARE updatePlayTimeStmt FROM \"INSERT INTO playtimes (ModID, UserID, Duration) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE Duration = Duration + ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_bad_request;
-				break;
-			}
-			if (pt.count("Achievements") > 0) {
-				for (const auto & v : pt.get_child("Achievements")) {
-					const auto data = v.second;
+	do {
+		if (!database.query("PREPARE insertAchievementStmt FROM \"INSERT IGNORE INTO modAchievements (ModID, Identifier, UserID) VALUES (?, ?, ?)\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("PREPARE updateAchievementProgress FROM \"INSERT INTO modAchievementProgress (ModID, Identifier, UserID, Current) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Current = ?\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("PREPARE updateScoresStmt FROM \"INSERT INTO modScores (ModID, Identifier, UserID, Score) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Score = ?\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("PREPARE updateOverallSaveStmt FROM \"INSERT INTO overallSaveData (ModID, UserID, Entry, Value) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Value = ?\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("PREPARE updatePlayTimeStmt FROM \"INSERT INTO playtimes (ModID, UserID, Duration) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE Duration = Duration + ?\";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			code = SimpleWeb::StatusCode::client_error_bad_request;
+			break;
+		}
+		if (pt.count("Achievements") > 0) {
+			for (const auto & v : pt.get_child("Achievements")) {
+				const auto data = v.second;
 
-					const auto projectID = data.get<int32_t>("ProjectID");
-					const auto identifier = data.get<int32_t>("Identifier");
+				const auto projectID = data.get<int32_t>("ProjectID");
+				const auto identifier = data.get<int32_t>("Identifier");
 
-					if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("SET @paramAchievementID=" + std::to_string(identifier) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("EXECUTE insertAchievementStmt USING @paramProjectID, @paramAchievementID, @paramUserID;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
+				if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("SET @paramAchievementID=" + std::to_string(identifier) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("EXECUTE insertAchievementStmt USING @paramProjectID, @paramAchievementID, @paramUserID;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
+				}
 
-					if (data.count("Progress") == 0) continue;
+				if (data.count("Progress") == 0) continue;
 
-					const auto progress = data.get<int32_t>("Progress");
+				const auto progress = data.get<int32_t>("Progress");
 
-					if (!database.query("SET @paramProgress=" + std::to_string(progress) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
-					if (!database.query("EXECUTE updateAchievementProgress USING @paramProjectID, @paramAchievementID, @paramUserID, @paramProgress, @paramProgress;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
+				if (!database.query("SET @paramProgress=" + std::to_string(progress) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
+				}
+				if (!database.query("EXECUTE updateAchievementProgress USING @paramProjectID, @paramAchievementID, @paramUserID, @paramProgress, @paramProgress;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
 				}
 			}
-			if (pt.count("OverallSaveData") > 0) {
-				for (const auto & v : pt.get_child("OverallSaveData")) {
-					const auto data = v.second;
+		}
+		if (pt.count("OverallSaveData") > 0) {
+			for (const auto & v : pt.get_child("OverallSaveData")) {
+				const auto data = v.second;
 
-					const auto projectID = data.get<int32_t>("ProjectID");
-					const auto key = data.get<std::string>("Key");
-					const auto value = data.get<std::string>("Value");
+				const auto projectID = data.get<int32_t>("ProjectID");
+				const auto key = data.get<std::string>("Key");
+				const auto value = data.get<std::string>("Value");
 
-					if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("SET @paramKey='" + key + "';")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("SET @paramValue='" + value + "';")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("EXECUTE updateOverallSaveStmt USING @paramProjectID, @paramUserID, @paramKey, @paramValue, @paramValue;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
+				if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("SET @paramKey='" + key + "';")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("SET @paramValue='" + value + "';")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("EXECUTE updateOverallSaveStmt USING @paramProjectID, @paramUserID, @paramKey, @paramValue, @paramValue;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
 				}
 			}
-			if (pt.count("PlayTimes") > 0) {
-				for (const auto & v : pt.get_child("PlayTimes")) {
-					const auto data = v.second;
+		}
+		if (pt.count("PlayTimes") > 0) {
+			for (const auto & v : pt.get_child("PlayTimes")) {
+				const auto data = v.second;
 
-					const auto projectID = data.get<int32_t>("ProjectID");
-					const auto time = data.get<int32_t>("Time");
+				const auto projectID = data.get<int32_t>("ProjectID");
+				const auto time = data.get<int32_t>("Time");
 
-					if (time > 60 * 24 || time < 0) continue;
+				if (time > 60 * 24 || time < 0) continue;
 
-					if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("SET @paramTime=" + std::to_string(time) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						continue;
-					}
-					if (!database.query("EXECUTE updatePlayTimeStmt USING @paramProjectID, @paramUserID, @paramTime, @paramTime;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_bad_request;
-						break;
-					}
+				if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("SET @paramTime=" + std::to_string(time) + ";")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					continue;
+				}
+				if (!database.query("EXECUTE updatePlayTimeStmt USING @paramProjectID, @paramUserID, @paramTime, @paramTime;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					code = SimpleWeb::StatusCode::client_error_bad_request;
+					break;
 				}
 			}
+		}
 
-			SpineLevel::updateLevel(userID);
-		} while (false);
+		SpineLevel::updateLevel(userID, SpineLevel::Achievements | SpineLevel::Scores | SpineLevel::PlayTime);
+	} while (false);
 
-		response->write(code);
-	} catch (...) {
-		response->write(SimpleWeb::StatusCode::client_error_bad_request);
-	}
+	return code;
 }
 
 void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
@@ -2660,8 +2608,8 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 
 		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
 
-		std::stringstream responseStream;
-		ptree responseTree;
+		JsonWriter writer;
+		writer.startObject();
 
 		const auto username = pt.get<std::string>("Username");
 		const auto password = pt.get<std::string>("Password");
@@ -2723,12 +2671,14 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 			}
 			auto lastResults = database.getResults<std::vector<std::string>>();
 
-			ptree achievementsNode;
+			if (!lastResults.empty()) {
+				writer.startArray("Achievements");
+			}
 			
 			for (const auto & vec : lastResults) {
-				ptree achievementNode;
-				achievementNode.put("ProjectID", vec[0]);
-				achievementNode.put("Identifier", vec[1]);
+				writer.startObject();
+				writer.add("ProjectID", vec[0]);
+				writer.add("Identifier", vec[1]);
 				
 				if (!database.query("SET @paramModID=" + vec[0] + ";")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
@@ -2748,7 +2698,7 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 				auto results = database.getResults<std::vector<std::string>>();
 
 				if (!results.empty()) {
-					achievementNode.put("Unlocked", true);
+					writer.add("Unlocked", true);
 				}
 				
 				if (!database.query("EXECUTE selectModAchievementProgressStmt USING @paramModID, @paramIdentifier, @paramUserID;")) {
@@ -2759,7 +2709,7 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 				results = database.getResults<std::vector<std::string>>();
 				
 				if (!results.empty()) {
-					achievementNode.put("Progress", results[0][0]);
+					writer.add("Progress", results[0][0]);
 				}
 				
 				if (!database.query("EXECUTE selectModAchievementProgressMaxStmt USING @paramModID, @paramIdentifier;")) {
@@ -2770,14 +2720,16 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 				results = database.getResults<std::vector<std::string>>();
 				
 				if (!results.empty()) {
-					achievementNode.put("Max", results[0][0]);
+					writer.add("Max", results[0][0]);
 				}
 
-				achievementsNode.push_back(std::make_pair("", achievementNode));
+				writer.endObject();
 			}
 
+			if (code != SimpleWeb::StatusCode::success_ok) break;
+
 			if (!lastResults.empty()) {
-				responseTree.add_child("Achievements", achievementsNode);
+				writer.endArray();
 			}
 			
 			if (!database.query("EXECUTE selectScoreOrderStmt USING @paramModID;")) {
@@ -2800,25 +2752,27 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 			}
 			lastResults = database.getResults<std::vector<std::string>>();
 
-			ptree scoresNode;
+			if (!lastResults.empty()) {
+				writer.startArray("Scores");
+			}
 			
 			for (const auto & vec : lastResults) {
-				ptree scoreNode;
-				scoreNode.put("ProjectID", vec[0]);
-				scoreNode.put("Identifier", vec[1]);
-				scoreNode.put("Username", ServerCommon::getUsername(std::stoi(vec[2])));
-				scoreNode.put("Score", vec[3]);
+				writer.startObject();
+				writer.add("ProjectID", vec[0]);
+				writer.add("Identifier", vec[1]);
+				writer.add("Username", ServerCommon::getUsername(std::stoi(vec[2])));
+				writer.add("Score", vec[3]);
 
 				const auto it = scoreOrders.find(std::stoi(vec[1]));
 				const auto scoreOrder = it != scoreOrders.end() ? it->second : common::ScoreOrder::Descending;
 				
-				scoreNode.put("Order", static_cast<int>(scoreOrder));
+				writer.add("Order", static_cast<int>(scoreOrder));
 
-				scoresNode.push_back(std::make_pair("", scoreNode));
+				writer.endObject();
 			}
 
 			if (!lastResults.empty()) {
-				responseTree.add_child("Scores", scoresNode);
+				writer.endArray();
 			}
 			
 			if (!database.query("EXECUTE selectOverallSavesStmt USING @paramUserID;")) {
@@ -2828,25 +2782,31 @@ void DatabaseServer::requestOfflineData(std::shared_ptr<HttpsServer::Response> r
 			}
 			lastResults = database.getResults<std::vector<std::string>>();
 
-			ptree overallSaveDataNodes;
+			if (!lastResults.empty()) {
+				writer.startArray("OverallSaveData");
+			}
 			
-			for (const auto & vec : lastResults) {				
-				ptree overallSaveDataNode;
-				overallSaveDataNode.put("ProjectID", vec[0]);
-				overallSaveDataNode.put("Key", vec[1]);
-				overallSaveDataNode.put("Value", vec[2]);
-
-				scoresNode.push_back(std::make_pair("", overallSaveDataNode));
+			for (const auto & vec : lastResults) {
+				writer.startObject();
+				writer.add("ProjectID", vec[0]);
+				writer.add("Key", vec[1]);
+				writer.add("Value", vec[2]);
+				writer.endObject();
 			}
 
 			if (!lastResults.empty()) {
-				responseTree.add_child("OverallSaveData", overallSaveDataNodes);
+				writer.endArray();
 			}
 		} while (false);
 
-		write_json(responseStream, responseTree);
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code);
+			return;
+		}
 
-		response->write(code, responseStream.str());
+		writer.endObject();
+
+		response->write(code, writer.getString());
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -3147,45 +3107,19 @@ void DatabaseServer::updateLoginTime(std::shared_ptr<HttpsServer::Response> resp
 		ptree pt;
 		read_json(ss, pt);
 
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
 		const auto username = pt.get<std::string>("Username");
 		const auto password = pt.get<std::string>("Password");
 
-		const int userID = ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+		const int userID = ServerCommon::getUserID(username, password);
 
 		if (userID == -1) {
 			response->write(SimpleWeb::StatusCode::client_error_bad_request);
 			return;
 		}
 
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO lastLoginTimes (UserID, Timestamp) VALUES (?, ?) ON DUPLICATE KEY UPDATE Timestamp = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			const int timestamp = std::chrono::duration_cast<std::chrono::hours>(std::chrono::system_clock::now() - std::chrono::system_clock::time_point()).count();
-			if (!database.query("SET @paramTimestamp=" + std::to_string(timestamp) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("EXECUTE insertStmt USING @paramUserID, @paramTimestamp, @paramTimestamp;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-		} while (false);
+		TelemetryWriter::addLoginTime(userID);
 
-		response->write(code);
+		response->write(SimpleWeb::StatusCode::success_ok);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -4132,37 +4066,12 @@ void DatabaseServer::linkClicked(std::shared_ptr<HttpsServer::Response> response
 		ptree pt;
 		read_json(ss, pt);
 
-		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
 		const auto newsID = pt.get<int32_t>("NewsID");
 		const auto url = pt.get<std::string>("Url");
 
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE insertLinkClick FROM \"INSERT INTO linksClicked (NewsID, Url, Counter) VALUES (?, ?, 1) ON DUPLICATE KEY UPDATE Counter = Counter + 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("SET @paramNewsID=" + std::to_string(newsID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("SET @paramUrl='" + url + "';")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("EXECUTE insertLinkClick USING @paramNewsID, @paramUrl;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-		} while (false);
+		TelemetryWriter::addLinkClick(newsID, url);
 
-		response->write(code);
+		response->write(SimpleWeb::StatusCode::success_ok);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -4221,7 +4130,7 @@ void DatabaseServer::submitRating(std::shared_ptr<HttpsServer::Response> respons
 				break;
 			}
 
-			SpineLevel::updateLevel(userID);
+			SpineLevel::updateLevel(userID, SpineLevel::Ratings);
 		} while (false);
 
 		response->write(code);
@@ -4527,7 +4436,12 @@ void DatabaseServer::requestAllProjectStats(std::shared_ptr<HttpsServer::Respons
 
 		write_json(responseStream, responseTree);
 
-		response->write(code, responseStream.str());
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code, responseStream.str());
+		} else {
+			// play times and scores change all the time, so the stats are only revalidated instead of cached
+			ResponseCache::write(response, request, responseStream.str());
+		}
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -4552,8 +4466,8 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 		const auto language = pt.get<std::string>("Language");
 		const auto projectID = pt.get<int32_t>("ProjectID");
 
-		std::stringstream responseStream;
-		ptree responseTree;
+		JsonWriter writer;
+		writer.startObject();
 
 		do {
 			CONNECTTODATABASE(__LINE__)
@@ -4647,11 +4561,9 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 
 			const bool isTeamMember = Server::isTeamMemberOfMod(projectID, userID);
 
-			ptree achievementNodes;
+			writer.startArray("Achievements");
 			for (const auto & vec : lastResults) {
 				// get mod name in current language
-				ptree achievementNode;
-
 				if (!database.query("SET @paramLanguage='" + language + "';")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
@@ -4697,7 +4609,7 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 
 				if (results.empty()) continue;
 
-				achievementNode.put("Name", results[0][0]);
+				const std::string name = results[0][0];
 
 				if (anyLanguage) {
 					if (!database.query("EXECUTE selectAnyAchievementDescriptionStmt USING @paramModID, @paramIdentifier;")) {
@@ -4714,20 +4626,14 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 				}
 				results = database.getResults<std::vector<std::string>>();
 
-				achievementNode.put("Description", results.empty() ? "" : results[0][0]);
+				const std::string description = results.empty() ? "" : results[0][0];
 				
 				if (!database.query("EXECUTE selectAchievementIconsStmt USING @paramModID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
 					continue;
 				}
-				results = database.getResults<std::vector<std::string>>();
-				if (!results.empty()) {
-					achievementNode.put("IconLocked", results[0][0]);
-					achievementNode.put("IconLockedHash", results[0][1]);
-					achievementNode.put("IconUnlocked", results[0][2]);
-					achievementNode.put("IconUnlockedHash", results[0][3]);
-				}
+				const auto icons = database.getResults<std::vector<std::string>>();
 				if (!database.query("EXECUTE selectAchievementHiddenStmt USING @paramModID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
@@ -4735,7 +4641,7 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 				}
 				results = database.getResults<std::vector<std::string>>();
 
-				achievementNode.put("Hidden", results.empty() ? 0 : 1);
+				const int hidden = results.empty() ? 0 : 1;
 
 				if (!database.query("EXECUTE selectUnlockedAchievementsStmt USING @paramModID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
@@ -4743,11 +4649,8 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 					continue;
 				}
 				results = database.getResults<std::vector<std::string>>();
-				if (results.empty()) {
-					achievementNode.put("UnlockedPercent", 0.0);
-				} else {
-					achievementNode.put("UnlockedPercent", playerCount == 0 ? 0.0 : static_cast<double>(std::stoi(results[0][0]) * 100) / playerCount);
-				}
+				const double unlockedPercent = results.empty() || playerCount == 0 ? 0.0 : static_cast<double>(std::stoi(results[0][0]) * 100) / playerCount;
+
 				if (!database.query("EXECUTE selectAllOwnAchievementsStmt USING @paramModID, @paramUserID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
@@ -4755,7 +4658,7 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 				}
 				results = database.getResults<std::vector<std::string>>();
 				
-				achievementNode.put("Unlocked", results.empty() ? 0 : 1);
+				const int unlocked = results.empty() ? 0 : 1;
 				
 				if (!database.query("EXECUTE selectAchievementMaxProgressStmt USING @paramModID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
@@ -4763,34 +4666,45 @@ void DatabaseServer::requestAllAchievementStats(std::shared_ptr<HttpsServer::Res
 					continue;
 				}
 				results = database.getResults<std::vector<std::string>>();
-				if (results.empty()) {
-					achievementNode.put("MaxProgress", 0);
-				} else {
-					achievementNode.put("MaxProgress", std::stoi(results[0][0]));
-				}
+				const int maxProgress = results.empty() ? 0 : std::stoi(results[0][0]);
+
 				if (!database.query("EXECUTE selectAchievementProgressStmt USING @paramModID, @paramUserID, @paramIdentifier;")) {
 					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
 					continue;
 				}
 				results = database.getResults<std::vector<std::string>>();
-				if (results.empty()) {
-					achievementNode.put("CurrentProgress", 0);
-				} else {
-					achievementNode.put("CurrentProgress", std::stoi(results[0][0]));
-				}
-
-				achievementNode.put("CanSeeHidden", isTeamMember ? 1: 0);
-
-				achievementNodes.push_back(std::make_pair("", achievementNode));
-			}
-			
-			responseTree.add_child("Achievements", achievementNodes);
+				const int currentProgress = results.empty() ? 0 : std::stoi(results[0][0]);
+
+				// the achievement is only written once all queries succeeded, so a failing query skips it completely
+				writer.startObject();
+				writer.add("Name", name);
+				writer.add("Description", description);
+				if (!icons.empty()) {
+					writer.add("IconLocked", icons[0][0]);
+					writer.add("IconLockedHash", icons[0][1]);
+					writer.add("IconUnlocked", icons[0][2]);
+					writer.add("IconUnlockedHash", icons[0][3]);
+				}
+				writer.add("Hidden", hidden);
+				writer.add("UnlockedPercent", unlockedPercent);
+				writer.add("Unlocked", unlocked);
+				writer.add("MaxProgress", maxProgress);
+				writer.add("CurrentProgress", currentProgress);
+				writer.add("CanSeeHidden", isTeamMember ? 1 : 0);
+				writer.endObject();
+			}
+			writer.endArray();
 		} while (false);
 
-		write_json(responseStream, responseTree);
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code);
+			return;
+		}
+
+		writer.endObject();
 
-		response->write(code, responseStream.str());
+		response->write(code, writer.getString());
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -4940,46 +4854,11 @@ void DatabaseServer::updateSucceeded(std::shared_ptr<HttpsServer::Response> resp
 		ptree pt;
 		read_json(ss, pt);
 
-		const SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO downloadsPerVersion (ModID, Version, Counter) VALUES (?, CONVERT(? USING BINARY), 1) ON DUPLICATE KEY UPDATE Counter = Counter + 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("PREPARE selectVersionStmt FROM \"SELECT MajorVersion, MinorVersion, PatchVersion FROM mods WHERE ModID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-
-			for (const auto & v : pt.get_child("IDs")) {
-				if (!database.query("SET @paramModID=" + v.second.data() + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					break;
-				}
-				if (!database.query("EXECUTE selectVersionStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					break;
-				}
-				auto results = database.getResults<std::vector<std::string>>();
-				
-				if (results.empty()) continue;
-				
-				const std::string version = results[0][0] + "." + results[0][1] + "." + results[0][2];
-				if (!database.query("SET @paramVersion='" + version + "';")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					break;
-				}
-				if (!database.query("EXECUTE insertStmt USING @paramModID, @paramVersion;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					break;
-				}
-			}
-		} while (false);
+		for (const auto & v : pt.get_child("IDs")) {
+			TelemetryWriter::addUpdate(std::stoi(v.second.data()));
+		}
 
-		response->write(code);
+		response->write(SimpleWeb::StatusCode::success_ok);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -5485,6 +5364,8 @@ void DatabaseServer::submitNews(std::shared_ptr<HttpsServer::Response> response,
 			}
 		} while (false);
 
+		ResponseCache::invalidate(ResponseCache::Endpoint::AllNews);
+
 		response->write(code);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
@@ -5509,204 +5390,117 @@ void DatabaseServer::requestAllProjects(std::shared_ptr<HttpsServer::Response> r
 
 		const int userID = ServerCommon::getUserID(username, password);
 
-		std::stringstream responseStream;
-		ptree responseTree;
-
-		do {
-			CONNECTTODATABASE(__LINE__)
+		// only the anonymous view in a supported language is shared, logged in users see their own unreleased projects and played projects
+		const bool cacheable = userID == -1 && LanguageConverter::convert(language) != common::Language::None;
+		const std::string cacheKey = language + (simplified ? ";Simplified" : "");
+		const uint64_t cacheGeneration = ResponseCache::getGeneration(ResponseCache::Endpoint::AllProjects);
 
-			std::map<int32_t, std::string> teamNames;
-			if (!simplified) {
-				if (!database.query(std::string("SELECT TeamID FROM teams;"))) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				auto lastResults = database.getResults<std::vector<std::string>>();
-				if (!database.query("PREPARE selectTeamnameStmt FROM \"SELECT CAST(Name AS BINARY) FROM teamNames WHERE TeamID = ? AND Languages & ? LIMIT 1\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				if (!database.query("SET @paramLanguage=" + std::to_string(LanguageConverter::convert(language)) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				if (!database.query("SET @paramFallbackLanguage=" + std::to_string(common::English) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				for (const auto & vec : lastResults) {
-					const auto id = static_cast<int32_t>(std::stoi(vec[0]));
+		if (cacheable) {
+			const auto cachedResponse = ResponseCache::get(ResponseCache::Endpoint::AllProjects, cacheKey);
 
-					if (!database.query("SET @paramTeamID=" + std::to_string(id) + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					if (!database.query("EXECUTE selectTeamnameStmt USING @paramTeamID, @paramLanguage;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					auto results = database.getResults<std::vector<std::string>>();
-					if (!results.empty()) {
-						teamNames.insert(std::make_pair(id, results[0][0]));
-					} else {
-						if (!database.query("EXECUTE selectTeamnameStmt USING @paramTeamID, @paramFallbackLanguage;")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-							code = SimpleWeb::StatusCode::client_error_failed_dependency;
-							break;
-						}
-						results = database.getResults<std::vector<std::string>>();
-						if (!results.empty()) {
-							teamNames.insert(std::make_pair(id, results[0][0]));
-						}
-					}
-				}
+			if (cachedResponse) {
+				ResponseCache::write(response, request, *cachedResponse);
+				return;
 			}
+		}
 
-			if (!database.query("PREPARE selectUpdateDateStmt FROM \"SELECT Date FROM lastUpdated WHERE ProjectID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("PREPARE selectPlayedProjectsStmt FROM \"SELECT ModID FROM playtimes WHERE Duration > 0 AND UserID = ? AND UserID != -1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+		JsonWriter writer;
+		writer.startObject();
+
+		do {
+			const auto catalog = ProjectCatalog::get();
+
+			if (!catalog) {
 				code = SimpleWeb::StatusCode::client_error_failed_dependency;
 				break;
 			}
 
-			// ModID | Name of the Mod shown in GUI | ID of the team | Enabled in GUI or only internal | 1 or 2 either if the mod is for Gothic 1 or 2 | Release date encoded as integer in days | one of Mod or Patch encoded as integer | major version | minor version | patch version
-			if (!database.query(std::string("SELECT ModID, TeamID, Gothic, ReleaseDate, Type, MajorVersion, MinorVersion, PatchVersion, SpineVersion FROM mods WHERE Enabled = 1;"))) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
+			CONNECTTODATABASE(__LINE__)
+
+			std::set<int32_t> memberTeams;
+			std::set<int32_t> earlyUnlocks;
+			std::vector<int32_t> playedProjects;
 
-			auto enabledResults = database.getResults<std::vector<std::string>>();
 			if (userID != -1) {
-				if (!database.query(std::string("SELECT ModID, TeamID, Gothic, ReleaseDate, Type, MajorVersion, MinorVersion, PatchVersion, SpineVersion FROM mods WHERE Enabled = 0;"))) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+				MariaDBStatement selectTeamsStmt(database, "SELECT TeamID FROM teammembers WHERE UserID = ?");
+				selectTeamsStmt.bind(userID);
+				if (!selectTeamsStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectTeamsStmt.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
 					break;
 				}
-				auto disabledResults = database.getResults<std::vector<std::string>>();
-				if (!database.query("PREPARE selectIsTeammemberStmt FROM \"SELECT UserID FROM teammembers WHERE TeamID = ? AND UserID = ? LIMIT 1\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
+				while (selectTeamsStmt.fetch()) {
+					memberTeams.insert(selectTeamsStmt.getInt(0));
 				}
-				if (!database.query("PREPARE selectEarlyUnlockStmt FROM \"SELECT * FROM earlyUnlocks WHERE ModID = ? AND UserID = ? LIMIT 1\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+
+				MariaDBStatement selectEarlyUnlocksStmt(database, "SELECT ModID FROM earlyUnlocks WHERE UserID = ?");
+				selectEarlyUnlocksStmt.bind(userID);
+				if (!selectEarlyUnlocksStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectEarlyUnlocksStmt.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
 					break;
 				}
-				if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				while (selectEarlyUnlocksStmt.fetch()) {
+					earlyUnlocks.insert(selectEarlyUnlocksStmt.getInt(0));
+				}
+
+				MariaDBStatement selectPlayedProjectsStmt(database, "SELECT ModID FROM playtimes WHERE Duration > 0 AND UserID = ?");
+				selectPlayedProjectsStmt.bind(userID);
+				if (!selectPlayedProjectsStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayedProjectsStmt.getLastError() << std::endl;
 					code = SimpleWeb::StatusCode::client_error_failed_dependency;
 					break;
 				}
-				for (const auto & vec : disabledResults) {
-					if (!database.query("SET @paramTeamID=" + vec[1] + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					if (!database.query("EXECUTE selectIsTeammemberStmt USING @paramTeamID, @paramUserID;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					auto allowed = database.getResults<std::vector<std::string>>();
-					if (!allowed.empty()) {
-						enabledResults.push_back(vec);
-						continue;
-					}
-					if (!database.query("SET @paramModID=" + vec[0] + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					if (!database.query("EXECUTE selectEarlyUnlockStmt USING @paramModID, @paramUserID;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					allowed = database.getResults<std::vector<std::string>>();
-					if (!allowed.empty()) {
-						enabledResults.push_back(vec);
-					}
+				while (selectPlayedProjectsStmt.fetch()) {
+					playedProjects.push_back(selectPlayedProjectsStmt.getInt(0));
 				}
 			}
 
-			if (!database.query("PREPARE selectModnameStmt FROM \"SELECT Languages, CAST(Name AS BINARY) FROM projectNames WHERE ProjectID = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("PREPARE selectDevtimeStmt FROM \"SELECT Duration FROM devtimes WHERE ModID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("PREPARE selectTimeStmt FROM \"SELECT IFNULL(SUM(Duration), 0), IFNULL(COUNT(Duration), 0) FROM playtimes WHERE ModID = ? AND UserID != -1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			if (!database.query("PREPARE selectKeywordsStmt FROM \"SELECT Keywords FROM keywordsPerProject WHERE ProjectID = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
+			// enabled projects first, followed by the disabled ones the user has access to as team member or by early unlock
+			std::vector<const ProjectCatalog::Project *> visibleProjects;
+			visibleProjects.reserve(catalog->projects.size());
+
+			for (const auto & project : catalog->projects) {
+				if (!project.enabled) continue;
+
+				visibleProjects.push_back(&project);
 			}
-			std::map<int32_t, uint32_t> versions;
+			if (userID != -1) {
+				for (const auto & project : catalog->projects) {
+					if (project.enabled) continue;
 
-			const common::Language clientLanguage = LanguageConverter::convert(language);
-			constexpr common::Language defaultLanguage = common::Language::English;
+					if (memberTeams.find(project.teamID) == memberTeams.end() && earlyUnlocks.find(project.projectID) == earlyUnlocks.end()) continue;
 
-			ptree projectNodes;
-			for (const auto & vec : enabledResults) {
-				ptree projectNode;
-				
-				projectNode.put("ProjectID", std::stoi(vec[0]));
-				
-				if (!database.query("SET @paramModID=" + vec[0] + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				if (!database.query("EXECUTE selectModnameStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
+					visibleProjects.push_back(&project);
 				}
-				auto results = database.getResults<std::vector<std::string>>();
+			}
 
-				if (results.empty()) continue;
+			const common::Language clientLanguage = LanguageConverter::convert(language);
+			constexpr common::Language defaultLanguage = common::Language::English;
 
-				std::map<int, std::string> names;
+			bool projectsStarted = false;
+			for (const auto * project : visibleProjects) {
+				const auto & names = project->names;
 
-				auto supportedLanguages = 0;
+				if (names.empty()) continue;
 
-				for (const auto & vec2 : results) {
-					const auto l = static_cast<common::Language>(std::stoi(vec2[0]));
-					const auto n = vec2[1];
+				if (!projectsStarted) {
+					writer.startArray("Projects");
+					projectsStarted = true;
+				}
 
-					names.insert(std::make_pair(l, n));
+				writer.startObject();
 
-					supportedLanguages |= l;
-				}
+				writer.add("ProjectID", project->projectID);
 
 				common::Language l = common::Language::None;
 
-				auto nameIt = std::find_if(names.begin(), names.end(), [clientLanguage](const std::pair<int, std::string> & p) {
+				auto nameIt = std::find_if(names.begin(), names.end(), [clientLanguage](const std::pair<const int, std::string> & p) {
 					return p.first & clientLanguage;
 				});
 
 				if (nameIt == names.end()) {
-					nameIt = std::find_if(names.begin(), names.end(), [=](const std::pair<int, std::string> & p) {
+					nameIt = std::find_if(names.begin(), names.end(), [=](const std::pair<const int, std::string> & p) {
 						return p.first & defaultLanguage;
 					});
 
@@ -5721,204 +5515,86 @@ void DatabaseServer::requestAllProjects(std::shared_ptr<HttpsServer::Response> r
 					l = clientLanguage;
 				}
 
-				projectNode.put("Name", nameIt->second);
-				projectNode.put("GameType", std::stoi(vec[2]));
-				projectNode.put("ModType", std::stoi(vec[4]));
+				writer.add("Name", nameIt->second);
+				writer.add("GameType", project->gameType);
+				writer.add("ModType", project->modType);
 
 				if (simplified) {
-					projectNodes.push_back(std::make_pair("", projectNode));
-					continue;
-				}
-
-				std::string keywords;
-
-				for (const auto & n : names) {
-					keywords += n.second + ";";
-				}
-
-				if (!database.query("EXECUTE selectKeywordsStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				results = database.getResults<std::vector<std::string>>();
-
-				for (const auto & v : results) {
-					keywords += v[0] + ";";
-				}
-
-				projectNode.put("Keywords", keywords);
-
-				projectNode.put("SupportedLanguages", supportedLanguages);
-
-				projectNode.put("TeamID", std::stoi(vec[1]));
-				const auto it = teamNames.find(std::stoi(vec[1]));
-				if (it != teamNames.end()) {
-					projectNode.put("TeamName", it->second);
-				}
-				projectNode.put("ReleaseDate", std::stoi(vec[3]));
-				projectNode.put("MajorVersion", std::stoi(vec[5]));
-				projectNode.put("MinorVersion", std::stoi(vec[6]));
-				projectNode.put("PatchVersion", std::stoi(vec[7]));
-				projectNode.put("SpineVersion", std::stoi(vec[8]));
-
-				if (!database.query("EXECUTE selectDevtimeStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+					writer.endObject();
 					continue;
 				}
-				results = database.getResults<std::vector<std::string>>();
-				if (!results.empty()) {
-					projectNode.put("DevDuration", std::stoi(results[0][0]));
-				} else {
-					projectNode.put("DevDuration", -1);
-				}
-				if (!database.query("EXECUTE selectTimeStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					continue;
-				}
-				results = database.getResults<std::vector<std::string>>();
-				if (!results.empty()) {
-					const int sumDurations = std::stoi(results[0][0]);
-					const int countDurations = std::stoi(results[0][1]);
-					if (countDurations >= 1) {
-						projectNode.put("AvgDuration", sumDurations / countDurations);
-					} else {
-						projectNode.put("AvgDuration", -1);
-					}
-				} else {
-					projectNode.put("AvgDuration", -1);
-				}
-				uint32_t version = (std::stoi(vec[5]) << 24) + (std::stoi(vec[6]) << 16) + (std::stoi(vec[7]) << 8) + std::stoi(vec[8]);
-				const auto downloadSize = _downloadSizeChecker->getBytes(std::stoi(vec[0]), LanguageConverter::convert(l), version);
-				projectNode.put("DownloadSize", downloadSize);
-
-				if (!database.query("EXECUTE selectUpdateDateStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				results = database.getResults<std::vector<std::string>>();
-
-				const int updateDate = results.empty() ? 0 : std::stoi(results[0][0]);
-				projectNode.put("UpdateDate", std::max(std::stoi(vec[3]), updateDate));
-				projectNode.put("Language", l);
-
-				projectNodes.push_back(std::make_pair("", projectNode));
-				
-				versions.insert(std::make_pair(std::stoi(vec[0]), version));
-			}
-
-			if (!database.query("EXECUTE selectPlayedProjectsStmt USING @paramUserID")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			const auto results = database.getResults<std::vector<std::string>>();
-
-			if (!projectNodes.empty()) {
-				responseTree.add_child("Projects", projectNodes);
-			}
-
-			ptree playedProjectNodes;
-			
-			for (const auto & vec : results) {
-				const int32_t projectID = std::stoi(vec[0]);
-
-				ptree playedProjectNode;
-				playedProjectNode.put("ID", projectID);
-
-				playedProjectNodes.push_back(std::make_pair("", playedProjectNode));
-			}
-
-			if (!playedProjectNodes.empty()) {
-				responseTree.add_child("PlayedProjects", playedProjectNodes);
-			}
-
-			// optional packages
-
-			// PackageID | ModID | Enabled
-			if (!database.query(std::string("SELECT * FROM optionalpackages WHERE Enabled = 1;"))) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
-			}
-			enabledResults = database.getResults<std::vector<std::string>>();
-			if (userID != -1) {
-				if (!database.query(std::string("SELECT * FROM optionalpackages WHERE Enabled = 0;"))) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				auto disabledResults = database.getResults<std::vector<std::string>>();
-				if (!database.query("PREPARE selectEarlyUnlockStmt FROM \"SELECT * FROM earlyUnlocks WHERE ModID = ? AND UserID = ? LIMIT 1\";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
-				}
-				for (auto vec : disabledResults) {
-					if (!database.query("SET @paramModID=" + vec[1] + ";")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					if (!database.query("EXECUTE selectEarlyUnlockStmt USING @paramModID, @paramUserID;")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-						code = SimpleWeb::StatusCode::client_error_failed_dependency;
-						break;
-					}
-					auto allowed = database.getResults<std::vector<std::string>>();
-					if (!allowed.empty()) {
-						enabledResults.push_back(vec);
-					}
-				}
-			}
 
-			std::map<int, std::map<std::string, std::string>> packageNames;
+				std::string keywords;
 
-			ptree packageNodes;
-			if (!database.query("PREPARE selectOptionalNamesStmt FROM \"SELECT PackageID, CAST(Name AS BINARY), Language FROM optionalpackagenames\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
+				for (const auto & n : names) {
+					keywords += n.second + ";";
+				}
+				for (const auto & k : project->keywords) {
+					keywords += k + ";";
+				}
+
+				writer.add("Keywords", keywords);
+
+				writer.add("SupportedLanguages", project->supportedLanguages);
+
+				writer.add("TeamID", project->teamID);
+				const auto teamName = ProjectCatalog::getTeamName(*catalog, project->teamID, clientLanguage);
+				if (!teamName.empty()) {
+					writer.add("TeamName", teamName);
+				}
+				writer.add("ReleaseDate", project->releaseDate);
+				writer.add("MajorVersion", project->majorVersion);
+				writer.add("MinorVersion", project->minorVersion);
+				writer.add("PatchVersion", project->patchVersion);
+				writer.add("SpineVersion", project->spineVersion);
+				writer.add("DevDuration", project->devDuration);
+				writer.add("AvgDuration", project->avgDuration);
+
+				const uint32_t version = (project->majorVersion << 24) + (project->minorVersion << 16) + (project->patchVersion << 8) + project->spineVersion;
+				const auto downloadSize = _downloadSizeChecker->getBytes(project->projectID, LanguageConverter::convert(l), version);
+				writer.add("DownloadSize", downloadSize);
+
+				writer.add("UpdateDate", project->updateDate);
+				writer.add("Language", static_cast<int>(l));
+
+				writer.endObject();
 			}
-			if (!database.query("EXECUTE selectOptionalNamesStmt;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				code = SimpleWeb::StatusCode::client_error_failed_dependency;
-				break;
+
+			if (projectsStarted) {
+				writer.endArray();
 			}
-			const auto nameResults = database.getResults<std::vector<std::string>>();
 
-			for (const auto & vec : nameResults) {
-				packageNames[std::stoi(vec[0])][vec[2]] = vec[1];
+			if (!playedProjects.empty()) {
+				writer.startArray("PlayedProjects");
+
+				for (const int32_t projectID : playedProjects) {
+					writer.startObject();
+					writer.add("ID", projectID);
+					writer.endObject();
+				}
+
+				writer.endArray();
 			}
 
-			for (const auto & vec : enabledResults) {
-				ptree packageNode;
+			// optional packages
 
-				const auto projectID = std::stoi(vec[1]);
-				const auto packageID = std::stoi(vec[0]);
+			bool packagesStarted = false;
+			for (const auto & package : catalog->packages) {
+				if (!package.enabled && (userID == -1 || earlyUnlocks.find(package.projectID) == earlyUnlocks.end())) continue;
 
-				packageNode.put("PackageID", packageID);
-				packageNode.put("ProjectID", projectID);
+				if (package.names.empty()) continue;
 
-				if (!database.query("SET @paramPackageID=" + vec[0] + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					code = SimpleWeb::StatusCode::client_error_failed_dependency;
-					break;
+				if (!packagesStarted) {
+					writer.startArray("Packages");
+					packagesStarted = true;
 				}
 
-				const auto mapIt = packageNames.find(packageID);
-
-				if (mapIt == packageNames.end()) continue;
+				writer.startObject();
 
-				const auto map = mapIt->second;
+				writer.add("PackageID", package.packageID);
+				writer.add("ProjectID", package.projectID);
 
-				if (map.empty()) continue;
+				const auto & map = package.names;
 
 				auto it = map.find(language);
 
@@ -5929,27 +5605,43 @@ void DatabaseServer::requestAllProjects(std::shared_ptr<HttpsServer::Response> r
 				if (it == map.end()) {
 					it = map.begin();
 				}
-				
-				const auto packageName = it->second;
 
-				packageNode.put("Name", packageName);
-				packageNode.put("Language", it->first);
+				writer.add("Name", it->second);
+				writer.add("Language", it->first);
+
+				uint32_t version = 0;
+				const auto projectIt = catalog->projectIndices.find(package.projectID);
+				if (projectIt != catalog->projectIndices.end()) {
+					const auto & project = catalog->projects[projectIt->second];
+					version = (project.majorVersion << 24) + (project.minorVersion << 16) + (project.patchVersion << 8) + project.spineVersion;
+				}
 				
-				const auto downloadSize = _downloadSizeChecker->getBytesForPackage(projectID, packageID, it->first, versions[packageID]);
+				const auto downloadSize = _downloadSizeChecker->getBytesForPackage(package.projectID, package.packageID, it->first, version);
 
-				packageNode.put("DownloadSize", downloadSize);
+				writer.add("DownloadSize", downloadSize);
 
-				packageNodes.push_back(std::make_pair("", packageNode));
+				writer.endObject();
 			}
 
-			if (!packageNodes.empty()) {
-				responseTree.add_child("Packages", packageNodes);
+			if (packagesStarted) {
+				writer.endArray();
 			}
 		} while (false);
 
-		write_json(responseStream, responseTree);
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code);
+			return;
+		}
 
-		response->write(code, responseStream.str());
+		writer.endObject();
+
+		if (cacheable) {
+			// download sizes and play times change without invalidation, so the anonymous view is refreshed together with the ProjectCatalog
+			const auto cachedResponse = ResponseCache::put(ResponseCache::Endpoint::AllProjects, cacheKey, cacheGeneration, writer.getString(), std::chrono::minutes(10));
+			ResponseCache::write(response, request, *cachedResponse);
+		} else {
+			ResponseCache::write(response, request, writer.getString());
+		}
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -6013,9 +5705,11 @@ void DatabaseServer::submitCompatibility(std::shared_ptr<HttpsServer::Response>
 				break;
 			}
 
-			SpineLevel::updateLevel(userID);
+			SpineLevel::updateLevel(userID, SpineLevel::Compatibilities);
 		} while (false);
 
+		ResponseCache::invalidate(ResponseCache::Endpoint::CompatibilityList);
+
 		response->write(code);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
@@ -6106,6 +5800,17 @@ void DatabaseServer::requestAllNews(std::shared_ptr<HttpsServer::Response> respo
 
 		const auto languageAsString = LanguageConverter::convert(language);
 
+		// empty for languages the server doesn't know, they aren't cached
+		const bool cacheable = !languageAsString.empty();
+
+		const uint64_t cacheGeneration = ResponseCache::getGeneration(ResponseCache::Endpoint::AllNews);
+		const auto cachedResponse = cacheable ? ResponseCache::get(ResponseCache::Endpoint::AllNews, languageAsString) : nullptr;
+
+		if (cachedResponse) {
+			ResponseCache::write(response, request, *cachedResponse);
+			return;
+		}
+
 		std::stringstream responseStream;
 		ptree responseTree;
 
@@ -6327,7 +6032,14 @@ void DatabaseServer::requestAllNews(std::shared_ptr<HttpsServer::Response> respo
 
 		write_json(responseStream, responseTree);
 
-		response->write(code, responseStream.str());
+		if (code != SimpleWeb::StatusCode::success_ok) {
+			response->write(code, responseStream.str());
+		} else if (!cacheable) {
+			ResponseCache::write(response, request, responseStream.str());
+		} else {
+			const auto newResponse = ResponseCache::put(ResponseCache::Endpoint::AllNews, languageAsString, cacheGeneration, responseStream.str(), std::chrono::hours(1));
+			ResponseCache::write(response, request, *newResponse);
+		}
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -6344,50 +6056,11 @@ void DatabaseServer::downloadSucceeded(std::shared_ptr<HttpsServer::Response> re
 
 		const auto id = pt.get<int32_t>("ID");
 
-		const SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+		TelemetryWriter::addDownload(id);
 
-		do {
-			CONNECTTODATABASE(__LINE__)
-
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO downloads (ModID, Counter) VALUES (?, 1) ON DUPLICATE KEY UPDATE Counter = Counter + 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("SET @paramModID=" + std::to_string(id) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE insertStmt USING @paramModID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("PREPARE insertPerVersionStmt FROM \"INSERT INTO downloadsPerVersion (ModID, Version, Counter) VALUES (?, CONVERT(? USING BINARY), 1) ON DUPLICATE KEY UPDATE Counter = Counter + 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("PREPARE selectVersionStmt FROM \"SELECT MajorVersion, MinorVersion, PatchVersion FROM mods WHERE ModID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE selectVersionStmt USING @paramModID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			auto results = database.getResults<std::vector<std::string>>();
-			if (!results.empty()) {
-				const std::string version = results[0][0] + "." + results[0][1] + "." + results[0][2];
-				if (!database.query("SET @paramVersion='" + version + "';")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-					break;
-				}
-				if (!database.query("EXECUTE insertPerVersionStmt USING @paramModID, @paramVersion;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					break;
-				}
-			}
-		} while (false);
+		addServedBytes(pt, _downloadSizeChecker->getMaxBytes(id));
 
-		response->write(code);
+		response->write(SimpleWeb::StatusCode::success_ok);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
@@ -6404,31 +6077,27 @@ void DatabaseServer::packageDownloadSucceeded(std::shared_ptr<HttpsServer::Respo
 
 		const auto id = pt.get<int32_t>("ID");
 
-		const SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
-
-		do {
-			CONNECTTODATABASE(__LINE__)
+		TelemetryWriter::addPackageDownload(id);
 
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO packagedownloads (PackageID, Counter) VALUES (?, 1) ON DUPLICATE KEY UPDATE Counter = Counter + 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("SET @paramPackageID=" + std::to_string(id) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE insertStmt USING @paramPackageID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-		} while (false);
+		addServedBytes(pt, _downloadSizeChecker->getMaxBytesForPackage(id));
 
-		response->write(code);
+		response->write(SimpleWeb::StatusCode::success_ok);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
 	}
 }
 
+void DatabaseServer::addServedBytes(const ptree & pt, uint64_t maxBytes) const {
+	// older clients don't report where they downloaded from
+	const auto fileserver = pt.get<std::string>("Fileserver", "");
+	const auto size = pt.get<uint64_t>("Size", 0);
+
+	if (fileserver.empty() || size == 0 || maxBytes == 0) return;
+
+	// the request isn't authenticated, so a single report must not be able to push a mirror out of rotation
+	FileserverCache::addServedBytes(fileserver, std::min(size, maxBytes));
+}
+
 void DatabaseServer::requestProjectFiles(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
 	try {
 		const std::string content = ServerCommon::convertString(request->content.string());
@@ -6791,6 +6460,158 @@ void DatabaseServer::gmpLogin(std::shared_ptr<HttpsServer::Response> response, s
 	}
 }
 
+void DatabaseServer::batch(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request) const {
+	try {
+		const std::string content = ServerCommon::convertString(request->content.string());
+
+		std::stringstream ss(content);
+
+		ptree pt;
+		read_json(ss, pt);
+
+		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+
+		static const std::map<std::string, RequestHandler> handlers = {
+			{ "updatePlayTime", &DatabaseServer::executeUpdatePlayTime },
+			{ "updateScore", &DatabaseServer::executeUpdateScore },
+			{ "updateAchievementProgress", &DatabaseServer::executeUpdateAchievementProgress },
+			{ "updateChapterStats", &DatabaseServer::executeUpdateChapterStats },
+			{ "isAchievementUnlocked", &DatabaseServer::executeIsAchievementUnlocked },
+			{ "updateOfflineData", &DatabaseServer::executeUpdateOfflineData },
+		};
+
+		const auto username = pt.get<std::string>("Username");
+		const auto password = pt.get<std::string>("Password");
+		const bool transaction = pt.get<bool>("Transaction", false);
+		const auto & requests = pt.get_child("Requests");
+
+		if (requests.size() > MAX_BATCH_SIZE) {
+			response->write(SimpleWeb::StatusCode::client_error_payload_too_large);
+			return;
+		}
+
+		// all sub requests are sent by the same user, so the credentials are checked only once
+		const int userID = username.empty() ? -1 : ServerCommon::getUserID(username, password);
+
+		std::stringstream responseStream;
+		ptree responseTree;
+
+		do {
+			CONNECTTODATABASE(__LINE__)
+
+			// telemetry isn't written through this connection, so it must only be counted once the transaction is committed
+			TelemetryWriter::Deferral telemetry;
+
+			if (transaction && !database.query("START TRANSACTION;")) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+				code = SimpleWeb::StatusCode::client_error_failed_dependency;
+				break;
+			}
+
+			bool failed = false;
+
+			ptree resultNodes;
+			for (const auto & v : requests) {
+				const auto & subRequest = v.second;
+
+				ptree resultNode;
+				ptree subResponseTree;
+				SimpleWeb::StatusCode subCode;
+
+				const auto it = handlers.find(subRequest.get<std::string>("Resource", ""));
+
+				if (it == handlers.end()) {
+					subCode = SimpleWeb::StatusCode::client_error_not_found;
+				} else {
+					try {
+						subCode = (this->*it->second)(database, userID, subRequest, subResponseTree);
+					} catch (...) {
+						subCode = SimpleWeb::StatusCode::client_error_bad_request;
+					}
+				}
+
+				failed |= static_cast<int>(subCode) >= 400;
+
+				resultNode.put("Status", static_cast<int>(subCode));
+
+				if (!subResponseTree.empty()) {
+					resultNode.add_child("Response", subResponseTree);
+				}
+
+				resultNodes.push_back(std::make_pair("", resultNode));
+
+				if (failed && transaction) break; // everything is rolled back anyway
+			}
+
+			if (transaction) {
+				if (!database.query(failed ? "ROLLBACK;" : "COMMIT;")) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+					if (!failed) {
+						database.query("ROLLBACK;");
+					}
+					code = SimpleWeb::StatusCode::client_error_failed_dependency;
+					break;
+				}
+				if (failed) {
+					code = SimpleWeb::StatusCode::client_error_failed_dependency;
+				}
+			}
+
+			if (!transaction || !failed) {
+				telemetry.commit();
+			}
+
+			if (!resultNodes.empty()) {
+				responseTree.add_child("Results", resultNodes);
+			}
+		} while (false);
+
+		write_json(responseStream, responseTree);
+
+		response->write(code, responseStream.str());
+	} catch (...) {
+		response->write(SimpleWeb::StatusCode::client_error_bad_request);
+	}
+}
+
+void DatabaseServer::executeSingleRequest(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, RequestHandler handler, bool hasResponseBody) const {
+	try {
+		const std::string content = ServerCommon::convertString(request->content.string());
+
+		std::stringstream ss(content);
+
+		ptree pt;
+		read_json(ss, pt);
+
+		SimpleWeb::StatusCode code = SimpleWeb::StatusCode::success_ok;
+
+		const auto username = pt.get<std::string>("Username");
+		const auto password = pt.get<std::string>("Password");
+
+		const int userID = username.empty() ? -1 : ServerCommon::getUserID(username, password); // if userID is -1 user is not in database, so it's the play time of all unregistered players summed up
+
+		std::stringstream responseStream;
+		ptree responseTree;
+
+		do {
+			CONNECTTODATABASE(__LINE__)
+
+			code = (this->*handler)(database, userID, pt, responseTree);
+		} while (false);
+
+		if (!hasResponseBody) {
+			response->write(code);
+			return;
+		}
+
+		write_json(responseStream, responseTree);
+
+		response->write(code, responseStream.str());
+	} catch (...) {
+		response->write(SimpleWeb::StatusCode::client_error_bad_request);
+	}
+}
+
 void DatabaseServer::requestAllTri6ScoreStats(ptree & responseTree) const {
 	do {
 		MariaDBWrapper database;
@@ -6862,98 +6683,10 @@ void DatabaseServer::requestAllTri6ScoreStats(ptree & responseTree) const {
 }
 
 std::string DatabaseServer::getFileServer(int userID, int projectID, int majorVersion, int minorVersion, int patchVersion, int spineVersion) const {
-	std::vector<std::string> possibilities;
-	std::vector<std::string> patronPossibilities;
-
-	do {
-		CONNECTTODATABASE(__LINE__)
-
-		auto timestamp = time(nullptr);
-		timestamp /= 60; // minutes
-		timestamp /= 60; // hours
-		timestamp /= 24; // days
-		timestamp += 3; // shift be 3
-		timestamp %= 7; // day of the week
-		timestamp = 1 << timestamp;
-
-		if (!database.query("PREPARE selectPotentialFileserversStmt FROM \"SELECT ServerID FROM projectsOnFileservers WHERE ProjectID = ? AND MajorVersion = ? AND MinorVersion = ? AND PatchVersion = ? AND SpineVersion = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("PREPARE selectActiveFileserversStmt FROM \"SELECT Url, PatronOnly, ActiveDays FROM fileserverList WHERE ServerID = ? AND Enabled = 1 LIMIT 1\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		if (!database.query("SET @paramProjectID=" + std::to_string(projectID) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("SET @paramMajorVersion=" + std::to_string(majorVersion) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("SET @paramMinorVersion=" + std::to_string(minorVersion) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("SET @paramPatchVersion=" + std::to_string(patchVersion) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("SET @paramSpineVersion=" + std::to_string(spineVersion) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		
-		if (!database.query("EXECUTE selectPotentialFileserversStmt USING @paramProjectID, @paramMajorVersion, @paramMinorVersion, @paramPatchVersion, @paramSpineVersion;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-			break;
-		}
-		const auto lastResults = database.getResults<std::vector<std::string>>();
-
-		if (lastResults.empty()) break;
-
-		for (const auto & vec : lastResults) {
-			if (!database.query("SET @paramServerID=" + vec[0] + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-
-			if (!database.query("EXECUTE selectActiveFileserversStmt USING @paramServerID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			const auto results = database.getResults<std::vector<std::string>>();
-
-			if (results.empty()) continue;
-
-			const auto url = results[0][0];
-			const auto patronOnly = results[0][1] == "1";
-			const auto activeDays = std::stoi(results[0][2]);
-
-			if (!(activeDays & timestamp)) continue;
-
-			if (patronOnly && ServerCommon::getPatronLevel(userID) < 4) continue;
-
-			possibilities.push_back(url);
-
-			if (!patronOnly) continue;
-
-			patronPossibilities.push_back(url);
-		}
-	} while (false);
-
-	// only add default server when no other one is available
-	if (possibilities.empty()) {
-		possibilities.push_back(DEFAULTURL);
-	}
-
-	// prefer Patron only server in that case
-	if (!patronPossibilities.empty()) return patronPossibilities[std::rand() % patronPossibilities.size()];
+	const auto fileserver = FileserverCache::getFileserver(userID, projectID, majorVersion, minorVersion, patchVersion, spineVersion);
 
-	// otherwise fall back to normal selection
-	return possibilities[std::rand() % possibilities.size()];
+	// only use default server when no other one is available
+	return fileserver.empty() ? DEFAULTURL : fileserver;
 }
 
 void DatabaseServer::attachNewsData(MariaDBWrapper & database, const std::string & newsID, int language, ptree & newsNode) const {
@@ -18,101 +18,346 @@
 
 #include "DownloadSizeChecker.h"
 
+#include <algorithm>
 #include <iostream>
 
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
-#include "SpineServerConfig.h"
+#include "ServerCommon.h"
 
 #include "boost/filesystem.hpp"
 
 using namespace spine::server;
 
-uint64_t DownloadSizeChecker::getBytes(int32_t modID, const std::string & language, uint32_t version) {
-	std::lock_guard<std::mutex> lg(_lock);
-	const auto it = _cache.find(std::make_tuple(modID, language, version));
-	if (it != _cache.end()) {
-		return it->second;
-	}
-	MariaDBWrapper database;
-	if (!database.connect("localhost", DATABASEUSER, DATABASEPASSWORD, SPINEDATABASE, 0)) {
-		std::cout << "Couldn't connect to database: " << __LINE__ << " " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("PREPARE selectStmt FROM \"SELECT Path FROM modfiles WHERE ModID = ? AND (Language = ? OR Language = 'All')\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("SET @paramModID=" + std::to_string(modID) + ";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("SET @paramLanguage='" + language + "';")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("EXECUTE selectStmt USING @paramModID, @paramLanguage;")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	const auto lastResults = database.getResults<std::vector<std::string>>();
-	uint64_t bytes = 0;
-	for (const auto & vec : lastResults) {
-		std::ifstream in("/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(modID) + "/" + vec[0], std::ifstream::ate | std::ifstream::binary);
-		if (!in.good()) {
-			std::cout << "Couldn't open file: " << "/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(modID) + "/" + vec[0] << std::endl;
-			break;
+namespace {
+#ifdef TEST_CONFIG
+	const std::string MODS_PATH = "./downloads/mods/";
+#else
+	const std::string MODS_PATH = "/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/";
+#endif
+
+	uint64_t getFileSize(int32_t modID, const std::string & path) {
+		const std::string filePath = MODS_PATH + std::to_string(modID) + "/" + path;
+
+		boost::system::error_code ec;
+		const auto size = boost::filesystem::file_size(filePath, ec);
+
+		if (ec) {
+			std::cout << "Couldn't open file: " << filePath << std::endl;
+			return 0;
 		}
-		const auto size = in.tellg();
-		bytes += size;
+
+		return size;
 	}
-	_cache.insert(std::make_pair(std::make_tuple(modID, language, version), bytes));
-	return bytes;
+}
+
+constexpr size_t DownloadSizeChecker::SHARD_COUNT;
+
+DownloadSizeChecker::DownloadSizeChecker() : _pendingWarmup(false), _running(true) {
+	for (Shard & shard : _shards) {
+		shard.generation = 0;
+	}
+
+	_worker = std::thread(&DownloadSizeChecker::work, this);
+}
+
+DownloadSizeChecker::~DownloadSizeChecker() {
+	{
+		std::lock_guard<std::mutex> lg(_workerLock);
+		_running = false;
+	}
+	_workerCondition.notify_one();
+
+	_worker.join();
+}
+
+uint64_t DownloadSizeChecker::getBytes(int32_t modID, const std::string & language, uint32_t version) {
+	Shard & shard = getShard(modID);
+
+	{
+		std::lock_guard<std::mutex> lg(shard.lock);
+
+		const auto it = shard.index.projects.find(modID);
+
+		if (it != shard.index.projects.end() && it->second.version == version) return getSize(it->second, language);
+	}
+
+	// not indexed yet or the project got a new version in the meantime
+	const Index index = load(modID);
+
+	const auto it = index.projects.find(modID);
+
+	return it == index.projects.end() ? 0 : getSize(it->second, language);
 }
 
 uint64_t DownloadSizeChecker::getBytesForPackage(int32_t modID, int32_t optionalID, const std::string & language, uint32_t version) {
-	std::lock_guard<std::mutex> lg(_lock);
-	const auto it = _packageCache.find(std::make_tuple(optionalID, language, version));
-	if (it != _packageCache.end()) {
-		return it->second;
-	}
-	MariaDBWrapper database;
-	if (!database.connect("localhost", DATABASEUSER, DATABASEPASSWORD, SPINEDATABASE, 0)) {
-		std::cout << "Couldn't connect to database: " << __LINE__ << " " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("PREPARE selectStmt FROM \"SELECT Path FROM optionalpackagefiles WHERE PackageID = ? AND (Language = ? OR Language = 'All')\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("SET @paramPackageID=" + std::to_string(optionalID) + ";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("SET @paramLanguage='" + language + "';")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	if (!database.query("EXECUTE selectStmt USING @paramPackageID, @paramLanguage;")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-		return 0;
-	}
-	const auto lastResults = database.getResults<std::vector<std::string>>();
-	uint64_t bytes = 0;
-	for (const auto & vec : lastResults) {
-		std::ifstream in("/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(modID) + "/" + vec[0], std::ifstream::ate | std::ifstream::binary);
-		if (!in.good()) {
-			std::cout << "Couldn't open file: " << "/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(modID) + "/" + vec[0] << std::endl;
-			break;
+	Shard & shard = getShard(modID);
+
+	{
+		std::lock_guard<std::mutex> lg(shard.lock);
+
+		const auto it = shard.index.packages.find(optionalID);
+
+		if (it != shard.index.packages.end() && it->second.second.version == version) return getSize(it->second.second, language);
+	}
+
+	const Index index = load(modID);
+
+	const auto it = index.packages.find(optionalID);
+
+	return it == index.packages.end() ? 0 : getSize(it->second.second, language);
+}
+
+uint64_t DownloadSizeChecker::getMaxBytes(int32_t modID) {
+	Shard & shard = getShard(modID);
+
+	std::lock_guard<std::mutex> lg(shard.lock);
+
+	const auto it = shard.index.projects.find(modID);
+
+	return it == shard.index.projects.end() ? 0 : getMaxSize(it->second);
+}
+
+uint64_t DownloadSizeChecker::getMaxBytesForPackage(int32_t optionalID) {
+	// packages are sharded by their project, which isn't known here
+	for (Shard & shard : _shards) {
+		std::lock_guard<std::mutex> lg(shard.lock);
+
+		const auto it = shard.index.packages.find(optionalID);
+
+		if (it != shard.index.packages.end()) return getMaxSize(it->second.second);
+	}
+
+	return 0;
+}
+
+void DownloadSizeChecker::warmup() {
+	{
+		std::lock_guard<std::mutex> lg(_workerLock);
+		_pendingWarmup = true;
+	}
+	_workerCondition.notify_one();
+}
+
+void DownloadSizeChecker::invalidate(int32_t modID) {
+	{
+		Shard & shard = getShard(modID);
+
+		std::lock_guard<std::mutex> lg(shard.lock);
+
+		shard.generation++;
+		shard.index.projects.erase(modID);
+
+		for (auto it = shard.index.packages.begin(); it != shard.index.packages.end();) {
+			if (it->second.first == modID) {
+				it = shard.index.packages.erase(it);
+			} else {
+				++it;
+			}
 		}
-		const auto size = in.tellg();
-		bytes += size;
 	}
-	_packageCache.insert(std::make_pair(std::make_tuple(optionalID, language, version), bytes));
-	return bytes;
+
+	{
+		std::lock_guard<std::mutex> lg(_workerLock);
+		_pendingProjects.insert(modID);
+	}
+	_workerCondition.notify_one();
 }
 
 void DownloadSizeChecker::clear() {
-	std::lock_guard<std::mutex> lg(_lock);
-	_cache.clear();
-	_packageCache.clear();
+	for (Shard & shard : _shards) {
+		std::lock_guard<std::mutex> lg(shard.lock);
+
+		shard.generation++;
+		shard.index.projects.clear();
+		shard.index.packages.clear();
+	}
+
+	warmup();
+}
+
+DownloadSizeChecker::Shard & DownloadSizeChecker::getShard(int32_t modID) {
+	return _shards[static_cast<uint32_t>(modID) % SHARD_COUNT];
+}
+
+void DownloadSizeChecker::work() {
+	std::unique_lock<std::mutex> ul(_workerLock);
+
+	while (_running) {
+		_workerCondition.wait(ul, [this]() {
+			return !_running || _pendingWarmup || !_pendingProjects.empty();
+		});
+
+		if (!_running) break;
+
+		if (_pendingWarmup) {
+			// a complete index covers all single projects as well
+			_pendingWarmup = false;
+			_pendingProjects.clear();
+
+			ul.unlock();
+
+			const Index index = load(-1);
+
+			std::cout << "Indexed download sizes of " << index.projects.size() << " projects and " << index.packages.size() << " packages" << std::endl;
+
+			ul.lock();
+		} else {
+			const int32_t modID = *_pendingProjects.begin();
+			_pendingProjects.erase(_pendingProjects.begin());
+
+			ul.unlock();
+
+			load(modID);
+
+			ul.lock();
+		}
+	}
+}
+
+DownloadSizeChecker::Index DownloadSizeChecker::load(int32_t modID) {
+	std::array<uint64_t, SHARD_COUNT> generations;
+
+	for (size_t i = 0; i < SHARD_COUNT; i++) {
+		std::lock_guard<std::mutex> lg(_shards[i].lock);
+		generations[i] = _shards[i].generation;
+	}
+
+	Index index;
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		// LEFT JOIN so projects and packages without files get an entry as well and aren't loaded again on every request
+		if (modID == -1) {
+			MariaDBStatement selectProjectsStmt(database, "SELECT m.ModID, m.MajorVersion, m.MinorVersion, m.PatchVersion, m.SpineVersion, f.Path, f.Language FROM mods AS m LEFT JOIN modfiles AS f ON f.ModID = m.ModID");
+
+			if (!loadProjects(selectProjectsStmt, index)) break;
+
+			MariaDBStatement selectPackagesStmt(database, "SELECT p.ModID, p.PackageID, f.Path, f.Language FROM optionalpackages AS p LEFT JOIN optionalpackagefiles AS f ON f.PackageID = p.PackageID");
+
+			if (!loadPackages(selectPackagesStmt, index)) break;
+		} else {
+			MariaDBStatement selectProjectsStmt(database, "SELECT m.ModID, m.MajorVersion, m.MinorVersion, m.PatchVersion, m.SpineVersion, f.Path, f.Language FROM mods AS m LEFT JOIN modfiles AS f ON f.ModID = m.ModID WHERE m.ModID = ?");
+			selectProjectsStmt.bind(modID);
+
+			if (!loadProjects(selectProjectsStmt, index)) break;
+
+			MariaDBStatement selectPackagesStmt(database, "SELECT p.ModID, p.PackageID, f.Path, f.Language FROM optionalpackages AS p LEFT JOIN optionalpackagefiles AS f ON f.PackageID = p.PackageID WHERE p.ModID = ?");
+			selectPackagesStmt.bind(modID);
+
+			if (!loadPackages(selectPackagesStmt, index)) break;
+		}
+
+		for (size_t i = 0; i < SHARD_COUNT; i++) {
+			Shard & shard = _shards[i];
+
+			std::lock_guard<std::mutex> lg(shard.lock);
+
+			if (shard.generation != generations[i]) continue; // invalidated while loading, the files might have changed already
+
+			for (const auto & p : index.projects) {
+				if (&getShard(p.first) != &shard) continue;
+
+				shard.index.projects[p.first] = p.second;
+			}
+
+			for (const auto & p : index.packages) {
+				if (&getShard(p.second.first) != &shard) continue;
+
+				shard.index.packages[p.first] = p.second;
+			}
+		}
+	} while (false);
+
+	return index;
+}
+
+bool DownloadSizeChecker::loadProjects(MariaDBStatement & stmt, Index & index) {
+	if (!stmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << stmt.getLastError() << std::endl;
+		return false;
+	}
+
+	while (stmt.fetch()) {
+		const int32_t modID = stmt.getInt(0);
+
+		auto it = index.projects.find(modID);
+
+		if (it == index.projects.end()) {
+			Sizes sizes;
+			sizes.version = (static_cast<uint32_t>(stmt.getInt(1)) << 24) + (static_cast<uint32_t>(stmt.getInt(2)) << 16) + (static_cast<uint32_t>(stmt.getInt(3)) << 8) + static_cast<uint32_t>(stmt.getInt(4));
+			sizes.allLanguages = 0;
+
+			it = index.projects.insert(std::make_pair(modID, sizes)).first;
+		}
+
+		if (stmt.isNull(5)) continue;
+
+		const auto size = getFileSize(modID, stmt.getString(5).to_string());
+		const auto language = stmt.getString(6);
+
+		if (language == "All") {
+			it->second.allLanguages += size;
+		} else {
+			it->second.languages[language.to_string()] += size;
+		}
+	}
+
+	return true;
+}
+
+bool DownloadSizeChecker::loadPackages(MariaDBStatement & stmt, Index & index) {
+	if (!stmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << stmt.getLastError() << std::endl;
+		return false;
+	}
+
+	while (stmt.fetch()) {
+		const int32_t modID = stmt.getInt(0);
+		const int32_t packageID = stmt.getInt(1);
+
+		const auto projectIt = index.projects.find(modID);
+
+		if (projectIt == index.projects.end()) continue; // package of a deleted project
+
+		auto it = index.packages.find(packageID);
+
+		if (it == index.packages.end()) {
+			Sizes sizes;
+			sizes.version = projectIt->second.version; // packages are updated together with their project
+			sizes.allLanguages = 0;
+
+			it = index.packages.insert(std::make_pair(packageID, std::make_pair(modID, sizes))).first;
+		}
+
+		if (stmt.isNull(2)) continue;
+
+		const auto size = getFileSize(modID, stmt.getString(2).to_string());
+		const auto language = stmt.getString(3);
+
+		if (language == "All") {
+			it->second.second.allLanguages += size;
+		} else {
+			it->second.second.languages[language.to_string()] += size;
+		}
+	}
+
+	return true;
+}
+
+uint64_t DownloadSizeChecker::getSize(const Sizes & sizes, const std::string & language) {
+	const auto it = sizes.languages.find(language);
+
+	return sizes.allLanguages + (it == sizes.languages.end() ? 0 : it->second);
+}
+
+uint64_t DownloadSizeChecker::getMaxSize(const Sizes & sizes) {
+	uint64_t languageSize = 0;
+
+	for (const auto & p : sizes.languages) {
+		languageSize = std::max(languageSize, p.second);
+	}
+
+	return sizes.allLanguages + languageSize;
 }
@@ -18,12 +18,17 @@
 
 #include "FileSynchronizer.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <set>
 #include <thread>
 
+#include "FileserverCache.h"
+#include "FtpSession.h"
 #include "ServerCommon.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
 
 namespace {
@@ -36,7 +41,20 @@ namespace {
 
 using namespace spine::server;
 
+const std::chrono::seconds FileSynchronizer::SESSION_IDLE_TIME(60);
+const std::chrono::seconds FileSynchronizer::DISPATCH_INTERVAL(5);
+const std::chrono::hours FileSynchronizer::IDLE_INTERVAL(1);
+const std::chrono::seconds FileSynchronizer::RETRY_DELAY(30);
+const std::chrono::hours FileSynchronizer::MAX_RETRY_DELAY(1);
+
 std::mutex FileSynchronizer::lock;
+std::condition_variable FileSynchronizer::_dispatchCondition;
+std::set<int> FileSynchronizer::_claimedJobs;
+std::set<FileSynchronizer::FileKey> FileSynchronizer::_claimedFiles;
+std::map<int, FileSynchronizer::Retry> FileSynchronizer::_retries;
+std::mutex FileSynchronizer::_workLock;
+std::condition_variable FileSynchronizer::_workCondition;
+std::map<int, std::unique_ptr<FileSynchronizer::FileServer>> FileSynchronizer::_fileServers;
 
 void FileSynchronizer::init() {
 	std::thread(&FileSynchronizer::exec).detach();
@@ -70,23 +88,295 @@ void FileSynchronizer::addJob(const AddJob & job) {
 	} while (false);
 }
 
+std::map<int, FileSynchronizer::Statistics> FileSynchronizer::getStatistics() {
+	std::lock_guard<std::mutex> lg(_workLock);
+
+	std::map<int, Statistics> statistics;
+
+	for (const auto & p : _fileServers) {
+		Statistics & s = statistics[p.first];
+		s = p.second->statistics;
+		s.queued = p.second->jobs.size();
+	}
+
+	return statistics;
+}
+
+void FileSynchronizer::printStatistics() {
+	const auto statistics = getStatistics();
+
+	std::cout << "File synchronization:" << std::endl;
+
+	for (const auto & p : statistics) {
+		const Statistics & s = p.second;
+		const double megabytes = static_cast<double>(s.bytes) / (1024.0 * 1024.0);
+		const double seconds = static_cast<double>(s.transferMicroseconds) / 1000000.0;
+
+		std::cout << "	server " << p.first << ":	" << s.queued << " queued, " << s.active << " active, " << s.succeeded << " done, " << s.failed << " failed, " << std::fixed << std::setprecision(1) << megabytes << " MB uploaded (" << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s per transfer)" << std::endl;
+	}
+}
+
 void FileSynchronizer::exec() {
+	auto nextCheck = std::chrono::steady_clock::now();
+	auto nextServerUpdate = nextCheck;
+
 	while (true) {
+		auto now = std::chrono::steady_clock::now();
+
 		// 1. add jobs for all missing files on servers
-		addMissing();
+		if (now >= nextCheck) {
+			addMissing();
+			nextCheck = now + IDLE_INTERVAL;
+		}
+
+		// 2. credentials and new servers are checked once a minute, not for every job
+		if (now >= nextServerUpdate) {
+			loadFileServers();
+			nextServerUpdate = now + std::chrono::minutes(1);
+		}
+
+		// 3. hand everything that can be executed to the workers, they wake this thread up whenever they finished a job
+		std::unique_lock<std::mutex> ul(lock);
+
+		const bool pending = dispatch();
 
-		// 2. while a job is available, execute it
-		while (true) {
-			lock.lock();
-			const auto job = getFirstJobInQueue();
-			lock.unlock();
+		now = std::chrono::steady_clock::now();
+
+		_dispatchCondition.wait_until(ul, pending ? std::min(nextCheck, now + DISPATCH_INTERVAL) : nextCheck);
+	}
+}
+
+void FileSynchronizer::loadFileServers() {
+	do {
+		CONNECTTODATABASE(__LINE__)
 
-			if (!job.valid) break;
+		MariaDBStatement selectStmt(database, "SELECT ServerID, Username, Password, FtpHost, RootFolder FROM fileserverList");
 
-			executeJob(job);
+		if (!selectStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
+			break;
 		}
 
-		std::this_thread::sleep_for(std::chrono::hours(1));
+		std::lock_guard<std::mutex> lg(_workLock);
+
+		while (selectStmt.fetch()) {
+			const int serverID = selectStmt.getInt(0);
+
+			auto & fileServer = _fileServers[serverID];
+
+			const bool added = fileServer == nullptr;
+
+			if (added) {
+				fileServer.reset(new FileServer());
+				fileServer->statistics = Statistics();
+			}
+
+			fileServer->username = selectStmt.getString(1).to_string();
+			fileServer->password = selectStmt.getString(2).to_string();
+			fileServer->ftpHost = selectStmt.getString(3).to_string();
+			fileServer->rootFolder = selectStmt.getString(4).to_string();
+
+			if (!added) continue;
+
+			for (size_t i = 0; i < WORKERS_PER_SERVER; i++) {
+				std::thread(&FileSynchronizer::work, serverID).detach();
+			}
+		}
+	} while (false);
+
+	removeOrphanedJobs();
+}
+
+void FileSynchronizer::removeOrphanedJobs() {
+	std::lock_guard<std::mutex> lg(lock);
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement deleteStmt(database, "DELETE FROM fileserverSynchronizationQueue WHERE ServerID NOT IN (SELECT ServerID FROM fileserverList)");
+
+		if (!deleteStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << deleteStmt.getLastError() << std::endl;
+			break;
+		}
+
+		const uint64_t removed = deleteStmt.getAffectedRows();
+
+		if (removed > 0) {
+			std::cout << "Removed " << removed << " synchronization jobs of fileservers that don't exist anymore" << std::endl;
+		}
+	} while (false);
+}
+
+bool FileSynchronizer::dispatch() {
+	const auto now = std::chrono::steady_clock::now();
+
+	bool pending = !_claimedJobs.empty();
+	size_t dispatched = 0;
+
+	std::vector<int> serverIDs;
+
+	{
+		std::lock_guard<std::mutex> lg(_workLock);
+
+		for (const auto & p : _fileServers) {
+			if (p.second->jobs.size() < MAX_QUEUED_JOBS_PER_SERVER) {
+				serverIDs.push_back(p.first);
+			} else {
+				pending = true; // full, its remaining jobs are read once a worker took some
+			}
+		}
+	}
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		// jobs of a file always belong to a single server, so every server is read on its own and only until it is full
+		// this way the jobs waiting for a busy server aren't read again on every wake-up
+		MariaDBStatement selectStmt(database, "SELECT JobID, ProjectID, MajorVersion, MinorVersion, PatchVersion, SpineVersion, Path, Operation FROM fileserverSynchronizationQueue WHERE ServerID = ? AND JobID > ? ORDER BY JobID LIMIT " + std::to_string(CLAIM_BATCH_SIZE));
+
+		for (const int serverID : serverIDs) {
+			std::set<FileKey> blockedFiles; // files with an earlier job that can't be executed yet
+			bool full = false;
+			int lastJobID = 0;
+			size_t rows = CLAIM_BATCH_SIZE;
+
+			while (rows == CLAIM_BATCH_SIZE && !full) {
+				selectStmt.reset();
+				selectStmt.bind(serverID);
+				selectStmt.bind(lastJobID);
+
+				if (!selectStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
+					break;
+				}
+
+				rows = 0;
+
+				while (selectStmt.fetch()) {
+					rows++;
+
+					ExecuteJob job;
+					job.jobID = selectStmt.getInt(0);
+					job.serverID = serverID;
+					job.projectID = selectStmt.getInt(1);
+					job.majorVersion = selectStmt.getInt(2);
+					job.minorVersion = selectStmt.getInt(3);
+					job.patchVersion = selectStmt.getInt(4);
+					job.spineVersion = selectStmt.getInt(5);
+					job.path = selectStmt.getString(6).to_string();
+					job.operation = static_cast<Operation>(selectStmt.getInt(7));
+
+					lastJobID = job.jobID;
+
+					if (_claimedJobs.find(job.jobID) != _claimedJobs.end()) continue;
+
+					FileKey key(job.serverID, job.projectID, job.path);
+
+					// jobs of the same file have to be executed in order
+					if (_claimedFiles.find(key) != _claimedFiles.end() || blockedFiles.find(key) != blockedFiles.end()) {
+						pending = true;
+						continue;
+					}
+
+					const auto retryIt = _retries.find(job.jobID);
+
+					if (retryIt != _retries.end() && retryIt->second.nextAttempt > now) {
+						blockedFiles.insert(key);
+						pending = true;
+						continue;
+					}
+
+					std::lock_guard<std::mutex> lg(_workLock);
+
+					FileServer & fileServer = *_fileServers[serverID];
+
+					if (fileServer.jobs.size() >= MAX_QUEUED_JOBS_PER_SERVER) {
+						full = true;
+						pending = true;
+						break;
+					}
+
+					job.username = fileServer.username;
+					job.password = fileServer.password;
+					job.ftpHost = fileServer.ftpHost;
+					job.rootFolder = fileServer.rootFolder;
+					job.valid = true;
+
+					fileServer.jobs.push_back(job);
+
+					_claimedJobs.insert(job.jobID);
+					_claimedFiles.insert(key);
+
+					dispatched++;
+				}
+			}
+		}
+	} while (false);
+
+	if (dispatched > 0) {
+		_workCondition.notify_all();
+	}
+
+	return pending;
+}
+
+void FileSynchronizer::work(int serverID) {
+	std::unique_ptr<FtpSession> session;
+	std::string sessionHost;
+	std::string sessionUsername;
+	std::string sessionPassword;
+
+	while (true) {
+		ExecuteJob job;
+
+		{
+			std::unique_lock<std::mutex> ul(_workLock);
+
+			FileServer & fileServer = *_fileServers[serverID];
+
+			while (fileServer.jobs.empty()) {
+				if (!_workCondition.wait_for(ul, SESSION_IDLE_TIME, [&fileServer]() { return !fileServer.jobs.empty(); }) && session) {
+					session->close();
+				}
+			}
+
+			job = fileServer.jobs.front();
+			fileServer.jobs.pop_front();
+			fileServer.statistics.active++;
+		}
+
+		if (!session || sessionHost != job.ftpHost || sessionUsername != job.username || sessionPassword != job.password) {
+			session.reset(new FtpSession(job.ftpHost, job.username, job.password));
+			sessionHost = job.ftpHost;
+			sessionUsername = job.username;
+			sessionPassword = job.password;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+
+		const bool success = executeJob(*session, job);
+
+		const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+		{
+			std::lock_guard<std::mutex> lg(_workLock);
+
+			Statistics & statistics = _fileServers[serverID]->statistics;
+			statistics.active--;
+			statistics.transferMicroseconds += static_cast<uint64_t>(duration.count());
+
+			if (success) {
+				statistics.succeeded++;
+			} else {
+				statistics.failed++;
+			}
+		}
+
+		if (success) {
+			finishJob(job);
+		} else {
+			retryJob(job);
+		}
 	}
 }
 
@@ -281,36 +571,28 @@ void FileSynchronizer::addMissing() {
 	} while (false);
 }
 
-void FileSynchronizer::executeJob(const ExecuteJob & job) {
+bool FileSynchronizer::executeJob(FtpSession & session, const ExecuteJob & job) {
+	const std::string localPath = PATH_PREFIX + "/" + std::to_string(job.projectID) + "/" + job.path;
+	const std::string remotePath = job.rootFolder + std::to_string(job.projectID) + "/" + job.path;
+
 	switch (job.operation) {
 	case Operation::Add:
 	case Operation::Update: {
-		const auto cmd = "curl --ftp-create-dirs -Q \'SITE UMASK 022\' -T \"" + PATH_PREFIX + "/" + std::to_string(job.projectID) + "/" + job.path + "\" \"ftp://" + job.username + ":" + job.password + "@" + job.ftpHost + "/" + job.rootFolder + std::to_string(job.projectID) + "/" + job.path + "\"";
+		const int serverID = job.serverID;
 
-		const auto result = system(cmd.c_str());
-
-		if (result) {
-			std::cout << "Update command: " << cmd << std::endl;
-			std::cout << "Update result: " << result << std::endl;
+		if (!session.upload(localPath, remotePath, [serverID](size_t bytes) { throttle(serverID, bytes); })) {
+			std::cout << "Update of " << remotePath << " on " << job.ftpHost << " failed: " << session.getLastError() << std::endl;
+			return false;
 		}
-
-		if (result) return;
-			
+		
 		break;
 	}
 	case Operation::Delete: {
-		const auto cmd = "curl -v -u " + job.username + ":" + job.password + " ftp://" + job.ftpHost + " -Q \'DELE " + job.rootFolder + std::to_string(job.projectID) + "/" + job.path + "\'";
-
-			
-		const auto result = system(cmd.c_str());
-
-		if (result) {
-			std::cout << "Delete command: " << cmd << std::endl;
-			std::cout << "Delete result: " << result << std::endl;
+		if (!session.remove(remotePath)) {
+			std::cout << "Delete of " << remotePath << " on " << job.ftpHost << " failed: " << session.getLastError() << std::endl;
+			return false;
 		}
-
-		if (result) return;
-			
+		
 		break;
 	}
 	case Operation::RaiseVersion: {
@@ -318,7 +600,7 @@ void FileSynchronizer::executeJob(const ExecuteJob & job) {
 	}
 	}
 
-	finishJob(job);
+	return true;
 }
 
 void FileSynchronizer::finishJob(const ExecuteJob & job) {
@@ -343,6 +625,55 @@ void FileSynchronizer::finishJob(const ExecuteJob & job) {
 
 		updateFileserver(job);
 	} while (false);
+
+	_claimedJobs.erase(job.jobID);
+	_claimedFiles.erase(FileKey(job.serverID, job.projectID, job.path));
+	_retries.erase(job.jobID);
+
+	_dispatchCondition.notify_one();
+}
+
+void FileSynchronizer::retryJob(const ExecuteJob & job) {
+	std::lock_guard<std::mutex> lg(lock);
+
+	Retry & retry = _retries[job.jobID];
+	retry.attempts++;
+
+	auto delay = std::chrono::duration_cast<std::chrono::seconds>(MAX_RETRY_DELAY);
+
+	if (retry.attempts < 8) {
+		delay = std::min(delay, RETRY_DELAY * (1 << (retry.attempts - 1)));
+	}
+
+	retry.nextAttempt = std::chrono::steady_clock::now() + delay;
+
+	_claimedJobs.erase(job.jobID);
+	_claimedFiles.erase(FileKey(job.serverID, job.projectID, job.path));
+
+	_dispatchCondition.notify_one();
+}
+
+void FileSynchronizer::throttle(int serverID, size_t bytes) {
+	const auto now = std::chrono::steady_clock::now();
+
+	std::chrono::steady_clock::time_point sendTime;
+
+	{
+		std::lock_guard<std::mutex> lg(_workLock);
+
+		FileServer & fileServer = *_fileServers[serverID];
+
+		// unused bandwidth can only be saved up for one second
+		fileServer.throttle = std::max(fileServer.throttle, now - std::chrono::seconds(1));
+		fileServer.throttle += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::microseconds(bytes * 1000000 / MAX_BYTES_PER_SECOND_PER_SERVER));
+		fileServer.statistics.bytes += bytes;
+
+		sendTime = fileServer.throttle;
+	}
+
+	if (sendTime > now) {
+		std::this_thread::sleep_until(sendTime);
+	}
 }
 
 void FileSynchronizer::updateFileserver(const ExecuteJob & job) {
@@ -402,80 +733,12 @@ void FileSynchronizer::updateFileserver(const ExecuteJob & job) {
 			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
 			break;
 		}
-	} while (false);
-}
-
-FileSynchronizer::ExecuteJob FileSynchronizer::getFirstJobInQueue() {
-	ExecuteJob job;
-	job.valid = false;
-	
-	do {
-		CONNECTTODATABASE(__LINE__)
-
-		if (!database.query("PREPARE selectStmt FROM \"SELECT JobID, ServerID, ProjectID, MajorVersion, MinorVersion, PatchVersion, SpineVersion, Path, Operation FROM fileserverSynchronizationQueue ORDER BY JobID LIMIT 1\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		if (!database.query("PREPARE selectServerDetailsStmt FROM \"SELECT Username, Password, FtpHost, RootFolder FROM fileserverList WHERE ServerID = ? LIMIT 1\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		if (!database.query("EXECUTE selectStmt;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		auto results = database.getResults<std::vector<std::string>>();
-
-		if (results.empty()) break;
-
-		auto vec = results[0];
-
-		job.jobID = std::stoi(vec[0]);
-		job.serverID = std::stoi(vec[1]);
-		job.projectID = std::stoi(vec[2]);
-		job.majorVersion = std::stoi(vec[3]);
-		job.minorVersion = std::stoi(vec[4]);
-		job.patchVersion = std::stoi(vec[5]);
-		job.spineVersion = std::stoi(vec[6]);
-		job.path = vec[7];
-		job.operation = static_cast<Operation>(std::stoi(vec[8]));
-
-		if (!database.query("SET @paramServerID=" + std::to_string(job.serverID) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		if (!database.query("EXECUTE selectServerDetailsStmt USING @paramServerID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-
-		results = database.getResults<std::vector<std::string>>();
 
-		if (results.empty()) break;
-
-		vec = results[0];
-
-		job.username = vec[0];
-		job.password = vec[1];
-		job.ftpHost = vec[2];
-		job.rootFolder = vec[3];
-
-		job.valid = true;
+		FileserverCache::invalidate();
 	} while (false);
-
-	return job;
 }
 
 void FileSynchronizer::addJob(const AddForServerJob & job) {
-	const auto firstJob = getFirstJobInQueue(); // might be processed right now
-
-	const bool add = !firstJob.valid; // in this case there is nothing to update anyway, so always add
-	bool update = firstJob.valid && (firstJob.serverID != job.serverID || firstJob.projectID != job.projectID || firstJob.path != job.path); // in this case we can update the file in theory, but we need to check whether a job for it is queued at all
-	
 	do {
 		CONNECTTODATABASE(__LINE__)
 
@@ -518,18 +781,11 @@ void FileSynchronizer::addJob(const AddForServerJob & job) {
 		for (const auto & vec : results) {
 			if (vec[1] != job.path) continue;
 
-			jobID = std::stoi(vec[0]);
-
-			break;
-		}
-
-		if (results.empty() || add || (!update && results.size() == 1) || jobID == -1) {
-			update = false;
-		} else {
-			update = true;
+			jobID = std::max(jobID, std::stoi(vec[0]));
 		}
 
-		if (update) {
+		// a claimed job might be processed right now, so the file needs a new job to be synchronized again afterwards
+		if (jobID != -1 && _claimedJobs.find(jobID) == _claimedJobs.end()) {
 			updateJob(job, jobID);
 			break;
 		}
@@ -563,7 +819,11 @@ void FileSynchronizer::addJob(const AddForServerJob & job) {
 			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
 			break;
 		}
+
+		FileserverCache::invalidate(); // the project isn't available on this server anymore until the job is done
 	} while (false);
+
+	_dispatchCondition.notify_one();
 }
 
 void FileSynchronizer::updateJob(const AddForServerJob & job, int jobID) {
@@ -0,0 +1,270 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "FileserverCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <random>
+
+#include "MariaDBStatement.h"
+#include "MariaDBWrapper.h"
+#include "ServerCommon.h"
+
+using namespace spine::server;
+
+const std::chrono::minutes FileserverCache::REFRESH_INTERVAL(5);
+const std::chrono::minutes FileserverCache::LOAD_HALF_LIFE(60);
+
+std::mutex FileserverCache::_lock;
+std::mutex FileserverCache::_loadLock;
+std::shared_ptr<const FileserverCache::Topology> FileserverCache::_topology;
+uint64_t FileserverCache::_generation = 0;
+uint64_t FileserverCache::_loadedGeneration = 0;
+std::chrono::steady_clock::time_point FileserverCache::_expiry;
+std::map<std::string, int> FileserverCache::_serverIDs;
+std::map<int, FileserverCache::Load> FileserverCache::_loads;
+
+std::string FileserverCache::getFileserver(int userID, int projectID, int majorVersion, int minorVersion, int patchVersion, int spineVersion) {
+	const auto topology = getTopology();
+
+	if (!topology) return "";
+
+	const auto it = topology->projects.find(projectID);
+
+	if (it == topology->projects.end()) return "";
+
+	auto timestamp = time(nullptr);
+	timestamp /= 60; // minutes
+	timestamp /= 60; // hours
+	timestamp /= 24; // days
+	timestamp += 3; // shift be 3
+	timestamp %= 7; // day of the week
+	timestamp = 1 << timestamp;
+
+	std::vector<size_t> possibilities;
+	std::vector<size_t> patronPossibilities;
+
+	int patronLevel = -1;
+
+	for (const Placement & placement : it->second) {
+		if (placement.majorVersion != majorVersion || placement.minorVersion != minorVersion || placement.patchVersion != patchVersion || placement.spineVersion != spineVersion) continue;
+
+		const Mirror & mirror = topology->mirrors[placement.mirror];
+
+		if (!(mirror.activeDays & timestamp)) continue;
+
+		if (mirror.patronOnly) {
+			if (patronLevel == -1) {
+				patronLevel = ServerCommon::getPatronLevel(userID);
+			}
+			if (patronLevel < 4) continue;
+
+			patronPossibilities.push_back(placement.mirror);
+		}
+
+		possibilities.push_back(placement.mirror);
+	}
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	// prefer Patron only server in that case
+	const Mirror * mirror = pick(*topology, patronPossibilities.empty() ? possibilities : patronPossibilities);
+
+	return mirror ? mirror->url : "";
+}
+
+void FileserverCache::invalidate() {
+	std::lock_guard<std::mutex> lg(_lock);
+	_generation++;
+}
+
+void FileserverCache::addServedBytes(const std::string & url, uint64_t bytes) {
+	const auto now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	const auto it = _serverIDs.find(url);
+
+	if (it == _serverIDs.end()) return;
+
+	Load & load = _loads[it->second];
+	load.bytes = getLoad(it->second, now) + static_cast<double>(bytes);
+	load.updated = now;
+}
+
+std::shared_ptr<const FileserverCache::Topology> FileserverCache::getTopology() {
+	std::shared_ptr<const Topology> current;
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		if (_topology && _loadedGeneration == _generation && std::chrono::steady_clock::now() < _expiry) return _topology;
+
+		current = _topology;
+	}
+
+	std::unique_lock<std::mutex> loadGuard(_loadLock, std::defer_lock);
+
+	if (!current) {
+		loadGuard.lock();
+	} else if (!loadGuard.try_lock()) {
+		return current; // somebody else is loading already, the old topology is good enough until then
+	}
+
+	uint64_t generation;
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		// loaded while waiting for _loadLock
+		if (_topology && _loadedGeneration == _generation && std::chrono::steady_clock::now() < _expiry) return _topology;
+
+		generation = _generation;
+	}
+
+	const auto topology = load();
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	if (!topology) return _topology; // keep the last known state if the database isn't available
+
+	_topology = topology;
+	_loadedGeneration = generation;
+	_expiry = std::chrono::steady_clock::now() + REFRESH_INTERVAL;
+
+	_serverIDs.clear();
+
+	for (const Mirror & mirror : topology->mirrors) {
+		_serverIDs[mirror.url] = mirror.serverID;
+	}
+
+	// loads of removed mirrors are never read again
+	for (auto it = _loads.begin(); it != _loads.end();) {
+		const bool known = std::any_of(topology->mirrors.begin(), topology->mirrors.end(), [&it](const Mirror & mirror) {
+			return mirror.serverID == it->first;
+		});
+
+		if (known) {
+			++it;
+		} else {
+			it = _loads.erase(it);
+		}
+	}
+
+	return _topology;
+}
+
+std::shared_ptr<const FileserverCache::Topology> FileserverCache::load() {
+	auto topology = std::make_shared<Topology>();
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement selectFileserversStmt(database, "SELECT ServerID, Url, PatronOnly, ActiveDays, Capacity FROM fileserverList WHERE Enabled = 1");
+
+		if (!selectFileserversStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectFileserversStmt.getLastError() << std::endl;
+			return nullptr;
+		}
+
+		std::map<int, size_t> mirrorIndices;
+
+		while (selectFileserversStmt.fetch()) {
+			Mirror mirror;
+			mirror.serverID = selectFileserversStmt.getInt(0);
+			mirror.url = selectFileserversStmt.getString(1).to_string();
+			mirror.patronOnly = selectFileserversStmt.getInt(2) == 1;
+			mirror.activeDays = selectFileserversStmt.getInt(3);
+			mirror.capacity = static_cast<uint32_t>(std::max(selectFileserversStmt.getInt(4), 0));
+
+			mirrorIndices[mirror.serverID] = topology->mirrors.size();
+			topology->mirrors.push_back(mirror);
+		}
+
+		MariaDBStatement selectProjectsStmt(database, "SELECT ServerID, ProjectID, MajorVersion, MinorVersion, PatchVersion, SpineVersion FROM projectsOnFileservers");
+
+		if (!selectProjectsStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectProjectsStmt.getLastError() << std::endl;
+			return nullptr;
+		}
+
+		while (selectProjectsStmt.fetch()) {
+			const auto it = mirrorIndices.find(selectProjectsStmt.getInt(0));
+
+			if (it == mirrorIndices.end()) continue; // disabled
+
+			Placement placement;
+			placement.mirror = it->second;
+			placement.majorVersion = selectProjectsStmt.getInt(2);
+			placement.minorVersion = selectProjectsStmt.getInt(3);
+			placement.patchVersion = selectProjectsStmt.getInt(4);
+			placement.spineVersion = selectProjectsStmt.getInt(5);
+
+			topology->projects[selectProjectsStmt.getInt(1)].push_back(placement);
+		}
+
+		return topology;
+	} while (false);
+
+	return nullptr;
+}
+
+double FileserverCache::getLoad(int serverID, std::chrono::steady_clock::time_point now) {
+	const auto it = _loads.find(serverID);
+
+	if (it == _loads.end()) return 0.0;
+
+	const double halfLives = std::chrono::duration<double>(now - it->second.updated).count() / std::chrono::duration<double>(LOAD_HALF_LIFE).count();
+
+	return it->second.bytes * std::exp2(-halfLives);
+}
+
+const FileserverCache::Mirror * FileserverCache::pick(const Topology & topology, const std::vector<size_t> & candidates) {
+	if (candidates.empty()) return nullptr;
+
+	if (candidates.size() == 1) return &topology.mirrors[candidates[0]];
+
+	static std::mt19937 generator{ std::random_device()() };
+
+	const auto now = std::chrono::steady_clock::now();
+
+	std::vector<double> weights;
+	weights.reserve(candidates.size());
+
+	double totalWeight = 0.0;
+
+	for (const size_t index : candidates) {
+		const Mirror & mirror = topology.mirrors[index];
+		const double capacity = static_cast<double>(mirror.capacity);
+
+		// a mirror that served a lot in relation to its capacity recently gets a smaller share until its load decayed again
+		const double weight = capacity > 0.0 ? capacity / (1.0 + getLoad(mirror.serverID, now) / (capacity * LOAD_UNIT)) : 0.0;
+
+		weights.push_back(weight);
+		totalWeight += weight;
+	}
+
+	if (totalWeight <= 0.0) return &topology.mirrors[candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(generator)]];
+
+	std::discrete_distribution<size_t> distribution(weights.begin(), weights.end());
+
+	return &topology.mirrors[candidates[distribution(generator)]];
+}
@@ -0,0 +1,394 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "FtpSession.h"
+
+#include <fstream>
+#include <vector>
+
+#include "boost/asio/connect.hpp"
+#include "boost/asio/read_until.hpp"
+#include "boost/asio/write.hpp"
+
+using namespace spine::server;
+
+namespace {
+	const boost::posix_time::seconds TIMEOUT(60);
+	constexpr size_t BLOCK_SIZE = 64 * 1024;
+}
+
+FtpSession::FtpSession(const std::string & host, const std::string & username, const std::string & password) : _host(host), _port(21), _username(username), _password(password), _deadline(_ioService), _control(_ioService), _data(_ioService) {
+	const auto colon = _host.rfind(':');
+
+	if (colon != std::string::npos) {
+		try {
+			_port = static_cast<uint16_t>(std::stoi(_host.substr(colon + 1)));
+			_host = _host.substr(0, colon);
+		} catch (...) {
+			// no port, keep the default one
+		}
+	}
+
+	_deadline.expires_at(boost::posix_time::pos_infin);
+	checkDeadline();
+}
+
+bool FtpSession::upload(const std::string & localPath, const std::string & remotePath, const ProgressCallback & progress) {
+	std::ifstream in(localPath, std::ios::binary);
+
+	if (!in.good()) {
+		_lastError = "can't open " + localPath;
+		return false;
+	}
+
+	if (!ensureConnected()) return false;
+
+	if (!createDirectories(remotePath)) return false;
+
+	if (!openDataConnection()) return false;
+
+	int code = command("STOR " + remotePath);
+
+	if (code != 125 && code != 150) {
+		boost::system::error_code ec;
+		_data.close(ec);
+		return false;
+	}
+
+	std::vector<char> buffer(BLOCK_SIZE);
+	bool sent = true;
+
+	while (in) {
+		in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+		const auto count = static_cast<size_t>(in.gcount());
+
+		if (count == 0) break;
+
+		if (!write(_data, buffer.data(), count)) {
+			sent = false;
+			break;
+		}
+
+		if (progress) {
+			progress(count);
+		}
+	}
+
+	boost::system::error_code ec;
+	_data.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec); // closing the data connection marks the end of the file
+	_data.close(ec);
+
+	if (!sent) {
+		close(); // the server might still wait for the rest of the file, so the control connection is in an unknown state
+		return false;
+	}
+
+	code = readReply(nullptr);
+
+	return code == 226 || code == 250;
+}
+
+bool FtpSession::remove(const std::string & remotePath) {
+	if (!ensureConnected()) return false;
+
+	const int code = command("DELE " + remotePath);
+
+	// 550 means the file doesn't exist (anymore), so there is nothing left to do
+	return code == 250 || code == 550;
+}
+
+void FtpSession::close() {
+	boost::system::error_code ec;
+	_data.close(ec);
+	_control.close(ec);
+
+	_controlBuffer.consume(_controlBuffer.size());
+	_knownDirectories.clear();
+}
+
+bool FtpSession::ensureConnected() {
+	if (_control.is_open()) {
+		if (command("NOOP") == 200) return true;
+
+		close();
+	}
+
+	return connect();
+}
+
+bool FtpSession::connect() {
+	close();
+
+	boost::system::error_code ec;
+
+	boost::asio::ip::tcp::resolver resolver(_ioService);
+	auto it = resolver.resolve(boost::asio::ip::tcp::resolver::query(_host, std::to_string(_port)), ec);
+
+	if (ec) {
+		_lastError = "can't resolve " + _host + ": " + ec.message();
+		return false;
+	}
+
+	bool connected = false;
+
+	for (; it != boost::asio::ip::tcp::resolver::iterator(); ++it) {
+		if (connectSocket(_control, *it)) {
+			connected = true;
+			break;
+		}
+	}
+
+	if (!connected) return false;
+
+	if (readReply(nullptr) != 220) {
+		close();
+		return false;
+	}
+
+	int code = command("USER " + _username);
+
+	if (code == 331) {
+		code = command("PASS " + _password);
+	}
+
+	if (code != 230) {
+		close();
+		return false;
+	}
+
+	if (command("TYPE I") != 200) {
+		close();
+		return false;
+	}
+
+	command("SITE UMASK 022"); // not supported by every server, files are readable anyway in that case
+
+	return true;
+}
+
+int FtpSession::command(const std::string & cmd, std::string * reply) {
+	const std::string line = cmd + "\r\n";
+
+	if (!write(_control, line.data(), line.size())) {
+		close();
+		return 0;
+	}
+
+	return readReply(reply);
+}
+
+int FtpSession::readReply(std::string * reply) {
+	std::string line;
+
+	if (!readLine(line) || line.size() < 3) {
+		close();
+		return 0;
+	}
+
+	int code = 0;
+
+	try {
+		code = std::stoi(line.substr(0, 3));
+	} catch (...) {
+		_lastError = "invalid reply: " + line;
+		close();
+		return 0;
+	}
+
+	// multi line replies end with the code followed by a space
+	if (line.size() > 3 && line[3] == '-') {
+		const std::string end = line.substr(0, 3) + " ";
+
+		do {
+			if (!readLine(line)) {
+				close();
+				return 0;
+			}
+		} while (line.compare(0, end.size(), end) != 0);
+	}
+
+	if (code >= 400) {
+		_lastError = line;
+	}
+
+	if (reply) {
+		*reply = line;
+	}
+
+	return code;
+}
+
+bool FtpSession::openDataConnection() {
+	boost::system::error_code ec;
+	const auto address = _control.remote_endpoint(ec).address();
+
+	if (ec) {
+		_lastError = ec.message();
+		close();
+		return false;
+	}
+
+	std::string reply;
+	uint16_t port = 0;
+
+	// the host part of a PASV reply is ignored on purpose, servers behind NAT often report their internal address
+	try {
+		if (command("EPSV", &reply) == 229) {
+			const auto start = reply.find("(|||");
+			const auto end = reply.find("|)", start);
+
+			if (start != std::string::npos && end != std::string::npos) {
+				port = static_cast<uint16_t>(std::stoi(reply.substr(start + 4, end - start - 4)));
+			}
+		} else if (_control.is_open() && command("PASV", &reply) == 227) {
+			const auto start = reply.find('(');
+			const auto end = reply.find(')', start);
+
+			if (start != std::string::npos && end != std::string::npos) {
+				std::vector<int> values;
+				std::string value;
+
+				for (const char c : reply.substr(start + 1, end - start - 1)) {
+					if (c == ',') {
+						values.push_back(std::stoi(value));
+						value.clear();
+					} else {
+						value.push_back(c);
+					}
+				}
+
+				values.push_back(std::stoi(value));
+
+				if (values.size() == 6) {
+					port = static_cast<uint16_t>((values[4] << 8) + values[5]);
+				}
+			}
+		}
+	} catch (...) {
+		port = 0; // malformed reply
+	}
+
+	if (port == 0) {
+		if (_lastError.empty()) {
+			_lastError = "passive mode not available: " + reply;
+		}
+		return false;
+	}
+
+	return connectSocket(_data, boost::asio::ip::tcp::endpoint(address, port));
+}
+
+bool FtpSession::createDirectories(const std::string & remotePath) {
+	size_t pos = remotePath.find('/');
+
+	while (pos != std::string::npos) {
+		const std::string directory = remotePath.substr(0, pos);
+
+		if (!directory.empty() && _knownDirectories.find(directory) == _knownDirectories.end()) {
+			const int code = command("MKD " + directory);
+
+			// 550 is also returned if the directory exists already, if it is a real error STOR will fail
+			if (code != 257 && code != 550) return false;
+
+			_knownDirectories.insert(directory);
+		}
+
+		pos = remotePath.find('/', pos + 1);
+	}
+
+	return true;
+}
+
+bool FtpSession::connectSocket(boost::asio::ip::tcp::socket & socket, const boost::asio::ip::tcp::endpoint & endpoint) {
+	boost::system::error_code ec;
+	socket.close(ec);
+
+	ec = boost::asio::error::would_block;
+
+	socket.async_connect(endpoint, [&ec](const boost::system::error_code & error) {
+		ec = error;
+	});
+
+	if (!wait(ec) || !socket.is_open()) {
+		_lastError = "can't connect to " + _host + ": " + _lastError;
+		socket.close(ec);
+		return false;
+	}
+
+	return true;
+}
+
+bool FtpSession::readLine(std::string & line) {
+	boost::system::error_code ec = boost::asio::error::would_block;
+
+	boost::asio::async_read_until(_control, _controlBuffer, "\r\n", [&ec](const boost::system::error_code & error, size_t) {
+		ec = error;
+	});
+
+	if (!wait(ec)) return false;
+
+	std::istream is(&_controlBuffer);
+	std::getline(is, line);
+
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+
+	return true;
+}
+
+bool FtpSession::write(boost::asio::ip::tcp::socket & socket, const char * data, size_t size) {
+	boost::system::error_code ec = boost::asio::error::would_block;
+
+	boost::asio::async_write(socket, boost::asio::buffer(data, size), [&ec](const boost::system::error_code & error, size_t) {
+		ec = error;
+	});
+
+	return wait(ec);
+}
+
+bool FtpSession::wait(boost::system::error_code & ec) {
+	_deadline.expires_from_now(TIMEOUT);
+
+	do {
+		_ioService.run_one();
+	} while (ec == boost::asio::error::would_block);
+
+	_deadline.expires_at(boost::posix_time::pos_infin);
+
+	if (ec) {
+		_lastError = ec == boost::asio::error::operation_aborted ? "timeout" : ec.message();
+		return false;
+	}
+
+	return true;
+}
+
+void FtpSession::checkDeadline() {
+	if (_deadline.expires_at() <= boost::asio::deadline_timer::traits_type::now()) {
+		// aborts the running operation, the session connects again with the next call
+		boost::system::error_code ec;
+		_control.close(ec);
+		_data.close(ec);
+
+		_deadline.expires_at(boost::posix_time::pos_infin);
+	}
+
+	_deadline.async_wait(std::bind(&FtpSession::checkDeadline, this));
+}
@@ -0,0 +1,160 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "JsonWriter.h"
+
+#include <cstdio>
+
+using namespace spine::server;
+
+JsonWriter::JsonWriter() {
+	_buffer.reserve(4096);
+}
+
+void JsonWriter::startObject() {
+	writeSeparator();
+	_buffer.push_back('{');
+	_emptyScopes.push_back(true);
+}
+
+void JsonWriter::startObject(boost::string_ref key) {
+	writeKey(key);
+	_buffer.push_back('{');
+	_emptyScopes.push_back(true);
+}
+
+void JsonWriter::endObject() {
+	_buffer.push_back('}');
+	_emptyScopes.pop_back();
+
+	if (_emptyScopes.empty()) {
+		_buffer.push_back('\n'); // write_json finishes with a newline, too
+	}
+}
+
+void JsonWriter::startArray(boost::string_ref key) {
+	writeKey(key);
+	_buffer.push_back('[');
+	_emptyScopes.push_back(true);
+}
+
+void JsonWriter::endArray() {
+	_buffer.push_back(']');
+	_emptyScopes.pop_back();
+}
+
+void JsonWriter::add(boost::string_ref key, boost::string_ref value) {
+	writeKey(key);
+	writeString(value);
+}
+
+void JsonWriter::add(boost::string_ref value) {
+	writeSeparator();
+	writeString(value);
+}
+
+void JsonWriter::writeSeparator() {
+	if (_emptyScopes.empty()) return;
+
+	if (_emptyScopes.back()) {
+		_emptyScopes.back() = false;
+	} else {
+		_buffer.push_back(',');
+	}
+}
+
+void JsonWriter::writeKey(boost::string_ref key) {
+	writeSeparator();
+	writeString(key);
+	_buffer.push_back(':');
+}
+
+void JsonWriter::writeString(boost::string_ref str) {
+	_buffer.push_back('"');
+
+	const char * begin = str.data();
+	const char * const end = str.data() + str.size();
+
+	for (const char * current = begin; current != end; ++current) {
+		const unsigned char c = static_cast<unsigned char>(*current);
+
+		// same set of characters write_json keeps as they are
+		if (c == 0x20 || c == 0x21 || (c >= 0x23 && c <= 0x2E) || (c >= 0x30 && c <= 0x5B) || c >= 0x5D) continue;
+
+		_buffer.append(begin, current);
+		begin = current + 1;
+
+		switch (c) {
+		case '\b': {
+			_buffer.append("\\b");
+			break;
+		}
+		case '\f': {
+			_buffer.append("\\f");
+			break;
+		}
+		case '\n': {
+			_buffer.append("\\n");
+			break;
+		}
+		case '\r': {
+			_buffer.append("\\r");
+			break;
+		}
+		case '\t': {
+			_buffer.append("\\t");
+			break;
+		}
+		case '/': {
+			_buffer.append("\\/");
+			break;
+		}
+		case '"': {
+			_buffer.append("\\\"");
+			break;
+		}
+		case '\\': {
+			_buffer.append("\\\\");
+			break;
+		}
+		default: {
+			char escaped[7];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04X", c);
+			_buffer.append(escaped, 6);
+			break;
+		}
+		}
+	}
+
+	_buffer.append(begin, end);
+	_buffer.push_back('"');
+}
+
+void JsonWriter::writeArithmetic(bool value) {
+	_buffer.append(value ? "\"true\"" : "\"false\"");
+}
+
+void JsonWriter::writeArithmetic(double value) {
+	// precision used by the stream translator of ptree
+	char buffer[32];
+	const int length = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+
+	_buffer.push_back('"');
+	_buffer.append(buffer, static_cast<size_t>(length));
+	_buffer.push_back('"');
+}
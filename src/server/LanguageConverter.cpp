@@ -26,24 +26,28 @@ using namespace spine::common;
 using namespace spine::server;
 
 std::string LanguageConverter::convert(Language language) {
-	static std::map<Language, std::string> languageStrings = {
+	static const std::map<Language, std::string> languageStrings = {
 		{ Language::German, "Deutsch" },
 		{ Language::English, "English" },
 		{ Language::Polish, "Polish" },
 		{ Language::Russian, "Russian" },
 	};
 
-	return languageStrings[language];
+	const auto it = languageStrings.find(language);
+
+	return it == languageStrings.end() ? std::string() : it->second;
 }
 
 Language LanguageConverter::convert(const std::string & language) {
-	static std::map<std::string, Language> languageStrings = {
+	static const std::map<std::string, Language> languageStrings = {
 		{ "Deutsch", Language::German },
 		{ "English", Language::English },
 		{ "Polish", Language::Polish },
 		{ "Russian", Language::Russian },
 	};
 
-	return languageStrings[language];
+	const auto it = languageStrings.find(language);
+
+	return it == languageStrings.end() ? Language::None : it->second;
 }
 
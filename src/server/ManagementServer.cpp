@@ -18,9 +18,12 @@
 
 #include "ManagementServer.h"
 
+#include "DownloadSizeChecker.h"
 #include "FileSynchronizer.h"
 #include "LanguageConverter.h"
 #include "MariaDBWrapper.h"
+#include "ProjectCatalog.h"
+#include "ResponseCache.h"
 #include "ServerCommon.h"
 #include "SpineServerConfig.h"
 
@@ -37,7 +40,7 @@ using namespace boost::property_tree;
 using namespace spine::common;
 using namespace spine::server;
 
-ManagementServer::ManagementServer() : _server(nullptr), _runner(nullptr) {
+ManagementServer::ManagementServer(DownloadSizeChecker * downloadSizeChecker) : _server(nullptr), _runner(nullptr), _downloadSizeChecker(downloadSizeChecker) {
 }
 
 ManagementServer::~ManagementServer() {
@@ -912,6 +915,10 @@ void ManagementServer::updateGeneralConfiguration(std::shared_ptr<HttpsServer::R
 			}
 		} while (false);
 
+		ProjectCatalog::invalidate();
+		ResponseCache::invalidate(ResponseCache::Endpoint::AllProjects);
+		ResponseCache::invalidate(ResponseCache::Endpoint::AllNews); // new projects and updates are announced in the news ticker
+
 		response->write(code);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
@@ -1312,6 +1319,11 @@ void ManagementServer::updateModVersion(std::shared_ptr<HttpsServer::Response> r
 			}
 		} while (false);
 
+		_downloadSizeChecker->invalidate(projectID);
+		ProjectCatalog::invalidate();
+		ResponseCache::invalidate(ResponseCache::Endpoint::AllProjects);
+		ResponseCache::invalidate(ResponseCache::Endpoint::AllNews); // new projects and updates are announced in the news ticker
+
 		response->write(code);
 	} catch (...) {
 		response->write(SimpleWeb::StatusCode::client_error_bad_request);
@@ -0,0 +1,185 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "MariaDBConnectionPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace spine::server;
+
+namespace {
+	// DatabaseServer and ManagementServer run 16 threads each and handlers sometimes hold a second connection to the same database (e.g. ServerCommon::hasPrivilege)
+	constexpr size_t MAX_CONNECTIONS_PER_DATABASE = 64;
+	constexpr std::chrono::seconds ACQUIRE_TIMEOUT(10);
+	constexpr std::chrono::seconds HEALTH_CHECK_INTERVAL(60);
+}
+
+std::mutex MariaDBConnectionPool::_lock;
+std::condition_variable MariaDBConnectionPool::_released;
+std::map<std::string, MariaDBConnectionPool::Pool> MariaDBConnectionPool::_pools;
+MariaDBConnectionPool::Statistics MariaDBConnectionPool::_statistics = {};
+
+MariaDBConnectionPool::Connection * MariaDBConnectionPool::acquire(const std::string & host, const std::string & user, const std::string & password, const std::string & database, uint16_t port) {
+	const std::string key = host + "|" + user + "|" + database + "|" + std::to_string(port);
+
+	Connection * connection = nullptr;
+
+	{
+		std::unique_lock<std::mutex> ul(_lock);
+		_statistics.acquisitions++;
+
+		Pool & pool = _pools[key];
+
+		if (pool.idle.empty() && pool.open >= MAX_CONNECTIONS_PER_DATABASE) {
+			_statistics.waits++;
+
+			const auto waitStart = std::chrono::steady_clock::now();
+			const bool available = _released.wait_for(ul, ACQUIRE_TIMEOUT, [&pool]() {
+				return !pool.idle.empty() || pool.open < MAX_CONNECTIONS_PER_DATABASE;
+			});
+			const auto waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart).count());
+
+			_statistics.totalWaitMicroseconds += waited;
+			_statistics.maxWaitMicroseconds = std::max(_statistics.maxWaitMicroseconds, waited);
+
+			if (!available) {
+				_statistics.exhausted++;
+				std::cout << "Connection pool exhausted for database " << database << std::endl;
+				return nullptr;
+			}
+		}
+
+		if (!pool.idle.empty()) {
+			connection = pool.idle.front();
+			pool.idle.pop_front();
+			_statistics.reused++;
+		} else {
+			pool.open++; // reserve the slot before connecting outside of the lock
+		}
+	}
+
+	if (connection) {
+		if (std::chrono::steady_clock::now() - connection->lastUsed < HEALTH_CHECK_INTERVAL || mysql_ping(connection->handle) == 0) {
+			return connection;
+		}
+
+		// server closed the connection (e.g. wait_timeout), replace it by a fresh one within the same slot
+		{
+			std::lock_guard<std::mutex> lg(_lock);
+			_statistics.healthCheckFailures++;
+		}
+		closeStatements(connection);
+		mysql_close(connection->handle);
+		connection->handle = nullptr;
+		connection->preparedStatements.clear();
+	} else {
+		connection = new Connection();
+		connection->key = key;
+	}
+
+	connection->handle = open(host, user, password, database, port);
+
+	if (!connection->handle) {
+		delete connection;
+
+		std::lock_guard<std::mutex> lg(_lock);
+		_pools[key].open--;
+		_released.notify_one();
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lg(_lock);
+	_statistics.created++;
+
+	return connection;
+}
+
+void MariaDBConnectionPool::release(Connection * connection, bool broken) {
+	if (!connection) return;
+
+	if (broken) {
+		closeStatements(connection);
+		mysql_close(connection->handle);
+	} else {
+		connection->lastUsed = std::chrono::steady_clock::now();
+	}
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		Pool & pool = _pools[connection->key];
+
+		if (broken) {
+			pool.open--;
+		} else {
+			pool.idle.push_front(connection); // most recently used first, so rarely needed connections run into the health check instead of all of them
+		}
+	}
+	_released.notify_one();
+
+	if (broken) {
+		delete connection;
+	}
+}
+
+void MariaDBConnectionPool::statementCached() {
+	std::lock_guard<std::mutex> lg(_lock);
+	_statistics.cachedPrepares++;
+}
+
+MariaDBConnectionPool::Statistics MariaDBConnectionPool::getStatistics() {
+	std::lock_guard<std::mutex> lg(_lock);
+	return _statistics;
+}
+
+void MariaDBConnectionPool::printStatistics() {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	std::cout << "Connection pool:" << std::endl;
+	for (const auto & p : _pools) {
+		std::cout << "\t" << p.first << ":\t" << p.second.open << " open, " << p.second.idle.size() << " idle" << std::endl;
+	}
+	std::cout << "\tacquisitions:\t\t" << _statistics.acquisitions << std::endl;
+	std::cout << "\tcreated:\t\t" << _statistics.created << std::endl;
+	std::cout << "\treused:\t\t\t" << _statistics.reused << std::endl;
+	std::cout << "\twaits:\t\t\t" << _statistics.waits << " (" << _statistics.totalWaitMicroseconds / 1000 << "ms total, " << _statistics.maxWaitMicroseconds / 1000 << "ms max)" << std::endl;
+	std::cout << "\texhausted:\t\t" << _statistics.exhausted << std::endl;
+	std::cout << "\thealth check failures:\t" << _statistics.healthCheckFailures << std::endl;
+	std::cout << "\tcached prepares:\t" << _statistics.cachedPrepares << std::endl;
+}
+
+MYSQL * MariaDBConnectionPool::open(const std::string & host, const std::string & user, const std::string & password, const std::string & database, uint16_t port) {
+	MYSQL * handle = mysql_init(nullptr);
+
+	if (!handle) return nullptr;
+
+	if (!mysql_real_connect(handle, host.c_str(), user.c_str(), password.c_str(), database.c_str(), port, "/var/lib/mysql/mysql.sock", 0)) {
+		std::cout << "Couldn't connect to database " << database << ": " << mysql_error(handle) << std::endl;
+		mysql_close(handle);
+		return nullptr;
+	}
+
+	return handle;
+}
+
+void MariaDBConnectionPool::closeStatements(Connection * connection) {
+	for (const auto & p : connection->statements) {
+		mysql_stmt_close(p.second);
+	}
+	connection->statements.clear();
+}
@@ -0,0 +1,276 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "MariaDBStatement.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "MariaDBWrapper.h"
+
+using namespace spine::server;
+
+MariaDBStatement::MariaDBStatement(MariaDBWrapper & database, const std::string & statement) : _connection(database._connection), _query(statement), _statement(nullptr), _errorCode(0), _nextParameter(0), _hasResult(false) {
+	if (!_connection) {
+		_prepareError = "not connected";
+		_errorCode = 2006; // CR_SERVER_GONE_ERROR
+		return;
+	}
+
+	// a pending text protocol result would make any further command fail with "Commands out of sync", cached statement or not
+	database.discardResult();
+
+	const auto it = _connection->statements.find(statement);
+
+	if (it != _connection->statements.end()) {
+		_statement = it->second;
+		MariaDBConnectionPool::statementCached();
+	} else {
+		MYSQL_STMT * stmt = mysql_stmt_init(_connection->handle);
+
+		if (!stmt) {
+			_prepareError = database.getLastError();
+			_errorCode = mysql_errno(_connection->handle);
+			return;
+		}
+
+		if (mysql_stmt_prepare(stmt, statement.c_str(), static_cast<unsigned long>(statement.size())) != 0) {
+			_prepareError = mysql_stmt_error(stmt);
+			_errorCode = mysql_stmt_errno(stmt);
+			mysql_stmt_close(stmt);
+			return;
+		}
+
+		// lets mysql_stmt_store_result calculate the longest value per column, so string buffers never truncate
+		my_bool updateMaxLength = 1;
+		mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+
+		_connection->statements.insert(std::make_pair(statement, stmt));
+		_statement = stmt;
+	}
+
+	const unsigned long parameterCount = mysql_stmt_param_count(_statement);
+
+	_parameters.resize(parameterCount);
+	_intParameters.resize(parameterCount);
+	_stringParameters.resize(parameterCount);
+	_parameterLengths.resize(parameterCount);
+}
+
+MariaDBStatement::~MariaDBStatement() {
+	if (_statement && _hasResult) {
+		mysql_stmt_free_result(_statement);
+	}
+}
+
+MariaDBStatement & MariaDBStatement::bind(int32_t value) {
+	return bind(static_cast<int64_t>(value));
+}
+
+MariaDBStatement & MariaDBStatement::bind(int64_t value) {
+	if (_nextParameter >= _parameters.size()) return *this;
+
+	_intParameters[_nextParameter] = value;
+
+	return bindParameter(MYSQL_TYPE_LONGLONG, &_intParameters[_nextParameter], 0);
+}
+
+MariaDBStatement & MariaDBStatement::bind(const std::string & value) {
+	if (_nextParameter >= _parameters.size()) return *this;
+
+	_stringParameters[_nextParameter] = value;
+
+	return bindParameter(MYSQL_TYPE_STRING, &_stringParameters[_nextParameter][0], static_cast<unsigned long>(value.size()));
+}
+
+void MariaDBStatement::reset() {
+	_nextParameter = 0;
+}
+
+bool MariaDBStatement::execute() {
+	if (!_statement) return false;
+
+	if (_hasResult) {
+		mysql_stmt_free_result(_statement);
+		_hasResult = false;
+	}
+
+	if (_nextParameter != _parameters.size()) {
+		_prepareError = "expected " + std::to_string(_parameters.size()) + " parameters, got " + std::to_string(_nextParameter);
+		return false;
+	}
+
+	if (!_parameters.empty() && mysql_stmt_bind_param(_statement, _parameters.data()) != 0) return false;
+
+	if (mysql_stmt_execute(_statement) != 0) {
+		invalidate();
+		return false;
+	}
+
+	if (mysql_stmt_field_count(_statement) == 0) return true;
+
+	if (mysql_stmt_store_result(_statement) != 0) {
+		invalidate();
+		return false;
+	}
+
+	_hasResult = true;
+
+	return bindResults();
+}
+
+bool MariaDBStatement::fetch() {
+	if (!_hasResult) return false;
+
+	const int rc = mysql_stmt_fetch(_statement);
+
+	return rc == 0 || rc == MYSQL_DATA_TRUNCATED;
+}
+
+size_t MariaDBStatement::getRowCount() const {
+	return _hasResult ? static_cast<size_t>(mysql_stmt_num_rows(_statement)) : 0;
+}
+
+uint64_t MariaDBStatement::getAffectedRows() const {
+	return _statement ? mysql_stmt_affected_rows(_statement) : 0;
+}
+
+uint64_t MariaDBStatement::getInsertID() const {
+	return _statement ? mysql_stmt_insert_id(_statement) : 0;
+}
+
+bool MariaDBStatement::isNull(unsigned int column) const {
+	return column >= _columns.size() || _columns[column].isNull;
+}
+
+int32_t MariaDBStatement::getInt(unsigned int column) const {
+	return static_cast<int32_t>(getInt64(column));
+}
+
+int64_t MariaDBStatement::getInt64(unsigned int column) const {
+	if (isNull(column)) return 0;
+
+	const Column & c = _columns[column];
+
+	if (c.integer) return c.intValue;
+
+	return std::strtoll(c.buffer.data(), nullptr, 10);
+}
+
+boost::string_ref MariaDBStatement::getString(unsigned int column) const {
+	if (isNull(column)) return boost::string_ref();
+
+	Column & c = _columns[column];
+
+	if (c.integer) {
+		c.length = static_cast<unsigned long>(std::snprintf(c.buffer.data(), c.buffer.size(), "%lld", static_cast<long long>(c.intValue)));
+	}
+
+	return boost::string_ref(c.buffer.data(), c.length);
+}
+
+bool MariaDBStatement::isTransientError() const {
+	return MariaDBWrapper::isTransientError(_errorCode);
+}
+
+std::string MariaDBStatement::getLastError() const {
+	if (!_statement) return _prepareError;
+
+	const std::string error = mysql_stmt_error(_statement);
+
+	return error.empty() ? _prepareError : error;
+}
+
+MariaDBStatement & MariaDBStatement::bindParameter(enum_field_types type, void * buffer, unsigned long length) {
+	MYSQL_BIND & b = _parameters[_nextParameter];
+	b = MYSQL_BIND();
+	b.buffer_type = type;
+	b.buffer = buffer;
+	b.buffer_length = length;
+
+	_parameterLengths[_nextParameter] = length;
+	b.length = &_parameterLengths[_nextParameter];
+
+	_nextParameter++;
+
+	return *this;
+}
+
+bool MariaDBStatement::bindResults() {
+	MYSQL_RES * meta = mysql_stmt_result_metadata(_statement);
+
+	if (!meta) return false;
+
+	const unsigned int fieldCount = mysql_num_fields(meta);
+	const MYSQL_FIELD * fields = mysql_fetch_fields(meta);
+
+	_columns.assign(fieldCount, Column());
+	_results.assign(fieldCount, MYSQL_BIND());
+
+	for (unsigned int i = 0; i < fieldCount; i++) {
+		Column & c = _columns[i];
+		MYSQL_BIND & b = _results[i];
+
+		switch (fields[i].type) {
+		case MYSQL_TYPE_TINY:
+		case MYSQL_TYPE_SHORT:
+		case MYSQL_TYPE_INT24:
+		case MYSQL_TYPE_LONG:
+		case MYSQL_TYPE_LONGLONG:
+		case MYSQL_TYPE_YEAR: {
+			c.integer = true;
+			c.buffer.resize(21); // enough for getString of any int64
+			b.buffer_type = MYSQL_TYPE_LONGLONG;
+			b.buffer = &c.intValue;
+			b.is_unsigned = (fields[i].flags & UNSIGNED_FLAG) != 0;
+			break;
+		}
+		default: {
+			c.integer = false;
+			c.buffer.resize(fields[i].max_length + 1); // + 1 for the terminating null used by getInt64
+			b.buffer_type = MYSQL_TYPE_STRING;
+			b.buffer = c.buffer.data();
+			b.buffer_length = static_cast<unsigned long>(c.buffer.size());
+			break;
+		}
+		}
+
+		b.length = &c.length;
+		b.is_null = &c.isNull;
+	}
+
+	mysql_free_result(meta);
+
+	return mysql_stmt_bind_result(_statement, _results.data()) == 0;
+}
+
+void MariaDBStatement::invalidate() {
+	const unsigned int error = mysql_stmt_errno(_statement);
+
+	_errorCode = error;
+
+	if (error < 2000 || error >= 3000) return;
+
+	// client side error, the statement handle is unusable and has to be prepared again by the next user
+	_prepareError = mysql_stmt_error(_statement);
+	_connection->statements.erase(_query);
+	mysql_stmt_close(_statement);
+	_statement = nullptr;
+	_hasResult = false;
+}
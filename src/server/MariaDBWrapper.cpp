@@ -18,27 +18,150 @@
 
 #include "MariaDBWrapper.h"
 
+#include <iostream>
+
 using namespace spine::server;
 
-MariaDBWrapper::MariaDBWrapper() : _database(mysql_init(nullptr)) {
+namespace {
+	// extracts the name of statements like PREPARE selectStmt FROM "SELECT ..."
+	bool getPreparedStatementName(const std::string & q, std::string & name) {
+		static const std::string PREPARE = "PREPARE ";
+		static const std::string FROM = " FROM ";
+
+		if (q.compare(0, PREPARE.size(), PREPARE) != 0) return false;
+
+		const size_t pos = q.find(FROM, PREPARE.size());
+
+		if (pos == std::string::npos) return false;
+
+		name = q.substr(PREPARE.size(), pos - PREPARE.size());
+
+		return true;
+	}
+
+	// extracts the name of assignments like SET @paramUserID=3;
+	bool getUserVariableName(const std::string & q, std::string & name) {
+		static const std::string SET = "SET @";
+
+		if (q.compare(0, SET.size(), SET) != 0) return false;
+
+		const size_t pos = q.find_first_of("= ", SET.size());
+
+		if (pos == std::string::npos) return false;
+
+		name = q.substr(SET.size() - 1, pos - SET.size() + 1);
+
+		return true;
+	}
+}
+
+MariaDBWrapper::MariaDBWrapper() : _connection(nullptr), _database(nullptr), _pendingResult(false) {
 }
 
 bool MariaDBWrapper::connect(const std::string & host, const std::string & user, const std::string & password, const std::string & database, uint16_t port) {
-	_database = mysql_real_connect(_database, host.c_str(), user.c_str(), password.c_str(), database.c_str(), port, "/var/lib/mysql/mysql.sock", 0);
+	close();
+
+	_connection = MariaDBConnectionPool::acquire(host, user, password, database, port);
+	_database = _connection ? _connection->handle : nullptr;
 	return _database != nullptr;
 }
 
 bool MariaDBWrapper::query(const std::string & q) const {
-	return _database && mysql_real_query(_database, q.c_str(), static_cast<unsigned long>(q.size())) == 0;
+	if (!_database) return false;
+
+	std::string statementName;
+	const bool isPrepare = getPreparedStatementName(q, statementName);
+
+	if (isPrepare) {
+		const auto it = _connection->preparedStatements.find(statementName);
+
+		if (it != _connection->preparedStatements.end() && it->second == q) {
+			MariaDBConnectionPool::statementCached();
+			return true;
+		}
+	}
+
+	discardResult();
+
+	const bool success = mysql_real_query(_database, q.c_str(), static_cast<unsigned long>(q.size())) == 0;
+
+	std::string variableName;
+	if (getUserVariableName(q, variableName)) {
+		_connection->userVariables.insert(variableName);
+	}
+
+	if (isPrepare) {
+		if (success) {
+			_connection->preparedStatements[statementName] = q;
+		} else {
+			_connection->preparedStatements.erase(statementName); // a failed PREPARE deallocates the old statement as well
+		}
+	}
+
+	_pendingResult = success && mysql_field_count(_database) > 0;
+
+	return success;
 }
 
 std::string MariaDBWrapper::getLastError() const {
 	return _database ? mysql_error(_database) : "";
 }
 
+bool MariaDBWrapper::isTransientError() const {
+	return !_database || isTransientError(mysql_errno(_database));
+}
+
+bool MariaDBWrapper::isTransientError(unsigned int error) {
+	// client side errors (CR_*, 2000 - 2999) like a lost connection, ER_LOCK_WAIT_TIMEOUT (1205) and ER_LOCK_DEADLOCK (1213)
+	return (error >= 2000 && error < 3000) || error == 1205 || error == 1213;
+}
+
 void MariaDBWrapper::close() {
-	if (_database) {
-		mysql_close(_database);
-		_database = nullptr;
+	if (!_connection) return;
+
+	discardResult();
+
+	// client side errors (CR_*, 2000 - 2999) mean the connection itself is unusable, e.g. server gone away
+	const unsigned int error = mysql_errno(_database);
+	bool broken = error >= 2000 && error < 3000;
+
+	if (!broken && (_database->server_status & SERVER_STATUS_IN_TRANS)) {
+		// closing a dedicated connection used to roll back implicitly, a pooled one has to do it explicitly or the next borrower would run inside our transaction
+		std::cout << "Rolling back transaction left open on pooled connection" << std::endl;
+		if (mysql_rollback(_database) != 0) {
+			std::cout << "Couldn't roll back transaction: " << mysql_error(_database) << std::endl;
+			broken = true;
+		}
+	}
+
+	if (!broken && !_connection->userVariables.empty()) {
+		// a fresh connection starts with all user variables being NULL and handlers rely on that, so the next borrower must not see our values
+		std::string reset = "SET ";
+		for (const auto & variable : _connection->userVariables) {
+			reset += variable + "=NULL,";
+		}
+		reset.back() = ';';
+
+		if (mysql_real_query(_database, reset.c_str(), static_cast<unsigned long>(reset.size())) != 0) {
+			std::cout << "Couldn't reset user variables: " << mysql_error(_database) << std::endl;
+			broken = true;
+		}
+		_connection->userVariables.clear();
+	}
+
+	MariaDBConnectionPool::release(_connection, broken);
+
+	_connection = nullptr;
+	_database = nullptr;
+}
+
+void MariaDBWrapper::discardResult() const {
+	if (!_pendingResult) return;
+
+	// results of the last query were never fetched, the connection would be out of sync otherwise
+	MYSQL_RES * res = mysql_store_result(_database);
+	if (res) {
+		mysql_free_result(res);
 	}
+	_pendingResult = false;
 }
@@ -123,7 +123,7 @@ void MatchmakingServer::handleSearchMatch(clockUtils::sockets::TcpSocket * sock,
 		for (clockUtils::sockets::TcpSocket * s : gs.members) {
 			common::FoundMatchMessage fmm;
 			fmm.users = usernames;
-			const std::string serialized = fmm.SerializeBlank();
+			const std::string serialized = fmm.SerializeBlank(common::WireFormat::Text); // members might use different versions, the last received message only tells the format of one of them
 			s->writePacket(serialized);
 		}
 		for (clockUtils::sockets::TcpSocket * s : gs.members) {
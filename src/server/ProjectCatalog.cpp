@@ -0,0 +1,259 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "ProjectCatalog.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "MariaDBStatement.h"
+#include "MariaDBWrapper.h"
+#include "ServerCommon.h"
+#include "SpineServerConfig.h"
+
+#include "common/Language.h"
+
+using namespace spine::server;
+
+namespace {
+	// play time aggregates change with every session, so the catalog is refreshed even without invalidation
+	constexpr std::chrono::minutes MAX_AGE(10);
+}
+
+std::mutex ProjectCatalog::_lock;
+std::mutex ProjectCatalog::_loadLock;
+std::shared_ptr<const ProjectCatalog::Catalog> ProjectCatalog::_catalog;
+std::chrono::steady_clock::time_point ProjectCatalog::_loadTime;
+std::atomic<uint64_t> ProjectCatalog::_generation(0);
+uint64_t ProjectCatalog::_loadedGeneration = 0;
+
+std::shared_ptr<const ProjectCatalog::Catalog> ProjectCatalog::get() {
+	const auto isFresh = []() {
+		return _catalog && _loadedGeneration == _generation && std::chrono::steady_clock::now() - _loadTime < MAX_AGE;
+	};
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		if (isFresh()) return _catalog;
+	}
+
+	std::unique_lock<std::mutex> loadLock(_loadLock, std::try_to_lock);
+
+	if (!loadLock.owns_lock()) {
+		{
+			// somebody else is already reloading, an outdated catalog is good enough in the meantime
+			std::lock_guard<std::mutex> lg(_lock);
+			if (_catalog) return _catalog;
+		}
+		loadLock.lock();
+	}
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		if (isFresh()) return _catalog;
+	}
+
+	const uint64_t generation = _generation; // read before loading, so an invalidation during the load triggers another one
+	const auto catalog = load();
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	if (catalog) {
+		_catalog = catalog;
+		_loadedGeneration = generation;
+		_loadTime = std::chrono::steady_clock::now();
+	}
+
+	return _catalog;
+}
+
+void ProjectCatalog::invalidate() {
+	++_generation;
+}
+
+std::string ProjectCatalog::getTeamName(const Catalog & catalog, int32_t teamID, int language) {
+	const auto it = catalog.teamNames.find(teamID);
+
+	if (it == catalog.teamNames.end()) return "";
+
+	for (const auto & p : it->second) {
+		if (p.first & language) return p.second;
+	}
+
+	for (const auto & p : it->second) {
+		if (p.first & common::English) return p.second;
+	}
+
+	return "";
+}
+
+std::shared_ptr<ProjectCatalog::Catalog> ProjectCatalog::load() {
+	auto catalog = std::make_shared<Catalog>();
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement selectProjectsStmt(database, "SELECT ModID, TeamID, Gothic, ReleaseDate, Type, MajorVersion, MinorVersion, PatchVersion, SpineVersion, Enabled FROM mods");
+		if (!selectProjectsStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectProjectsStmt.getLastError() << std::endl;
+			break;
+		}
+		catalog->projects.reserve(selectProjectsStmt.getRowCount());
+
+		while (selectProjectsStmt.fetch()) {
+			Project project;
+			project.projectID = selectProjectsStmt.getInt(0);
+			project.teamID = selectProjectsStmt.getInt(1);
+			project.gameType = selectProjectsStmt.getInt(2);
+			project.releaseDate = selectProjectsStmt.getInt(3);
+			project.modType = selectProjectsStmt.getInt(4);
+			project.majorVersion = selectProjectsStmt.getInt(5);
+			project.minorVersion = selectProjectsStmt.getInt(6);
+			project.patchVersion = selectProjectsStmt.getInt(7);
+			project.spineVersion = selectProjectsStmt.getInt(8);
+			project.enabled = selectProjectsStmt.getInt(9) == 1;
+			project.supportedLanguages = 0;
+			project.devDuration = -1;
+			project.avgDuration = -1;
+			project.updateDate = project.releaseDate;
+
+			catalog->projectIndices.insert(std::make_pair(project.projectID, catalog->projects.size()));
+			catalog->projects.push_back(project);
+		}
+
+		const auto findProject = [&catalog](int32_t projectID) -> Project * {
+			const auto it = catalog->projectIndices.find(projectID);
+			return it == catalog->projectIndices.end() ? nullptr : &catalog->projects[it->second];
+		};
+
+		MariaDBStatement selectNamesStmt(database, "SELECT ProjectID, Languages, CAST(Name AS BINARY) FROM projectNames");
+		if (!selectNamesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectNamesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectNamesStmt.fetch()) {
+			auto * project = findProject(selectNamesStmt.getInt(0));
+
+			if (!project) continue;
+
+			const int languages = selectNamesStmt.getInt(1);
+
+			project->names.insert(std::make_pair(languages, selectNamesStmt.getString(2).to_string()));
+			project->supportedLanguages |= languages;
+		}
+
+		MariaDBStatement selectKeywordsStmt(database, "SELECT ProjectID, Keywords FROM keywordsPerProject");
+		if (!selectKeywordsStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectKeywordsStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectKeywordsStmt.fetch()) {
+			auto * project = findProject(selectKeywordsStmt.getInt(0));
+
+			if (!project) continue;
+
+			project->keywords.push_back(selectKeywordsStmt.getString(1).to_string());
+		}
+
+		MariaDBStatement selectDevtimesStmt(database, "SELECT ModID, Duration FROM devtimes");
+		if (!selectDevtimesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectDevtimesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectDevtimesStmt.fetch()) {
+			auto * project = findProject(selectDevtimesStmt.getInt(0));
+
+			if (!project || project->devDuration != -1) continue;
+
+			project->devDuration = selectDevtimesStmt.getInt(1);
+		}
+
+		MariaDBStatement selectPlaytimesStmt(database, "SELECT ModID, IFNULL(SUM(Duration), 0), COUNT(Duration) FROM playtimes WHERE UserID != -1 GROUP BY ModID");
+		if (!selectPlaytimesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlaytimesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectPlaytimesStmt.fetch()) {
+			auto * project = findProject(selectPlaytimesStmt.getInt(0));
+
+			if (!project) continue;
+
+			const int64_t sumDurations = selectPlaytimesStmt.getInt64(1);
+			const int64_t countDurations = selectPlaytimesStmt.getInt64(2);
+
+			if (countDurations >= 1) {
+				project->avgDuration = static_cast<int32_t>(sumDurations / countDurations);
+			}
+		}
+
+		MariaDBStatement selectUpdateDatesStmt(database, "SELECT ProjectID, Date FROM lastUpdated");
+		if (!selectUpdateDatesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectUpdateDatesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectUpdateDatesStmt.fetch()) {
+			auto * project = findProject(selectUpdateDatesStmt.getInt(0));
+
+			if (!project) continue;
+
+			project->updateDate = std::max(project->updateDate, selectUpdateDatesStmt.getInt(1));
+		}
+
+		MariaDBStatement selectTeamNamesStmt(database, "SELECT TeamID, Languages, CAST(Name AS BINARY) FROM teamNames");
+		if (!selectTeamNamesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectTeamNamesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectTeamNamesStmt.fetch()) {
+			catalog->teamNames[selectTeamNamesStmt.getInt(0)].emplace_back(selectTeamNamesStmt.getInt(1), selectTeamNamesStmt.getString(2).to_string());
+		}
+
+		MariaDBStatement selectPackagesStmt(database, "SELECT PackageID, ModID, Enabled FROM optionalpackages");
+		if (!selectPackagesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPackagesStmt.getLastError() << std::endl;
+			break;
+		}
+		std::map<int32_t, size_t> packageIndices;
+		while (selectPackagesStmt.fetch()) {
+			Package package;
+			package.packageID = selectPackagesStmt.getInt(0);
+			package.projectID = selectPackagesStmt.getInt(1);
+			package.enabled = selectPackagesStmt.getInt(2) == 1;
+
+			packageIndices.insert(std::make_pair(package.packageID, catalog->packages.size()));
+			catalog->packages.push_back(package);
+		}
+
+		MariaDBStatement selectPackageNamesStmt(database, "SELECT PackageID, CAST(Name AS BINARY), Language FROM optionalpackagenames");
+		if (!selectPackageNamesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPackageNamesStmt.getLastError() << std::endl;
+			break;
+		}
+		while (selectPackageNamesStmt.fetch()) {
+			const auto it = packageIndices.find(selectPackageNamesStmt.getInt(0));
+
+			if (it == packageIndices.end()) continue;
+
+			catalog->packages[it->second].names[selectPackageNamesStmt.getString(2).to_string()] = selectPackageNamesStmt.getString(1).to_string();
+		}
+
+		return catalog;
+	} while (false);
+
+	return nullptr;
+}
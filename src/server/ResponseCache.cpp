@@ -0,0 +1,114 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "ResponseCache.h"
+
+#include <functional>
+#include <sstream>
+
+using namespace spine::server;
+
+std::mutex ResponseCache::_lock;
+ResponseCache::EndpointCache ResponseCache::_caches[static_cast<size_t>(Endpoint::Count)];
+
+uint64_t ResponseCache::getGeneration(Endpoint endpoint) {
+	std::lock_guard<std::mutex> lg(_lock);
+	return _caches[static_cast<size_t>(endpoint)].generation;
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::get(Endpoint endpoint, const std::string & key) {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	const auto & entries = _caches[static_cast<size_t>(endpoint)].entries;
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) return nullptr;
+
+	if (it->second->expiry < std::chrono::steady_clock::now()) return nullptr;
+
+	return it->second;
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::put(Endpoint endpoint, const std::string & key, uint64_t generation, const std::string & body, std::chrono::seconds maxAge) {
+	auto entry = std::make_shared<Entry>();
+	entry->body = body;
+	entry->etag = createETag(body);
+	entry->expiry = std::chrono::steady_clock::now() + maxAge;
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	auto & cache = _caches[static_cast<size_t>(endpoint)];
+
+	// content changed while the response was built, so it might already be outdated
+	if (cache.generation != generation) return entry;
+
+	if (cache.entries.size() >= MAX_ENTRIES && cache.entries.find(key) == cache.entries.end()) {
+		const auto now = std::chrono::steady_clock::now();
+
+		for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+			if (it->second->expiry < now) {
+				it = cache.entries.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		if (cache.entries.size() >= MAX_ENTRIES) return entry;
+	}
+
+	cache.entries[key] = entry;
+
+	return entry;
+}
+
+void ResponseCache::invalidate(Endpoint endpoint) {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	auto & cache = _caches[static_cast<size_t>(endpoint)];
+	cache.generation++;
+	cache.entries.clear();
+}
+
+void ResponseCache::write(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, const Entry & entry) {
+	SimpleWeb::CaseInsensitiveMultimap header;
+	header.emplace("ETag", entry.etag);
+
+	const auto it = request->header.find("If-None-Match");
+
+	if (it != request->header.end() && (it->second == "*" || it->second.find(entry.etag) != std::string::npos)) {
+		response->write(SimpleWeb::StatusCode::redirection_not_modified, header);
+		return;
+	}
+
+	response->write(SimpleWeb::StatusCode::success_ok, entry.body, header);
+}
+
+void ResponseCache::write(std::shared_ptr<HttpsServer::Response> response, std::shared_ptr<HttpsServer::Request> request, const std::string & body) {
+	Entry entry;
+	entry.body = body;
+	entry.etag = createETag(body);
+
+	write(response, request, entry);
+}
+
+std::string ResponseCache::createETag(const std::string & body) {
+	std::stringstream ss;
+	ss << "\"" << std::hex << std::hash<std::string>()(body) << "-" << body.size() << "\"";
+
+	return ss.str();
+}
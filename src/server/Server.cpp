@@ -20,7 +20,6 @@
 
 #include <fstream>
 #include <map>
-#include <set>
 #include <thread>
 
 #include "Cleanup.h"
@@ -31,11 +30,13 @@
 #include "FileSynchronizer.h"
 #include "GMPServer.h"
 #include "ManagementServer.h"
+#include "MariaDBConnectionPool.h"
 #include "MariaDBWrapper.h"
 #include "MatchmakingServer.h"
 #include "ServerCommon.h"
 #include "SpineLevel.h"
 #include "StatsCollector.h"
+#include "UpdateManifest.h"
 #include "UploadServer.h"
 
 #include "common/MessageStructs.h"
@@ -44,12 +45,14 @@
 
 #include "clockUtils/sockets/TcpSocket.h"
 
-#include "tinyxml2.h"
-
 using namespace spine::common;
 using namespace spine::server;
 
-Server::Server() : _listenClient(new clockUtils::sockets::TcpSocket()), _listenMPServer(new clockUtils::sockets::TcpSocket()), _downloadSizeChecker(new DownloadSizeChecker()), _matchmakingServer(new MatchmakingServer()), _gmpServer(new GMPServer()), _uploadServer(new UploadServer()), _databaseServer(new DatabaseServer(_downloadSizeChecker)), _managementServer(new ManagementServer()) {
+namespace {
+	const std::string MODS_PATH = "/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/";
+}
+
+Server::Server() : _listenClient(new clockUtils::sockets::TcpSocket()), _listenMPServer(new clockUtils::sockets::TcpSocket()), _downloadSizeChecker(new DownloadSizeChecker()), _matchmakingServer(new MatchmakingServer()), _gmpServer(new GMPServer()), _uploadServer(new UploadServer(_downloadSizeChecker)), _databaseServer(new DatabaseServer(_downloadSizeChecker)), _managementServer(new ManagementServer(_downloadSizeChecker)) {
 	DatabaseCreator::createTables();
 
 	DatabaseMigrator::migrate();
@@ -61,6 +64,10 @@ Server::Server() : _listenClient(new clockUtils::sockets::TcpSocket()), _listenM
 	FileSynchronizer::init();
 
 	StatsCollector::init();
+
+	UpdateManifest::init();
+
+	_downloadSizeChecker->warmup();
 }
 
 Server::~Server() {
@@ -93,7 +100,10 @@ int Server::run() {
 	while (running) {
 		std::cout << "Possible actions:" << std::endl;
 		std::cout << "\tx:\t\tshutdown server" << std::endl;
-		std::cout << "\tc:\t\tclear download sizes" << std::endl;
+		std::cout << "\tc:\t\tindex download sizes again" << std::endl;
+		std::cout << "\tp:\t\tprint database connection pool statistics" << std::endl;
+		std::cout << "\tl:\t\tprint level update statistics" << std::endl;
+		std::cout << "\ts:\t\tprint file synchronization statistics" << std::endl;
 
 		const int c = getchar();
 
@@ -106,6 +116,18 @@ int Server::run() {
 			_downloadSizeChecker->clear();
 			break;
 		}
+		case 'p': {
+			MariaDBConnectionPool::printStatistics();
+			break;
+		}
+		case 'l': {
+			SpineLevel::printStatistics();
+			break;
+		}
+		case 's': {
+			FileSynchronizer::printStatistics();
+			break;
+		}
 		default: {
 			break;
 		}
@@ -141,6 +163,9 @@ void Server::receiveMessage(const std::vector<uint8_t> & message, clockUtils::so
 			} else if (m->type == MessageType::UPLOADSCREENSHOTS) {
 				auto * msg = dynamic_cast<UploadScreenshotsMessage *>(m);
 				handleUploadScreenshots(sock, msg);
+			} else if (m->type == MessageType::UPLOADSCREENSHOTCHUNK) {
+				auto * msg = dynamic_cast<UploadScreenshotChunkMessage *>(m);
+				handleUploadScreenshotChunk(sock, msg);
 			} else if (m->type == MessageType::UPLOADACHIEVEMENTICONS) {
 				auto * msg = dynamic_cast<UploadAchievementIconsMessage *>(m);
 				_managementServer->uploadAchievementIcons(msg);
@@ -165,82 +190,85 @@ void Server::receiveMessage(const std::vector<uint8_t> & message, clockUtils::so
 }
 
 void Server::handleAutoUpdate(clockUtils::sockets::TcpSocket * sock, UpdateRequestMessage * msg) const {
-	// 1. read xml
-	tinyxml2::XMLDocument doc;
+	const uint32_t version = (msg->majorVersion << 16) + (msg->minorVersion << 8) + msg->patchVersion;
 
-	const tinyxml2::XMLError e = doc.LoadFile("Spine_Version.xml");
+	// the client learns from a binary answer that it can send binary messages as well, older clients only understand text
+	const WireFormat format = version >= BINARY_FORMAT_CLIENT_VERSION ? WireFormat::Binary : WireFormat::Text;
 
-	if (e) {
-		std::cerr << "Couldn't open xml file!" << std::endl;
-		UpdateFileCountMessage ufcm;
-		ufcm.count = 0;
+	sock->writePacket(UpdateManifest::getSerializedUpdate(msg->majorVersion, msg->minorVersion, msg->patchVersion, format));
+}
 
-		const std::string serialized = ufcm.SerializeBlank();
+void Server::handleUploadScreenshots(clockUtils::sockets::TcpSocket *, UploadScreenshotsMessage * msg) const {
+	do {
+		const int userID = ServerCommon::getUserID(msg->username, msg->password);
+		
+		if (userID == -1) break;
 
-		sock->writePacket(serialized);
-		return;
-	}
+		boost::filesystem::create_directories(MODS_PATH + std::to_string(msg->projectID) + "/screens/"); // ensure folder exists
+		
+		for (const auto & p : msg->screenshots) {
+			std::ofstream out;
+			out.open(MODS_PATH + std::to_string(msg->projectID) + "/screens/" + p.first, std::ios::out | std::ios::binary);
+			out.write(reinterpret_cast<const char *>(&p.second[0]), p.second.size());
+			out.close();
+		}
+	} while (false);
+}
 
-	uint32_t lastVersion = (msg->majorVersion << 16) + (msg->minorVersion << 8) + msg->patchVersion;
+void Server::handleUploadScreenshotChunk(clockUtils::sockets::TcpSocket *, UploadScreenshotChunkMessage * msg) const {
+	do {
+		const int userID = ServerCommon::getUserID(msg->username, msg->password);
 
-	std::map<uint32_t, std::vector<std::pair<std::string, std::string>>> versions;
-	versions.insert(std::make_pair(lastVersion, std::vector<std::pair<std::string, std::string>>()));
+		if (userID == -1) break;
 
-	auto * const rootNode = doc.FirstChildElement("Versions");
+		if (msg->filename.empty() || msg->filename == "." || msg->filename == ".." || msg->filename.find_first_of("/\\") != std::string::npos) break;
 
-	if (rootNode != nullptr) {
-		for (tinyxml2::XMLElement * node = rootNode->FirstChildElement("Version"); node != nullptr; node = node->NextSiblingElement("Version")) {
-			const uint8_t majorVersion = static_cast<uint8_t>(std::stoi(node->Attribute("majorVersion")));
-			const uint8_t minorVersion = static_cast<uint8_t>(std::stoi(node->Attribute("minorVersion")));
-			const uint8_t patchVersion = static_cast<uint8_t>(std::stoi(node->Attribute("patchVersion")));
-			uint32_t version = (majorVersion << 16) + (minorVersion << 8) + patchVersion;
+		const std::string folder = MODS_PATH + std::to_string(msg->projectID) + "/screens/";
+		const std::string partFile = folder + msg->filename + ".part";
 
-			versions.insert(std::make_pair(version, std::vector<std::pair<std::string, std::string>>()));
+		// chunks are written right away, the screenshot is only moved to its final name once it is complete
+		std::fstream out;
 
-			auto it = versions.find(version);
+		boost::system::error_code ec;
+
+		if (msg->data.size() > MAX_SCREENSHOT_SIZE || msg->offset > MAX_SCREENSHOT_SIZE - msg->data.size()) {
+			std::cout << "Screenshot " << partFile << " exceeds " << MAX_SCREENSHOT_SIZE << " bytes" << std::endl;
+			boost::filesystem::remove(partFile, ec);
+			break;
+		}
 
-			for (tinyxml2::XMLElement * file = node->FirstChildElement("File"); file != nullptr; file = file->NextSiblingElement("File")) {
-				it->second.emplace_back(file->GetText(), file->Attribute("Hash"));
+		if (msg->offset == 0) {
+			boost::filesystem::create_directories(folder); // ensure folder exists
+			ServerCommon::removeStalePartFiles(folder, std::chrono::hours(24));
+			out.open(partFile, std::ios::out | std::ios::binary | std::ios::trunc);
+		} else {
+			// a chunk has to continue exactly where the part file ends, so a client can't create huge sparse files with a large offset
+			const auto partSize = boost::filesystem::file_size(partFile, ec);
+
+			if (ec || partSize != msg->offset) {
+				std::cout << "Screenshot chunk at " << msg->offset << " doesn't continue " << partFile << std::endl;
+				break;
 			}
+
+			out.open(partFile, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
 		}
-	}
 
-	// 2. find all changed files
-	std::set<std::pair<std::string, std::string>> files;
+		if (!out.is_open()) break;
 
-	auto it = versions.find(lastVersion);
-	if (it != versions.end()) {
-		++it;
-		for (; it != versions.end(); ++it) {
-			for (const std::pair<std::string, std::string> & file : it->second) {
-				files.insert(file);
-			}
-			lastVersion = it->first;
+		out.write(reinterpret_cast<const char *>(msg->data.data()), static_cast<std::streamsize>(msg->data.size()));
+		out.close();
+
+		if (out.fail()) {
+			std::cout << "Couldn't write screenshot " << partFile << std::endl;
+			break;
 		}
-	}
 
-	// 3. send file count
-	UpdateFilesMessage ufm;
-	for (const auto & p : files) {
-		ufm.files.push_back(p);
-	}
-	const std::string serialized = ufm.SerializeBlank();
-	sock->writePacket(serialized);
-}
+		if (!msg->last) break;
 
-void Server::handleUploadScreenshots(clockUtils::sockets::TcpSocket *, UploadScreenshotsMessage * msg) const {
-	do {
-		const int userID = ServerCommon::getUserID(msg->username, msg->password);
-		
-		if (userID == -1) break;
+		boost::filesystem::rename(partFile, folder + msg->filename, ec);
 
-		boost::filesystem::create_directories("/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(msg->projectID) + "/screens/"); // ensure folder exists
-		
-		for (const auto & p : msg->screenshots) {
-			std::ofstream out;
-			out.open("/var/www/vhosts/clockwork-origins.de/httpdocs/Gothic/downloads/mods/" + std::to_string(msg->projectID) + "/screens/" + p.first, std::ios::out | std::ios::binary);
-			out.write(reinterpret_cast<const char *>(&p.second[0]), p.second.size());
-			out.close();
+		if (ec) {
+			std::cout << "Couldn't move screenshot " << partFile << ": " << ec.message() << std::endl;
 		}
 	} while (false);
 }
@@ -18,81 +18,157 @@
 
 #include "ServerCommon.h"
 
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <regex>
 #include <thread>
 
 #include "LanguageConverter.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
+#include "SessionCache.h"
 #include "SpineServerConfig.h"
 #include "Smtp.h"
 
 #include "common/Language.h"
 
+#include "boost/filesystem.hpp"
+
 using namespace spine::common;
 using namespace spine::server;
 
+namespace {
+	int hexDigit(char c) {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+
+		return -1;
+	}
+
+	/**
+	 * \brief returns the character of a lowercase escape sequence or -1 if it isn't one of the escaped special characters
+	 * all other sequences stay untouched
+	 */
+	int decodeEscape(char high, char low) {
+		const int h = hexDigit(high);
+		const int l = hexDigit(low);
+
+		if (h == -1 || l == -1) return -1;
+
+		const int c = h * 16 + l;
+
+		if ((c >= 0x20 && c <= 0x2f) || (c >= 0x3a && c <= 0x40) || (c >= 0x5b && c <= 0x5f) || c == 0x7b || c == 0x7d) return c;
+
+		return -1;
+	}
+}
+
 std::string ServerCommon::convertString(const std::string & str) {
-	std::string result = str;
-	result = std::regex_replace(result, std::regex("%20"), " ");
-	result = std::regex_replace(result, std::regex("%21"), "!");
-	result = std::regex_replace(result, std::regex("%22"), "\"");
-	result = std::regex_replace(result, std::regex("%23"), "#");
-	result = std::regex_replace(result, std::regex("%24"), "$");
-	result = std::regex_replace(result, std::regex("%25"), "%");
-	result = std::regex_replace(result, std::regex("%26"), "&");
-	result = std::regex_replace(result, std::regex("%27"), "'");
-	result = std::regex_replace(result, std::regex("%28"), "(");
-	result = std::regex_replace(result, std::regex("%29"), ")");
-	result = std::regex_replace(result, std::regex("%2a"), "*");
-	result = std::regex_replace(result, std::regex("%2b"), "+");
-	result = std::regex_replace(result, std::regex("%2c"), ",");
-	result = std::regex_replace(result, std::regex("%2d"), "-");
-	result = std::regex_replace(result, std::regex("%2e"), ".");
-	result = std::regex_replace(result, std::regex("%2f"), "/");
-	result = std::regex_replace(result, std::regex("%3a"), ":");
-	result = std::regex_replace(result, std::regex("%3b"), ";");
-	result = std::regex_replace(result, std::regex("%3c"), "<");
-	result = std::regex_replace(result, std::regex("%3d"), "=");
-	result = std::regex_replace(result, std::regex("%3e"), ">");
-	result = std::regex_replace(result, std::regex("%3f"), "?");
-	result = std::regex_replace(result, std::regex("%40"), "@");
-	result = std::regex_replace(result, std::regex("%5b"), "[");
-	result = std::regex_replace(result, std::regex("%5c"), "\\");
-	result = std::regex_replace(result, std::regex("%5d"), "]");
-	result = std::regex_replace(result, std::regex("%5e"), "^");
-	result = std::regex_replace(result, std::regex("%5f"), "_");
-	result = std::regex_replace(result, std::regex("%7b"), "{");
-	result = std::regex_replace(result, std::regex("%7d"), "}");
+	std::string result;
+	result.reserve(str.size());
+
+	const char * current = str.data();
+	const char * const end = current + str.size();
+
+	while (current != end) {
+		// memchr is vectorized by the C library, so the long runs without escapes are skipped and copied in one go
+		const char * percent = static_cast<const char *>(std::memchr(current, '%', static_cast<size_t>(end - current)));
+
+		if (!percent) {
+			result.append(current, end);
+			break;
+		}
+
+		result.append(current, percent);
+
+		const int decoded = end - percent >= 3 ? decodeEscape(percent[1], percent[2]) : -1;
+
+		if (decoded == -1) {
+			result.push_back('%');
+			current = percent + 1;
+		} else {
+			result.push_back(static_cast<char>(decoded));
+			current = percent + 3;
+		}
+	}
+
 	return result;
 }
 
 int ServerCommon::getUserID(const std::string & username, const std::string & password) {
+	if (SessionCache::isToken(password)) {
+		std::string fingerprint;
+		const int userID = SessionCache::verifyToken(username, password, fingerprint);
+
+		if (userID != -1) return fingerprint == getPasswordFingerprint(userID) ? userID : -1;
+
+		// might still be a password that just looks like a token
+	}
+
+	const int cachedUserID = SessionCache::lookup(username, password);
+
+	if (cachedUserID != -1) return cachedUserID;
+
+	std::string passwordHash;
+	const int userID = checkPassword(username, password, passwordHash);
+
+	SessionCache::store(username, password, userID);
+
+	if (userID != -1) {
+		SessionCache::storeFingerprint(userID, SessionCache::getFingerprint(passwordHash));
+	}
+
+	return userID;
+}
+
+int ServerCommon::checkPassword(const std::string & username, const std::string & password, std::string & passwordHash) {
 	MariaDBWrapper accountDatabase;
 	if (!accountDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, ACCOUNTSDATABASE, 0)) {
 		std::cout << "Couldn't connect to database" << std::endl;
 		return -1;
 	}
 
-	if (!accountDatabase.query("PREPARE selectStmt FROM \"SELECT ID FROM accounts WHERE Username = ? AND Password = PASSWORD(?) LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-		return -1;
-	}
-	if (!accountDatabase.query("SET @paramUsername='" + username + "';")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
+	MariaDBStatement selectStmt(accountDatabase, "SELECT ID, Password FROM accounts WHERE Username = ? AND Password = PASSWORD(?) LIMIT 1");
+	selectStmt.bind(username).bind(password);
+
+	if (!selectStmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
 		return -1;
 	}
-	if (!accountDatabase.query("SET @paramPassword='" + password + "';")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-		return -1;
+
+	if (!selectStmt.fetch()) return -1;
+
+	passwordHash = selectStmt.getString(1).to_string();
+
+	return selectStmt.getInt(0);
+}
+
+std::string ServerCommon::getPasswordFingerprint(int userID) {
+	std::string fingerprint;
+
+	if (SessionCache::lookupFingerprint(userID, fingerprint)) return fingerprint;
+
+	MariaDBWrapper accountDatabase;
+	if (!accountDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, ACCOUNTSDATABASE, 0)) {
+		std::cout << "Couldn't connect to database" << std::endl;
+		return "";
 	}
-	if (!accountDatabase.query("EXECUTE selectStmt USING @paramUsername, @paramPassword;")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
+
+	MariaDBStatement selectStmt(accountDatabase, "SELECT Password FROM accounts WHERE ID = ? LIMIT 1");
+	selectStmt.bind(userID);
+
+	if (!selectStmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
+		return "";
 	}
-	const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
-	return results.empty() ? -1 : std::stoi(results[0][0]);
+	// a deleted account gets a fingerprint no token can match
+	fingerprint = selectStmt.fetch() ? SessionCache::getFingerprint(selectStmt.getString(0).to_string()) : "-";
+
+	SessionCache::storeFingerprint(userID, fingerprint);
+
+	return fingerprint;
 }
 
 int ServerCommon::getUserID(const std::string & username) {
@@ -102,20 +178,15 @@ int ServerCommon::getUserID(const std::string & username) {
 		return -1;
 	}
 
-	if (!accountDatabase.query("PREPARE selectStmt FROM \"SELECT ID FROM accounts WHERE Username = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-		return -1;
-	}
-	if (!accountDatabase.query("SET @paramUsername='" + username + "';")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
+	MariaDBStatement selectStmt(accountDatabase, "SELECT ID FROM accounts WHERE Username = ? LIMIT 1");
+	selectStmt.bind(username);
+
+	if (!selectStmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
 		return -1;
 	}
-	if (!accountDatabase.query("EXECUTE selectStmt USING @paramUsername;")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-	}
-	const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
-	return results.empty() ? -1 : std::stoi(results[0][0]);
+	return selectStmt.fetch() ? selectStmt.getInt(0) : -1;
 }
 
 std::string ServerCommon::getUsername(const int id) {
@@ -448,21 +519,36 @@ int ServerCommon::getPatronLevel(int userID) {
 		return 0;
 	}
 
-	if (!accountDatabase.query("PREPARE selectStmt FROM \"SELECT Level FROM patronLevels WHERE ID = ? AND ProjectID = 0 LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-		return 0;
-	}
-	if (!accountDatabase.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
-		return 0;
-	}
-	if (!accountDatabase.query("EXECUTE selectStmt USING @paramUserID;")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << accountDatabase.getLastError() << std::endl;
+	MariaDBStatement selectStmt(accountDatabase, "SELECT Level FROM patronLevels WHERE ID = ? AND ProjectID = 0 LIMIT 1");
+	selectStmt.bind(userID);
+
+	if (!selectStmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
 		return 0;
 	}
-	const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
-	if (results.empty()) return 0;
+	return selectStmt.fetch() ? selectStmt.getInt(0) : 0;
+}
+
+void ServerCommon::removeStalePartFiles(const std::string & folder, std::chrono::hours maxAge) {
+	const std::time_t limit = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - maxAge);
+
+	boost::system::error_code ec;
+
+	if (!boost::filesystem::is_directory(folder, ec)) return;
+
+	for (boost::filesystem::recursive_directory_iterator it(folder, ec), end; !ec && it != end; it.increment(ec)) {
+		if (it->path().extension() != ".part" || !boost::filesystem::is_regular_file(it->status())) continue;
 
-	return std::stoi(results[0][0]);
+		boost::system::error_code fileError;
+		const std::time_t lastWrite = boost::filesystem::last_write_time(it->path(), fileError);
+
+		if (fileError || lastWrite >= limit) continue;
+
+		boost::filesystem::remove(it->path(), fileError);
+
+		if (fileError) {
+			std::cout << "Couldn't remove stale part file " << it->path().string() << ": " << fileError.message() << std::endl;
+		}
+	}
 }
@@ -0,0 +1,220 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "SessionCache.h"
+
+#include <ctime>
+#include <functional>
+
+#include "openssl/crypto.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#include "openssl/rand.h"
+
+using namespace spine::server;
+
+namespace {
+	const std::string TOKEN_PREFIX = "token:";
+
+	// expired entries are only removed once a shard got that big, so lookups never have to clean up
+	constexpr size_t MAX_ENTRIES_PER_SHARD = 1024;
+}
+
+const std::chrono::minutes SessionCache::CREDENTIALS_TTL(10);
+const std::chrono::hours SessionCache::TOKEN_TTL(24);
+
+SessionCache::Shard SessionCache::_shards[SHARD_COUNT];
+
+int SessionCache::lookup(const std::string & username, const std::string & password) {
+	const std::string key = sign(username + '\0' + password);
+
+	Shard & shard = getShard(key);
+
+	std::lock_guard<std::mutex> lg(shard.lock);
+
+	const auto it = shard.entries.find(key);
+
+	if (it == shard.entries.end()) return -1;
+
+	if (it->second.expiry < std::chrono::steady_clock::now()) {
+		shard.entries.erase(it);
+		return -1;
+	}
+
+	return it->second.userID;
+}
+
+void SessionCache::store(const std::string & username, const std::string & password, int userID) {
+	if (userID == -1) return;
+
+	const std::string key = sign(username + '\0' + password);
+	const auto now = std::chrono::steady_clock::now();
+
+	Shard & shard = getShard(key);
+
+	std::lock_guard<std::mutex> lg(shard.lock);
+
+	if (shard.entries.size() >= MAX_ENTRIES_PER_SHARD) {
+		for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+			if (it->second.expiry < now) {
+				it = shard.entries.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	Entry entry;
+	entry.userID = userID;
+	entry.expiry = now + CREDENTIALS_TTL;
+
+	shard.entries[key] = entry;
+}
+
+std::string SessionCache::createToken(const std::string & username, int userID, const std::string & passwordHash) {
+	const auto expiry = static_cast<int64_t>(time(nullptr)) + std::chrono::duration_cast<std::chrono::seconds>(TOKEN_TTL).count();
+
+	const std::string payload = std::to_string(userID) + ":" + std::to_string(expiry) + ":" + getFingerprint(passwordHash);
+
+	return TOKEN_PREFIX + payload + ":" + sign(username + '\0' + payload);
+}
+
+bool SessionCache::isToken(const std::string & password) {
+	return password.compare(0, TOKEN_PREFIX.size(), TOKEN_PREFIX) == 0;
+}
+
+std::string SessionCache::getFingerprint(const std::string & passwordHash) {
+	// signed, so the token doesn't tell anything about the password hash
+	return sign("password" + std::string(1, '\0') + passwordHash).substr(0, 16);
+}
+
+bool SessionCache::lookupFingerprint(int userID, std::string & fingerprint) {
+	Shard & shard = getShard(userID);
+
+	std::lock_guard<std::mutex> lg(shard.lock);
+
+	const auto it = shard.fingerprints.find(userID);
+
+	if (it == shard.fingerprints.end()) return false;
+
+	if (it->second.expiry < std::chrono::steady_clock::now()) {
+		shard.fingerprints.erase(it);
+		return false;
+	}
+
+	fingerprint = it->second.fingerprint;
+
+	return true;
+}
+
+void SessionCache::storeFingerprint(int userID, const std::string & fingerprint) {
+	const auto now = std::chrono::steady_clock::now();
+
+	Shard & shard = getShard(userID);
+
+	std::lock_guard<std::mutex> lg(shard.lock);
+
+	if (shard.fingerprints.size() >= MAX_ENTRIES_PER_SHARD) {
+		for (auto it = shard.fingerprints.begin(); it != shard.fingerprints.end();) {
+			if (it->second.expiry < now) {
+				it = shard.fingerprints.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	FingerprintEntry entry;
+	entry.fingerprint = fingerprint;
+	entry.expiry = now + CREDENTIALS_TTL;
+
+	shard.fingerprints[userID] = entry;
+}
+
+const std::string & SessionCache::getSecret() {
+	static const std::string secret = []() {
+		std::string s(32, '\0');
+		RAND_bytes(reinterpret_cast<unsigned char *>(&s[0]), static_cast<int>(s.size()));
+		return s;
+	}();
+
+	return secret;
+}
+
+std::string SessionCache::sign(const std::string & data) {
+	const std::string & secret = getSecret();
+
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digestLength = 0;
+
+	HMAC(EVP_sha256(), secret.data(), static_cast<int>(secret.size()), reinterpret_cast<const unsigned char *>(data.data()), data.size(), digest, &digestLength);
+
+	static const char * hexDigits = "0123456789abcdef";
+
+	std::string result;
+	result.reserve(digestLength * 2);
+
+	for (unsigned int i = 0; i < digestLength; i++) {
+		result.push_back(hexDigits[digest[i] >> 4]);
+		result.push_back(hexDigits[digest[i] & 0xF]);
+	}
+
+	return result;
+}
+
+SessionCache::Shard & SessionCache::getShard(const std::string & key) {
+	return _shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+SessionCache::Shard & SessionCache::getShard(int userID) {
+	return _shards[static_cast<size_t>(userID) % SHARD_COUNT];
+}
+
+int SessionCache::verifyToken(const std::string & username, const std::string & token, std::string & fingerprint) {
+	if (!isToken(token)) return -1;
+
+	const size_t payloadStart = TOKEN_PREFIX.size();
+	const size_t signatureStart = token.rfind(':');
+
+	if (signatureStart == std::string::npos || signatureStart <= payloadStart) return -1;
+
+	const std::string payload = token.substr(payloadStart, signatureStart - payloadStart);
+	const std::string signature = token.substr(signatureStart + 1);
+	const std::string expectedSignature = sign(username + '\0' + payload);
+
+	if (signature.size() != expectedSignature.size() || CRYPTO_memcmp(signature.data(), expectedSignature.data(), signature.size()) != 0) return -1;
+
+	// userID:expiry:fingerprint
+	const size_t separator = payload.find(':');
+	const size_t fingerprintSeparator = payload.rfind(':');
+
+	if (separator == std::string::npos || fingerprintSeparator == separator) return -1;
+
+	try {
+		const int userID = std::stoi(payload.substr(0, separator));
+		const int64_t expiry = std::stoll(payload.substr(separator + 1, fingerprintSeparator - separator - 1));
+
+		if (expiry < static_cast<int64_t>(time(nullptr))) return -1;
+
+		fingerprint = payload.substr(fingerprintSeparator + 1);
+
+		return userID;
+	} catch (...) {
+		return -1;
+	}
+}
@@ -18,22 +18,57 @@
 
 #include "SpineLevel.h"
 
+#include <algorithm>
 #include <thread>
 
+#include "JsonWriter.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
 #include "ServerCommon.h"
 
-using namespace boost::property_tree;
-
 using namespace spine::common;
 using namespace spine::server;
 
+namespace {
+	constexpr size_t MAX_RANKING_PAGE_SIZE = 100;
+
+	bool compareRankingKeys(uint32_t xpA, int userA, uint32_t xpB, int userB) {
+		return xpA > xpB || (xpA == xpB && userA < userB);
+	}
+
+	size_t getSourceIndex(int source) {
+		size_t index = 0;
+
+		while ((source & 1) == 0) {
+			source >>= 1;
+			index++;
+		}
+
+		return index;
+	}
+}
+
+const std::chrono::minutes SpineLevel::QUARTILE_REFRESH_INTERVAL(15);
+const std::chrono::hours SpineLevel::VERIFICATION_INTERVAL(24);
+const std::chrono::milliseconds SpineLevel::VERIFICATION_DELAY(200);
+
 std::mutex SpineLevel::_lock;
 std::map<int, SendUserLevelMessage> SpineLevel::_levels;
-std::vector<SpineLevel::RankingEntry> SpineLevel::_rankings;
+std::map<int, SpineLevel::XPComponents> SpineLevel::_components;
+std::map<int, SpineLevel::RankingEntry> SpineLevel::_rankings;
+std::vector<SpineLevel::RankingKey> SpineLevel::_rankingIndex;
+uint64_t SpineLevel::_rankingGeneration = 0;
+std::string SpineLevel::_serializedRanking;
+uint64_t SpineLevel::_serializedRankingGeneration = UINT64_MAX;
 std::mutex SpineLevel::_rankingLock;
-std::list<int> SpineLevel::_updateQueue;
+std::deque<int> SpineLevel::_updateQueue;
+std::unordered_map<int, SpineLevel::PendingUpdate> SpineLevel::_pendingUpdates;
+std::unordered_set<int> SpineLevel::_processingUsers;
 std::mutex SpineLevel::_updateQueueLock;
+std::condition_variable SpineLevel::_updateCondition;
+SpineLevel::Statistics SpineLevel::_statistics = {};
+std::map<int32_t, SpineLevel::Quartiles> SpineLevel::_quartiles;
+std::mutex SpineLevel::_quartileLock;
 
 void SpineLevel::init() {
 	std::thread([]() {
@@ -88,7 +123,6 @@ void SpineLevel::init() {
 			const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
 			std::lock_guard<std::mutex> lg(_rankingLock);
-			std::lock_guard<std::mutex> lg2(_updateQueueLock);
 
 			for (const auto & vec : results) {
 				const int id = std::stoi(vec[0]);
@@ -107,25 +141,86 @@ void SpineLevel::init() {
 					re.xp = std::get<1>(it->second);
 				}
 				
-				_updateQueue.push_back(id);
-				_rankings.push_back(re);
+				_rankings.insert(std::make_pair(id, re));
+			}
+
+			// sorted once here, afterwards users are only moved on level changes
+			_rankingIndex.clear();
+			_rankingIndex.reserve(_rankings.size());
+
+			for (const auto & p : _rankings) {
+				RankingKey key;
+				key.xp = p.second.xp;
+				key.userID = p.first;
+
+				_rankingIndex.push_back(key);
 			}
+
+			std::sort(_rankingIndex.begin(), _rankingIndex.end(), [](const RankingKey & a, const RankingKey & b) {
+				return compareRankingKeys(a.xp, a.userID, b.xp, b.userID);
+			});
+
+			_rankingGeneration++;
 		} while (false);
 		
+		refreshQuartiles();
+
+		for (size_t i = 0; i < WORKER_COUNT; i++) {
+			std::thread(&SpineLevel::processUpdates).detach();
+		}
+
+		auto lastQuartileRefresh = std::chrono::steady_clock::now();
+		auto nextVerification = std::chrono::steady_clock::now();
+
+		std::vector<int> verificationQueue;
+		size_t correctedLevels = 0;
+		
 		while (true) {
-			_updateQueueLock.lock();
-			
-			if (!_updateQueue.empty()) {
-				const int id = _updateQueue.front();
-				_updateQueue.pop_front();
+			const auto now = std::chrono::steady_clock::now();
+
+			if (now - lastQuartileRefresh >= QUARTILE_REFRESH_INTERVAL) {
+				refreshQuartiles();
+				lastQuartileRefresh = now;
+			}
 
-				_updateQueueLock.unlock();
+			if (verificationQueue.empty() && now >= nextVerification) {
+				{
+					std::lock_guard<std::mutex> lg(_rankingLock);
 
-				cacheLevel(id);
-			} else {
-				_updateQueueLock.unlock();
+					for (const auto & p : _rankings) {
+						verificationQueue.push_back(p.first);
+					}
+				}
+				nextVerification = now + VERIFICATION_INTERVAL;
+				correctedLevels = 0;
+			}
+
+			if (verificationQueue.empty()) {
 				std::this_thread::sleep_for(std::chrono::seconds(30));
+				continue;
+			}
+
+			bool eventsPending;
+			{
+				std::lock_guard<std::mutex> lg(_updateQueueLock);
+				eventsPending = !_updateQueue.empty();
+			}
+
+			// events have priority, everybody is recalculated completely in the meantime to catch anything they missed
+			if (!eventsPending) {
+				const int userID = verificationQueue.back();
+				verificationQueue.pop_back();
+
+				if (verifyLevel(userID)) {
+					correctedLevels++;
+				}
+
+				if (verificationQueue.empty()) {
+					std::cout << "SpineLevel: verification finished, corrected " << correctedLevels << " levels" << std::endl;
+				}
 			}
+
+			std::this_thread::sleep_for(VERIFICATION_DELAY);
 		}
 	}).detach();
 }
@@ -138,442 +233,788 @@ SendUserLevelMessage SpineLevel::getLevel(int userID) {
 		if (it != _levels.end()) return it->second;
 	}
 
-	cacheLevel(userID);
+	cacheLevel(userID, All);
 	
 	std::lock_guard<std::mutex> lg(_lock);
 	
 	const auto it = _levels.find(userID);
-	
-	return it->second;
+
+	if (it != _levels.end()) return it->second;
+
+	SendUserLevelMessage sulm;
+	sulm.nextXP = 500;
+
+	return sulm;
 }
 
-void SpineLevel::updateLevel(int userID) {
+void SpineLevel::updateLevel(int userID, int sources) {
 	if (userID == -1) return;
-	
-	std::lock_guard<std::mutex> lg(_updateQueueLock);
 
-	const auto it = std::find_if(_updateQueue.begin(), _updateQueue.end(), [userID](int id) {
-		return userID == id;
-	});
+	{
+		std::lock_guard<std::mutex> lg(_updateQueueLock);
 
-	if (it != _updateQueue.end()) return; // already queued
-	
-	_updateQueue.push_back(userID);
+		_statistics.queued++;
+
+		const auto it = _pendingUpdates.find(userID);
+
+		if (it != _pendingUpdates.end()) {
+			it->second.sources |= sources; // already queued
+			_statistics.merged++;
+			return;
+		}
+
+		PendingUpdate update;
+		update.sources = sources;
+		update.queued = std::chrono::steady_clock::now();
+
+		_pendingUpdates.insert(std::make_pair(userID, update));
+		_updateQueue.push_back(userID);
+
+		_statistics.maxQueueDepth = std::max(_statistics.maxQueueDepth, _updateQueue.size());
+	}
+
+	_updateCondition.notify_one();
 }
 
-void SpineLevel::clear(const std::vector<int> & userList) {
+SpineLevel::Statistics SpineLevel::getStatistics() {
 	std::lock_guard<std::mutex> lg(_updateQueueLock);
-	for (int userID : userList) {
-		const auto it = std::find_if(_updateQueue.begin(), _updateQueue.end(), [userID](int id) {
-			return userID == id;
-		});
 
-		if (it != _updateQueue.end()) continue; // already queued
-		
-		_updateQueue.push_back(userID);
+	Statistics statistics = _statistics;
+	statistics.queueDepth = _updateQueue.size();
+
+	return statistics;
+}
+
+void SpineLevel::printStatistics() {
+	const Statistics statistics = getStatistics();
+
+	std::cout << "Level updates:" << std::endl;
+	std::cout << "	queued:		" << statistics.queued << " (" << statistics.merged << " merged into pending updates)" << std::endl;
+	std::cout << "	queue depth:	" << statistics.queueDepth << " (" << statistics.maxQueueDepth << " max)" << std::endl;
+	std::cout << "	processed:	" << statistics.processed << " (" << statistics.failed << " failed)" << std::endl;
+	std::cout << "	latency:	" << (statistics.processed == 0 ? 0 : statistics.totalLatencyMicroseconds / statistics.processed / 1000) << "ms average, " << statistics.maxLatencyMicroseconds / 1000 << "ms max" << std::endl;
+}
+
+std::string SpineLevel::getRanking() {
+	std::lock_guard<std::mutex> lg(_rankingLock);
+
+	if (_serializedRankingGeneration != _rankingGeneration) {
+		const size_t rankedCount = static_cast<size_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [](const RankingKey & key) {
+			return key.xp > 0;
+		}) - _rankingIndex.begin());
+
+		JsonWriter writer;
+		writer.startObject();
+		writeRanking(writer, 0, rankedCount);
+		writer.endObject();
+
+		_serializedRanking = writer.getString();
+		_serializedRankingGeneration = _rankingGeneration;
 	}
+
+	return _serializedRanking;
 }
 
-void SpineLevel::addRanking(ptree & json) {
+std::string SpineLevel::getRankingPage(size_t offset, size_t count) {
+	count = std::min(count, MAX_RANKING_PAGE_SIZE);
+
 	std::lock_guard<std::mutex> lg(_rankingLock);
 
-	std::sort(_rankings.begin(), _rankings.end(), [](const RankingEntry & a, const RankingEntry & b) {
-		return a.level > b.level || (a.level == b.level && a.xp > b.xp);
-	});
+	const size_t rankedCount = static_cast<size_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [](const RankingKey & key) {
+		return key.xp > 0;
+	}) - _rankingIndex.begin());
 
-	uint32_t rank = 0;
-	uint32_t lastXP = 0;
-	uint32_t realRank = 0;
+	const size_t begin = std::min(offset, rankedCount);
+	const size_t end = std::min(begin + count, rankedCount);
 
-	ptree rankingList;
-	
-	for (const auto & re : _rankings) {
-		if (re.xp == 0) break;
+	JsonWriter writer;
+	writer.startObject();
+	writeRanking(writer, begin, end);
+	writer.add("Total", rankedCount);
+	writer.endObject();
 
-		realRank++;
+	return writer.getString();
+}
 
-		if (re.xp != lastXP) {
-			rank = realRank;
-			lastXP = re.xp;
-		}
+std::string SpineLevel::getRankingAround(int userID, size_t count) {
+	count = std::min(count, MAX_RANKING_PAGE_SIZE / 2);
 
-		ptree rankingEntry;
+	std::lock_guard<std::mutex> lg(_rankingLock);
 
-		rankingEntry.put("Name", re.username);
-		rankingEntry.put("Level", re.level);
-		rankingEntry.put("XP", re.xp);
-		rankingEntry.put("Rank", rank);
+	const size_t rankedCount = static_cast<size_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [](const RankingKey & key) {
+		return key.xp > 0;
+	}) - _rankingIndex.begin());
 
-		rankingList.push_back(std::make_pair("", rankingEntry));
+	size_t begin = 0;
+	size_t end = 0;
+	uint32_t ownRank = 0;
+
+	const auto it = _rankings.find(userID);
+
+	if (it != _rankings.end() && it->second.xp > 0) {
+		const uint32_t xp = it->second.xp;
+
+		const size_t position = static_cast<size_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [xp, userID](const RankingKey & key) {
+			return compareRankingKeys(key.xp, key.userID, xp, userID);
+		}) - _rankingIndex.begin());
+
+		begin = position - std::min(position, count);
+		end = std::min(position + count + 1, rankedCount);
+
+		ownRank = static_cast<uint32_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [xp](const RankingKey & key) {
+			return key.xp > xp;
+		}) - _rankingIndex.begin()) + 1;
 	}
 
-	json.add_child("Names", rankingList);
+	JsonWriter writer;
+	writer.startObject();
+	writeRanking(writer, begin, end);
+	writer.add("OwnRank", ownRank);
+	writer.add("Total", rankedCount);
+	writer.endObject();
+
+	return writer.getString();
 }
 
-void SpineLevel::cacheLevel(int userID) {
-	SendUserLevelMessage sulm;
+uint32_t SpineLevel::getRank(int userID) {
+	std::lock_guard<std::mutex> lg(_rankingLock);
 
-	int level = 0;
-	uint32_t currentXP = 0;
+	const auto it = _rankings.find(userID);
 
-	do {
-		CONNECTTODATABASE(__LINE__)
-		
-		if (!database.query("PREPARE selectAchievementsStmt FROM \"SELECT COUNT(*) FROM modAchievements WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
-		}
-		if (!database.query("PREPARE selectAchievementListStmt FROM \"SELECT COUNT(*) FROM modAchievementList WHERE ModID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+	if (it == _rankings.end() || it->second.xp == 0) return 0;
+
+	const uint32_t xp = it->second.xp;
+
+	// users with the same XP share their rank
+	return static_cast<uint32_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [xp](const RankingKey & key) {
+		return key.xp > xp;
+	}) - _rankingIndex.begin()) + 1;
+}
+
+void SpineLevel::processUpdates() {
+	std::vector<std::pair<int, PendingUpdate>> batch;
+	batch.reserve(UPDATE_BATCH_SIZE);
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> ul(_updateQueueLock);
+
+			while (batch.empty()) {
+				_updateCondition.wait(ul, []() {
+					return !_updateQueue.empty();
+				});
+
+				// users another worker is calculating right now stay queued, so nobody is calculated twice at the same time
+				for (size_t i = _updateQueue.size(); i > 0 && batch.size() < UPDATE_BATCH_SIZE; i--) {
+					const int userID = _updateQueue.front();
+					_updateQueue.pop_front();
+
+					if (_processingUsers.find(userID) != _processingUsers.end()) {
+						_updateQueue.push_back(userID);
+						continue;
+					}
+
+					const auto it = _pendingUpdates.find(userID);
+
+					batch.emplace_back(userID, it->second);
+
+					_pendingUpdates.erase(it);
+					_processingUsers.insert(userID);
+				}
+
+				if (batch.empty()) {
+					_updateCondition.wait(ul); // woken up once another worker finished its batch
+				}
+			}
 		}
-		if (!database.query("PREPARE selectAchievementsPerModStmt FROM \"SELECT COUNT(*) FROM modAchievements WHERE UserID = ? AND ModID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		for (const auto & entry : batch) {
+			const bool success = cacheLevel(entry.first, entry.second.sources);
+
+			const auto latency = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - entry.second.queued).count());
+
+			std::lock_guard<std::mutex> lg(_updateQueueLock);
+
+			_processingUsers.erase(entry.first);
+
+			_statistics.processed++;
+
+			if (!success) {
+				_statistics.failed++;
+			}
+
+			_statistics.totalLatencyMicroseconds += latency;
+			_statistics.maxLatencyMicroseconds = std::max(_statistics.maxLatencyMicroseconds, latency);
 		}
-		if (!database.query("PREPARE selectAchievementWithModsStmt FROM \"SELECT DISTINCT ModID FROM modAchievements WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		batch.clear();
+
+		_updateCondition.notify_all();
+	}
+}
+
+bool SpineLevel::cacheLevel(int userID, int sources) {
+	XPComponents components = {};
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		if (_components.find(userID) == _components.end()) {
+			sources = All; // nothing to update incrementally yet
 		}
-		if (!database.query("PREPARE selectScoresStmt FROM \"SELECT Count(*) FROM modScores WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+	}
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		for (size_t i = 0; i < XPSOURCE_COUNT; i++) {
+			const auto source = static_cast<XPSource>(1 << i);
+
+			if ((sources & source) == 0) continue;
+
+			if (!calculateXP(database, userID, source, components[i])) return false;
 		}
-		if (!database.query("PREPARE selectRatingsStmt FROM \"SELECT Count(*) FROM ratings WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		storeLevel(userID, sources, components);
+
+		return true;
+	} while (false);
+
+	return false;
+}
+
+bool SpineLevel::verifyLevel(int userID) {
+	bool known = false;
+	uint32_t previousXP = 0;
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		const auto it = _levels.find(userID);
+
+		if (it != _levels.end()) {
+			known = true;
+			previousXP = it->second.currentXP;
 		}
-		if (!database.query("PREPARE selectReviewsStmt FROM \"SELECT Count(*) FROM reviews WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+	}
+
+	if (!cacheLevel(userID, All)) return false;
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	return known && _levels[userID].currentXP != previousXP;
+}
+
+bool SpineLevel::calculateXP(MariaDBWrapper & database, int userID, XPSource source, uint32_t & xp) {
+	const auto countRows = [&database, userID](const std::string & table, uint32_t & count) {
+		MariaDBStatement selectCountStmt(database, "SELECT COUNT(*) FROM " + table + " WHERE UserID = ?");
+		selectCountStmt.bind(userID);
+
+		if (!selectCountStmt.execute() || !selectCountStmt.fetch()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectCountStmt.getLastError() << std::endl;
+			return false;
 		}
-		if (!database.query("PREPARE selectCompatibilitiesStmt FROM \"SELECT Count(*) FROM compatibilityList WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+		count = static_cast<uint32_t>(selectCountStmt.getInt(0));
+
+		return true;
+	};
+
+	uint32_t count = 0;
+
+	switch (source) {
+	case Achievements: {
+		MariaDBStatement selectAchievementsStmt(database, "SELECT COUNT(*), (SELECT COUNT(*) FROM modAchievementList l WHERE l.ModID = a.ModID) FROM modAchievements a WHERE a.UserID = ? GROUP BY a.ModID");
+		selectAchievementsStmt.bind(userID);
+
+		if (!selectAchievementsStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectAchievementsStmt.getLastError() << std::endl;
+			return false;
 		}
-		if (!database.query("PREPARE selectPlayedModsWithTimeStmt FROM \"SELECT ModID, Duration FROM playtimes WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		xp = 0;
+
+		while (selectAchievementsStmt.fetch()) {
+			const int32_t unlockedAchievementCount = selectAchievementsStmt.getInt(0);
+			const int32_t achievementCount = selectAchievementsStmt.getInt(1);
+
+			xp += unlockedAchievementCount * 50; // 50 EP per achievement
+
+			if (unlockedAchievementCount == achievementCount) {
+				xp += 1000; // 1000 EP for perfect games
+			}
 		}
-		if (!database.query("PREPARE selectPlayTimesStmt FROM \"SELECT Duration FROM playtimes WHERE ModID = ? ORDER BY Duration ASC\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		return true;
+	}
+	case Scores: {
+		MariaDBStatement selectScoresStmt(database, "SELECT COUNT(*), EXISTS(SELECT * FROM cheaters WHERE UserID = ?) FROM modScores WHERE UserID = ?");
+		selectScoresStmt.bind(userID).bind(userID);
+
+		if (!selectScoresStmt.execute() || !selectScoresStmt.fetch()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectScoresStmt.getLastError() << std::endl;
+			return false;
 		}
-		if (!database.query("PREPARE selectDonationStmt FROM \"SELECT Amount FROM donations WHERE UserID = ? LIMIT 1\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		const bool cheater = selectScoresStmt.getInt(1) != 0;
+
+		xp = cheater ? 0 : selectScoresStmt.getInt(0) * 100; // 100 EP per score
+
+		return true;
+	}
+	case Ratings: {
+		if (!countRows("ratings", count)) return false;
+
+		xp = count * 250; // 250 EP per rating
+
+		return true;
+	}
+	case Reviews: {
+		if (!countRows("reviews", count)) return false;
+
+		xp = count * 250; // 250 EP per review for now, maybe more later, but can easily be abused by one letter reviews
+
+		return true;
+	}
+	case Compatibilities: {
+		if (!countRows("compatibilityList", count)) return false;
+
+		xp = count * 10; // 10 EP per compatibility list entry
+
+		return true;
+	}
+	case PlayTime: {
+		return calculatePlayTimeXP(database, userID, xp);
+	}
+	case UserVotes: {
+		if (!countRows("userVotes", count)) return false;
+
+		xp = count * 250;
+
+		return true;
+	}
+	case Supporter: {
+		return calculateSupporterXP(database, userID, xp);
+	}
+	default: {
+		return false;
+	}
+	}
+}
+
+bool SpineLevel::calculatePlayTimeXP(MariaDBWrapper & database, int userID, uint32_t & xp) {
+	// play time over median or even third quartile gives some bonus XP
+
+	std::vector<std::pair<int32_t, int32_t>> playTimes;
+
+	{
+		MariaDBStatement selectPlayedModsWithTimeStmt(database, "SELECT ModID, Duration FROM playtimes WHERE UserID = ?");
+		selectPlayedModsWithTimeStmt.bind(userID);
+
+		if (!selectPlayedModsWithTimeStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayedModsWithTimeStmt.getLastError() << std::endl;
+			return false;
 		}
-		if (!database.query("PREPARE selectCheaterStmt FROM \"SELECT UserID FROM cheaters WHERE UserID = ? LIMIT 1\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		while (selectPlayedModsWithTimeStmt.fetch()) {
+			playTimes.emplace_back(selectPlayedModsWithTimeStmt.getInt(0), selectPlayedModsWithTimeStmt.getInt(1));
 		}
-		if (!database.query("PREPARE selectUserVotesStmt FROM \"SELECT Count(*) FROM userVotes WHERE UserID = ?\";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+	}
+
+	uint32_t playTimeXP = 0;
+
+	for (const auto & p : playTimes) {
+		Quartiles quartiles;
+		bool found = false;
+
+		{
+			std::lock_guard<std::mutex> lg(_quartileLock);
+			const auto it = _quartiles.find(p.first);
+
+			if (it != _quartiles.end()) {
+				quartiles = it->second;
+				found = true;
+			}
 		}
-		
-		if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-			break;
+
+		if (!found) {
+			// first play time of the project since the last refresh
+			MariaDBStatement selectPlayTimesStmt(database, "SELECT Duration FROM playtimes WHERE ModID = ? ORDER BY Duration ASC");
+			selectPlayTimesStmt.bind(p.first);
+
+			if (!selectPlayTimesStmt.execute()) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayTimesStmt.getLastError() << std::endl;
+				return false;
+			}
+
+			std::vector<int32_t> durations;
+			durations.reserve(selectPlayTimesStmt.getRowCount());
+
+			while (selectPlayTimesStmt.fetch()) {
+				durations.push_back(selectPlayTimesStmt.getInt(0));
+			}
+
+			if (durations.empty()) continue;
+
+			quartiles = getQuartiles(durations);
+
+			std::lock_guard<std::mutex> lg(_quartileLock);
+			_quartiles[p.first] = quartiles;
 		}
-		if (!database.query("EXECUTE selectCheaterStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+
+		playTimeXP += getPlayTimeXP(p.second, quartiles);
+	}
+
+	xp = playTimeXP;
+
+	return true;
+}
+
+bool SpineLevel::calculateSupporterXP(MariaDBWrapper & database, int userID, uint32_t & xp) {
+	MariaDBStatement selectDonationStmt(database, "SELECT Amount FROM donations WHERE UserID = ? LIMIT 1");
+	selectDonationStmt.bind(userID);
+
+	if (!selectDonationStmt.execute()) {
+		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectDonationStmt.getLastError() << std::endl;
+		return false;
+	}
+
+	xp = 0;
+
+	if (selectDonationStmt.fetch()) {
+		xp += selectDonationStmt.getInt(0);
+	}
+
+	// the other databases are optional, XP from them just count as 0 if they aren't available
+
+	// Patreon also counts
+	do {
+		MariaDBWrapper accountDatabase;
+		if (!accountDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, ACCOUNTSDATABASE, 0)) {
 			break;
 		}
-		auto lastResults = database.getResults<std::vector<std::string>>();
-		const bool cheater = !lastResults.empty();
-		
-		if (!database.query("EXECUTE selectAchievementsStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+
+		MariaDBStatement selectStmt(accountDatabase, "SELECT LifetimeAmount FROM patronLevels WHERE ID = ? AND ProjectID = 0 LIMIT 1");
+		selectStmt.bind(userID);
+
+		if (!selectStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectStmt.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			const int count = std::stoi(lastResults[0][0]);
-			currentXP += count * 50; // 50 EP per achievement
+
+		if (selectStmt.fetch()) {
+			xp += selectStmt.getInt(0);
 		}
+	} while (false);
 
-		// perfect games (all achievements)
-		if (!database.query("EXECUTE selectAchievementWithModsStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+	// bonus XP for people that support us by playing our games
+	do {
+		MariaDBWrapper ewDatabase;
+		if (!ewDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, EWDATABASE, 0)) {
+			std::cout << "Couldn't connect to database: " << __LINE__ << " " << ewDatabase.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		for (const auto & vec : lastResults) {
-			if (!database.query("SET @paramModID=" + vec[0] + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE selectAchievementListStmt USING @paramModID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			auto r = database.getResults<std::vector<std::string>>();
-			const uint32_t achievementCount = std::stoi(r[0][0]);
-			
-			if (!database.query("EXECUTE selectAchievementsPerModStmt USING @paramUserID, @paramModID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			r = database.getResults<std::vector<std::string>>();
-			const uint32_t unlockedAchievementCount = std::stoi(r[0][0]);
 
-			if (unlockedAchievementCount == achievementCount) {
-				currentXP += 1000; // 1000 EP for perfect games
-			}
-		}
-		
-		if (!database.query("EXECUTE selectScoresStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+		MariaDBStatement selectPlayedTimeStmt(ewDatabase, "SELECT Time FROM playTimes WHERE UserID = ? LIMIT 1");
+		selectPlayedTimeStmt.bind(userID);
+
+		if (!selectPlayedTimeStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayedTimeStmt.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty() && !cheater) {
-			const int count = std::stoi(lastResults[0][0]);
-			
-			currentXP += count * 100; // 100 EP per score
+
+		if (selectPlayedTimeStmt.fetch()) {
+			xp += 1000;
 		}
-		
-		if (!database.query("EXECUTE selectRatingsStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+	} while (false);
+
+	do {
+		MariaDBWrapper tri6Database;
+		if (!tri6Database.connect("localhost", DATABASEUSER, DATABASEPASSWORD, TRI6DATABASE, 0)) {
+			std::cout << "Couldn't connect to database: " << __LINE__ << " " << tri6Database.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			const int count = std::stoi(lastResults[0][0]);
-			
-			currentXP += count * 250; // 250 EP per rating
-		}
 
-		if (!database.query("EXECUTE selectReviewsStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+		MariaDBStatement selectPlayedTimeStmt(tri6Database, "SELECT Time FROM playTimes WHERE UserID = ? LIMIT 1");
+		selectPlayedTimeStmt.bind(userID);
+
+		if (!selectPlayedTimeStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayedTimeStmt.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			const int count = std::stoi(lastResults[0][0]);
 
-			currentXP += count * 250; // 250 EP per review for now, maybe more later, but can easily be abused by one letter reviews
-		}
-		
-		if (!database.query("EXECUTE selectCompatibilitiesStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+		if (selectPlayedTimeStmt.fetch()) {
+			xp += 1000;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			const int count = std::stoi(lastResults[0][0]);
-			
-			currentXP += count * 10; // 10 EP per compatibility list entry
-		}
 
-		// play time over median or even third quartile gives some bonus XP
-		
-		if (!database.query("EXECUTE selectPlayedModsWithTimeStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+		MariaDBStatement selectPlayedTimeDemoStmt(tri6Database, "SELECT Time FROM playTimesDemo WHERE UserID = ? LIMIT 1");
+		selectPlayedTimeDemoStmt.bind(userID);
+
+		if (!selectPlayedTimeDemoStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayedTimeDemoStmt.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		for (const auto & vec : lastResults) {
-			const int ownDuration = std::stoi(vec[1]);
-			if (!database.query("SET @paramModID=" + vec[0] + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE selectPlayTimesStmt USING @paramModID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			const auto r = database.getResults<std::vector<std::string>>();
-			const int firstQuartile = std::stoi(r[r.size() / 4][0]);
-			const int median = std::stoi(r[r.size() / 2][0]);
-			const int thirdQuartile = std::stoi(r[(r.size() * 3) / 4][0]);
-
-			if (ownDuration > thirdQuartile) {
-				currentXP += 100;
-			} else if (ownDuration > median) {
-				currentXP += 50;
-			} else if (ownDuration > firstQuartile) {
-				currentXP += 25;
-			} else {
-				currentXP += 10;
-			}
-		}
-		if (!database.query("EXECUTE selectDonationStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-			break;
+
+		if (selectPlayedTimeDemoStmt.fetch()) {
+			xp += 250;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			currentXP += std::stoi(lastResults[0][0]);
+	} while (false);
+
+	return true;
+}
+
+SpineLevel::Quartiles SpineLevel::getQuartiles(const std::vector<int32_t> & sortedDurations) {
+	Quartiles quartiles;
+	quartiles.firstQuartile = sortedDurations[sortedDurations.size() / 4];
+	quartiles.median = sortedDurations[sortedDurations.size() / 2];
+	quartiles.thirdQuartile = sortedDurations[(sortedDurations.size() * 3) / 4];
+
+	return quartiles;
+}
+
+uint32_t SpineLevel::getPlayTimeXP(int32_t duration, const Quartiles & quartiles) {
+	if (duration > quartiles.thirdQuartile) return 100;
+
+	if (duration > quartiles.median) return 50;
+
+	if (duration > quartiles.firstQuartile) return 25;
+
+	return 10;
+}
+
+void SpineLevel::refreshQuartiles() {
+	std::map<int, uint32_t> playTimeXP; // UserID => XP, only for users that can be updated incrementally
+
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		for (const auto & p : _components) {
+			playTimeXP.insert(std::make_pair(p.first, 0));
 		}
-		
-		if (!database.query("EXECUTE selectUserVotesStmt USING @paramUserID;")) {
-			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+	}
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement selectPlayTimesStmt(database, "SELECT ModID, UserID, Duration FROM playtimes ORDER BY ModID, Duration ASC");
+
+		if (!selectPlayTimesStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << selectPlayTimesStmt.getLastError() << std::endl;
 			break;
 		}
-		lastResults = database.getResults<std::vector<std::string>>();
-		if (!lastResults.empty()) {
-			currentXP += std::stoi(lastResults[0][0]) * 250;
-		}
 
-		// Patreon also counts
-		{
-			MariaDBWrapper accountDatabase;
-			if (!accountDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, ACCOUNTSDATABASE, 0)) {
-				break;
-			}
+		std::map<int32_t, Quartiles> quartiles;
+		std::vector<int32_t> durations;
+		std::vector<int> users;
 
-			if (!accountDatabase.query("PREPARE selectStmt FROM \"SELECT LifetimeAmount FROM patronLevels WHERE ID = ? AND ProjectID = 0 LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!accountDatabase.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!accountDatabase.query("EXECUTE selectStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
+		const auto finishProject = [&quartiles, &durations, &users, &playTimeXP](int32_t projectID) {
+			if (durations.empty()) return;
+
+			const Quartiles q = getQuartiles(durations);
+			quartiles[projectID] = q;
+
+			for (size_t i = 0; i < users.size(); i++) {
+				const auto it = playTimeXP.find(users[i]);
+
+				if (it == playTimeXP.end()) continue;
+
+				it->second += getPlayTimeXP(durations[i], q);
 			}
-			const auto results = accountDatabase.getResults<std::vector<std::string>>();
 
-			if (!results.empty()) {
-				currentXP += std::stoi(results[0][0]);
+			durations.clear();
+			users.clear();
+		};
+
+		int32_t projectID = 0;
+
+		while (selectPlayTimesStmt.fetch()) {
+			const int32_t currentProjectID = selectPlayTimesStmt.getInt(0);
+
+			if (currentProjectID != projectID) {
+				finishProject(projectID);
+				projectID = currentProjectID;
 			}
+
+			users.push_back(selectPlayTimesStmt.getInt(1));
+			durations.push_back(selectPlayTimesStmt.getInt(2));
 		}
 
-		// bonus XP for people that support us by playing our games
+		finishProject(projectID);
+
 		{
-			MariaDBWrapper ewDatabase;
-			if (!ewDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, EWDATABASE, 0)) {
-				std::cout << "Couldn't connect to database: " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!ewDatabase.query("PREPARE selectPlayedTimeStmt FROM \"SELECT Time FROM playTimes WHERE UserID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-		
-			if (!ewDatabase.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!ewDatabase.query("EXECUTE selectPlayedTimeStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			const auto r = ewDatabase.getResults<std::vector<std::string>>();
-			if (!r.empty()) {
-				currentXP += 1000;
-			}
+			std::lock_guard<std::mutex> lg(_quartileLock);
+			_quartiles.swap(quartiles);
 		}
-		{
-			MariaDBWrapper tri6Database;
-			if (!tri6Database.connect("localhost", DATABASEUSER, DATABASEPASSWORD, TRI6DATABASE, 0)) {
-				std::cout << "Couldn't connect to database: " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!tri6Database.query("PREPARE selectPlayedTimeStmt FROM \"SELECT Time FROM playTimes WHERE UserID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!tri6Database.query("PREPARE selectPlayedTimeDemoStmt FROM \"SELECT Time FROM playTimesDemo WHERE UserID = ? LIMIT 1\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-		
-			if (!tri6Database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!tri6Database.query("EXECUTE selectPlayedTimeStmt USING @paramUserID;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-			auto r = tri6Database.getResults<std::vector<std::string>>();
-			if (!r.empty()) {
-				currentXP += 1000;
-			} else {
-				if (!tri6Database.query("EXECUTE selectPlayedTimeDemoStmt USING @paramUserID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-					break;
-				}
-				r = tri6Database.getResults<std::vector<std::string>>();
-				if (!r.empty()) {
-					currentXP += 250;
-				}
+
+		// new quartiles change the play time XP of everybody who played these projects, not only of the ones playing right now
+		const size_t playTimeIndex = getSourceIndex(PlayTime);
+
+		for (const auto & p : playTimeXP) {
+			{
+				std::lock_guard<std::mutex> lg(_lock);
+				const auto it = _components.find(p.first);
+
+				if (it == _components.end() || it->second[playTimeIndex] == p.second) continue;
 			}
+
+			XPComponents components = {};
+			components[playTimeIndex] = p.second;
+
+			storeLevel(p.first, PlayTime, components);
 		}
 	} while (false);
+}
+
+void SpineLevel::storeLevel(int userID, int sources, const XPComponents & components) {
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		// other sources may have been recalculated in the meantime by another thread, so only the recalculated ones are taken over
+		XPComponents & storedComponents = _components[userID];
+
+		for (size_t i = 0; i < XPSOURCE_COUNT; i++) {
+			if ((sources & (1 << i)) == 0) continue;
+
+			storedComponents[i] = components[i];
+		}
+
+		const SendUserLevelMessage sulm = calculateLevel(storedComponents);
+
+		const auto it = _levels.find(userID);
+
+		// nothing to write, happens for most users during verification
+		if (it != _levels.end() && it->second.level == sulm.level && it->second.currentXP == sulm.currentXP && it->second.nextXP == sulm.nextXP) return;
+
+		_levels[userID] = sulm;
+	}
+
+	const auto username = ServerCommon::getUsername(userID);
+
+	if (username.empty()) return;
+
+	// a concurrent update of the same user may have finished while the username was loaded, so always the latest level is written
+	SendUserLevelMessage sulm;
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		sulm = _levels[userID];
+	}
+
+	const int level = sulm.level;
+	const uint32_t currentXP = sulm.currentXP;
+	const uint32_t nextXP = sulm.nextXP;
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement insertStmt(database, "INSERT INTO levels (UserID, Level, XP, NextXP) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Level = VALUES(Level), XP = VALUES(XP), NextXP = VALUES(NextXP)");
+		insertStmt.bind(userID).bind(level).bind(static_cast<int64_t>(currentXP)).bind(static_cast<int64_t>(nextXP));
+
+		if (!insertStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << insertStmt.getLastError() << std::endl;
+			break;
+		}
+	} while (false);
+
+	std::lock_guard<std::mutex> lg(_rankingLock);
+
+	RankingEntry re;
+	re.userID = userID;
+	re.username = username;
+
+	{
+		// read again under _rankingLock, so a slower update of the same user can't rank an outdated level last
+		std::lock_guard<std::mutex> lgLevel(_lock);
+		re.xp = _levels[userID].currentXP;
+		re.level = _levels[userID].level;
+	}
+
+	updateRanking(re);
+}
+
+SendUserLevelMessage SpineLevel::calculateLevel(const XPComponents & components) {
+	uint32_t currentXP = 0;
+
+	for (const uint32_t xp : components) {
+		currentXP += xp;
+	}
+
+	int level = 0;
 
 	uint32_t nextXP = 500;
 	while (currentXP >= nextXP) {
 		level++;
 		nextXP += (level + 1) * 500;
 	}
-	
+
+	SendUserLevelMessage sulm;
 	sulm.level = level;
 	sulm.currentXP = currentXP;
 	sulm.nextXP = nextXP;
 
-	const auto username = ServerCommon::getUsername(userID);
+	return sulm;
+}
 
-	if (!username.empty()) {
-		do {
-			CONNECTTODATABASE(__LINE__)
-			
-			if (!database.query("PREPARE insertStmt FROM \"INSERT INTO levels (UserID, Level, XP, NextXP) VALUES (?, ?, ?, ?) ON DUPLICATE KEY UPDATE Level = ?, XP = ?, NextXP = ?\";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			
-			if (!database.query("SET @paramUserID=" + std::to_string(userID) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("SET @paramLevel=" + std::to_string(level) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("SET @paramCurrentXP=" + std::to_string(currentXP) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("SET @paramNextXP=" + std::to_string(nextXP) + ";")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
-				break;
-			}
-			if (!database.query("EXECUTE insertStmt USING @paramUserID, @paramLevel, @paramCurrentXP, @paramNextXP, @paramLevel, @paramCurrentXP, @paramNextXP;")) {
-				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
-				break;
-			}
-		} while (false);
-	}
+void SpineLevel::updateRanking(const RankingEntry & entry) {
+	const auto compare = [](const RankingKey & a, const RankingKey & b) {
+		return compareRankingKeys(a.xp, a.userID, b.xp, b.userID);
+	};
 
-	{
-		std::lock_guard<std::mutex> lg(_lock);
-		_levels[userID] = sulm;
+	const auto it = _rankings.find(entry.userID);
+
+	if (it != _rankings.end()) {
+		if (it->second.xp == entry.xp && it->second.level == entry.level && it->second.username == entry.username) return;
+
+		RankingKey oldKey;
+		oldKey.xp = it->second.xp;
+		oldKey.userID = entry.userID;
+
+		const auto oldPosition = std::lower_bound(_rankingIndex.begin(), _rankingIndex.end(), oldKey, compare);
+
+		if (oldPosition != _rankingIndex.end() && oldPosition->userID == entry.userID) {
+			_rankingIndex.erase(oldPosition);
+		}
+
+		it->second = entry;
+	} else {
+		_rankings.insert(std::make_pair(entry.userID, entry));
 	}
 
-	if (!username.empty()) {
-		std::lock_guard<std::mutex> lg(_rankingLock);
-		
-		const auto it = std::find_if(_rankings.begin(), _rankings.end(), [userID](const RankingEntry & re) {
-			return re.userID == userID;
-		});
-		
-		if (it == _rankings.end()) {
-			RankingEntry re;
-			re.userID = userID;
-			re.xp = currentXP;
-			re.level = level;
-			re.username = username;
-			
-			_rankings.push_back(re);
-		} else {
-			it->xp = currentXP;
-			it->level = level;
+	RankingKey key;
+	key.xp = entry.xp;
+	key.userID = entry.userID;
+
+	_rankingIndex.insert(std::upper_bound(_rankingIndex.begin(), _rankingIndex.end(), key, compare), key);
+
+	_rankingGeneration++;
+}
+
+void SpineLevel::writeRanking(JsonWriter & writer, size_t begin, size_t end) {
+	writer.startArray("Names");
+
+	if (begin < end) {
+		const uint32_t firstXP = _rankingIndex[begin].xp;
+
+		// users with the same XP share their rank
+		uint32_t rank = static_cast<uint32_t>(std::partition_point(_rankingIndex.begin(), _rankingIndex.end(), [firstXP](const RankingKey & key) {
+			return key.xp > firstXP;
+		}) - _rankingIndex.begin()) + 1;
+
+		for (size_t i = begin; i < end; i++) {
+			const RankingKey & key = _rankingIndex[i];
+
+			if (i > begin && key.xp != _rankingIndex[i - 1].xp) {
+				rank = static_cast<uint32_t>(i) + 1;
+			}
+
+			const RankingEntry & re = _rankings[key.userID];
+
+			writer.startObject();
+			writer.add("Name", re.username);
+			writer.add("Level", re.level);
+			writer.add("XP", re.xp);
+			writer.add("Rank", rank);
+			writer.endObject();
 		}
 	}
+
+	writer.endArray();
 }
@@ -0,0 +1,517 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "TelemetryWriter.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+#include "MariaDBStatement.h"
+#include "MariaDBWrapper.h"
+#include "ServerCommon.h"
+#include "SpineLevel.h"
+
+using namespace spine::server;
+
+namespace {
+	int32_t getCurrentHour() {
+		return static_cast<int32_t>(std::chrono::duration_cast<std::chrono::hours>(std::chrono::system_clock::now() - std::chrono::system_clock::time_point()).count());
+	}
+
+	template<typename Container>
+	std::string joinIDs(const Container & ids) {
+		std::string result;
+
+		for (const int32_t id : ids) {
+			if (!result.empty()) {
+				result += ", ";
+			}
+			result += std::to_string(id);
+		}
+
+		return result;
+	}
+}
+
+const std::chrono::seconds TelemetryWriter::FLUSH_INTERVAL(10);
+const std::chrono::milliseconds TelemetryWriter::MAX_BLOCKING_TIME(500);
+
+std::mutex TelemetryWriter::_lock;
+std::condition_variable TelemetryWriter::_flushCondition;
+std::condition_variable TelemetryWriter::_capacityCondition;
+std::thread TelemetryWriter::_writer;
+bool TelemetryWriter::_running = false;
+TelemetryWriter::Batch TelemetryWriter::_pending;
+TelemetryWriter::Statistics TelemetryWriter::_statistics = {};
+int TelemetryWriter::_failedFlushes = 0;
+thread_local std::vector<std::function<void()>> * TelemetryWriter::_deferred = nullptr;
+
+TelemetryWriter::Deferral::Deferral() : _previous(_deferred), _active(true) {
+	_deferred = &_updates;
+}
+
+TelemetryWriter::Deferral::~Deferral() {
+	deactivate(); // not committed, so the updates are dropped
+}
+
+void TelemetryWriter::Deferral::commit() {
+	deactivate();
+
+	// an enclosing Deferral is active again at this point and holds the updates back until it is committed itself
+	for (const auto & update : _updates) {
+		update();
+	}
+	_updates.clear();
+}
+
+void TelemetryWriter::Deferral::deactivate() {
+	if (!_active) return;
+
+	_active = false;
+	_deferred = _previous;
+}
+
+void TelemetryWriter::start() {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	if (_running) return;
+
+	_running = true;
+	_writer = std::thread(&TelemetryWriter::run);
+}
+
+void TelemetryWriter::stop() {
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+
+		if (!_running) return;
+
+		_running = false;
+	}
+	_flushCondition.notify_one();
+	_writer.join();
+
+	const Statistics statistics = getStatistics();
+
+	std::cout << "TelemetryWriter: " << statistics.enqueued << " updates, " << statistics.coalesced << " coalesced, " << statistics.blocked << " blocked, " << statistics.dropped << " dropped, " << statistics.writtenRows << " rows written, " << statistics.rejectedRows << " rejected in " << statistics.flushes << " flushes (" << statistics.failedFlushes << " failed), at most " << statistics.maxPendingRows << " rows pending" << std::endl;
+}
+
+void TelemetryWriter::addPlayTime(int32_t userID, const std::vector<int32_t> & projectIDs, int32_t duration) {
+	if (defer([=]() { addPlayTime(userID, projectIDs, duration); })) return;
+
+	const int32_t timestamp = getCurrentHour();
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	for (const int32_t projectID : projectIDs) {
+		addCounter(_pending.playTimes, std::make_pair(projectID, userID), duration);
+		_pending.sessionTimes.emplace_back(projectID, duration);
+		setValue(_pending.lastPlayTimes, std::make_pair(projectID, userID), timestamp);
+	}
+
+	enqueued();
+}
+
+void TelemetryWriter::addLoginTime(int32_t userID) {
+	if (defer([=]() { addLoginTime(userID); })) return;
+
+	const int32_t timestamp = getCurrentHour();
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	setValue(_pending.loginTimes, userID, timestamp);
+
+	enqueued();
+}
+
+void TelemetryWriter::addLinkClick(int32_t newsID, const std::string & url) {
+	if (defer([=]() { addLinkClick(newsID, url); })) return;
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	addCounter(_pending.linkClicks, std::make_pair(newsID, url), 1);
+
+	enqueued();
+}
+
+void TelemetryWriter::addDownload(int32_t projectID) {
+	if (defer([=]() { addDownload(projectID); })) return;
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	addCounter(_pending.downloads, projectID, 1);
+	addCounter(_pending.versionDownloads, projectID, 1);
+
+	enqueued();
+}
+
+void TelemetryWriter::addUpdate(int32_t projectID) {
+	if (defer([=]() { addUpdate(projectID); })) return;
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	addCounter(_pending.versionDownloads, projectID, 1);
+
+	enqueued();
+}
+
+void TelemetryWriter::addPackageDownload(int32_t packageID) {
+	if (defer([=]() { addPackageDownload(packageID); })) return;
+
+	std::unique_lock<std::mutex> ul(_lock);
+
+	if (!waitForCapacity(ul)) return;
+
+	addCounter(_pending.packageDownloads, packageID, 1);
+
+	enqueued();
+}
+
+TelemetryWriter::Statistics TelemetryWriter::getStatistics() {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	Statistics statistics = _statistics;
+	statistics.pendingRows = getSize(_pending);
+
+	return statistics;
+}
+
+bool TelemetryWriter::defer(const std::function<void()> & update) {
+	if (!_deferred) return false;
+
+	_deferred->push_back(update);
+
+	return true;
+}
+
+void TelemetryWriter::run() {
+	std::unique_lock<std::mutex> ul(_lock);
+
+	bool lastFlushFailed = false;
+
+	while (_running) {
+		// after a failure only retry once the interval is over instead of hammering a database that is down
+		_flushCondition.wait_for(ul, FLUSH_INTERVAL, [&lastFlushFailed]() {
+			return !_running || (!lastFlushFailed && getSize(_pending) >= FLUSH_THRESHOLD);
+		});
+
+		lastFlushFailed = !flush(ul);
+	}
+
+	if (!flush(ul)) {
+		std::cout << "TelemetryWriter: lost " << getSize(_pending) << " rows on shutdown" << std::endl;
+	}
+}
+
+bool TelemetryWriter::flush(std::unique_lock<std::mutex> & ul) {
+	if (getSize(_pending) == 0) return true;
+
+	Batch batch;
+	std::swap(batch, _pending);
+
+	const bool lastAttempt = _failedFlushes + 1 >= MAX_FAILED_FLUSHES;
+
+	ul.unlock();
+	_capacityCondition.notify_all();
+
+	const WriteResult result = write(batch);
+
+	Batch remaining;
+	uint64_t rejected = 0;
+
+	if (result == WriteResult::Rejected || (result == WriteResult::Transient && lastAttempt)) {
+		// a single row the database refuses would make every later batch fail as well, so it has to be found and dropped
+		writeSingleRows(batch, remaining, rejected);
+	} else if (result == WriteResult::Transient) {
+		remaining = batch;
+	}
+
+	ul.lock();
+
+	_statistics.flushes++;
+	_statistics.writtenRows += getSize(batch) - getSize(remaining) - rejected;
+	_statistics.rejectedRows += rejected;
+
+	if (result != WriteResult::Written) {
+		_statistics.failedFlushes++;
+	}
+
+	if (getSize(remaining) == 0) {
+		_failedFlushes = 0;
+		return true;
+	}
+
+	_failedFlushes++;
+	merge(_pending, remaining);
+
+	return false;
+}
+
+TelemetryWriter::WriteResult TelemetryWriter::write(const Batch & batch) {
+	WriteResult result = WriteResult::Transient;
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		if (!database.query("START TRANSACTION;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			break;
+		}
+
+		result = writeRows(database, batch);
+
+		if (!database.query(result == WriteResult::Written ? "COMMIT;" : "ROLLBACK;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+
+			if (result == WriteResult::Written) {
+				result = WriteResult::Transient;
+			}
+			break;
+		}
+
+		if (result == WriteResult::Written) {
+			updateLevels(batch);
+		}
+	} while (false);
+
+	return result;
+}
+
+void TelemetryWriter::writeSingleRows(const Batch & batch, Batch & remaining, uint64_t & rejected) {
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		for (const Batch & row : split(batch)) {
+			const WriteResult result = writeRows(database, row);
+
+			if (result == WriteResult::Written) {
+				updateLevels(row);
+			} else if (result == WriteResult::Transient) {
+				merge(remaining, row);
+			} else {
+				std::cout << "TelemetryWriter: dropping row refused by the database" << std::endl;
+				rejected++;
+			}
+		}
+
+		return;
+	} while (false);
+
+	merge(remaining, batch);
+}
+
+TelemetryWriter::WriteResult TelemetryWriter::writeRows(MariaDBWrapper & database, const Batch & batch) {
+	std::map<int32_t, std::string> versions;
+
+	if (!batch.versionDownloads.empty()) {
+		std::set<int32_t> projectIDs;
+
+		for (const auto & p : batch.versionDownloads) {
+			projectIDs.insert(p.first);
+		}
+
+		if (!database.query("SELECT ModID, MajorVersion, MinorVersion, PatchVersion FROM mods WHERE ModID IN (" + joinIDs(projectIDs) + ");")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			return database.isTransientError() ? WriteResult::Transient : WriteResult::Rejected;
+		}
+		const auto results = database.getResults<std::vector<std::string>>();
+
+		for (const auto & vec : results) {
+			versions[std::stoi(vec[0])] = vec[1] + "." + vec[2] + "." + vec[3];
+		}
+	}
+
+	std::vector<std::string> rows;
+	WriteResult result = WriteResult::Written;
+
+	const auto collect = [&rows](const std::string & row) {
+		rows.push_back(row);
+	};
+	const auto insert = [&rows, &result, &database](const std::string & statement, const std::string & onDuplicateKey) {
+		if (result == WriteResult::Written) {
+			result = insertRows(database, statement, rows, onDuplicateKey);
+		}
+		rows.clear();
+	};
+
+	for (const auto & p : batch.playTimes) {
+		collect("(" + std::to_string(p.first.first) + ", " + std::to_string(p.first.second) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO playtimes (ModID, UserID, Duration) VALUES ", " ON DUPLICATE KEY UPDATE Duration = Duration + VALUES(Duration)");
+
+	for (const auto & p : batch.sessionTimes) {
+		collect("(" + std::to_string(p.first) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO sessionTimes (ModID, Duration) VALUES ", "");
+
+	for (const auto & p : batch.lastPlayTimes) {
+		collect("(" + std::to_string(p.first.first) + ", " + std::to_string(p.first.second) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO lastPlayTimes (ModID, UserID, Timestamp) VALUES ", " ON DUPLICATE KEY UPDATE Timestamp = VALUES(Timestamp)");
+
+	for (const auto & p : batch.loginTimes) {
+		collect("(" + std::to_string(p.first) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO lastLoginTimes (UserID, Timestamp) VALUES ", " ON DUPLICATE KEY UPDATE Timestamp = VALUES(Timestamp)");
+
+	for (const auto & p : batch.downloads) {
+		collect("(" + std::to_string(p.first) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO downloads (ModID, Counter) VALUES ", " ON DUPLICATE KEY UPDATE Counter = Counter + VALUES(Counter)");
+
+	for (const auto & p : batch.versionDownloads) {
+		const auto it = versions.find(p.first);
+
+		if (it == versions.end()) continue;
+
+		collect("(" + std::to_string(p.first) + ", CONVERT('" + it->second + "' USING BINARY), " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO downloadsPerVersion (ModID, Version, Counter) VALUES ", " ON DUPLICATE KEY UPDATE Counter = Counter + VALUES(Counter)");
+
+	for (const auto & p : batch.packageDownloads) {
+		collect("(" + std::to_string(p.first) + ", " + std::to_string(p.second) + ")");
+	}
+	insert("INSERT INTO packagedownloads (PackageID, Counter) VALUES ", " ON DUPLICATE KEY UPDATE Counter = Counter + VALUES(Counter)");
+
+	if (result == WriteResult::Written && !batch.linkClicks.empty()) {
+		// urls are user input, so they are bound instead of being part of a multi-row statement
+		MariaDBStatement insertLinkClickStmt(database, "INSERT INTO linksClicked (NewsID, Url, Counter) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE Counter = Counter + VALUES(Counter)");
+
+		for (const auto & p : batch.linkClicks) {
+			insertLinkClickStmt.reset();
+			insertLinkClickStmt.bind(p.first.first).bind(p.first.second).bind(p.second);
+
+			if (!insertLinkClickStmt.execute()) {
+				std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << insertLinkClickStmt.getLastError() << std::endl;
+				result = insertLinkClickStmt.isTransientError() ? WriteResult::Transient : WriteResult::Rejected;
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+TelemetryWriter::WriteResult TelemetryWriter::insertRows(MariaDBWrapper & database, const std::string & insert, const std::vector<std::string> & rows, const std::string & onDuplicateKey) {
+	for (size_t i = 0; i < rows.size(); i += ROWS_PER_STATEMENT) {
+		const size_t end = std::min(rows.size(), i + ROWS_PER_STATEMENT);
+
+		std::string query = insert;
+
+		for (size_t j = i; j < end; j++) {
+			if (j > i) {
+				query += ", ";
+			}
+			query += rows[j];
+		}
+		query += onDuplicateKey + ";";
+
+		if (!database.query(query)) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << " " << database.getLastError() << std::endl;
+			return database.isTransientError() ? WriteResult::Transient : WriteResult::Rejected;
+		}
+	}
+
+	return WriteResult::Written;
+}
+
+void TelemetryWriter::updateLevels(const Batch & batch) {
+	// the other players of the projects follow with the next refresh of the play time quartiles
+	for (const auto & p : batch.playTimes) {
+		SpineLevel::updateLevel(p.first.second, SpineLevel::PlayTime);
+	}
+}
+
+bool TelemetryWriter::waitForCapacity(std::unique_lock<std::mutex> & ul) {
+	if (getSize(_pending) < MAX_PENDING_ROWS) return true;
+
+	_statistics.blocked++;
+	_flushCondition.notify_one();
+
+	if (_capacityCondition.wait_for(ul, MAX_BLOCKING_TIME, []() { return getSize(_pending) < MAX_PENDING_ROWS; })) return true;
+
+	_statistics.dropped++;
+
+	return false;
+}
+
+void TelemetryWriter::enqueued() {
+	_statistics.enqueued++;
+
+	const size_t pendingRows = getSize(_pending);
+	_statistics.maxPendingRows = std::max(_statistics.maxPendingRows, pendingRows);
+
+	if (pendingRows >= FLUSH_THRESHOLD) {
+		_flushCondition.notify_one();
+	}
+}
+
+size_t TelemetryWriter::getSize(const Batch & batch) {
+	return batch.playTimes.size() + batch.sessionTimes.size() + batch.lastPlayTimes.size() + batch.loginTimes.size() + batch.linkClicks.size() + batch.downloads.size() + batch.versionDownloads.size() + batch.packageDownloads.size();
+}
+
+void TelemetryWriter::merge(Batch & target, const Batch & source) {
+	for (const auto & p : source.playTimes) {
+		target.playTimes[p.first] += p.second;
+	}
+	target.sessionTimes.insert(target.sessionTimes.end(), source.sessionTimes.begin(), source.sessionTimes.end());
+
+	// timestamps in target are newer, they were added while source was written
+	target.lastPlayTimes.insert(source.lastPlayTimes.begin(), source.lastPlayTimes.end());
+	target.loginTimes.insert(source.loginTimes.begin(), source.loginTimes.end());
+
+	for (const auto & p : source.linkClicks) {
+		target.linkClicks[p.first] += p.second;
+	}
+	for (const auto & p : source.downloads) {
+		target.downloads[p.first] += p.second;
+	}
+	for (const auto & p : source.versionDownloads) {
+		target.versionDownloads[p.first] += p.second;
+	}
+	for (const auto & p : source.packageDownloads) {
+		target.packageDownloads[p.first] += p.second;
+	}
+}
+
+std::vector<TelemetryWriter::Batch> TelemetryWriter::split(const Batch & batch) {
+	std::vector<Batch> result;
+	result.reserve(getSize(batch));
+
+	split(batch.playTimes, &Batch::playTimes, result);
+	split(batch.sessionTimes, &Batch::sessionTimes, result);
+	split(batch.lastPlayTimes, &Batch::lastPlayTimes, result);
+	split(batch.loginTimes, &Batch::loginTimes, result);
+	split(batch.linkClicks, &Batch::linkClicks, result);
+	split(batch.downloads, &Batch::downloads, result);
+	split(batch.versionDownloads, &Batch::versionDownloads, result);
+	split(batch.packageDownloads, &Batch::packageDownloads, result);
+
+	return result;
+}
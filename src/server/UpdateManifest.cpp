@@ -0,0 +1,145 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "UpdateManifest.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+
+#include "common/MessageStructs.h"
+
+#include "boost/filesystem.hpp"
+
+#include "tinyxml2.h"
+
+using namespace spine::common;
+using namespace spine::server;
+
+namespace {
+	const std::string MANIFEST_FILE = "Spine_Version.xml";
+}
+
+std::mutex UpdateManifest::_lock;
+std::shared_ptr<const UpdateManifest::Index> UpdateManifest::_index;
+std::time_t UpdateManifest::_lastWriteTime = 0;
+
+void UpdateManifest::init() {
+	getIndex();
+}
+
+std::string UpdateManifest::getSerializedUpdate(uint8_t majorVersion, uint8_t minorVersion, uint8_t patchVersion, WireFormat format) {
+	const auto index = getIndex();
+
+	if (!index) {
+		UpdateFileCountMessage ufcm;
+		ufcm.count = 0;
+
+		return ufcm.SerializeBlank(format);
+	}
+
+	const uint32_t version = (majorVersion << 16) + (minorVersion << 8) + patchVersion;
+
+	// everything newer than the version of the client
+	const auto it = std::upper_bound(index->versions.begin(), index->versions.end(), version);
+
+	return index->updates[static_cast<size_t>(format)][static_cast<size_t>(it - index->versions.begin())];
+}
+
+std::shared_ptr<const UpdateManifest::Index> UpdateManifest::getIndex() {
+	boost::system::error_code ec;
+	const std::time_t lastWriteTime = boost::filesystem::last_write_time(MANIFEST_FILE, ec);
+
+	std::lock_guard<std::mutex> lg(_lock);
+
+	if (ec) {
+		std::cerr << "Couldn't open xml file!" << std::endl;
+		_index = nullptr;
+		_lastWriteTime = 0;
+
+		return nullptr;
+	}
+
+	if (!_index || lastWriteTime != _lastWriteTime) {
+		_index = load();
+		_lastWriteTime = _index ? lastWriteTime : 0;
+	}
+
+	return _index;
+}
+
+std::shared_ptr<const UpdateManifest::Index> UpdateManifest::load() {
+	tinyxml2::XMLDocument doc;
+
+	const tinyxml2::XMLError e = doc.LoadFile(MANIFEST_FILE.c_str());
+
+	if (e) {
+		std::cerr << "Couldn't open xml file!" << std::endl;
+		return nullptr;
+	}
+
+	std::map<uint32_t, std::vector<std::pair<std::string, std::string>>> versions;
+
+	auto * const rootNode = doc.FirstChildElement("Versions");
+
+	if (rootNode != nullptr) {
+		for (tinyxml2::XMLElement * node = rootNode->FirstChildElement("Version"); node != nullptr; node = node->NextSiblingElement("Version")) {
+			const uint8_t majorVersion = static_cast<uint8_t>(std::stoi(node->Attribute("majorVersion")));
+			const uint8_t minorVersion = static_cast<uint8_t>(std::stoi(node->Attribute("minorVersion")));
+			const uint8_t patchVersion = static_cast<uint8_t>(std::stoi(node->Attribute("patchVersion")));
+			const uint32_t version = (majorVersion << 16) + (minorVersion << 8) + patchVersion;
+
+			auto & files = versions[version];
+
+			for (tinyxml2::XMLElement * file = node->FirstChildElement("File"); file != nullptr; file = file->NextSiblingElement("File")) {
+				files.emplace_back(file->GetText(), file->Attribute("Hash"));
+			}
+		}
+	}
+
+	auto index = std::make_shared<Index>();
+	index->versions.reserve(versions.size());
+
+	for (const WireFormat format : { WireFormat::Text, WireFormat::Binary }) {
+		auto & updates = index->updates[static_cast<size_t>(format)];
+		updates.resize(versions.size() + 1);
+
+		// walk from the newest version backwards, so every update is the one of the next version plus the own files
+		std::set<std::pair<std::string, std::string>> files;
+
+		updates.back() = UpdateFilesMessage().SerializeBlank(format);
+
+		size_t i = versions.size();
+
+		for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+			files.insert(it->second.begin(), it->second.end());
+
+			UpdateFilesMessage ufm;
+			ufm.files.assign(files.begin(), files.end());
+
+			updates[--i] = ufm.SerializeBlank(format);
+		}
+	}
+
+	for (const auto & p : versions) {
+		index->versions.push_back(p.first);
+	}
+
+	return index;
+}
@@ -18,10 +18,17 @@
 
 #include "UploadServer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <thread>
 
+#include "DownloadSizeChecker.h"
 #include "FileSynchronizer.h"
+#include "MariaDBStatement.h"
 #include "MariaDBWrapper.h"
+#include "ServerCommon.h"
 #include "SpineServerConfig.h"
 
 #include "common/MessageStructs.h"
@@ -30,6 +37,10 @@
 
 #include "clockUtils/sockets/TcpSocket.h"
 
+#include "openssl/evp.h"
+
+#include "zlib.h"
+
 #ifdef TEST_CONFIG
 	const std::string PATH_PREFIX = "./downloads/mods/";
 #else
@@ -39,6 +50,8 @@
 using namespace spine::server;
 
 namespace {
+	constexpr size_t BLOCK_SIZE = 64 * 1024;
+
 	std::vector<std::string> split(const std::string & str, const std::string & delim) {
 		std::vector<std::string> ret;
 
@@ -61,9 +74,106 @@ namespace {
 
 		return ret;
 	}
+
+	bool isValidFilename(const std::string & filename) {
+		if (filename.empty() || filename[0] == '/' || filename.find('\\') != std::string::npos) return false;
+
+		const auto parts = split(filename, "/");
+
+		return std::none_of(parts.begin(), parts.end(), [](const std::string & part) {
+			return part == "..";
+		});
+	}
+
+	// SHA512 of the uncompressed content, the client hashes the files before compressing them
+	class ContentHash {
+	public:
+		explicit ContentHash(bool compressed) : _compressed(compressed), _valid(true), _context(EVP_MD_CTX_create()), _stream(), _buffer(BLOCK_SIZE) {
+			EVP_DigestInit_ex(_context, EVP_sha512(), nullptr);
+
+			if (_compressed && inflateInit(&_stream) != Z_OK) {
+				_valid = false;
+			}
+		}
+
+		~ContentHash() {
+			if (_compressed) {
+				inflateEnd(&_stream);
+			}
+			EVP_MD_CTX_destroy(_context);
+		}
+
+		ContentHash(const ContentHash &) = delete;
+		ContentHash & operator=(const ContentHash &) = delete;
+
+		void update(const char * data, size_t size) {
+			if (!_valid) return;
+
+			if (!_compressed) {
+				EVP_DigestUpdate(_context, data, size);
+				return;
+			}
+
+			_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+			_stream.avail_in = static_cast<uInt>(size);
+
+			while (_stream.avail_in > 0) {
+				_stream.next_out = _buffer.data();
+				_stream.avail_out = static_cast<uInt>(_buffer.size());
+
+				const int result = inflate(&_stream, Z_NO_FLUSH);
+
+				if (result != Z_OK && result != Z_STREAM_END) {
+					_valid = false;
+					return;
+				}
+
+				EVP_DigestUpdate(_context, _buffer.data(), _buffer.size() - _stream.avail_out);
+
+				if (result == Z_STREAM_END) break;
+			}
+		}
+
+		/**
+		 * \brief returns the hash as hex string, empty if the data couldn't be decompressed
+		 */
+		std::string finish() {
+			if (!_valid) return "";
+
+			unsigned char digest[EVP_MAX_MD_SIZE];
+			unsigned int digestLength = 0;
+
+			EVP_DigestFinal_ex(_context, digest, &digestLength);
+
+			static const char * hexDigits = "0123456789abcdef";
+
+			std::string result;
+			result.reserve(digestLength * 2);
+
+			for (unsigned int i = 0; i < digestLength; i++) {
+				result.push_back(hexDigits[digest[i] >> 4]);
+				result.push_back(hexDigits[digest[i] & 0xF]);
+			}
+
+			return result;
+		}
+
+	private:
+		bool _compressed;
+		bool _valid;
+		EVP_MD_CTX * _context;
+		z_stream _stream;
+		std::vector<Bytef> _buffer;
+	};
+
+	bool isCompressed(const std::string & filename) {
+		return filename.size() > 2 && filename.compare(filename.size() - 2, 2, ".z") == 0;
+	}
 }
 
-UploadServer::UploadServer() : _listenUploadServer(new clockUtils::sockets::TcpSocket()) {
+const std::chrono::hours UploadServer::STALE_PART_AGE(24 * 7);
+
+UploadServer::UploadServer(DownloadSizeChecker * downloadSizeChecker) : _listenUploadServer(new clockUtils::sockets::TcpSocket()), _downloadSizeChecker(downloadSizeChecker) {
 #ifdef TEST_CONFIG
 	if (!boost::filesystem::exists(PATH_PREFIX)) {
 		boost::filesystem::create_directories(PATH_PREFIX);
@@ -84,282 +194,447 @@ int UploadServer::run() {
 }
 
 void UploadServer::handleUploadFiles(clockUtils::sockets::TcpSocket * sock) const {
+	std::string headerBuffer; // size and metadata, collected until they are complete
+	std::string newBuffer;
+	std::unique_ptr<common::UploadModfilesMessage> umm;
+	std::vector<Upload> uploads;
+	size_t currentUpload = 0;
+	int64_t remaining = 0;
+	std::ofstream fs;
+	std::unique_ptr<ContentHash> contentHash;
 	bool error = false;
-	MariaDBWrapper spineDatabase;
-	if (!spineDatabase.connect("localhost", DATABASEUSER, DATABASEPASSWORD, SPINEDATABASE, 0)) {
-		delete sock;
-		error = true;
-	}
+	bool finished = false;
 
-	if (!spineDatabase.query("PREPARE deleteFileStmt FROM \"DELETE FROM modfiles WHERE ModID = ? AND Path = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
-		error = true;
-	}
-	if (!spineDatabase.query("PREPARE selectFileStmt FROM \"SELECT FileID FROM modfiles WHERE ModID = ? AND Path = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
-		error = true;
-	}
-	if (!spineDatabase.query("PREPARE updateFileStmt FROM \"UPDATE modfiles SET Hash = ?, Language = ? WHERE ModID = ? AND Path = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
-		error = true;
+	const auto verifyUpload = [&]() {
+		const Upload & upload = uploads[currentUpload];
+		const common::ModFile & mf = umm->files[upload.index];
+
+		if (mf.hash.empty() || contentHash->finish() == mf.hash) return true;
+
+		std::cout << "Hash mismatch for '" << mf.filename << "'" << std::endl;
+
+		// the part can't be resumed, it has to be uploaded completely again
+		boost::system::error_code ec;
+		boost::filesystem::remove(upload.partPath, ec);
+
+		return false;
+	};
+
+	// opens the part file of the next upload that still needs bytes
+	const auto openUpload = [&]() {
+		for (; currentUpload < uploads.size(); currentUpload++) {
+			const Upload & upload = uploads[currentUpload];
+			const common::ModFile & mf = umm->files[upload.index];
+
+			contentHash.reset(new ContentHash(isCompressed(mf.filename)));
+
+			// the bytes of an earlier attempt are part of the hash as well
+			if (upload.offset > 0) {
+				std::ifstream in(upload.partPath, std::ios::in | std::ios::binary);
+				std::vector<char> buffer(BLOCK_SIZE);
+				int64_t toRead = upload.offset;
+
+				while (toRead > 0 && in.read(buffer.data(), static_cast<std::streamsize>(std::min<int64_t>(toRead, BLOCK_SIZE)))) {
+					contentHash->update(buffer.data(), static_cast<size_t>(in.gcount()));
+					toRead -= in.gcount();
+				}
+
+				if (toRead > 0) return false;
+			}
+
+			remaining = mf.size - upload.offset;
+
+			if (remaining == 0) {
+				if (!verifyUpload()) return false;
+				continue;
+			}
+
+			std::cout << "Receiving File '" << mf.filename << "' with size " << mf.size;
+			if (upload.offset > 0) {
+				std::cout << ", resuming at " << upload.offset;
+			}
+			std::cout << std::endl;
+
+			fs.open(upload.partPath, std::ios::out | std::ios::binary | (upload.offset > 0 ? std::ios::app : std::ios::trunc));
+
+			return fs.good();
+		}
+
+		finished = true;
+
+		return true;
+	};
+
+	// file content is written straight from the socket buffer
+	const auto receive = [&](const char * data, size_t size) {
+		while (size > 0 && !finished) {
+			const auto count = static_cast<size_t>(std::min<int64_t>(remaining, static_cast<int64_t>(size)));
+
+			fs.write(data, static_cast<std::streamsize>(count));
+			contentHash->update(data, count);
+
+			data += count;
+			size -= count;
+			remaining -= static_cast<int64_t>(count);
+
+			if (remaining > 0) continue;
+
+			const bool written = fs.good();
+			fs.close();
+
+			if (!written || !verifyUpload()) return false;
+
+			currentUpload++;
+
+			if (!openUpload()) return false;
+		}
+
+		return true;
+	};
+
+	while (!error && !finished && sock->read(newBuffer) == clockUtils::ClockError::SUCCESS) {
+		if (umm) {
+			error = !receive(newBuffer.data(), newBuffer.size());
+			continue;
+		}
+
+		headerBuffer.append(newBuffer);
+
+		if (headerBuffer.size() < 4) continue;
+
+		int32_t metadataSize = 0;
+		memcpy(&metadataSize, headerBuffer.data(), 4);
+
+		if (metadataSize <= 0) {
+			error = true;
+			break;
+		}
+
+		if (headerBuffer.size() < 4 + static_cast<size_t>(metadataSize)) continue;
+
+		common::Message * msg = common::Message::DeserializeBlank(headerBuffer.substr(4, static_cast<size_t>(metadataSize)));
+		umm.reset(dynamic_cast<common::UploadModfilesMessage *>(msg));
+
+		if (!umm) {
+			delete msg;
+			error = true;
+			break;
+		}
+
+		const bool resumable = umm->type == common::MessageType::UPLOADMODFILESRESUMABLE;
+
+		std::cout << "Updating " << umm->files.size() << std::endl;
+
+		if (!prepareUploads(*umm, resumable, uploads)) {
+			error = true;
+			break;
+		}
+
+		if (resumable) {
+			common::UploadModfilesOffsetsMessage uomm;
+
+			for (const Upload & upload : uploads) {
+				uomm.offsets.push_back(upload.offset);
+			}
+
+			if (sock->writePacket(uomm.SerializeBlank()) != clockUtils::ClockError::SUCCESS) {
+				error = true;
+				break;
+			}
+		}
+
+		if (!openUpload()) {
+			error = true;
+			break;
+		}
+
+		// the rest of the buffer already belongs to the files
+		const size_t headerSize = 4 + static_cast<size_t>(metadataSize);
+		error = !receive(headerBuffer.data() + headerSize, headerBuffer.size() - headerSize);
+
+		headerBuffer.clear();
+		headerBuffer.shrink_to_fit();
 	}
-	if (!spineDatabase.query("PREPARE insertFileStmt FROM \"INSERT INTO modfiles (ModID, Path, Language, Hash) VALUES (?, ?, ?, ?)\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
+
+	// received parts are kept, so a resumable client can continue with them
+	if (!error && finished) {
+		error = !commitUpload(*umm, uploads);
+	} else {
 		error = true;
 	}
-	if (!spineDatabase.query("PREPARE updateLanguageStmt FROM \"UPDATE modfiles SET Language = ? WHERE ModID = ? AND Path = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
-		error = true;
+
+	std::cout << "Finished Upload: " << !error << std::endl;
+	common::AckMessage am;
+	am.success = !error;
+	const std::string serialized = am.SerializeBlank();
+	sock->writePacket(serialized);
+	delete sock;
+}
+
+bool UploadServer::prepareUploads(const common::UploadModfilesMessage & umm, bool resumable, std::vector<Upload> & uploads) const {
+	const std::string projectPath = PATH_PREFIX + std::to_string(umm.modID) + "/";
+
+	// parts of uploads that were never continued, the ones of this upload are kept if they are younger
+	ServerCommon::removeStalePartFiles(projectPath, STALE_PART_AGE);
+
+	for (size_t i = 0; i < umm.files.size(); i++) {
+		const common::ModFile & mf = umm.files[i];
+
+		if (!isValidFilename(mf.filename) || mf.size < 0) {
+			std::cout << "Invalid file in upload: '" << mf.filename << "'" << std::endl;
+			return false;
+		}
+
+		// only a language change
+		if (mf.deleted || (mf.changed && mf.size == 0)) continue;
+
+		Upload upload;
+		upload.index = i;
+		upload.path = projectPath + mf.filename;
+		upload.partPath = upload.path + "." + mf.hash.substr(0, 16) + ".part"; // a new version of the file doesn't continue the old part
+		upload.offset = 0;
+
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(boost::filesystem::path(upload.path).parent_path(), ec);
+
+		if (ec) {
+			std::cout << "Couldn't create directory for '" << upload.path << "': " << ec.message() << std::endl;
+			return false;
+		}
+
+		if (resumable && boost::filesystem::exists(upload.partPath, ec)) {
+			const auto partSize = boost::filesystem::file_size(upload.partPath, ec);
+
+			if (!ec && partSize <= static_cast<uint64_t>(mf.size)) {
+				upload.offset = static_cast<int64_t>(partSize);
+			}
+		}
+
+		uploads.push_back(upload);
 	}
-	if (!spineDatabase.query("PREPARE selectVersionStmt FROM \"SELECT MajorVersion, MinorVersion, PatchVersion, SpineVersion FROM mods WHERE ModID = ? LIMIT 1\";")) {
-		std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-		delete sock;
-		error = true;
+
+	return true;
+}
+
+bool UploadServer::commitUpload(const common::UploadModfilesMessage & umm, const std::vector<Upload> & uploads) const {
+	std::vector<bool> received(umm.files.size(), false);
+
+	for (const Upload & upload : uploads) {
+		received[upload.index] = true;
 	}
 
-	std::string newBuffer;
-	std::string unreadBuffer;
-	enum States {
-		MetadataSize,
-		Metadata,
-		File
-	};
-	int64_t currentSize = 0;
-	int currentIndex = 0;
-	int state = MetadataSize;
-	int versionMajor = 0;
-	int versionMinor = 0;
-	int versionPatch = 0;
-	int versionSpine = 0;
-	common::UploadModfilesMessage * umm = nullptr;
-	std::ofstream fs;
-	while (sock->read(newBuffer) == clockUtils::ClockError::SUCCESS && !error) {
-		unreadBuffer.append(newBuffer);
-		if (state == MetadataSize) {
-			if (unreadBuffer.size() >= 4) {
-				memcpy(&currentSize, unreadBuffer.c_str(), 4);
-				unreadBuffer = unreadBuffer.substr(4);
-				state = Metadata;
-			}
+	std::vector<FileSynchronizer::AddJob> jobs;
+	bool success = false;
+
+	do {
+		CONNECTTODATABASE(__LINE__)
+
+		MariaDBStatement selectVersionStmt(database, "SELECT MajorVersion, MinorVersion, PatchVersion, SpineVersion FROM mods WHERE ModID = ? LIMIT 1");
+		selectVersionStmt.bind(umm.modID);
+
+		if (!selectVersionStmt.execute()) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectVersionStmt.getLastError() << std::endl;
+			break;
 		}
-		if (state == Metadata) {
-			if (unreadBuffer.size() >= static_cast<size_t>(currentSize)) {
-				const std::string serialized = unreadBuffer.substr(0, currentSize);
-				unreadBuffer = unreadBuffer.substr(currentSize);
-				common::Message * msg = common::Message::DeserializeBlank(serialized);
-				umm = dynamic_cast<common::UploadModfilesMessage *>(msg);
-				std::cout << "Updating " << umm->files.size() << std::endl;
-				state = File;
-				currentIndex = 0;
-				if (!spineDatabase.query("SET @paramModID=" + std::to_string(umm->modID) + ";")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-					error = true;
-					break;
-				}
-				if (!spineDatabase.query("EXECUTE selectVersionStmt USING @paramModID;")) {
-					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-					error = true;
+
+		if (!selectVersionStmt.fetch()) break;
+
+		FileSynchronizer::AddJob baseJob;
+		baseJob.projectID = umm.modID;
+		baseJob.majorVersion = selectVersionStmt.getInt(0);
+		baseJob.minorVersion = selectVersionStmt.getInt(1);
+		baseJob.patchVersion = selectVersionStmt.getInt(2);
+		baseJob.spineVersion = selectVersionStmt.getInt(3);
+
+		MariaDBStatement deleteFileStmt(database, "DELETE FROM modfiles WHERE ModID = ? AND Path = ? LIMIT 1");
+		MariaDBStatement updateLanguageStmt(database, "UPDATE modfiles SET Language = ? WHERE ModID = ? AND Path = ? LIMIT 1");
+		MariaDBStatement selectFileStmt(database, "SELECT FileID FROM modfiles WHERE ModID = ? AND Path = ? LIMIT 1");
+		MariaDBStatement updateFileStmt(database, "UPDATE modfiles SET Hash = ?, Language = ? WHERE ModID = ? AND Path = ? LIMIT 1");
+		MariaDBStatement insertFileStmt(database, "INSERT INTO modfiles (ModID, Path, Language, Hash) VALUES (?, ?, ?, ?)");
+
+		if (!database.query("START TRANSACTION;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			break;
+		}
+
+		bool failed = false;
+
+		for (size_t i = 0; i < umm.files.size() && !failed; i++) {
+			const common::ModFile & mf = umm.files[i];
+
+			FileSynchronizer::AddJob job = baseJob;
+			job.path = mf.filename;
+
+			if (mf.deleted) {
+				deleteFileStmt.reset();
+				deleteFileStmt.bind(umm.modID).bind(mf.filename);
+
+				if (!deleteFileStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << deleteFileStmt.getLastError() << std::endl;
+					failed = true;
 					break;
 				}
-				auto lastResults = spineDatabase.getResults<std::vector<std::string>>();
-				if (lastResults.empty()) {
-					error = true;
+
+				job.operation = FileSynchronizer::Operation::Delete;
+				jobs.push_back(job);
+			} else if (!received[i]) {
+				updateLanguageStmt.reset();
+				updateLanguageStmt.bind(mf.language).bind(umm.modID).bind(mf.filename);
+
+				if (!updateLanguageStmt.execute()) {
+					std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << updateLanguageStmt.getLastError() << std::endl;
+					failed = true;
 					break;
 				}
-				versionMajor = std::stoi(lastResults[0][0]);
-				versionMinor = std::stoi(lastResults[0][1]);
-				versionPatch = std::stoi(lastResults[0][2]);
-				versionSpine = std::stoi(lastResults[0][3]);
-				
-				do {
-					if (currentIndex == static_cast<int>(umm->files.size())) {
-						break;
-					}
-					const common::ModFile mf = umm->files[currentIndex];
-					if (mf.deleted) {
-						if (boost::filesystem::exists(PATH_PREFIX + std::to_string(umm->modID) + "/" + mf.filename) && !boost::filesystem::remove(PATH_PREFIX + std::to_string(umm->modID) + "/" + mf.filename)) {
-							error = true;
-							break;
-						}
-						if (!spineDatabase.query("SET @paramPath='" + mf.filename + "';")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-						if (!spineDatabase.query("EXECUTE deleteFileStmt USING @paramModID, @paramPath;")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-						currentIndex++;
-
-						FileSynchronizer::AddJob job;
-						job.operation = FileSynchronizer::Operation::Delete;
-						job.majorVersion = versionMajor;
-						job.minorVersion = versionMinor;
-						job.patchVersion = versionPatch;
-						job.spineVersion = versionSpine;
-						job.projectID = umm->modID;
-						job.path = mf.filename;
-
-						FileSynchronizer::addJob(job);
-					} else if (mf.changed && mf.size == 0) {
-						if (!spineDatabase.query("SET @paramLanguage='" + mf.language + "';")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-						if (!spineDatabase.query("EXECUTE updateLanguageStmt USING @paramLanguage, @paramModID, @paramPath;")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-						currentIndex++;
-					} else {
-						// now we have to receive a new file, so set currentSize and go on
-						currentSize = mf.size;
-						std::cout << "Receiving File '" << mf.filename << "' with size " << mf.size << std::endl;
-						std::vector<std::string> path = split(mf.filename, "/");
-						std::string currentPath = PATH_PREFIX + std::to_string(umm->modID) + "/";
-
-						for (size_t i = 0; i < path.size() - 1; i++) {
-							currentPath += path[i] + "/";
-							if (!boost::filesystem::exists(currentPath) && !boost::filesystem::create_directories(currentPath)) {
-								error = true;
-								break;
-							}
-						}
-						fs.open(currentPath + path.back(), std::ios::out | std::ios::binary);
+			} else {
+				bool exists = false;
+
+				if (mf.changed) {
+					selectFileStmt.reset();
+					selectFileStmt.bind(umm.modID).bind(mf.filename);
+
+					if (!selectFileStmt.execute()) {
+						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << selectFileStmt.getLastError() << std::endl;
+						failed = true;
 						break;
 					}
-				} while (true);
-			}
-		}
-		if (state == File) {
-			while (!unreadBuffer.empty()) {
-				if (currentSize > 0) {
-					const size_t diff = std::min(unreadBuffer.size(), static_cast<size_t>(currentSize));
-					fs.write(unreadBuffer.c_str(), diff);
-					currentSize -= diff;
-					unreadBuffer = unreadBuffer.substr(diff);
-				}
 
-				common::ModFile mf = umm->files[currentIndex];
+					exists = selectFileStmt.fetch();
+				}
 
-				if (currentSize == 0) {
-					fs.close();
+				if (exists) {
+					updateFileStmt.reset();
+					updateFileStmt.bind(mf.hash).bind(mf.language).bind(umm.modID).bind(mf.filename);
 
-					if (!spineDatabase.query("SET @paramPath='" + mf.filename + "';")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-						error = true;
-						break;
-					}
-					if (!spineDatabase.query("SET @paramHash='" + mf.hash + "';")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-						error = true;
-						break;
-					}
-					if (!spineDatabase.query("SET @paramLanguage='" + mf.language + "';")) {
-						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-						error = true;
+					if (!updateFileStmt.execute()) {
+						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << updateFileStmt.getLastError() << std::endl;
+						failed = true;
 						break;
 					}
-					if (mf.changed) {
-						if (!spineDatabase.query("EXECUTE selectFileStmt USING @paramModID, @paramPath;")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-						auto lastResults = spineDatabase.getResults<std::vector<std::string>>();
-						if (lastResults.empty()) {
-							if (!spineDatabase.query("EXECUTE insertFileStmt USING @paramModID, @paramPath, @paramLanguage, @paramHash;")) {
-								std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-								error = true;
-								break;
-							}
-
-							FileSynchronizer::AddJob job;
-							job.operation = FileSynchronizer::Operation::Add;
-							job.majorVersion = versionMajor;
-							job.minorVersion = versionMinor;
-							job.patchVersion = versionPatch;
-							job.spineVersion = versionSpine;
-							job.projectID = umm->modID;
-							job.path = mf.filename;
-
-							FileSynchronizer::addJob(job);
-						} else {
-							if (!spineDatabase.query("EXECUTE updateFileStmt USING @paramHash, @paramLanguage, @paramModID, @paramPath;")) {
-								std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-								error = true;
-								break;
-							}
-
-							FileSynchronizer::AddJob job;
-							job.operation = FileSynchronizer::Operation::Update;
-							job.majorVersion = versionMajor;
-							job.minorVersion = versionMinor;
-							job.patchVersion = versionPatch;
-							job.spineVersion = versionSpine;
-							job.projectID = umm->modID;
-							job.path = mf.filename;
-
-							FileSynchronizer::addJob(job);
-						}
-					} else if (!mf.changed) {
-						if (!spineDatabase.query("EXECUTE insertFileStmt USING @paramModID, @paramPath, @paramLanguage, @paramHash;")) {
-							std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << spineDatabase.getLastError() << std::endl;
-							error = true;
-							break;
-						}
-
-						FileSynchronizer::AddJob job;
-						job.operation = FileSynchronizer::Operation::Add;
-						job.majorVersion = versionMajor;
-						job.minorVersion = versionMinor;
-						job.patchVersion = versionPatch;
-						job.spineVersion = versionSpine;
-						job.projectID = umm->modID;
-						job.path = mf.filename;
-
-						FileSynchronizer::addJob(job);
-					}
 
-					currentIndex++;
+					job.operation = FileSynchronizer::Operation::Update;
+				} else {
+					insertFileStmt.reset();
+					insertFileStmt.bind(umm.modID).bind(mf.filename).bind(mf.language).bind(mf.hash);
 
-					if (umm && currentIndex == static_cast<int>(umm->files.size())) {
-						break; // finished uploads
+					if (!insertFileStmt.execute()) {
+						std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << insertFileStmt.getLastError() << std::endl;
+						failed = true;
+						break;
 					}
 
-					mf = umm->files[currentIndex];
-					currentSize = mf.size;
-					std::cout << "Receiving File '" << mf.filename << "' with size " << mf.size << std::endl;
-					std::vector<std::string> path = split(mf.filename, "/");
-					std::string currentPath = PATH_PREFIX + std::to_string(umm->modID) + "/";
-					for (size_t i = 0; i < path.size() - 1; i++) {
-						currentPath += path[i] + "/";
-						if (!boost::filesystem::exists(currentPath) && !boost::filesystem::create_directories(currentPath)) {
-							error = true;
-							break;
-						}
-					}
-					fs.open(currentPath + path.back(), std::ios::out | std::ios::binary);
+					job.operation = FileSynchronizer::Operation::Add;
 				}
+
+				jobs.push_back(job);
 			}
 		}
-		
-		if (umm && currentIndex == static_cast<int>(umm->files.size())) break; // finished uploads
+
+		if (failed) {
+			database.query("ROLLBACK;");
+			break;
+		}
+
+		// the files are replaced only now, so an aborted upload never leaves the project with a mix of old and new files
+		// the old files are kept until the COMMIT succeeded, so the files always match the hashes in the database
+		size_t moved = 0;
+
+		for (; moved < uploads.size(); moved++) {
+			if (!moveInPlace(uploads[moved])) break;
+		}
+
+		if (moved < uploads.size()) {
+			restore(uploads, moved);
+			database.query("ROLLBACK;");
+			break;
+		}
+
+		if (!database.query("COMMIT;")) {
+			std::cout << "Query couldn't be started: " << __FILE__ << ": " << __LINE__ << ": " << database.getLastError() << std::endl;
+			database.query("ROLLBACK;");
+			restore(uploads, moved);
+			break;
+		}
+
+		for (const Upload & upload : uploads) {
+			boost::system::error_code ec;
+			boost::filesystem::remove(getBackupPath(upload), ec);
+		}
+
+		success = true;
+	} while (false);
+
+	if (!success) return false;
+
+	_downloadSizeChecker->invalidate(umm.modID);
+
+	// deleted files are only removed once the database doesn't reference them anymore
+	for (const common::ModFile & mf : umm.files) {
+		if (!mf.deleted) continue;
+
+		boost::system::error_code ec;
+		boost::filesystem::remove(PATH_PREFIX + std::to_string(umm.modID) + "/" + mf.filename, ec);
+	}
+
+	// adding the jobs needs some queries per fileserver, the client doesn't have to wait for that
+	std::thread([jobs]() {
+		for (const auto & job : jobs) {
+			FileSynchronizer::addJob(job);
+		}
+	}).detach();
+
+	return true;
+}
+
+std::string UploadServer::getBackupPath(const Upload & upload) {
+	return upload.path + ".previous.part"; // ends with .part, so it's removed as stale part if the server stopped in between
+}
+
+bool UploadServer::moveInPlace(const Upload & upload) {
+	boost::system::error_code ec;
+
+	if (boost::filesystem::exists(upload.path, ec)) {
+		boost::filesystem::rename(upload.path, getBackupPath(upload), ec);
+
+		if (ec) {
+			std::cout << "Couldn't keep '" << upload.path << "': " << ec.message() << std::endl;
+			return false;
+		}
+	}
+
+	boost::filesystem::rename(upload.partPath, upload.path, ec);
+
+	if (ec) {
+		std::cout << "Couldn't move '" << upload.partPath << "' in place: " << ec.message() << std::endl;
+
+		boost::system::error_code restoreError;
+		if (boost::filesystem::exists(getBackupPath(upload), restoreError)) {
+			boost::filesystem::rename(getBackupPath(upload), upload.path, restoreError);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+void UploadServer::restore(const std::vector<Upload> & uploads, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		const Upload & upload = uploads[i];
+
+		// the received file becomes a part again, so a resumable client doesn't have to send it another time
+		boost::system::error_code ec;
+		boost::filesystem::rename(upload.path, upload.partPath, ec);
+
+		if (ec) {
+			std::cout << "Couldn't move '" << upload.path << "' back: " << ec.message() << std::endl;
+		}
+
+		if (!boost::filesystem::exists(getBackupPath(upload), ec)) continue;
+
+		boost::filesystem::rename(getBackupPath(upload), upload.path, ec);
+
+		if (ec) {
+			std::cout << "Couldn't restore '" << upload.path << "': " << ec.message() << std::endl;
+		}
 	}
-	std::cout << "Finished Upload: " << !error << std::endl;
-	delete umm;
-	common::AckMessage am;
-	am.success = !error;
-	const std::string serialized = am.SerializeBlank();
-	sock->writePacket(serialized);
-	delete sock;
 }
@@ -18,7 +18,10 @@
 
 #include "gtest/gtest.h"
 
+#include <QCoreApplication>
+
 int main(int argc, char ** argv) {
+	QCoreApplication app(argc, argv); // event loops of network tests need an application
 	testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
 }
@@ -0,0 +1,333 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include <algorithm>
+#include <cstdint>
+
+#include "utils/FileDownloader.h"
+
+#include "gtest/gtest.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+using namespace spine::utils;
+
+namespace {
+	constexpr int TIMEOUT = 60000; // milliseconds, resuming waits a few seconds on its own
+	constexpr qint64 SEGMENT_SIZE = 16 * 1024 * 1024;
+
+	/**
+	 * \brief minimal HTTP/1.1 server on the loopback interface serving one file
+	 * supports HEAD and single Range requests and can be told to misbehave for exactly one response
+	 */
+	class HttpFixture {
+	public:
+		qint64 disconnectAfter; // closes the connection after that many bytes of the next body
+		qint64 shortenTo; // the next ranged response only covers that many bytes, but with matching headers
+		qint64 shortenedAt; // start of the shortened range
+		bool ignoreRanges; // answers every GET with 200 and the complete file
+		QList<QByteArray> ranges; // Range header of every GET, empty if there was none
+
+		explicit HttpFixture(const QByteArray & data) : disconnectAfter(-1), shortenTo(-1), shortenedAt(-1), ignoreRanges(false), _data(data) {
+			_server.listen(QHostAddress::LocalHost, 0);
+
+			QObject::connect(&_server, &QTcpServer::newConnection, &_server, [this]() {
+				while (_server.hasPendingConnections()) {
+					QTcpSocket * socket = _server.nextPendingConnection();
+
+					QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+						handle(socket);
+					});
+					QObject::connect(socket, &QTcpSocket::disconnected, socket, [this, socket]() {
+						_buffers.remove(socket);
+						socket->deleteLater();
+					});
+				}
+			});
+		}
+
+		QUrl getUrl() const {
+			return QUrl(QString("http://127.0.0.1:%1/file.bin").arg(_server.serverPort()));
+		}
+
+	private:
+		QTcpServer _server;
+		QByteArray _data;
+		QHash<QTcpSocket *, QByteArray> _buffers;
+
+		void handle(QTcpSocket * socket) {
+			QByteArray & buffer = _buffers[socket];
+			buffer += socket->readAll();
+
+			int end;
+
+			// connections are kept alive, so several requests can arrive on the same socket
+			while (socket->state() == QAbstractSocket::ConnectedState && (end = buffer.indexOf("\r\n\r\n")) != -1) {
+				const QByteArray header = buffer.left(end);
+				buffer.remove(0, end + 4);
+
+				respond(socket, header);
+			}
+		}
+
+		void respond(QTcpSocket * socket, const QByteArray & header) {
+			const QList<QByteArray> lines = header.split('\n');
+			const QByteArray method = lines[0].split(' ')[0];
+			const qint64 size = _data.size();
+
+			QByteArray range;
+
+			for (const QByteArray & line : lines) {
+				if (line.toLower().startsWith("range:")) {
+					range = line.mid(6).trimmed();
+				}
+			}
+
+			if (method == "HEAD") {
+				socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(size) + "\r\nAccept-Ranges: bytes\r\n\r\n");
+				return;
+			}
+
+			ranges.append(range);
+
+			qint64 first = 0;
+			qint64 last = size - 1;
+			const bool ranged = !range.isEmpty() && !ignoreRanges;
+
+			if (ranged) {
+				const QByteArray spec = range.mid(6); // bytes=
+				const int dash = spec.indexOf('-');
+
+				first = spec.left(dash).toLongLong();
+
+				if (dash + 1 < spec.size()) {
+					last = std::min(last, spec.mid(dash + 1).toLongLong());
+				}
+
+				if (first >= size) {
+					socket->write("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */" + QByteArray::number(size) + "\r\nContent-Length: 0\r\n\r\n");
+					return;
+				}
+
+				if (shortenTo >= 0) {
+					last = std::min(last, first + shortenTo - 1);
+					shortenedAt = first;
+					shortenTo = -1;
+				}
+			}
+
+			QByteArray body = _data.mid(first, last - first + 1);
+
+			QByteArray response = ranged ? "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) + "/" + QByteArray::number(size) + "\r\n" : QByteArray("HTTP/1.1 200 OK\r\n");
+			response += "Content-Length: " + QByteArray::number(body.size()) + "\r\nAccept-Ranges: bytes\r\n\r\n";
+
+			if (disconnectAfter >= 0) {
+				body.truncate(disconnectAfter);
+				disconnectAfter = -1;
+
+				socket->write(response + body);
+				socket->disconnectFromHost(); // sends everything written so far before closing
+				return;
+			}
+
+			socket->write(response + body);
+		}
+	};
+
+	QByteArray createData(qint64 size) {
+		QByteArray data(size, Qt::Uninitialized);
+		uint32_t state = 42;
+
+		for (qint64 i = 0; i < size; i++) {
+			state = state * 1103515245 + 12345;
+			data[i] = static_cast<char>(state >> 24);
+		}
+
+		return data;
+	}
+
+	QString getHash(const QByteArray & data) {
+		return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha512).toHex());
+	}
+
+	void writeFile(const QString & path, const QByteArray & data) {
+		QFile f(path);
+		ASSERT_TRUE(f.open(QIODevice::WriteOnly));
+		ASSERT_EQ(data.size(), f.write(data));
+	}
+
+	QByteArray readFile(const QString & path) {
+		QFile f(path);
+
+		if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+
+		return f.readAll();
+	}
+}
+
+class FileDownloaderTest : public ::testing::Test {
+protected:
+	QTemporaryDir directory;
+
+	void SetUp() override {
+		qRegisterMetaType<DownloadError>("DownloadError");
+
+		ASSERT_TRUE(directory.isValid());
+	}
+
+	QString getPartPath(const QString & hash) const {
+		return directory.path() + "/file.bin." + hash.left(16) + ".part";
+	}
+
+	/**
+	 * \brief runs the download until it succeeded or failed, determineSize requests the size first like MultiFileDownloader does, which enables segments
+	 */
+	bool download(FileDownloader & downloader, bool determineSize) {
+		if (determineSize) {
+			QEventLoop sizeLoop;
+			QObject::connect(&downloader, &FileDownloader::totalBytes, &sizeLoop, &QEventLoop::quit);
+			QTimer::singleShot(TIMEOUT, &sizeLoop, &QEventLoop::quit);
+			downloader.requestFileSize();
+			sizeLoop.exec();
+		}
+
+		bool succeeded = false;
+
+		QEventLoop loop;
+		QObject::connect(&downloader, &FileDownloader::fileSucceeded, &loop, [&succeeded, &loop]() {
+			succeeded = true;
+			loop.quit();
+		});
+		QObject::connect(&downloader, &FileDownloader::fileFailed, &loop, &QEventLoop::quit);
+		QTimer::singleShot(TIMEOUT, &loop, &QEventLoop::quit);
+
+		downloader.startDownload();
+		loop.exec();
+
+		return succeeded;
+	}
+};
+
+TEST_F(FileDownloaderTest, ResumesAfterDisconnect) {
+	const QByteArray data = createData(1024 * 1024);
+	const QString hash = getHash(data);
+
+	HttpFixture fixture(data);
+	fixture.disconnectAfter = 256 * 1024;
+
+	FileDownloader downloader(fixture.getUrl(), directory.path(), "file.bin", hash, nullptr);
+
+	ASSERT_TRUE(download(downloader, false));
+
+	ASSERT_EQ(2, fixture.ranges.size());
+	ASSERT_TRUE(fixture.ranges[0].isEmpty());
+	ASSERT_EQ("bytes=262144-", fixture.ranges[1]);
+
+	ASSERT_TRUE(data == readFile(directory.path() + "/file.bin"));
+	ASSERT_FALSE(QFileInfo::exists(getPartPath(hash)));
+}
+
+TEST_F(FileDownloaderTest, CompletePartIsAnswered416) {
+	const QByteArray data = createData(1024 * 1024);
+	const QString hash = getHash(data);
+
+	writeFile(getPartPath(hash), data);
+
+	HttpFixture fixture(data);
+
+	FileDownloader downloader(fixture.getUrl(), directory.path(), "file.bin", hash, nullptr);
+
+	ASSERT_TRUE(download(downloader, false));
+
+	ASSERT_EQ(1, fixture.ranges.size());
+	ASSERT_EQ("bytes=" + QByteArray::number(data.size()) + "-", fixture.ranges[0]);
+
+	ASSERT_TRUE(data == readFile(directory.path() + "/file.bin"));
+}
+
+TEST_F(FileDownloaderTest, RangeAnsweredWith200RestartsStream) {
+	const QByteArray data = createData(1024 * 1024);
+	const QString hash = getHash(data);
+
+	writeFile(getPartPath(hash), data.left(300 * 1024));
+
+	HttpFixture fixture(data);
+	fixture.ignoreRanges = true;
+
+	FileDownloader downloader(fixture.getUrl(), directory.path(), "file.bin", hash, nullptr);
+
+	ASSERT_TRUE(download(downloader, false));
+
+	ASSERT_EQ(1, fixture.ranges.size());
+	ASSERT_EQ("bytes=307200-", fixture.ranges[0]);
+
+	ASSERT_TRUE(data == readFile(directory.path() + "/file.bin"));
+}
+
+TEST_F(FileDownloaderTest, ShortSegmentIsResumed) {
+	const QByteArray data = createData(4 * SEGMENT_SIZE);
+	const QString hash = getHash(data);
+
+	HttpFixture fixture(data);
+	fixture.shortenTo = 1024 * 1024;
+
+	FileDownloader downloader(fixture.getUrl(), directory.path(), "file.bin", hash, nullptr);
+
+	ASSERT_TRUE(download(downloader, true));
+
+	// four segments and one resume of the shortened one
+	ASSERT_EQ(5, fixture.ranges.size());
+	ASSERT_NE(-1, fixture.shortenedAt);
+	ASSERT_EQ("bytes=" + QByteArray::number(fixture.shortenedAt + 1024 * 1024) + "-" + QByteArray::number(fixture.shortenedAt + SEGMENT_SIZE - 1), fixture.ranges.last());
+
+	ASSERT_TRUE(data == readFile(directory.path() + "/file.bin"));
+
+	for (int i = 0; i < 4; i++) {
+		ASSERT_FALSE(QFileInfo::exists(getPartPath(hash) + "." + QString::number(i)));
+	}
+}
+
+TEST_F(FileDownloaderTest, SegmentsAnsweredWith200RestartInOnePiece) {
+	const QByteArray data = createData(4 * SEGMENT_SIZE);
+	const QString hash = getHash(data);
+
+	HttpFixture fixture(data);
+
+	FileDownloader downloader(fixture.getUrl(), directory.path(), "file.bin", hash, nullptr);
+
+	// the HEAD request still announces ranges, only the GETs ignore them
+	QObject::connect(&downloader, &FileDownloader::totalBytes, [&fixture]() {
+		fixture.ignoreRanges = true;
+	});
+
+	ASSERT_TRUE(download(downloader, true));
+
+	// the restart requests the file without a Range header
+	ASSERT_TRUE(fixture.ranges.contains(QByteArray()));
+
+	ASSERT_TRUE(data == readFile(directory.path() + "/file.bin"));
+}
@@ -18,68 +18,183 @@
 
 #include "Database.h"
 
+const size_t Database::MAX_CACHED_STATEMENTS = 64;
+
 std::mutex Database::_lock;
-std::map<std::string, sqlite3 *> Database::_databases = std::map<std::string, sqlite3 *>();
+std::map<std::string, std::shared_ptr<Database::Connection>> Database::_connections;
+
+Database::Connection::~Connection() {
+	for (const auto & p : statements) {
+		sqlite3_finalize(p.second);
+	}
+	sqlite3_close(db);
+}
 
 void Database::execute(const std::string & dbpath, const std::string & query, DBError & error) {
 	error.error = false;
 	error.errMsg = "";
-	sqlite3 * db;
-	bool selfOpened = false;
-	std::lock_guard<std::mutex> lg(_lock); // lock the database vector and sqlite
-	if (_databases.find(dbpath) != _databases.end()) {
-		db = _databases[dbpath];
+	const auto connection = getConnection(dbpath, true, error);
+	if (!connection) return;
+
+	std::lock_guard<std::mutex> lg(connection->lock);
+	const int r = sqlite3_exec(connection->db, query.c_str(), nullptr, nullptr, nullptr);
+	if (r != SQLITE_OK) {
+		error.error = true;
+		error.errMsg = std::string("exec(): ") + sqlite3_errmsg(connection->db);
 	} else {
-		const int r = sqlite3_open(dbpath.c_str(), &db);
-		if (r != SQLITE_OK) {
+		error.error = false;
+	}
+}
+
+void Database::open(const std::string & dbpath, DBError & error) {
+	const auto connection = getConnection(dbpath, true, error);
+	if (!connection) return;
+
+	std::lock_guard<std::mutex> lg(connection->lock);
+	if (connection->opened) {
+		error.error = true;
+		error.errMsg = "Database already open!";
+		return;
+	}
+	error.error = false;
+	connection->opened = true;
+}
+
+void Database::close(const std::string & dbpath, DBError & error) {
+	std::shared_ptr<Connection> connection;
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		const auto it = _connections.find(dbpath);
+		if (it == _connections.end() || !it->second->opened) {
 			error.error = true;
-			error.errMsg = std::string("open(): ") + sqlite3_errmsg(db);
+			error.errMsg = "Database not open!";
 			return;
 		}
-		selfOpened = true;
+		connection = it->second;
 	}
-	const int r = sqlite3_exec(db, query.c_str(), nullptr, nullptr, nullptr);
-	if (r != SQLITE_OK) {
+	error.error = false;
+
+	// the connection is shared with all other users of the database, so it stays open and only the settings made after open() are undone
+	std::lock_guard<std::mutex> lg(connection->lock);
+	connection->opened = false;
+	setDefaultPragmas(connection->db);
+}
+
+int Database::queryCount(std::string dbpath, std::string query, DBError & error) {
+	const auto connection = getConnection(dbpath, false, error);
+	if (!connection) return -1;
+
+	std::lock_guard<std::mutex> lg(connection->lock);
+	sqlite3_stmt * stmt = prepare(*connection, query, false, error);
+	if (!stmt) return -1;
+
+	int counter = 0;
+	int r;
+	while ((r = sqlite3_step(stmt)) == SQLITE_ROW) {
+		counter++;
+	}
+	finish(*connection, stmt, false);
+	if (r != SQLITE_DONE) {
 		error.error = true;
-		error.errMsg = std::string("exec(): ") + sqlite3_errmsg(db);
-	} else {
-		error.error = false;
+		error.errMsg = std::string("step(): ") + sqlite3_errmsg(connection->db);
+		return -1;
 	}
+	error.error = false;
+	return counter;
+}
 
-	if (selfOpened) {
-		sqlite3_close(db);
+bool Database::exists(std::string dbpath) {
+	{
+		std::lock_guard<std::mutex> lg(_lock);
+		if (_connections.find(dbpath) != _connections.end()) return true;
 	}
+	sqlite3 * db;
+	const int r = sqlite3_open_v2(dbpath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+	sqlite3_close(db);
+	return r == SQLITE_OK;
 }
 
-void Database::open(const std::string & dbpath, DBError & error) {
+std::shared_ptr<Database::Connection> Database::getConnection(const std::string & dbpath, bool create, DBError & error) {
+	std::lock_guard<std::mutex> lg(_lock);
+
+	const auto it = _connections.find(dbpath);
+	if (it != _connections.end()) return it->second;
+
+	// queries on a database that doesn't exist fail like before instead of creating an empty file
+	const int flags = SQLITE_OPEN_READWRITE | (create ? SQLITE_OPEN_CREATE : 0);
+
 	sqlite3 * db;
-	std::lock_guard<std::mutex> lg(_lock); // lock the database vector and sqlite
-	const int r = sqlite3_open(dbpath.c_str(), &db);
+	const int r = sqlite3_open_v2(dbpath.c_str(), &db, flags, nullptr);
 	if (r != SQLITE_OK) {
 		error.error = true;
 		error.errMsg = std::string("open(): ") + sqlite3_errmsg(db);
-		return;
+		sqlite3_close(db);
+		return nullptr;
 	}
-	if (_databases.find(dbpath) != _databases.end()) {
+
+	setDefaultPragmas(db);
+	sqlite3_busy_timeout(db, 5000); // another process like the game might use the database as well
+
+	auto connection = std::make_shared<Connection>();
+	connection->db = db;
+	_connections.insert(std::make_pair(dbpath, connection));
+
+	return connection;
+}
+
+void Database::setDefaultPragmas(sqlite3 * db) {
+	// readers don't block the writer and the other way around, only the commit of a transaction syncs
+	sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "PRAGMA cache_size = -2000;", nullptr, nullptr, nullptr); // default of sqlite, bulk inserts raise it
+}
+
+sqlite3_stmt * Database::prepare(Connection & connection, const std::string & query, bool cache, DBError & error) {
+	if (cache) {
+		const auto it = connection.statements.find(query);
+		if (it != connection.statements.end()) return it->second;
+	}
+
+	sqlite3_stmt * stmt;
+	const int r = sqlite3_prepare_v2(connection.db, query.c_str(), -1, &stmt, nullptr);
+	if (r != SQLITE_OK) {
 		error.error = true;
-		error.errMsg = "Database already open!";
-		return;
+		error.errMsg = std::string("prepare(): ") + sqlite3_errmsg(connection.db);
+		return nullptr;
 	}
-	error.error = false;
-	_databases.insert(std::make_pair(dbpath, db));
+
+	if (cache) {
+		if (connection.statements.size() >= MAX_CACHED_STATEMENTS) {
+			for (const auto & p : connection.statements) {
+				sqlite3_finalize(p.second);
+			}
+			connection.statements.clear();
+		}
+		connection.statements.insert(std::make_pair(query, stmt));
+	}
+
+	return stmt;
 }
 
-void Database::close(const std::string & dbpath, DBError & error) {
-	std::lock_guard<std::mutex> lg(_lock); // lock the database vector and sqlite
-	if (_databases.find(dbpath) == _databases.end()) {
-		error.error = true;
-		error.errMsg = "Database not open!";
-		return;
+void Database::finish(Connection &, sqlite3_stmt * stmt, bool cached) {
+	if (cached) {
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	} else {
+		sqlite3_finalize(stmt);
 	}
-	error.error = false;
-	sqlite3_close(_databases[dbpath]);
+}
+
+int Database::bindParameter(sqlite3_stmt * stmt, int index, double value) {
+	return sqlite3_bind_double(stmt, index, value);
+}
+
+int Database::bindParameter(sqlite3_stmt * stmt, int index, const std::string & value) {
+	return sqlite3_bind_text(stmt, index, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+}
 
-	_databases.erase(dbpath);
+int Database::bindParameter(sqlite3_stmt * stmt, int index, const char * value) {
+	return sqlite3_bind_text(stmt, index, value, -1, SQLITE_TRANSIENT);
 }
 
 template<>
@@ -32,8 +32,9 @@
 using namespace spine::utils;
 
 DownloadQueue * DownloadQueue::instance = nullptr;
+const int DownloadQueue::MAX_RUNNING = 2;
 
-DownloadQueue::DownloadQueue() : _taskbarButton(nullptr), _taskbarProgress(nullptr), _running(false) {
+DownloadQueue::DownloadQueue() : _taskbarButton(nullptr), _taskbarProgress(nullptr), _runningTotalBytes(0), _runningDownloadedBytes(0) {
 	instance = this;
 	
 #ifdef Q_OS_WIN
@@ -72,9 +73,9 @@ void DownloadQueue::setWindow(QMainWindow * mainWindow) {
 void DownloadQueue::cancel(MultiFileDownloader * downloader) {
 	if (!downloader) return;
 	
-	if (_running == downloader) {
-		_running->cancel();
-		_running = nullptr;
+	if (_running.contains(downloader)) {
+		downloader->cancel();
+		removeRunning(downloader);
 		checkQueue();
 		return;
 	}
@@ -83,29 +84,23 @@ void DownloadQueue::cancel(MultiFileDownloader * downloader) {
 }
 
 void DownloadQueue::checkQueue() {
-	if (_running) return;
+	while (_running.size() < MAX_RUNNING && !_queue.isEmpty()) {
+		MultiFileDownloader * downloader = _queue.dequeue();
 
-	do {
-		if (_queue.isEmpty()) return;
-		
-		_running = _queue.dequeue();
-
-		if (_cancelled.contains(_running)) {
-			_cancelled.remove(_running);
-			emit _running->downloadFailed(DownloadError::CanceledError);
-			_running = nullptr;
+		if (_cancelled.contains(downloader)) {
+			_cancelled.remove(downloader);
+			emit downloader->downloadFailed(DownloadError::CanceledError);
 			continue;
 		}
 
-		break;
-	} while (true);
-	
-#ifdef Q_OS_WIN
-	_taskbarProgress->setMaximum(static_cast<int>(_totalBytesMap[_running] / 1024 + 1));
-	_taskbarProgress->show();
-#endif
-	
-	_running->startDownload();
+		_running << downloader;
+		_runningTotalBytes += _totalBytesMap[downloader];
+		_runningDownloadedBytes += _downloadedBytesMap[downloader];
+
+		updateTaskbar();
+
+		downloader->startDownload();
+	}
 }
 
 void DownloadQueue::updateTotalBytes(qint64 bytes) {
@@ -121,26 +116,46 @@ void DownloadQueue::updateTotalBytes(qint64 bytes) {
 void DownloadQueue::downloadedBytes(qint64 bytes) {
 	const auto * downloader = dynamic_cast<const MultiFileDownloader *>(sender());
 
+	if (_running.contains(downloader)) {
+		_runningDownloadedBytes += bytes - _downloadedBytesMap[downloader];
+	}
+
 	_downloadedBytesMap[downloader] = bytes;
 	
-#ifdef Q_OS_WIN
-	_taskbarProgress->setValue(static_cast<int>(bytes / 1024));
-#endif
+	updateTaskbar();
 }
 
 void DownloadQueue::finishedDownload() {
 	const auto * downloader = dynamic_cast<const MultiFileDownloader *>(sender());
 
+	removeRunning(downloader);
+
 	_totalBytesMap.remove(downloader);
 	_downloadedBytesMap.remove(downloader);
 
-	_running = nullptr;
-
 	sender()->deleteLater();
-	
-#ifdef Q_OS_WIN
-	_taskbarProgress->hide();
-#endif
 
 	checkQueue();
 }
+
+void DownloadQueue::removeRunning(const MultiFileDownloader * downloader) {
+	if (!_running.remove(downloader)) return;
+
+	_runningTotalBytes -= _totalBytesMap[downloader];
+	_runningDownloadedBytes -= _downloadedBytesMap[downloader];
+
+	updateTaskbar();
+}
+
+void DownloadQueue::updateTaskbar() {
+#ifdef Q_OS_WIN
+	if (_running.isEmpty()) {
+		_taskbarProgress->hide();
+		return;
+	}
+
+	_taskbarProgress->setMaximum(static_cast<int>(_runningTotalBytes / 1024 + 1));
+	_taskbarProgress->setValue(static_cast<int>(_runningDownloadedBytes / 1024));
+	_taskbarProgress->show();
+#endif
+}
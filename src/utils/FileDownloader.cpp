@@ -18,15 +18,15 @@
 
 #include "FileDownloader.h"
 
-#include "utils/Compression.h"
+#include <algorithm>
+
 #include "utils/Config.h"
 #include "utils/Conversion.h"
 #include "utils/Hashing.h"
+#include "utils/StreamingUncompressor.h"
 
 #include "utils/ErrorReporting.h"
 
-#include "boost/iostreams/filter/zlib.hpp"
-
 #include "clockUtils/log/Log.h"
 
 #include <QDir>
@@ -38,6 +38,8 @@
 #include <QNetworkReply>
 #include <QProcess>
 #include <QSettings>
+#include <QThreadStorage>
+#include <QTimer>
 #include <QtConcurrentRun>
 
 #include "zipper/unzipper.h"
@@ -49,26 +51,32 @@
 
 using namespace spine::utils;
 
+namespace {
+	constexpr qint64 SEGMENT_THRESHOLD = 64 * 1024 * 1024;
+	constexpr qint64 MIN_SEGMENT_SIZE = 16 * 1024 * 1024;
+	constexpr int MAX_SEGMENTS = 4;
+	constexpr int MAX_RESUME_ATTEMPTS = 5;
+	constexpr int RESUME_DELAY = 2000; // milliseconds, multiplied with the attempt
+}
+
 FileDownloader::FileDownloader(QUrl url, QString targetDirectory, QString fileName, QString hash, QObject * par) : FileDownloader(url, url, targetDirectory, fileName, hash, par) {
-	connect(this, &FileDownloader::retry, this, &FileDownloader::startDownload, Qt::QueuedConnection); // queue to process potential errors earlier so they get blocked
 }
 
-FileDownloader::FileDownloader(QUrl url, QUrl fallbackUrl, QString targetDirectory, QString fileName, QString hash, QObject * par) : QObject(par), _url(url), _fallbackUrl(fallbackUrl), _targetDirectory(targetDirectory), _fileName(fileName), _hash(hash), _filesize(-1), _outputFile(nullptr), _finished(false), _retried(false), _blockErrors(false) {
+FileDownloader::FileDownloader(QUrl url, QUrl fallbackUrl, QString targetDirectory, QString fileName, QString hash, QObject * par) : QObject(par), _url(url), _fallbackUrl(fallbackUrl), _targetDirectory(targetDirectory), _fileName(fileName), _hash(hash), _filesize(-1), _acceptRanges(false), _uncompressor(nullptr), _resumeAttempts(0), _finished(false), _failed(false) {
 	connect(this, &FileDownloader::retry, this, &FileDownloader::startDownload, Qt::QueuedConnection); // queue to process potential errors earlier so they get blocked
 }
 
 FileDownloader::~FileDownloader() {
-	delete _outputFile;
+	closeSegments();
+	delete _uncompressor;
 }
 
 void FileDownloader::requestFileSize() {
 	const QNetworkRequest request(_url);
-	auto * networkAccessManager = new QNetworkAccessManager(this);
-	QNetworkReply * reply = networkAccessManager->head(request);
+	QNetworkReply * reply = getNetworkAccessManager()->head(request);
 	reply->setReadBufferSize(Config::downloadRate * 8);
 	connect(reply, &QNetworkReply::sslErrors, this, &FileDownloader::sslErrors);
 	connect(reply, &QNetworkReply::finished, this, &FileDownloader::determineFileSize);
-	connect(reply, &QNetworkReply::finished, networkAccessManager, &QObject::deleteLater);
 	connect(this, &FileDownloader::abort, reply, &QNetworkReply::abort);
 }
 
@@ -76,12 +84,23 @@ QString FileDownloader::getFileName() const {
 	return _fileName;
 }
 
+QUrl FileDownloader::getUrl() const {
+	return _url;
+}
+
+int FileDownloader::getConnectionCount() const {
+	if (!_acceptRanges || _filesize < SEGMENT_THRESHOLD) return 1;
+
+	return static_cast<int>(std::min<qint64>(MAX_SEGMENTS, _filesize / MIN_SEGMENT_SIZE));
+}
+
 void FileDownloader::cancel() {
 	emit abort();
 }
 
 void FileDownloader::startDownload() {
-	_blockErrors = false;
+	_failed = false;
+	_resumeAttempts = 0;
 	
 	if (Config::extendedLogging) {
 		LOGINFO("Starting Download of file " << _fileName.toStdString() << " from " << _url.toString().toStdString())
@@ -144,84 +163,154 @@ void FileDownloader::startDownload() {
 		emit fileSucceeded();
 		return;
 	}
-	_outputFile = new QFile(_targetDirectory + "/" + _fileName);
-	if (!_outputFile->open(QIODevice::WriteOnly)) {
-		if (Config::extendedLogging) {
-			LOGINFO("Can't open file for output")
+
+	closeSegments();
+	_segments.clear();
+
+	delete _uncompressor;
+	_uncompressor = nullptr;
+
+	const int segmentCount = getConnectionCount();
+
+	for (int i = 0; i < segmentCount; i++) {
+		Segment segment;
+		segment.start = segmentCount == 1 ? 0 : _filesize * i / segmentCount;
+		segment.end = segmentCount == 1 ? -1 : _filesize * (i + 1) / segmentCount - 1;
+		segment.file = new QFile(segmentCount == 1 ? getPartPath() : getPartPath() + "." + QString::number(i));
+		segment.reply = nullptr;
+		segment.checkedRange = false;
+
+		// whatever is already on disk is from an earlier attempt and doesn't need to be downloaded again
+		if (!segment.file->open(QIODevice::ReadWrite | QIODevice::Append)) {
+			if (Config::extendedLogging) {
+				LOGINFO("Can't open file for output")
+			}
+
+			delete segment.file;
+			closeSegments();
+
+			emit downloadFinished();
+			emit fileFailed(DownloadError::UnknownError);
+			return;
 		}
 
-		emit downloadFinished();
-		emit fileFailed(DownloadError::UnknownError);
-		return;
+		segment.received = segment.file->size();
+
+		if (segment.end != -1 && segment.received > segment.end - segment.start + 1) {
+			segment.file->resize(0);
+			segment.received = 0;
+		}
+
+		_segments.append(segment);
 	}
-	const QNetworkRequest request(_url);
-	auto * networkAccessManager = new QNetworkAccessManager(this);
-	QNetworkReply * reply = networkAccessManager->get(request);
-	reply->setReadBufferSize(Config::downloadRate * 8);
-	connect(reply, &QNetworkReply::downloadProgress, this, &FileDownloader::updateDownloadProgress);
-	connect(reply, &QNetworkReply::readyRead, this, &FileDownloader::writeToFile);
-	connect(reply, &QNetworkReply::finished, this, &FileDownloader::fileDownloaded);
-	connect(reply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::error), this, &FileDownloader::networkError);
-	connect(reply, &QNetworkReply::sslErrors, this, &FileDownloader::sslErrors);
-	connect(this, &FileDownloader::abort, reply, &QNetworkReply::abort);
-	connect(reply, &QNetworkReply::finished, networkAccessManager, &QObject::deleteLater);
+
+	// a fresh single stream is uncompressed and hashed while it arrives, everything else in one pass after the download
+	if (_segments.size() == 1 && _segments[0].received == 0) {
+		const bool compressed = QFileInfo(_fileName).suffix().compare("z", Qt::CaseInsensitive) == 0;
+
+		_uncompressor = new StreamingUncompressor(compressed, compressed ? getPartPath() + ".out" : QString());
+
+		if (!_uncompressor->open()) {
+			delete _uncompressor;
+			_uncompressor = nullptr;
+		}
+	}
+
 	emit startedDownload(_fileName);
-}
+	emit downloadProgress(getReceivedBytes());
+
+	bool complete = true;
+
+	for (int i = 0; i < _segments.size(); i++) {
+		const Segment & segment = _segments[i];
+
+		// a single stream of unknown size has to be requested anyway, the server answers with 416 if nothing is missing
+		if (segment.end == -1 || segment.received < segment.end - segment.start + 1) {
+			complete = false;
+			startSegment(i);
+		}
+	}
+
+	if (complete) {
+		closeSegments();
+
+		emit downloadFinished();
 
-void FileDownloader::updateDownloadProgress(qint64 bytesReceived, qint64) {
-	emit downloadProgress(bytesReceived);
+		uncompressAndHash();
+	}
 }
 
 void FileDownloader::fileDownloaded() {
 	auto * reply = dynamic_cast<QNetworkReply *>(sender());
+	const int index = findSegment(reply);
 
-	emit downloadFinished();
+	reply->deleteLater();
+
+	if (index == -1 || _failed) return;
+
+	Segment & segment = _segments[index];
+	segment.reply = nullptr;
+
+	auto err = reply->error();
+	const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+	if (err == QNetworkReply::NetworkError::NoError) {
+		if (!writeData(segment, reply->readAll())) return; // the rest
+
+		// connection closed before the segment was complete
+		if (segment.end != -1 && segment.received < segment.end - segment.start + 1) {
+			err = QNetworkReply::NetworkError::RemoteHostClosedError;
+		}
+	} else if (statusCode == 416 && segment.end == -1 && segment.received > 0) {
+		err = QNetworkReply::NetworkError::NoError; // the part was already complete
+	}
 
-	const auto err = reply->error();
-	
 	if (err == QNetworkReply::NetworkError::NoError) {
+		for (const Segment & s : _segments) {
+			if (s.reply) return; // other segments are still running
+		}
+
 		if (Config::extendedLogging) {
 			LOGINFO("Uncompressing file")
 		}
-		const QByteArray data = reply->readAll(); // the rest
-		_outputFile->write(data);
-		_outputFile->close();
-		
-		delete _outputFile;
-		_outputFile = nullptr;
 
-		uncompressAndHash();		
-	} else {
-		const auto fileSize = _outputFile->size();
+		closeSegments();
 
-		_outputFile->close();
-		
-		_outputFile->remove();
-		
-		delete _outputFile;
-		_outputFile = nullptr;
-		
-		if (_retried) {
-			LOGERROR("Unknown Error: " << reply->error() << ", " << q2s(reply->errorString()))
-			if (reply->error() != QNetworkReply::OperationCanceledError) {
-				ErrorReporting::report(QString("Unknown Error during download: %1, %2 (%3)").arg(reply->error()).arg(reply->errorString()).arg(_url.toString()));
-			}
-			emit fileFailed(DownloadError::UnknownError);
-		} else {
-			delete _outputFile;
-			_outputFile = nullptr;
-			
-			_retried = true;
-			_blockErrors = true;
+		emit downloadFinished();
 
-			_url = _fallbackUrl;
-			
-			emit downloadProgress(-fileSize);
+		uncompressAndHash();
+
+		return;
+	}
 
-			emit retry();
+	if (err == QNetworkReply::NetworkError::OperationCanceledError) {
+		failDownload(DownloadError::CanceledError);
+		return;
+	}
+
+	if (_resumeAttempts < MAX_RESUME_ATTEMPTS) {
+		_resumeAttempts++;
+
+		// the mirror might be the problem, so the later attempts use the fallback
+		if (_resumeAttempts > MAX_RESUME_ATTEMPTS / 2) {
+			_url = _fallbackUrl;
 		}
+
+		LOGWARN("Resuming download of " << q2s(_fileName) << " at " << segment.start + segment.received << " after error " << err << ", " << q2s(reply->errorString()))
+
+		QTimer::singleShot(RESUME_DELAY * _resumeAttempts, this, [this, index]() {
+			if (_failed || index >= _segments.size() || _segments[index].reply || !_segments[index].file) return;
+
+			startSegment(index);
+		});
+
+		return;
 	}
-	reply->deleteLater();
+
+	LOGERROR("Unknown Error: " << err << ", " << q2s(reply->errorString()))
+	ErrorReporting::report(QString("Unknown Error during download: %1, %2 (%3)").arg(err).arg(reply->errorString()).arg(_url.toString()));
+
+	failDownload(DownloadError::NetworkError);
 }
 
 void FileDownloader::determineFileSize() {
@@ -241,6 +330,7 @@ void FileDownloader::determineFileSize() {
 	}
 	
 	const qlonglong filesize = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+	_acceptRanges = reply->rawHeader("Accept-Ranges").trimmed().toLower() == "bytes";
 	reply->deleteLater();
 	_filesize = filesize;
 
@@ -253,26 +343,51 @@ void FileDownloader::determineFileSize() {
 
 void FileDownloader::writeToFile() {
 	auto * reply = dynamic_cast<QNetworkReply *>(sender());
-	const QByteArray data = reply->readAll();
-	_outputFile->write(data);
-	const QFileDevice::FileError err = _outputFile->error();
-	if (err != QFileDevice::NoError) {
-		reply->abort();
-		emit downloadFinished();
-		emit fileFailed(err == QFileDevice::ResizeError || err == QFileDevice::ResourceError ? DownloadError::DiskSpaceError : DownloadError::UnknownError);
+	const int index = findSegment(reply);
+
+	if (index == -1 || _failed) return;
+
+	Segment & segment = _segments[index];
+
+	const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+	// body of an error page, fileDownloaded handles the error itself
+	if (statusCode != 200 && statusCode != 206) {
+		reply->readAll();
+		return;
 	}
-}
 
-void FileDownloader::networkError(QNetworkReply::NetworkError err) {
-	if (_blockErrors) return;
-	
-	emit downloadFinished();
-	
-	if (err == QNetworkReply::NetworkError::OperationCanceledError) {
-		emit fileFailed(DownloadError::CanceledError);
-	} else {
-		emit fileFailed(DownloadError::NetworkError);
+	if (!segment.checkedRange) {
+		segment.checkedRange = true;
+
+		// the server ignored the Range header and sends the complete file
+		if (statusCode == 200 && (segment.start > 0 || segment.received > 0)) {
+			if (segment.start > 0) {
+				LOGWARN("Server doesn't support ranges, downloading " << q2s(_fileName) << " again in one piece")
+
+				_acceptRanges = false;
+				_failed = true; // ignore the aborted replies
+
+				closeSegments();
+
+				for (int i = 0; i < _segments.size(); i++) {
+					QFile::remove(getSegmentPath(i));
+				}
+
+				emit retry();
+				return;
+			}
+
+			segment.file->resize(0);
+			segment.received = 0;
+
+			// already got the beginning of the stream
+			delete _uncompressor;
+			_uncompressor = nullptr;
+		}
 	}
+
+	writeData(segment, reply->readAll());
 }
 
 void FileDownloader::sslErrors(const QList<QSslError> & errors) {
@@ -287,68 +402,238 @@ void FileDownloader::sslErrors(const QList<QSslError> & errors) {
 	}
 }
 
+QNetworkAccessManager * FileDownloader::getNetworkAccessManager() {
+	// QNetworkAccessManager keeps up to six connections per host alive, but only if all requests go through the same instance
+	static QThreadStorage<QNetworkAccessManager *> networkAccessManagers;
+
+	if (!networkAccessManagers.hasLocalData()) {
+		networkAccessManagers.setLocalData(new QNetworkAccessManager());
+	}
+
+	return networkAccessManagers.localData();
+}
+
+QString FileDownloader::getPartPath() const {
+	// the hash is part of the name, so a part of an older version of the file is never continued
+	return _targetDirectory + "/" + _fileName + "." + _hash.left(16) + ".part";
+}
+
+QString FileDownloader::getSegmentPath(int index) const {
+	return _segments.size() == 1 ? getPartPath() : getPartPath() + "." + QString::number(index);
+}
+
+int FileDownloader::findSegment(QNetworkReply * reply) const {
+	for (int i = 0; i < _segments.size(); i++) {
+		if (_segments[i].reply == reply) return i;
+	}
+
+	return -1;
+}
+
+qint64 FileDownloader::getReceivedBytes() const {
+	qint64 received = 0;
+
+	for (const Segment & segment : _segments) {
+		received += segment.received;
+	}
+
+	return received;
+}
+
+void FileDownloader::startSegment(int index) {
+	Segment & segment = _segments[index];
+	segment.checkedRange = false;
+
+	QNetworkRequest request(_url);
+
+	const qint64 offset = segment.start + segment.received;
+
+	if (offset > 0 || segment.end != -1) {
+		request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-" + (segment.end == -1 ? QByteArray() : QByteArray::number(segment.end)));
+	}
+
+	QNetworkReply * reply = getNetworkAccessManager()->get(request);
+	reply->setReadBufferSize(Config::downloadRate * 8);
+	segment.reply = reply;
+
+	connect(reply, &QNetworkReply::readyRead, this, &FileDownloader::writeToFile);
+	connect(reply, &QNetworkReply::finished, this, &FileDownloader::fileDownloaded);
+	connect(reply, &QNetworkReply::sslErrors, this, &FileDownloader::sslErrors);
+	connect(this, &FileDownloader::abort, reply, &QNetworkReply::abort);
+}
+
+bool FileDownloader::writeData(Segment & segment, const QByteArray & data) {
+	qint64 size = data.size();
+
+	if (segment.end != -1) {
+		size = std::min(size, segment.end - segment.start + 1 - segment.received);
+	}
+
+	if (size <= 0) return true;
+
+	segment.file->write(data.constData(), size);
+
+	const QFileDevice::FileError err = segment.file->error();
+
+	if (err != QFileDevice::NoError) {
+		failDownload(err == QFileDevice::ResizeError || err == QFileDevice::ResourceError ? DownloadError::DiskSpaceError : DownloadError::UnknownError);
+		return false;
+	}
+
+	segment.received += size;
+
+	// on invalid data the pass after the download reports the error
+	if (_uncompressor && !_uncompressor->add(data.constData(), size)) {
+		delete _uncompressor;
+		_uncompressor = nullptr;
+	}
+
+	emit downloadProgress(getReceivedBytes());
+
+	return true;
+}
+
+void FileDownloader::closeSegments() {
+	for (Segment & segment : _segments) {
+		if (segment.reply) {
+			disconnect(segment.reply, nullptr, this, nullptr);
+			segment.reply->abort();
+			segment.reply->deleteLater();
+			segment.reply = nullptr;
+		}
+
+		if (segment.file) {
+			segment.file->close();
+			delete segment.file;
+			segment.file = nullptr;
+		}
+	}
+}
+
+void FileDownloader::failDownload(DownloadError error) {
+	if (_failed) return;
+
+	_failed = true;
+
+	closeSegments();
+
+	delete _uncompressor;
+	_uncompressor = nullptr;
+
+	emit downloadFinished();
+	emit fileFailed(error);
+}
+
 void FileDownloader::uncompressAndHash() {
 	QtConcurrent::run([this]() {
-		// try a sleep in case file handle is closed with some delay
-		// for some reason it happens sometimes that uncompressing fails, but we don't have any meaningful error message
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		
-		QFileInfo fi(_fileName);
-		const QString fileNameBackup = _fileName;
+		QString hash;
+		const DownloadError error = finishPartFile(hash);
 
-		auto suffix = fi.suffix();
-		
-		// compressed files always end with .z
-		// in this case, uncompress, drop file extension and proceeed		
-		if (suffix.compare("z", Qt::CaseInsensitive) == 0) {
-			try {
-				Compression::uncompress(_targetDirectory + "/" + _fileName, true); // remove compressed download now
-			} catch (boost::iostreams::zlib_error & e) {
-				LOGERROR("Exception: " << e.what())
-				ErrorReporting::report(QString("Uncompressing of %1 failed: %2 (%3)").arg(_fileName).arg(e.what()).arg(_url.toString()));
-			}
-			_fileName.chop(2);
+		if (error == DownloadError::HashError) {
+			LOGERROR("Uncompressing failed: " << _fileName.toStdString())
+			emit fileFailed(DownloadError::HashError);
+			ErrorReporting::report(QString("Uncompressing of %1 failed (%2)").arg(_fileName).arg(_url.toString()));
+			return;
 		}
 
-		fi = QFileInfo(_fileName);
-		suffix = fi.suffix();
-
-		// zip case
-		if (suffix.compare("zip", Qt::CaseInsensitive) == 0) {
-			handleZip();
-			
+		if (error != DownloadError::NoError) {
+			LOGERROR("Can't write downloaded file: " << _fileName.toStdString())
+			emit fileFailed(error);
 			return;
 		}
-		
-		const bool b = Hashing::checkHash(_targetDirectory + "/" + _fileName, _hash);
-		if (b) {
-			if (_fileName.startsWith("vc") && _fileName.endsWith(".exe")) {
-				handleVcRedist();
-			} else if (_fileName == "directx_Jun2010_redist.exe") {
-				handleDirectX();
-			} else {
-				emit fileSucceeded();
-			}
-		} else {
+
+		if (hash != _hash) {
 			LOGERROR("Hash invalid: " << _fileName.toStdString())
 			emit fileFailed(DownloadError::HashError);
 			ErrorReporting::report(QString("Hash invalid: %1 (%2)").arg(_fileName).arg(_url.toString()));
+			return;
+		}
+
+		const auto suffix = QFileInfo(_fileName).suffix();
+
+		// zip case
+		if (suffix.compare("zip", Qt::CaseInsensitive) == 0) {
+			handleZip();
+		} else if (_fileName.startsWith("vc") && _fileName.endsWith(".exe")) {
+			handleVcRedist();
+		} else if (_fileName == "directx_Jun2010_redist.exe") {
+			handleDirectX();
+		} else {
+			emit fileSucceeded();
 		}
 	});
 }
 
-void FileDownloader::handleZip() {
-	const auto fullPath = _targetDirectory + "/" + _fileName;
-	{
-		const bool b = Hashing::checkHash(fullPath, _hash);
-		if (!b) {
-			LOGERROR("Hash invalid: " << _fileName.toStdString())
-			emit fileFailed(DownloadError::HashError);
-			ErrorReporting::report(QString("Hash invalid: %1 (%2)").arg(_fileName).arg(_url.toString()));
-			return;
+DownloadError FileDownloader::finishPartFile(QString & hash) {
+	// compressed files always end with .z, they are stored without that extension
+	const bool compressed = QFileInfo(_fileName).suffix().compare("z", Qt::CaseInsensitive) == 0;
+
+	QString realName = _fileName;
+
+	if (compressed) {
+		realName.chop(2);
+	}
+
+	const QString outputPath = getPartPath() + ".out";
+
+	// an uncompressed file downloaded in one piece is the final file already
+	const bool copy = compressed || _segments.size() > 1;
+
+	// the download was streamed through the uncompressor already unless it was resumed or segmented
+	if (!_uncompressor || !_uncompressor->finish()) {
+		delete _uncompressor;
+		_uncompressor = new StreamingUncompressor(compressed, copy ? outputPath : QString());
+
+		bool b = _uncompressor->open();
+
+		for (int i = 0; i < _segments.size() && b; i++) {
+			b = _uncompressor->addFile(getSegmentPath(i));
+		}
+
+		if (!b || !_uncompressor->finish()) {
+			const bool writeError = _uncompressor->isWriteError();
+
+			delete _uncompressor;
+			_uncompressor = nullptr;
+
+			QFile::remove(outputPath);
+
+			if (writeError) return DownloadError::DiskSpaceError;
+
+			// invalid data, resuming it later makes no sense
+			for (int i = 0; i < _segments.size(); i++) {
+				QFile::remove(getSegmentPath(i));
+			}
+
+			return DownloadError::HashError;
+		}
+	}
+
+	hash = _uncompressor->getHash();
+
+	delete _uncompressor;
+	_uncompressor = nullptr;
+
+	const QString targetPath = _targetDirectory + "/" + realName;
+
+	QFile::remove(targetPath);
+
+	if (copy) {
+		for (int i = 0; i < _segments.size(); i++) {
+			QFile::remove(getSegmentPath(i));
 		}
 	}
 
+	if (!QFile::rename(copy ? outputPath : getPartPath(), targetPath)) return DownloadError::UnknownError;
+
+	_fileName = realName;
+
+	return DownloadError::NoError;
+}
+
+void FileDownloader::handleZip() {
+	const auto fullPath = _targetDirectory + "/" + _fileName;
+
 	{
 		zipper::Unzipper unzipper(q2s(fullPath));
 		const bool b = unzipper.extract(q2s(_targetDirectory));
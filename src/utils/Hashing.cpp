@@ -18,23 +18,45 @@
 
 #include "Hashing.h"
 
+#include <algorithm>
+
 #include <QCryptographicHash>
 #include <QFile>
 
 using namespace spine::utils;
 
+namespace {
+	// mapped in windows so large files also fit into the address space of the 32 bit client
+	constexpr qint64 MAP_SIZE = 64 * 1024 * 1024;
+}
+
 bool Hashing::hash(const QString & file, QString & hash) {
 	QFile f(file);
 	
 	if (!f.open(QFile::ReadOnly)) return false;
 	
 	QCryptographicHash cryptoHash(QCryptographicHash::Sha512);
-	if (cryptoHash.addData(&f)) {
-		hash = QString::fromLatin1(cryptoHash.result().toHex());
-		return true;
+
+	const qint64 size = f.size();
+	qint64 offset = 0;
+
+	while (offset < size) {
+		const qint64 length = std::min(MAP_SIZE, size - offset);
+		uchar * data = f.map(offset, length);
+
+		if (!data) break; // not supported by the file system, read it instead
+
+		cryptoHash.addData(reinterpret_cast<const char *>(data), static_cast<int>(length));
+		f.unmap(data);
+
+		offset += length;
 	}
-	
-	return false;
+
+	if (offset < size && (!f.seek(offset) || !cryptoHash.addData(&f))) return false;
+
+	hash = QString::fromLatin1(cryptoHash.result().toHex());
+
+	return true;
 }
 
 bool Hashing::checkHash(const QString & file, const QString & referenceHash) {
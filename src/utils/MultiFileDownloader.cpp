@@ -18,18 +18,39 @@
 
 #include "utils/MultiFileDownloader.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "utils/FileDownloader.h"
 
+#include <QSet>
+#include <QTimer>
+
 using namespace spine::utils;
 
-MultiFileDownloader::MultiFileDownloader(QObject * par) : QObject(par), _counter(0), _maxSize(0), _downloadFilesCount(0) {
+const int MultiFileDownloader::MAX_DOWNLOADS = 12;
+const int MultiFileDownloader::MAX_CONNECTIONS_PER_HOST = 6; // QNetworkAccessManager doesn't open more connections per host anyway
+const int MultiFileDownloader::MAX_SIZE_REQUESTS = 6;
+
+thread_local QHash<QString, int> MultiFileDownloader::_connectionsPerHost;
+thread_local QList<MultiFileDownloader *> MultiFileDownloader::_instances;
+
+MultiFileDownloader::MultiFileDownloader(QObject * par) : QObject(par), _sizeRequests(0), _maxSize(0), _downloadedBytes(0), _downloadFilesCount(0), _started(false), _scheduling(false), _scheduleAgain(false) {
+	_instances.append(this);
+}
+
+MultiFileDownloader::~MultiFileDownloader() {
+	_instances.removeOne(this);
+
+	// files of a canceled or failed download might not have finished yet
+	for (auto it = _runningDownloads.begin(); it != _runningDownloads.end(); ++it) {
+		releaseConnections(it.value().first, it.value().second);
+	}
 }
 
 void MultiFileDownloader::addFileDownloader(FileDownloader * fileDownloader) {
-	_downloadStats.insert(fileDownloader, qMakePair(0, 100));
-	_downloadQueue.enqueue(fileDownloader);
+	_downloadStats.insert(fileDownloader, qMakePair(0, 0));
+	_downloadQueue.append(fileDownloader);
 
 	qRegisterMetaType<DownloadError>("DownloadError");
 
@@ -47,21 +68,25 @@ void MultiFileDownloader::startDownloads(qint64 maxSize) {
 		_maxSize = maxSize;
 		startDownload();
 	} else {
-		_currentIndex = _downloadStats.begin();
-		if (_currentIndex != _downloadStats.end()) {
-			emit startedDownload(_currentIndex.key()->getFileName());
-			_currentIndex.key()->requestFileSize();
+		if (!_downloadQueue.isEmpty()) {
+			emit startedDownload(_downloadQueue.first()->getFileName());
 		}
+		querySize();
 	}
 }
 
 void MultiFileDownloader::querySize() {
-	_currentIndex = _downloadStats.begin();
-	if (_currentIndex != _downloadStats.end() && _maxSize == 0) {
-		_currentIndex.key()->requestFileSize();
-	} else {
+	if (_downloadStats.isEmpty() || _maxSize != 0) {
 		emit totalBytes(_maxSize);
+		return;
 	}
+
+	// the HEAD requests are only about latency, so several of them run at once
+	for (auto it = _downloadStats.begin(); it != _downloadStats.end(); ++it) {
+		_sizeQueue.enqueue(it.key());
+	}
+
+	requestNextSizes();
 }
 
 void MultiFileDownloader::setSize(qint64 size) {
@@ -79,28 +104,48 @@ void MultiFileDownloader::startDownload() {
 		emit downloadSucceeded();
 		return;
 	}
-	
-	FileDownloader * fd = _downloadQueue.dequeue();
-	fd->startDownload();
+
+	_started = true;
+
+	// sizes are only known if they were queried, otherwise the order of adding stays
+	std::stable_sort(_downloadQueue.begin(), _downloadQueue.end(), [this](FileDownloader * a, FileDownloader * b) {
+		return _downloadStats.value(a).second > _downloadStats.value(b).second;
+	});
+
+	scheduleDownloads();
 }
 
 void MultiFileDownloader::startDownloadInternal() {
-	if (_downloadQueue.empty()) return;
-	
-	FileDownloader * fd = _downloadQueue.dequeue();
-	fd->startDownload();
+	auto * fd = dynamic_cast<FileDownloader *>(sender());
+	assert(fd);
+
+	// the FileDownloader might have switched to the fallback url meanwhile
+	const auto it = _runningDownloads.find(fd);
+
+	if (it == _runningDownloads.end()) return;
+
+	const QString host = it.value().first;
+	const int connections = it.value().second;
+	_runningDownloads.erase(it);
+
+	releaseConnections(host, connections);
+
+	scheduleDownloads();
 }
 
 void MultiFileDownloader::updateDownloadProgress(qint64 bytesReceived) {
 	auto * fd = dynamic_cast<FileDownloader *>(sender());
 	assert(fd);
-	_downloadStats[fd].first = bytesReceived;
-	qint64 sum = 0;
-	for (auto & downloadStat : _downloadStats) {
-		sum += downloadStat.first;
+
+	auto & stat = _downloadStats[fd];
+	_downloadedBytes += bytesReceived - stat.first;
+	stat.first = bytesReceived;
+
+	emit downloadProgress(_downloadedBytes);
+
+	if (_maxSize > 0) {
+		emit downloadProgressPercent(static_cast<qreal>(_downloadedBytes) / static_cast<qreal>(_maxSize));
 	}
-	emit downloadProgress(sum);
-	emit downloadProgressPercent(static_cast<qreal>(sum) / static_cast<qreal>(_maxSize));
 }
 
 void MultiFileDownloader::updateDownloadMax(qint64 bytesTotal) {
@@ -108,13 +153,14 @@ void MultiFileDownloader::updateDownloadMax(qint64 bytesTotal) {
 	assert(fd);
 	_maxSize += bytesTotal;
 	_downloadStats[fd].second = bytesTotal;
-	if (++_currentIndex != _downloadStats.end()) {
-		auto * nextFd = _currentIndex.key();
-		
-		nextFd->requestFileSize();
-	} else {
+	_sizeRequests--;
+
+	if (_sizeRequests == 0 && _sizeQueue.isEmpty()) {
 		emit totalBytes(_maxSize);
+		return;
 	}
+
+	requestNextSizes();
 }
 
 void MultiFileDownloader::finishedFile() {
@@ -123,3 +169,65 @@ void MultiFileDownloader::finishedFile() {
 		emit downloadSucceeded();
 	}
 }
+
+void MultiFileDownloader::scheduleDownloads() {
+	// starting a file can finish it right away (e.g. it exists already) and even run an event loop, so this isn't entered recursively
+	if (_scheduling) {
+		_scheduleAgain = true;
+		return;
+	}
+
+	_scheduling = true;
+
+	do {
+		_scheduleAgain = false;
+
+		// a host where the next file doesn't fit gets no smaller ones either, otherwise they could keep a segmented file from ever starting
+		QSet<QString> fullHosts;
+
+		for (auto it = _downloadQueue.begin(); it != _downloadQueue.end() && _runningDownloads.size() < MAX_DOWNLOADS;) {
+			FileDownloader * fd = *it;
+			const QString host = fd->getUrl().host();
+			const int connections = std::min(fd->getConnectionCount(), MAX_CONNECTIONS_PER_HOST);
+
+			if (fullHosts.contains(host) || _connectionsPerHost.value(host) + connections > MAX_CONNECTIONS_PER_HOST) {
+				fullHosts.insert(host);
+				++it;
+				continue;
+			}
+
+			_downloadQueue.erase(it);
+			_runningDownloads.insert(fd, qMakePair(host, connections));
+			_connectionsPerHost[host] += connections;
+
+			fd->startDownload();
+
+			// might have changed while the file was started
+			it = _downloadQueue.begin();
+		}
+	} while (_scheduleAgain);
+
+	_scheduling = false;
+}
+
+void MultiFileDownloader::releaseConnections(const QString & host, int connections) {
+	if ((_connectionsPerHost[host] -= connections) <= 0) {
+		_connectionsPerHost.remove(host);
+	}
+
+	for (MultiFileDownloader * mfd : _instances) {
+		if (mfd == this || !mfd->_started || mfd->_downloadQueue.isEmpty()) continue;
+
+		// queued, as this might be called while the other one is scheduling or from a destructor
+		QTimer::singleShot(0, mfd, [mfd]() {
+			mfd->scheduleDownloads();
+		});
+	}
+}
+
+void MultiFileDownloader::requestNextSizes() {
+	while (_sizeRequests < MAX_SIZE_REQUESTS && !_sizeQueue.isEmpty()) {
+		_sizeRequests++;
+		_sizeQueue.dequeue()->requestFileSize();
+	}
+}
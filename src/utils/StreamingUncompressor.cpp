@@ -0,0 +1,149 @@
+/*
+	This file is part of Spine.
+
+    Spine is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Spine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Spine.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Copyright 2021 Clockwork Origins
+
+#include "StreamingUncompressor.h"
+
+#include <cstring>
+
+using namespace spine::utils;
+
+namespace {
+	constexpr int BUFFER_SIZE = 256 * 1024;
+}
+
+StreamingUncompressor::StreamingUncompressor(bool compressed, const QString & targetFile) : _compressed(compressed), _target(targetFile), _hash(QCryptographicHash::Sha512), _initialized(false), _streamEnded(false), _failed(false), _writeError(false), _buffer(BUFFER_SIZE, Qt::Uninitialized) {
+	memset(&_stream, 0, sizeof(_stream));
+}
+
+StreamingUncompressor::~StreamingUncompressor() {
+	if (_initialized) {
+		inflateEnd(&_stream);
+	}
+}
+
+bool StreamingUncompressor::open() {
+	if (!_target.fileName().isEmpty() && !_target.open(QIODevice::WriteOnly)) {
+		_failed = true;
+		_writeError = true;
+		return false;
+	}
+
+	if (_compressed) {
+		if (inflateInit(&_stream) != Z_OK) {
+			_failed = true;
+			return false;
+		}
+		_initialized = true;
+	}
+
+	return true;
+}
+
+bool StreamingUncompressor::add(const char * data, qint64 size) {
+	if (_failed) return false;
+
+	if (!_compressed) return output(data, size);
+
+	// Compression writes nothing after the end of the zlib stream
+	if (_streamEnded) return size == 0;
+
+	_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+	_stream.avail_in = static_cast<uInt>(size);
+
+	do {
+		_stream.next_out = reinterpret_cast<Bytef *>(_buffer.data());
+		_stream.avail_out = static_cast<uInt>(_buffer.size());
+
+		const int err = inflate(&_stream, Z_NO_FLUSH);
+
+		if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+			_failed = true;
+			return false;
+		}
+
+		if (!output(_buffer.constData(), _buffer.size() - _stream.avail_out)) return false;
+
+		if (err == Z_STREAM_END) {
+			_streamEnded = true;
+			break;
+		}
+
+		if (err == Z_BUF_ERROR) break; // needs more input
+	} while (_stream.avail_in > 0 || _stream.avail_out == 0);
+
+	return true;
+}
+
+bool StreamingUncompressor::addFile(const QString & file) {
+	QFile f(file);
+
+	if (!f.open(QIODevice::ReadOnly)) {
+		_failed = true;
+		return false;
+	}
+
+	QByteArray block(BUFFER_SIZE, Qt::Uninitialized);
+
+	while (!f.atEnd()) {
+		const qint64 count = f.read(block.data(), block.size());
+
+		if (count < 0) {
+			_failed = true;
+			return false;
+		}
+
+		if (!add(block.constData(), count)) return false;
+	}
+
+	return true;
+}
+
+bool StreamingUncompressor::finish() {
+	if (_target.isOpen()) {
+		_target.close();
+
+		if (_target.error() != QFileDevice::NoError) {
+			_failed = true;
+			_writeError = true;
+		}
+	}
+
+	if (_compressed && !_streamEnded) {
+		_failed = true;
+	}
+
+	return !_failed;
+}
+
+QString StreamingUncompressor::getHash() const {
+	return QString::fromLatin1(_hash.result().toHex());
+}
+
+bool StreamingUncompressor::output(const char * data, qint64 size) {
+	if (size == 0) return true;
+
+	_hash.addData(data, static_cast<int>(size));
+
+	if (_target.isOpen() && _target.write(data, size) != size) {
+		_failed = true;
+		_writeError = true;
+		return false;
+	}
+
+	return true;
+}